@@ -86,6 +86,20 @@ class PortraitSetController {
         }
     }
 
+    /**
+     * Advances the animation of a single portrait view
+     *
+     * @param id    The portrait index
+     */
+    void updateView(int id) { _portraitViews[id]->update(); }
+
+    /**
+     * Returns a single portrait view to its first frame
+     *
+     * @param id    The portrait index
+     */
+    void resetView(int id) { _portraitViews[id]->reset(); }
+
     int getTickSpec(int id) { return _portraitViews[id]->getTick(); }
 
     /**
@@ -156,6 +170,18 @@ class PortraitSetController {
 
     Vec3 getPosition(int index) { return _portraits[index]->getPosition(); }
 
+    int getSize() { return static_cast<int>(_portraits.size()); }
+
+    float getBattery(int index) { return _portraits[index]->getBattery(); }
+
+    bool getState(int index) { return _portraits[index]->getState(); }
+
+    /** Sets the battery and on state of a portrait, as from a snapshot */
+    void restoreBattery(int index, float battery, bool state) {
+        _portraits[index]->updateBattery(battery);
+        _portraits[index]->updateState(state);
+    }
+
 #pragma mark Main Functions
   public:
     /**
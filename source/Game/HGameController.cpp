@@ -11,6 +11,7 @@
 //
 // This is in the same directory
 #include "HGameController.h"
+#include "LevelBenchmark.h"
 #include "LevelConstants.h"
 #include <box2d/b2_collision.h>
 #include <box2d/b2_contact.h>
@@ -72,6 +73,10 @@ HGameController::HGameController(
     _frameNumClose = 0;
     _didLose = false;
     _animates = true;
+    _indexfromspirit = -1;
+    _indicator = nullptr;
+    _camVersion = 0;
+    _hasCamState = false;
     _dimen = Application::get()->getDisplaySize();
     //    _offset = Vec3((_dimen.width)/2.0f,(_dimen.height)/2.0f,50);
     _offset = Vec3(0, 0, 50);
@@ -298,26 +303,46 @@ HGameController::HGameController(
     _world = physics2::ObstacleWorld::alloc(
         Rect(0, 0, DEFAULT_WIDTH, DEFAULT_HEIGHT), Vec2(0, 0));
 
-    _serializer = NetcodeSerializer::alloc();
-    _deserializer = NetcodeDeserializer::alloc();
-
     initJoystick();
     Vec3 currPos = (_hunter->getPosition());
+    _telemetry.init(_assets->get<JsonValue>("telemetry"), "hunter");
+    _outbox.setTelemetry(&_telemetry);
+    _reliable.setTelemetry(&_telemetry);
+    _telemetryLabel = scene2::Label::allocWithText(
+        Vec2::ZERO, " ", _assets->get<Font>("gamefont"));
+    _telemetryLabel->setAnchor(Vec2::ANCHOR_TOP_LEFT);
+    _telemetryLabel->setForeground(Color4::WHITE);
+    _telemetryLabel->setVisible(_telemetry.showOverlay());
+    _scene->addChild(_telemetryLabel);
+    auto network = _assets->get<JsonValue>("network");
+    _authoritative =
+        network != nullptr && network->getBool("authoritative movement", false);
+    _step = [this](Vec2 position, float forward, float rightward) {
+        return _movement.step(position, forward, rightward);
+    };
+    _predictor.reset();
+    _peers.reset();
+    _teammateShown.fill(false);
     if (_network) {
-        _network->receive([this](const std::string source,
-                                 const std::vector<std::byte>& data) {
-            processData(source, data);
+        _network->drain([this](const std::string& source,
+                               const NetEvent& event) {
+            processEvent(source, event);
         });
         checkConnection();
 
-        if (Vec2(currPos) != _lastpos) {
-            std::vector<float> pos = std::vector<float>();
-            pos.push_back(0);
-            pos.push_back(currPos.x);
-            pos.push_back(currPos.y);
-            transmitPos(pos);
-            _lastpos = Vec2(currPos);
-        }
+        _outbox.reset();
+        _positionStream.reset();
+        _clock.reset();
+        _reliable.init(Outbox::Route::Host);
+        _resume.reset(_network->getSession());
+        _unackedEvents.clear();
+        _desync.reset();
+        _messageLog.reset();
+        _hasDeadline = false;
+        if (!_authoritative) {
+            transmitPos(Vec2(currPos));
+        }
+        _lastpos = Vec2(currPos);
     }
 }
 
@@ -346,6 +371,7 @@ void HGameController::update(float dt) {
 
     if (_gameStatus == 0) {
         _status = START;
+        updateTimer();
         if (!_levelLoaded) {
             checkLevelLoaded();
         }
@@ -437,9 +463,6 @@ void HGameController::update(float dt) {
             _gameStatus = 1;
         }
 
-        for (auto& indicator : _indicators) {
-            indicator->setVisible(false);
-        }
         _filter->setPosition(_scene->getCamera()->getPosition());
         string seconds = std::to_string(int(_timer / 60) % 60).length() <= 1 ? "0" + std::to_string(int(_timer / 60) % 60) : std::to_string(int(_timer / 60) % 60);
         _timerLabel->setText(std::to_string(int(_timer / 60 / 60)) + ":" +
@@ -477,20 +500,11 @@ void HGameController::update(float dt) {
             _collision.beginContact(contact);
         };
 
-        if (_animates) {
-            _portraits->updatespecific(_indexfromspirit);
-            if (_indexfromspirit == 0) {
-                _indicators[_indicators.size() - 1]->setVisible(true);
-            }
-            if (_indexfromspirit == -1) {
-                for(auto id:_indicators){
-                    id->setVisible(false);
-                }
-            }
-            if (_indexfromspirit != 0 && _indexfromspirit != -1) {
-                _indicators[_indexfromspirit - 1]->setVisible(true);
-            }
+        // Only the watched portrait animates; changes arrive as messages
+        if (_animates && _indexfromspirit != -1) {
+            _portraits->updateView(_indexfromspirit);
         }
+        updateIndicator();
 
 
 
@@ -569,7 +583,9 @@ void HGameController::update(float dt) {
             if (_frameNumDoor <= 0) {
                 //            _frameNumDoor=12;
                 _doortrigger = false;
-                transmitUnlockDoor(_doorslocked[_currdoorindex]);
+                // The door has already left _doorslocked
+                _movement.setLocked(_currdoor, false);
+                transmitUnlockDoor(_currdoor);
             }
         }
 
@@ -596,6 +612,10 @@ void HGameController::update(float dt) {
         float forward = _inputController->getForward();
 
         float rightward = _inputController->getRight();
+        if (_bot != nullptr) {
+            forward = _bot->getForward();
+            rightward = _bot->getRight();
+        }
         _threehearts->setPosition(_scene->getCamera()->getPosition() +
                                                 Vec2(-150 - 850, 500));
         _twohearts->setPosition(_scene->getCamera()->getPosition() +
@@ -612,6 +632,7 @@ void HGameController::update(float dt) {
         _count++;
         if (_count == 6) {
             _hunter->setViewFrame(forward, rightward, _beingKilled);
+            updateTeammates(true);
             if (_heart_frame >= 11) {
                 _heart_frame = 0;
             }
@@ -648,55 +669,17 @@ void HGameController::update(float dt) {
             _move = false;
         }
 
-        for (auto obsta : _obstaclePoly) {
-            if (obsta.contains(_shadow->getPosition() + Vec2(40, 0) +
-                               Vec2(rightward * _hunter->getVelocity().x,
-                                    forward * _hunter->getVelocity().y)) or
-                obsta.contains(_shadow->getPosition() - Vec2(40, 0) +
-                               Vec2(rightward * _hunter->getVelocity().x,
-                                    forward * _hunter->getVelocity().y)) or
-                obsta.contains(_shadow->getPosition() +
-                               Vec2(rightward * _hunter->getVelocity().x,
-                                    forward * _hunter->getVelocity().y))) {
-                _move = false;
+        // A sprung trap holds the hunter in place
+        _ismovedonece = false;
+        for (int i = 0; i < _hunter->getTrapSize(); i++) {
+            if (_hunter->getTraps()[i]->getTrigger()) {
+                _ismovedonece = true;
             }
         }
-
-        if (_doorslocked.size() != 0) {
-            for (int i = 0; i < _doorslocked.size(); i++) {
-                Vec2 position = _doors.at(_doorslocked[i])->getViewPosition();
-
-                if (abs(_hunter->getPosition().x +
-                        Vec2(rightward * _hunter->getVelocity().x,
-                             forward * _hunter->getVelocity().y)
-                            .x -
-                        (position.x)) < 128 * 2 and
-                    abs(_hunter->getPosition().y +
-                        Vec2(rightward * _hunter->getVelocity().x,
-                             forward * _hunter->getVelocity().y)
-                            .y -
-                        (position.y - 128)) < 30) {
-                    _move = false;
-                }
-            }
-        }
-
-        if (_move) {
-            if (_hunter->getTrapSize() > 0) {
-                _ismovedonece = false;
-
-                for (int i = 0; i < _hunter->getTrapSize(); i++) {
-                    if (_hunter->getTraps()[i]->getTrigger()) {
-                        _ismovedonece = true;
-                    }
-                }
-                if (!_ismovedonece && _move) {
-                    _hunter->move(forward, rightward);
-                }
-
-            } else {
-                _hunter->move(forward, rightward);
-            }
+        if (_move && !_ismovedonece) {
+            moveHunter(forward, rightward);
+        } else {
+            moveHunter(0, 0);
         }
 
         //        if (_didLose || _didFinalwin) {
@@ -758,7 +741,7 @@ void HGameController::update(float dt) {
             _treasure.getNode()->setVisible(false);
             AudioEngine::get()->play("treasureSound", _treasureSound, false,
                                      0.8, true);
-            transmitTreasureStolen();
+            transmitTreasureStolen(0);
             _treasureCount++;
         }
         if (abs(_treasure2.getPosition().x - _hunter->getPosition().x) <= 200 &&
@@ -769,7 +752,7 @@ void HGameController::update(float dt) {
             _treasure2.getNode()->setVisible(false);
             AudioEngine::get()->play("treasureSound", _treasureSound, false,
                                      0.8, true);
-            transmitTreasureStolen();
+            transmitTreasureStolen(1);
             _treasureCount++;
         }
         if (abs(_treasure3.getPosition().x - _hunter->getPosition().x) <= 200 &&
@@ -780,7 +763,7 @@ void HGameController::update(float dt) {
             _treasure3.getNode()->setVisible(false);
             AudioEngine::get()->play("treasureSound", _treasureSound, false,
                                      0.8, true);
-            transmitTreasureStolen();
+            transmitTreasureStolen(2);
             _treasureCount++;
         }
 
@@ -815,19 +798,23 @@ void HGameController::update(float dt) {
         //    index#>)
 
         if (_network) {
-            _network->receive([this](const std::string source,
-                                     const std::vector<std::byte>& data) {
-                processData(source, data);
+            _network->drain([this](const std::string& source,
+                                   const NetEvent& event) {
+                processEvent(source, event);
             });
             checkConnection();
+            updateResume();
+            updateTeammates(false);
+
+            // The host knows us by our old connection until we resume
+            if (!_authoritative && !_resume.isWaiting()) {
+                transmitPos(Vec2(currPos));
+            }
+            _lastpos = Vec2(currPos);
 
-            if (Vec2(currPos) != _lastpos) {
-                std::vector<float> pos = std::vector<float>();
-                pos.push_back(0);
-                pos.push_back(currPos.x);
-                pos.push_back(currPos.y);
-                transmitPos(pos);
-                _lastpos = Vec2(currPos);
+            GameMessage ping;
+            if (_clock.update(ping) && !_resume.isWaiting()) {
+                transmit(ping);
             }
             //            for (int i = 0; i < _spriteNodes.size(); i++) {
             //                _spriteNodes[i]->setPosition(
@@ -877,6 +864,12 @@ void HGameController::update(float dt) {
         // Hunter win!
         //        _endScene->update();
     }
+
+    if (_network) {
+        _reliable.update(_outbox);
+        _outbox.flush(_network);
+    }
+    updateTelemetry();
 }
 
 /**
@@ -893,7 +886,7 @@ void HGameController::render(std::shared_ptr<cugl::SpriteBatch>& batch) {
 }
 
 void HGameController::initDoors() {
-    std::vector<std::pair<Vec2, int>> doors = _level->getDoors();
+    LevelSpan<std::pair<Vec2, int>> doors = _level->getDoors();
 
     for (int i = 0; i < doors.size(); i++) {
         _doors.emplace_back(std::make_shared<DoorController>(
@@ -911,6 +904,7 @@ void HGameController::animatelocks() {
 
 void HGameController::addlocks(int index) {
     _doorslocked.push_back(index);
+    _movement.setLocked(index, true);
     _stopanim = false;
     while (!_stopanim) {
         _doors.at(index)->setFrame(_frameNumClose);
@@ -930,6 +924,9 @@ void HGameController::checkLevelLoaded() {
 
     // Check to see if new level loaded yet
     if (!_levelLoaded && _assets->complete()) {
+#ifdef SC_LEVEL_BENCHMARK
+        size_t allocations = LevelBenchmark::getAllocations();
+#endif
         _level = nullptr;
 
         // Access and initialize level
@@ -950,7 +947,7 @@ void HGameController::checkLevelLoaded() {
         _tilemap->updateColor(Color4::WHITE);
         _tilemap->updateTileSize(_level->getTileSize());
 
-        std::vector<int> tiles = _level->getTileTextures();
+        LevelSpan<int> tiles = _level->getTileTextures();
         for (int i = 0; i < tiles.size(); i++) {
             int c = i % width;
             int r = i / width;
@@ -958,47 +955,23 @@ void HGameController::checkLevelLoaded() {
             addFloorTile(type, c, height - 1 - r);
         }
 
-        std::vector<std::vector<int>> details = _level->getDetails();
-
-        for (int n = 0; n < details.size(); n++) {
-            for (int m = 0; m < details.at(n).size(); m++) {
-                int type = details[n][m];
-                if (!(type == 0 || type >= 641 || type == 129 + 16 ||
-                      type == 129 + 24)) {
-                    int c = m % width;
-                    int r = m / width;
-                    addDetails(type, c, height - 1 - r);
-                }
-            }
-        }
-
-        std::sort(_obstacles.begin(), _obstacles.end(),
-                  [](std::shared_ptr<TileController>& a,
-                     std::shared_ptr<TileController>& b) {
-                      return a->getPosition().x < b->getPosition().x;
-                  });
-
-        std::vector<std::shared_ptr<TileController>> tmp;
-        tmp.emplace_back(_obstacles.at(0));
-        for (int i = 1; i < _obstacles.size(); i++) {
-            if (_obstacles.at(i)->getPosition().x !=
-                _obstacles.at(i - 1)->getPosition().x) {
-                _sortedObstacles.emplace_back(tmp);
-                tmp.clear();
+        // The classification, columns and walls come from the level cache
+        LevelCache cache;
+        cache.init(*_level, LEVEL_FINAL_KEY);
+        _obstacles.clear();
+        for (const LevelCache::Tile& detail : cache.getTiles()) {
+            addDetails(detail);
+        }
+        for (LevelSpan<uint32_t> column : cache.getColumns()) {
+            std::vector<std::shared_ptr<TileController>> tiles;
+            tiles.reserve(column.size());
+            for (uint32_t index : column) {
+                tiles.push_back(_obstacles[index]);
             }
-            tmp.emplace_back(_obstacles.at(i));
+            _sortedObstacles.push_back(std::move(tiles));
         }
         _obstacles.clear();
 
-        for (int i = 0; i < _sortedObstacles.size(); i++) {
-            std::sort(_sortedObstacles.at(i).begin(),
-                      _sortedObstacles.at(i).end(),
-                      [](std::shared_ptr<TileController>& a,
-                         std::shared_ptr<TileController>& b) {
-                          return a->getYPos() > b->getYPos();
-                      });
-        }
-
         for (int i = 0; i < _holes.size(); i++) {
             _holes[i]->removeChildFrom(_obstacleNode);
             _holes[i]->addChildTo(_obstacleNode);
@@ -1035,16 +1008,18 @@ void HGameController::checkLevelLoaded() {
         _miniMap->shiftTexture(-_miniMap->getSize().height - 780,
                                -_miniMap->getSize().width - 500);
 
-        for (int i = 0; i < _level->getPortaits().size(); i++) {
-            _portraits->addPortrait(_portraitNodes, i,
-                                    _level->getPortaits()[i][0],
-                                    _level->getPortaits()[i][1], Vec3(0, 0, -1),
-                                    Vec2::ZERO, true, _level->getPortraitTypes()[i], _level->getBattery());
+        LevelRagged<Vec2> portraits = _level->getPortaits();
+        LevelSpan<int> portraitTypes = _level->getPortraitTypes();
+        for (int i = 0; i < portraits.size(); i++) {
+            _portraits->addPortrait(_portraitNodes, i, portraits[i][0],
+                                    portraits[i][1], Vec3(0, 0, -1), Vec2::ZERO,
+                                    true, portraitTypes[i],
+                                    _level->getBattery());
             if (i <= 0)
                 continue;
             auto indicator = cugl::scene2::PolygonNode::allocWithTexture(
                 _assets->get<Texture>("indicator" + to_string(i)));
-            indicator->setPosition(_level->getPortaits()[i][2]);
+            indicator->setPosition(portraits[i][2]);
             indicator->setScale(2);
             indicator->setVisible(false);
             _scene->addChild(indicator);
@@ -1172,7 +1147,7 @@ void HGameController::checkLevelLoaded() {
         _killSound = _assets->get<Sound>("kill");
         _damageSound = _assets->get<Sound>("damage");
 
-        addPolys();
+        addPolys(cache);
         makePolyObstacle(_obstaclePoly);
 
         //        _world->addObstacle(_hunter->getModel());
@@ -1205,7 +1180,14 @@ void HGameController::checkLevelLoaded() {
         
 
         Vec2 posxx=randomHunterLocation();
+        if (_authoritative) {
+            // Spawn where the host, reading the spawn off the wire, will
+            posxx = InputPredictor::snap(posxx);
+        }
         _hunter->setPosition(posxx);
+        if (_network && _authoritative) {
+            transmitReliable(_predictor.spawn(posxx, _clock.now()));
+        }
         _exitpos = posxx;
 
         _exitTexture = _assets->get<Texture>("exit");
@@ -1232,6 +1214,10 @@ void HGameController::checkLevelLoaded() {
         //_scene->addChild(_exit);
 
         _levelLoaded = true;
+#ifdef SC_LEVEL_BENCHMARK
+        CULog("checkLevelLoaded: %zu allocations",
+              LevelBenchmark::getAllocations() - allocations);
+#endif
     }
 }
 
@@ -1259,7 +1245,9 @@ void HGameController::initCamera() {
 
 Vec2 HGameController::randomHunterLocation(){
 
-    std::vector<Vec2> boarder = _level->getBoarder();
+    // The triangulator takes a vector, so this is the one copy of the border
+    LevelSpan<Vec2> border = _level->getBoarder();
+    std::vector<Vec2> boarder(border.begin(), border.end());
     srand(time(NULL));
     int maxx= -1410065408;
     int maxy=-1410065408;
@@ -1320,7 +1308,9 @@ Vec2 HGameController::randomHunterLocation(){
 
 std::vector<Vec2> HGameController::randomTreasureLocation(){
     std::vector<Vec2> treasurepo;
-    std::vector<Vec2> boarder = _level->getBoarder();
+    // The triangulator takes a vector, so this is the one copy of the border
+    LevelSpan<Vec2> border = _level->getBoarder();
+    std::vector<Vec2> boarder(border.begin(), border.end());
     
     srand(time(NULL));
     int maxx= -1410065408;
@@ -1527,39 +1517,136 @@ void HGameController::removeJoystick() {
     _joystickon = false;
 }
 
-void HGameController::processData(const std::string source,
-                                  const std::vector<std::byte>& data) {
-    if (source == _network->getHost()) {
-        _deserializer->receive(data);
-        std::vector<float> mes =
-            std::get<std::vector<float>>(_deserializer->read());
-        if (mes[0] == 1) {
-            _hunter->addTrap(Vec2(mes[1], mes[2]));
-        } else if (mes[0] == 3) {
-            //            CULog("portrait received");
-            int idx = static_cast<int>(mes[1]);
-            _indexfromspirit = idx;
-        } else if (mes[0] == 5) {
-            int idx = static_cast<int>(mes[1]);
-            //            CULog("door index: %d", idx);
-            addlocks(idx);
-        } else if (mes[0] == 9) {
-            CULog("got killed");
-            _killed = true;
-        } else if (mes[0] == 10) {
-            _didLose = true;
-            _didFinalwin = false;
-            _didWin = false;
-        } else if (mes[0] == 8) {
-            _didWin = true;
-            _didFinalwin = true;
-            _didLose = false;
-        }else if (mes[0] == 11) {
-            int idx = static_cast<int>(mes[1]);
-            _timer=idx;
+void HGameController::processEvent(const std::string& source,
+                                   const NetEvent& event) {
+    if (!event.host) {
+        return;
+    }
+    switch (event.kind) {
+    case NetEvent::Kind::Packet:
+        // A reliable header never carries over into another packet
+        _reliable.interrupt();
+        _telemetry.recordPacketReceived(event.bytes);
+        break;
+    case NetEvent::Kind::Dropped:
+        _reliable.interrupt();
+        break;
+    case NetEvent::Kind::Message: {
+        _telemetry.recordReceived(event.message.type, event.bytes);
+        auto deliver = [this](const GameMessage& message) {
+            _messageLog.record(message, false);
+            processMessage(message);
+        };
+        if (!_reliable.filter(event.message, deliver)) {
+            processMessage(event.message);
         }
+    } break;
+    case NetEvent::Kind::Malformed:
+        CULog("Dropping malformed packet from host");
+        break;
+    }
+}
 
-        _deserializer->reset();
+void HGameController::processMessage(const GameMessage& message) {
+    switch (message.type) {
+    case MessageType::TrapPlaced: {
+        const TrapPlacedMessage& trap = message.get<TrapPlacedMessage>();
+        _hunter->addTrap(Vec2(trap.x, trap.y));
+    } break;
+    case MessageType::CameraState: {
+        const CameraStateMessage& camera = message.get<CameraStateMessage>();
+        // A repeat has the same version, a late packet an older one
+        if (_hasCamState &&
+            static_cast<Sint8>(camera.version - _camVersion) <= 0) {
+            break;
+        }
+        _camVersion = camera.version;
+        _hasCamState = true;
+        setSpiritCamera(camera.index);
+    } break;
+    case MessageType::DoorLocked:
+        addlocks(message.get<DoorLockedMessage>().door);
+        break;
+    case MessageType::Kill:
+        // The hearts belong to the team, whoever was caught
+        CULog("player %d got killed", message.get<KillMessage>().player);
+        _killed = true;
+        break;
+    case MessageType::Interest:
+        _positionStream.setVisible(message.get<InterestMessage>().visible != 0);
+        break;
+    case MessageType::PlayerAssign:
+        _peers.setPlayer(message.get<PlayerAssignMessage>().player);
+        CULog("We are player %d", _peers.getPlayer());
+        break;
+    case MessageType::PeerState:
+        _peers.receive(message.get<PeerStateMessage>(),
+                       ClockSync::localMillis());
+        break;
+    case MessageType::TreasureStolen:
+        receiveTreasureStolen(message.get<TreasureStolenMessage>().treasure);
+        break;
+    case MessageType::DoorUnlocked:
+        receiveDoorUnlocked(message.get<DoorUnlockedMessage>().door);
+        break;
+    case MessageType::TrapTriggered: {
+        const TrapTriggeredMessage& trap = message.get<TrapTriggeredMessage>();
+        receiveTrapTriggered(Vec2(trap.x, trap.y));
+    } break;
+    case MessageType::SpiritWin:
+        _didLose = true;
+        _didFinalwin = false;
+        _didWin = false;
+        break;
+    case MessageType::HunterWin:
+        _didWin = true;
+        _didFinalwin = true;
+        _didLose = false;
+        break;
+    case MessageType::ClockPong: {
+        const ClockPongMessage& pong = message.get<ClockPongMessage>();
+        _clock.receivePong(pong);
+        _telemetry.recordRoundTrip(ClockSync::localMillis() - pong.clientTime);
+        if (_clock.isSynced()) {
+            Sint64 delay = static_cast<Sint64>(_clock.now()) - pong.hostTime;
+            _telemetry.recordDelay(delay > 0 ? static_cast<Uint32>(delay) : 0);
+        }
+    } break;
+    case MessageType::MatchDeadline:
+        _deadline = message.get<MatchDeadlineMessage>();
+        _hasDeadline = true;
+        break;
+    case MessageType::PositionAck:
+        _positionStream.acknowledge(message.get<PositionAckMessage>().seq);
+        break;
+    case MessageType::HunterState: {
+        Vec2 position = _hunter->getPosition();
+        if (_predictor.reconcile(message.get<HunterStateMessage>(), _step,
+                                 position)) {
+            _hunter->setPosition(position);
+        }
+    } break;
+    case MessageType::SnapshotChunk:
+        if (_resume.receive(message.get<SnapshotChunkMessage>(),
+                            ClockSync::localMillis(), _resumeSnapshot)) {
+            resumeSnapshot(_resumeSnapshot);
+        } else if (!_resume.isWaiting()) {
+            // The snapshot was corrupt, so the host may have missed anything
+            for (const GameMessage& event : _unackedEvents) {
+                if (event.type != MessageType::HunterSpawn &&
+                    event.type != MessageType::Desync) {
+                    transmitReliable(event);
+                }
+            }
+            _unackedEvents.clear();
+        }
+        break;
+    case MessageType::StateHash:
+        _messageLog.record(message, false);
+        checkStateHash(message.get<StateHashMessage>());
+        break;
+    default:
+        break;
     }
 }
 
@@ -1574,15 +1661,16 @@ void HGameController::processData(const std::string source,
  */
 bool HGameController::checkConnection() {
     // IMPLEMENT ME
-    NetcodeConnection::State network_state = _network->getState();
+    Transport::State network_state = _network->getState();
     switch (network_state) {
-    case NetcodeConnection::State::FAILED:
-    case NetcodeConnection::State::DISCONNECTED:
+    case Transport::State::FAILED:
+    case Transport::State::DISCONNECTED:
+        // A lost connection is only reported once it could not be rejoined
         disconnect();
         _quit = true;
         return false;
         break;
-    case NetcodeConnection::State::CONNECTED:
+    case Transport::State::CONNECTED:
         break;
     default:
         break;
@@ -1590,54 +1678,433 @@ bool HGameController::checkConnection() {
     return true;
 }
 
-void HGameController::transmitPos(std::vector<float> position) {
-    _serializer->writeFloatVector(position);
-    _network->broadcast(_serializer->serialize());
-    _serializer->reset();
+size_t HGameController::transmit(const GameMessage& message,
+                                 bool broadcast) {
+    return _outbox.push(message, broadcast ? Outbox::Route::Broadcast
+                                           : Outbox::Route::Host);
+}
+
+void HGameController::transmitReliable(const GameMessage& message) {
+    _messageLog.record(message, true);
+    _reliable.send(message, _outbox);
+}
+
+void HGameController::checkStateHash(const StateHashMessage& host) {
+    if (_resume.isWaiting()) {
+        // Our state is stale until the resume snapshot is applied
+        return;
+    }
+    MatchSnapshot snapshot;
+    saveSnapshot(snapshot);
+    Uint32 hash = DesyncDetector::hash(snapshot);
+    if (!_desync.check(host, _reliable.getNextSeq(),
+                       _reliable.getNextExpected(), hash)) {
+        return;
+    }
+    CULog("Desync: host hash %u, hunter hash %u", host.hash, hash);
+    transmitReliable(DesyncMessage{host.hash, hash});
+    _desync.dump("hunter", snapshot, hash, host.hash, _messageLog);
+}
+
+void HGameController::transmitPos(Vec2 position) {
+    GameMessage message;
+    // The host relays us to the other hunters, so only it needs the stream
+    if (_positionStream.update(position, _clock.now(), message)) {
+        _positionStream.recordSent(transmit(message));
+    }
+    const BandwidthCounter& counter = _positionStream.getCounter();
+    if (counter.getFrames() % 600 == 0) {
+        CULog("position stream: %.1f msgs/s, %.1f bytes/s, %llu keyframes",
+              counter.getMessagesPerSecond(), counter.getBytesPerSecond(),
+              (unsigned long long)_positionStream.getKeyframes());
+    }
+}
+
+void HGameController::moveHunter(float forward, float rightward) {
+    if (_network && _resume.isWaiting()) {
+        // Stand still until the host has caught us up
+        return;
+    }
+    if (!_authoritative || !_network) {
+        _hunter->setPosition(
+            _movement.step(_hunter->getPosition(), forward, rightward));
+        return;
+    }
+    if (!_levelLoaded) {
+        // The host does not know where we are until the spawn is sent
+        return;
+    }
+    Vec2 position = _hunter->getPosition();
+    transmit(
+        _predictor.predict(_step, position, forward, rightward, _clock.now()));
+    _hunter->setPosition(position);
+}
+
+void HGameController::saveSnapshot(MatchSnapshot& snapshot) {
+    snapshot.clear();
+    snapshot.time = _clock.now();
+    if (_hasDeadline) {
+        snapshot.deadline = _deadline.deadline;
+        snapshot.remaining = _deadline.remaining;
+    }
+    snapshot.hunter = _hunter->getPosition();
+    snapshot.health = std::max(0, 3 - _killCount);
+    snapshot.exit = _exitpos;
+    snapshot.treasureCount = _treasureCount;
+    snapshot.treasures.push_back(
+        {_treasure.getPosition(), _collision.didHitTreasure});
+    snapshot.treasures.push_back(
+        {_treasure2.getPosition(), _collision.didHitTreasure2});
+    snapshot.treasures.push_back(
+        {_treasure3.getPosition(), _collision.didHitTreasure3});
+    snapshot.camera = _indexfromspirit;
+    snapshot.lockedDoors.assign(_doorslocked.begin(), _doorslocked.end());
+    for (const std::shared_ptr<TrapModel>& trap : _hunter->getTraps()) {
+        snapshot.traps.push_back({trap->getPosition(), trap->getAge(),
+                                  trap->getTriggerTime(), trap->getTrigger()});
+    }
+}
+
+void HGameController::restoreSnapshot(const MatchSnapshot& snapshot) {
+    if (snapshot.deadline != 0 || snapshot.remaining != 0) {
+        _deadline = MatchDeadlineMessage{snapshot.deadline, snapshot.remaining};
+        _hasDeadline = true;
+    }
+    _hunter->setPosition(snapshot.hunter);
+    _killCount = 3 - std::max(0, std::min(3, snapshot.health));
+    _threehearts->setVisible(_killCount == 0);
+    _twohearts->setVisible(_killCount == 1);
+    _oneheart->setVisible(_killCount == 2);
+    _exitpos = snapshot.exit;
+    _exit->setPosition(_exitpos);
+
+    _treasureCount = snapshot.treasureCount;
+    TreasureController* treasures[] = {&_treasure, &_treasure2, &_treasure3};
+    bool* taken[] = {&_collision.didHitTreasure, &_collision.didHitTreasure2,
+                     &_collision.didHitTreasure3};
+    for (int i = 0; i < 3 && i < (int)snapshot.treasures.size(); i++) {
+        treasures[i]->setPosition(snapshot.treasures[i].position);
+        treasures[i]->getNode()->setVisible(!snapshot.treasures[i].taken);
+        *taken[i] = snapshot.treasures[i].taken;
+    }
+
+    setSpiritCamera(snapshot.camera);
+    for (int door : _doorslocked) {
+        _doors.at(door)->setFrame(0);
+        _movement.setLocked(door, false);
+    }
+    _doorslocked.clear();
+    for (int door : snapshot.lockedDoors) {
+        if (door >= 0 && door < (int)_doors.size()) {
+            addlocks(door);
+        }
+    }
+
+    _hunter->clearTraps();
+    for (const TrapSnapshot& trap : snapshot.traps) {
+        _hunter->addTrap(trap.position);
+        std::shared_ptr<TrapModel> model = _hunter->getTraps().back();
+        model->setAge(trap.age);
+        model->setTriggerTime(trap.triggerTime);
+        model->setTrigger(trap.triggered);
+    }
+}
+
+void HGameController::updateResume() {
+    if (!_network) {
+        return;
+    }
+    Uint32 now = ClockSync::localMillis();
+    if (_resume.update(_network->getState(), _network->getSession(), now)) {
+        // The host knew us by the old connection; start every channel over,
+        // keeping the events it may have missed for after the resume
+        _positionStream.reset();
+        _reliable.takeUnacked(_unackedEvents);
+        _reliable.reset();
+    }
+    // The host gave us our player number before the connection was lost
+    Uint8 player = static_cast<Uint8>(std::max(0, _peers.getPlayer()));
+    GameMessage request;
+    if (_resume.request(now, player, request)) {
+        transmit(request);
+    }
+}
+
+void HGameController::resumeSnapshot(const MatchSnapshot& host) {
+    MatchSnapshot snapshot;
+    saveSnapshot(snapshot);
+    std::vector<TrapSnapshot> ours = snapshot.traps;
+    // The host owns the clock, the doors, the traps, the camera, our hearts
+    // and which treasures are taken; where the treasures lie is ours
+    snapshot.deadline = host.deadline;
+    snapshot.remaining = host.remaining;
+    snapshot.health = host.health;
+    snapshot.camera = host.camera;
+    snapshot.lockedDoors = host.lockedDoors;
+    snapshot.traps = host.traps;
+    snapshot.treasureCount = host.treasureCount;
+    for (int i = 0; i < (int)snapshot.treasures.size() &&
+                    i < (int)host.treasures.size();
+         i++) {
+        snapshot.treasures[i].taken = host.treasures[i].taken;
+    }
+    if (_authoritative) {
+        snapshot.hunter = host.hunter;
+    }
+    restoreSnapshot(snapshot);
+    if (_authoritative) {
+        // Our inputs start over from the host position
+        _predictor.reset();
+        transmitReliable(_predictor.spawn(snapshot.hunter, _clock.now()));
+    }
+
+    // Whatever the host missed is done again here and sent once more
+    for (const GameMessage& event : _unackedEvents) {
+        if (hostShows(event, host, ours)) {
+            continue;
+        }
+        switch (event.type) {
+        case MessageType::TreasureStolen:
+            receiveTreasureStolen(event.get<TreasureStolenMessage>().treasure);
+            break;
+        case MessageType::DoorUnlocked:
+            receiveDoorUnlocked(event.get<DoorUnlockedMessage>().door);
+            break;
+        case MessageType::TrapTriggered: {
+            const TrapTriggeredMessage& trap =
+                event.get<TrapTriggeredMessage>();
+            receiveTrapTriggered(Vec2(trap.x, trap.y));
+        } break;
+        default:
+            break;
+        }
+        transmitReliable(event);
+    }
+    _unackedEvents.clear();
+    CULog("Resumed after %u ms offline; the resync took %u ms",
+          _resume.getOutage(), _resume.getResync());
+}
+
+bool HGameController::hostShows(const GameMessage& event,
+                                const MatchSnapshot& host,
+                                const std::vector<TrapSnapshot>& ours) const {
+    switch (event.type) {
+    case MessageType::TreasureStolen: {
+        size_t treasure = event.get<TreasureStolenMessage>().treasure;
+        return treasure < host.treasures.size() &&
+               host.treasures[treasure].taken;
+    }
+    case MessageType::DoorUnlocked: {
+        int door = event.get<DoorUnlockedMessage>().door;
+        return std::find(host.lockedDoors.begin(), host.lockedDoors.end(),
+                         door) == host.lockedDoors.end();
+    }
+    case MessageType::TrapTriggered: {
+        // We took the sprung trap off our own list at once, so the host has
+        // missed it if its trap nearest the hunter is one we no longer have
+        const TrapTriggeredMessage& trap = event.get<TrapTriggeredMessage>();
+        Vec2 position(trap.x, trap.y);
+        const TrapSnapshot* nearest = nullptr;
+        for (const TrapSnapshot& candidate : host.traps) {
+            if (nearest == nullptr ||
+                candidate.position.distanceSquared(position) <
+                    nearest->position.distanceSquared(position)) {
+                nearest = &candidate;
+            }
+        }
+        if (nearest == nullptr) {
+            return true;
+        }
+        for (const TrapSnapshot& kept : ours) {
+            if (kept.position.distanceSquared(nearest->position) < 1) {
+                return true;
+            }
+        }
+        return false;
+    }
+    case MessageType::HunterSpawn:
+    case MessageType::Desync:
+        // Both are about the session that was lost
+        return true;
+    default:
+        return false;
+    }
+}
+
+void HGameController::updateTimer() {
+    if (!_hasDeadline) {
+        return;
+    }
+    if (_deadline.deadline == 0) {
+        // The host has not started the countdown yet
+        _timer = _deadline.remaining * 60 / 1000.0f;
+    } else if (_clock.isSynced()) {
+        Sint64 left = static_cast<Sint64>(_deadline.deadline) - _clock.now();
+        _timer = left > 0 ? left * 60 / 1000.0f : 0;
+    }
+}
+
+void HGameController::setSpiritCamera(int index) {
+    if (index == _indexfromspirit) {
+        return;
+    }
+    if (_indexfromspirit != -1) {
+        _portraits->resetView(_indexfromspirit);
+    }
+    _indexfromspirit = index;
+}
+
+void HGameController::updateIndicator() {
+    std::shared_ptr<scene2::PolygonNode> indicator =
+        _animates ? getIndicator(_indexfromspirit) : nullptr;
+    if (indicator == _indicator) {
+        return;
+    }
+    if (_indicator != nullptr) {
+        _indicator->setVisible(false);
+    }
+    if (indicator != nullptr) {
+        indicator->setVisible(true);
+    }
+    _indicator = indicator;
+}
+
+std::shared_ptr<scene2::PolygonNode> HGameController::getIndicator(int index) {
+    if (index < 0 || index > static_cast<int>(_indicators.size()) ||
+        _indicators.empty()) {
+        return nullptr;
+    }
+    // Portrait 0 is the default camera, shown by the last indicator
+    return _indicators[index == 0 ? _indicators.size() - 1 : index - 1];
+}
+
+void HGameController::updateTelemetry() {
+    _telemetry.update();
+    if (!_telemetry.showOverlay()) {
+        return;
+    }
+    std::string summary = _telemetry.getSummary();
+    if (_network) {
+        summary += "  " + _network->getSummary();
+    }
+    _telemetryLabel->setText(summary);
+    _telemetryLabel->setScale(0.5f / getZoom());
+    _telemetryLabel->setPosition(
+        _scene->getCamera()->screenToWorldCoords(Vec2(20, 20)));
+}
+
+void HGameController::transmitTreasureStolen(int treasure) {
+    // The host fills in our player number when it relays the treasure
+    transmitReliable(TreasureStolenMessage{0, static_cast<Uint8>(treasure)});
+}
+
+void HGameController::receiveTreasureStolen(int treasure) {
+    TreasureController* treasures[] = {&_treasure, &_treasure2, &_treasure3};
+    bool* taken[] = {&_collision.didHitTreasure, &_collision.didHitTreasure2,
+                     &_collision.didHitTreasure3};
+    if (treasure < 0 || treasure >= 3 || *taken[treasure]) {
+        return;
+    }
+    *taken[treasure] = true;
+    treasures[treasure]->getNode()->setVisible(false);
+    _treasureCount++;
 }
 
-void HGameController::transmitTreasureStolen() {
-    std::vector<float> message = std::vector<float>();
-    message.push_back(4);
-    message.push_back(1);
-    _serializer->writeFloatVector(message);
-    _network->sendToHost(_serializer->serialize());
-    _serializer->reset();
+void HGameController::receiveDoorUnlocked(int door) {
+    auto locked = std::find(_doorslocked.begin(), _doorslocked.end(), door);
+    if (locked == _doorslocked.end()) {
+        return;
+    }
+    int index = static_cast<int>(locked - _doorslocked.begin());
+    if ((_triggered || _inprogress) && door == _currdoor) {
+        // Someone else got there first; drop our own unlock
+        _triggered = false;
+        _inprogress = false;
+        _timerlock = 300;
+        _frameNum = 0;
+        _timerLabellock->setVisible(false);
+        _lockhunter->setFrame(0);
+        _lockhunter->setVisible(false);
+    } else if (index < _currdoorindex) {
+        _currdoorindex--;
+    }
+    _doorslocked.erase(locked);
+    _doors.at(door)->setFrame(0);
+    _movement.setLocked(door, false);
+}
+
+void HGameController::receiveTrapTriggered(Vec2 position) {
+    // The trap is the one nearest the hunter that sprang it
+    int nearest = -1;
+    float best = 0;
+    for (int i = 0; i < _hunter->getTrapSize(); i++) {
+        float distance =
+            _hunter->getTraps()[i]->getPosition().distanceSquared(position);
+        if (nearest == -1 || distance < best) {
+            nearest = i;
+            best = distance;
+        }
+    }
+    if (nearest == -1 || (_trappedbool && nearest == _trapped)) {
+        // We are caught in it too, and remove it when we get out
+        return;
+    }
+    _hunter->removeTrap(nearest);
+    if (_trappedbool && nearest < _trapped) {
+        _trapped--;
+    }
+}
+
+void HGameController::updateTeammates(bool advance) {
+    int self = _peers.getPlayer();
+    if (self == -1 || !_levelLoaded) {
+        return;
+    }
+    Uint32 now = ClockSync::localMillis();
+    for (int player = 0; player < MAX_HUNTERS; player++) {
+        Vec2 position;
+        if (!_peers.sample(player, now, position)) {
+            continue;
+        }
+        // We are always slot 0, the others fill the slots after us
+        int slot = player < self ? player + 1 : player;
+        std::shared_ptr<HunterController> teammate = _hunterSet[slot];
+        if (!_teammateShown[slot]) {
+            _teammateNodes[slot].emplace_back(_shadowSet[slot]);
+            teammate->addChildToNode(_teammateNodes[slot]);
+            for (int n = 0; n < _teammateNodes[slot].size(); n++) {
+                _obstacleNode->addChild(_teammateNodes[slot].at(n));
+            }
+            _teammatePos[slot] = position;
+            _teammateShown[slot] = true;
+        }
+        if (advance) {
+            Vec2 step = position - _teammatePos[slot];
+            if (!step.isZero()) {
+                step.normalize();
+            }
+            teammate->setViewFrame(step.y, step.x, false);
+            _teammatePos[slot] = position;
+        }
+        teammate->setPosition(position);
+        _shadowSet[slot]->setPosition(position - Vec2(130, 270));
+    }
 }
 
 void HGameController::transmitUnlockDoor(int idx) {
-    std::vector<float> message = std::vector<float>();
-    message.push_back(6);
-    message.push_back(idx);
-    _serializer->writeFloatVector(message);
-    _network->sendToHost(_serializer->serialize());
-    _serializer->reset();
+    transmitReliable(DoorUnlockedMessage{idx});
 }
 
 void HGameController::transmitTrapTriggered(Vec2 position) {
-    std::vector<float> message = std::vector<float>();
-    message.push_back(7);
-    message.push_back(position.x);
-    message.push_back(position.y);
-    _serializer->writeFloatVector(message);
-    _network->sendToHost(_serializer->serialize());
-    _serializer->reset();
+    transmitReliable(TrapTriggeredMessage{0, position.x, position.y});
 }
 
 void HGameController::transmitHunterWin() {
-    std::vector<float> message = std::vector<float>();
-    message.push_back(8);
-    _serializer->writeFloatVector(message);
-    _network->sendToHost(_serializer->serialize());
-    _serializer->reset();
+    transmitReliable(HunterWinMessage{});
 }
 
 void HGameController::transmitSpiritWin() {
-    std::vector<float> message = std::vector<float>();
-    message.push_back(10);
-    _serializer->writeFloatVector(message);
-    _network->sendToHost(_serializer->serialize());
-    _serializer->reset();
+    transmitReliable(SpiritWinMessage{});
 }
 
 void HGameController::updateJoystick(float forward, float rightward,
@@ -1778,38 +2245,44 @@ void HGameController::modifyTexture(std::shared_ptr<Texture>& texture,
     texture = texture->getSubTexture(c * y, (c + 1) * y, r * x, (r + 1) * x);
 }
 
-void HGameController::addPolys() {
-    std::vector<Vec2> boarder = _level->getBoarder();
-    cugl::SimpleExtruder extruder = SimpleExtruder();
-    extruder.set(boarder, true);
-    extruder.calculate(10, 10);
-    _obstaclePoly.emplace_back(extruder.getPolygon());
-
-    std::vector<std::vector<Vec2>> obs = _level->getCollision();
-    cugl::Path2 line = Path2();
-    for (int i = 0; i < obs.size(); i++) {
-        line.set(obs.at(i));
-        EarclipTriangulator et;
-        et.set(line);
-        et.calculate();
-        cugl::Poly2 poly = et.getPolygon();
-        _obstaclePoly.emplace_back(poly);
+void HGameController::addPolys(const LevelCache& cache) {
+    std::vector<Vec2> doors;
+    for (const std::pair<Vec2, int>& door : _level->getDoors()) {
+        doors.push_back(door.first);
     }
+    _movement.init(cache.getObstacles(), doors);
+    _obstaclePoly = _movement.getObstacles();
 }
 
 void HGameController::sortNodes() {
-    for (int n = 0; n < _hunterNodes.size(); n++) {
-        _obstacleNode->removeChild(_hunterNodes.at(n));
-        _obstacleNode->addChild(_hunterNodes.at(n));
+    // Painter's order: the hunter highest up the screen is drawn first
+    std::vector<int> order = {0};
+    for (int slot = 1; slot < MAX_HUNTERS; slot++) {
+        if (_teammateShown[slot]) {
+            order.push_back(slot);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return _hunterSet[a]->getPosition().y > _hunterSet[b]->getPosition().y;
+    });
+
+    for (int slot : order) {
+        std::vector<std::shared_ptr<scene2::PolygonNode>>& nodes =
+            slot == 0 ? _hunterNodes : _teammateNodes[slot];
+        for (int n = 0; n < nodes.size(); n++) {
+            _obstacleNode->removeChild(nodes.at(n));
+            _obstacleNode->addChild(nodes.at(n));
+        }
+        sortNodesAround(_hunterSet[slot]->getPosition());
     }
+}
 
+void HGameController::sortNodesAround(Vec2 pos) {
     for (int i = 0; i < _sortedObstacles.size(); i++) {
-        float xDiff = abs(_hunter->getPosition().x -
-                          _sortedObstacles[i][0]->getPosition().x);
+        float xDiff = abs(pos.x - _sortedObstacles[i][0]->getPosition().x);
         if (xDiff < 128 * 2) {
             for (int n = 0; n < _sortedObstacles.at(i).size(); n++) {
-                if (_hunter->getPosition().y >
-                        _sortedObstacles[i][n]->getYPos() &&
+                if (pos.y > _sortedObstacles[i][n]->getYPos() &&
                     _sortedObstacles[i][n]->isObstacle()) {
                     _sortedObstacles[i][n]->removeChildFrom(_obstacleNode);
                     _sortedObstacles[i][n]->addChildTo(_obstacleNode);
@@ -1819,19 +2292,18 @@ void HGameController::sortNodes() {
     }
 
     for (int i = 0; i < _doorNodes.size(); i++) {
-        if (_hunter->getPosition().y > _doorNodes.at(i)->getPositionY() + 32) {
+        if (pos.y > _doorNodes.at(i)->getPositionY() + 32) {
             _obstacleNode->removeChild(_doorNodes.at(i));
             _obstacleNode->addChild(_doorNodes.at(i));
         }
     }
 
     for (int i = 0; i < _portraitNodes.size(); i++) {
-        if (_hunter->getPosition().y >
-            _portraitNodes.at(i)->getPositionY() - 64) {
+        if (pos.y > _portraitNodes.at(i)->getPositionY() - 64) {
             _obstacleNode->removeChild(_portraitNodes.at(i));
             _obstacleNode->addChild(_portraitNodes.at(i));
         } else {
-            return;
+            break;
         }
     }
 }
@@ -1873,106 +2345,32 @@ std::shared_ptr<Texture> HGameController::getTexture(int type) {
     return texture;
 }
 
-void HGameController::addDetails(int type, int c, int r) {
-    std::shared_ptr<Texture> texture = getTexture(type);
-    Vec2 pos(_level->getTileWidth() * c, _level->getTileWidth() * r);
+void HGameController::addDetails(const LevelCache::Tile& detail) {
+    std::shared_ptr<Texture> texture = getTexture(detail.type);
+    Vec2 pos(_level->getTileWidth() * detail.c,
+             _level->getTileWidth() * detail.r);
     std::shared_ptr<TileController> tile = std::make_shared<TileController>(
         pos, _level->getTileSize(), Color4::WHITE, false, texture, pos.y);
-    float yPos = getYPos(type, pos.y, tile, c, r);
-    if (yPos != -FLT_MAX) {
-        tile->setYPos(yPos);
-    } else {
+    switch (detail.kind) {
+    case LevelCache::Kind::Wall:
+        _tilemap->setTileTraversable(detail.c, detail.r, false);
+        tile->setYPos(detail.yPos);
+        break;
+    case LevelCache::Kind::Obstacle:
+        tile->setYPos(detail.yPos);
+        break;
+    case LevelCache::Kind::Carpet:
+        _carpets.emplace_back(tile);
+        tile->setObstacle(false);
+        break;
+    case LevelCache::Kind::Hole:
+        _holes.emplace_back(tile);
         tile->setObstacle(false);
+        break;
+    case LevelCache::Kind::Flat:
+        tile->setObstacle(false);
+        break;
     }
     _obstacles.emplace_back(tile);
     tile->addChildTo(_obstacleNode);
 }
-
-float HGameController::getYPos(int type, float pos,
-                               std::shared_ptr<TileController>& tile, int c, int r) {
-    float yPos = pos;
-    int tileSize = _level->getTileWidth();
-    int index = type;
-    if (type < 65) {
-        // wall
-        _tilemap->setTileTraversable(c, r, false);
-        yPos += 11;
-        index -= 1;
-        if (index == 0 || index == 1 || index == 8 || index == 9 ||
-            index == 10 || index == 11 || index == 20 || index == 21 ||
-            index == 22 || index == 34 || index == 35) {
-            yPos -= 2 * tileSize;
-        } else if (index == 32 || index == 33) {
-            yPos -= tileSize;
-        }
-    } else if (type < 129) {
-        // floor
-        return -FLT_MAX;
-    } else if (type < 193) {
-        // dector
-        yPos += 8;
-        index -= 129;
-        if (type == 16 || type == 24) {
-            return FLT_MAX;
-        }
-        if (index == 6 || index == 7) {
-            yPos -= 2 * tileSize;
-        } else if (index == 14 || index == 15 || index == 1 || index == 2 ||
-                   index == 3 || index == 4 || index == 17 || index == 18 ||
-                   index == 19 || index == 20 || index == 32 || index == 33 ||
-                   index == 34 || index == 35 || index == 36 || index == 37) {
-            yPos -= tileSize;
-        }
-    } else if (type < 257) {
-        // grime
-        yPos += 9;
-        index -= 193;
-    } else if (type < 321) {
-        // placeholder
-        return -FLT_MAX;
-    } else if (type < 385) {
-        // wall upper
-        yPos += 10;
-        index -= 321;
-        if (index >= 16 && index <= 63) {
-            yPos += tileSize;
-        }
-    } else if (type < 449) {
-        // ao
-        return -FLT_MAX;
-    } else if (type < 513) {
-        // dector2
-        yPos += 8;
-        index -= 449;
-        if (index == 36 || index == 37 || index == 38 || index == 44 ||
-            index == 45 || index == 46 || index == 52 || index == 53 ||
-            index == 54) {
-            _carpets.emplace_back(tile);
-            return -FLT_MAX;
-        }
-        if (index < 8 || (index >= 16 && index <= 23) || index == 32 ||
-            index == 48 || index == 49) {
-            yPos -= tileSize;
-        }
-    } else if (type < 577) {
-        // env
-        yPos += 8;
-        index -= 513;
-        if (index == 24 || index == 25 || index == 32 || index == 33 ||
-            index == 40 || index == 41 || index == 35 || index == 36 ||
-            index == 37 || index == 48 || index == 49 || index == 50 ||
-            index == 54 || index == 55 || index == 62) {
-            _holes.emplace_back(tile);
-            return -FLT_MAX;
-        }
-    } else {
-        // env2
-        yPos += 8;
-        index -= 577;
-        if (index == 0 || index == 1 || index == 6 || index == 7 ||
-            (index >= 16 && index <= 21)) {
-            yPos -= tileSize;
-        }
-    }
-    return yPos;
-}
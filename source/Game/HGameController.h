@@ -11,6 +11,7 @@
 //
 #ifndef __HGAME_CONTROLLER_H__
 #define __HGAME_CONTROLLER_H__
+#include <array>
 #include <climits>
 #include <random>
 
@@ -19,7 +20,9 @@
 #include <vector>
 using namespace cugl;
 #include "HunterController.h"
+#include "HunterMovement.h"
 #include "InputController.h"
+#include "LevelCache.h"
 #include "LevelModel.h"
 #include "SpiritController.h"
 //#include "TrapController.hpp"
@@ -28,6 +31,20 @@ using namespace cugl;
 
 #include "TilemapController.h"
 #include "TreasureController.hpp"
+#include "SCBot.hpp"
+#include "SCMessage.hpp"
+#include "SCNetTelemetry.hpp"
+#include "SCOutbox.hpp"
+#include "SCPrediction.hpp"
+#include "SCClockSync.hpp"
+#include "SCDesync.hpp"
+#include "SCHunterRoster.hpp"
+#include "SCMatchSnapshot.hpp"
+#include "SCPositionStream.hpp"
+#include "SCReliableChannel.hpp"
+#include "SCSessionResume.hpp"
+#include "SCThreadedTransport.hpp"
+#include "SCTransport.hpp"
 
 /**
  * The primary controller for the game logic.
@@ -217,6 +234,8 @@ class HGameController {
     std::shared_ptr<scene2::PolygonNode> _threehearts;
     
     std::vector<std::shared_ptr<cugl::scene2::PolygonNode>> _indicators;
+    /** The indicator on screen, or nullptr for none */
+    std::shared_ptr<cugl::scene2::PolygonNode> _indicator;
     std::vector<std::shared_ptr<cugl::scene2::PolygonNode>> _shadows;
 
     int _heart_frame = 0;
@@ -290,11 +309,80 @@ class HGameController {
 
     Vec2 _lastpos;
 
-    std::shared_ptr<cugl::net::NetcodeConnection> _network;
+    /** The connection, received and decoded on its own thread */
+    std::shared_ptr<ThreadedTransport> _network;
 
-    std::shared_ptr<cugl::net::NetcodeSerializer> _serializer;
+    /** The messages to send at the end of this frame */
+    Outbox _outbox;
 
-    std::shared_ptr<cugl::net::NetcodeDeserializer> _deserializer;
+    /** The replication channel for our position */
+    PositionSender _positionStream;
+
+    /** The estimate of the host clock */
+    ClockSync _clock;
+
+    /** The reliable ordered channel for game events with the host */
+    ReliableChannel _reliable;
+
+    /** The wire statistics of this device */
+    NetTelemetry _telemetry;
+
+    /** The bot that drives the hunter instead of the input, or nullptr */
+    Bot* _bot = nullptr;
+
+    /** The telemetry overlay, hidden unless enabled in json/telemetry.json */
+    std::shared_ptr<cugl::scene2::Label> _telemetryLabel;
+
+    /** The last match deadline received from the host */
+    MatchDeadlineMessage _deadline;
+
+    /** Whether a match deadline has been received */
+    bool _hasDeadline;
+
+    /** The version of the last camera state applied */
+    Uint8 _camVersion;
+
+    /** Whether a camera state has been received */
+    bool _hasCamState;
+
+    /** Whether the host decides where the hunter is; see json/network.json */
+    bool _authoritative;
+
+    /** The walls and doors the hunter collides with, shared with the host */
+    HunterMovement _movement;
+
+    /** The movement step of _movement */
+    MovementStep _step;
+
+    /** The inputs the host has not acknowledged yet */
+    InputPredictor _predictor;
+
+    /** The rejoin and resync after a lost connection */
+    ResumeClient _resume;
+
+    /** The host snapshot received on a resume */
+    MatchSnapshot _resumeSnapshot;
+
+    /**
+     * The events the host had not acknowledged when the connection was
+     * lost, sent again after the resume unless the host snapshot shows them
+     */
+    std::vector<GameMessage> _unackedEvents;
+
+    /** The comparison of our state hash with the host one */
+    DesyncDetector _desync;
+
+    /** The recent game events, written out on a desync */
+    MessageLog _messageLog;
+
+    /** The other hunters, as the host relays them */
+    PeerView _peers;
+
+    /** Whether the other hunters are on screen, by slot in _hunterSet */
+    std::array<bool, MAX_HUNTERS> _teammateShown;
+
+    /** The last positions of the other hunters, by slot in _hunterSet */
+    std::array<Vec2, MAX_HUNTERS> _teammatePos;
 
     bool _gameStatus = 0;
 
@@ -311,6 +399,9 @@ class HGameController {
 
     std::vector<std::shared_ptr<scene2::SpriteNode>> _candleNodes;
     std::vector<std::shared_ptr<scene2::PolygonNode>> _hunterNodes;
+    /** The nodes of the other hunters, by slot in _hunterSet */
+    std::array<std::vector<std::shared_ptr<scene2::PolygonNode>>, MAX_HUNTERS>
+        _teammateNodes;
     std::vector<std::shared_ptr<scene2::PolygonNode>> _doorNodes;
     std::vector<std::shared_ptr<scene2::PolygonNode>> _portraitNodes;
 
@@ -379,7 +470,7 @@ class HGameController {
      *
      * @return the network connection (as made by this scene)
      */
-    std::shared_ptr<cugl::net::NetcodeConnection> getConnection() const {
+    std::shared_ptr<Transport> getConnection() const {
         return _network;
     }
 
@@ -397,10 +488,21 @@ class HGameController {
      * @return the network connection (as made by this scene)
      */
     void setConnection(
-        const std::shared_ptr<cugl::net::NetcodeConnection>& network) {
-        _network = network;
+        const std::shared_ptr<Transport>& network) {
+        // Packets are received and decoded off the game loop
+        _network = network ? ThreadedTransport::alloc(network) : nullptr;
     }
 
+    /**
+     * Lets a bot drive the hunter instead of the input controller.
+     *
+     * @param bot   The bot, or nullptr for the input controller
+     */
+    void setBot(Bot* bot) { _bot = bot; }
+
+    /** Returns the wire statistics of this device */
+    NetTelemetry& getTelemetry() { return _telemetry; }
+
     /**
      * Returns true if the player quits the game.
      *
@@ -427,22 +529,24 @@ class HGameController {
     void generateLevel();
 
     /**
-     * Processes data sent over the network.
+     * Processes something received over the network.
      *
-     * Once connection is established, all data sent over the network consistes
-     * of byte vectors. This function is a call back function to process that
-     * data. Note that this function may be called *multiple times* per
-     * animation frame, as the messages can come from several sources.
-     *
-     * Typically this is where players would communicate their names after being
-     * connected. In this lab, we only need it to do one thing: communicate that
-     * the host has started the game.
+     * The network thread has already split each packet into its messages.
+     * This is called from the drain at the start of the frame, once per
+     * packet and once per message, and may run *many times* per animation
+     * frame, as the messages can come from several sources.
      *
      * @param source    The UUID of the sender
-     * @param data      The data received
+     * @param event     The packet or message received
      */
-    void processData(const std::string source,
-                     const std::vector<std::byte>& data);
+    void processEvent(const std::string& source, const NetEvent& event);
+
+    /**
+     * Processes a single message from the host.
+     *
+     * @param message   The decoded message
+     */
+    void processMessage(const GameMessage& message);
 
     /**
      * Checks that the network connection is still active.
@@ -456,13 +560,154 @@ class HGameController {
     bool checkConnection();
 
     /**
-     * Transmits a hunter position change to all other devices.
+     * Queues a message to be sent at the end of this frame.
+     *
+     * @param message   The message to send
+     * @param broadcast Whether to send to every peer instead of just the host
+     *
+     * @return the encoded size of the message in bytes
+     */
+    size_t transmit(const GameMessage& message, bool broadcast = false);
+
+    /**
+     * Queues a game event for reliable, ordered delivery to the host.
+     *
+     * @param message   The event to send
+     */
+    void transmitReliable(const GameMessage& message);
+
+    /**
+     * Compares the host state hash with ours, and reports a lasting desync.
+     *
+     * @param host  The host hash and event counts
+     */
+    void checkStateHash(const StateHashMessage& host);
+
+    /**
+     * Advances the position stream, transmitting to all other devices when
+     * an update is due. This must be called every frame.
+     *
+     * @param position The hunter's current position
+     */
+    void transmitPos(Vec2 position);
+
+    /**
+     * Moves the hunter by one frame of input. In authoritative mode the
+     * input is also sent to the host, which checks the move.
+     *
+     * @param forward   The vertical input in [-1, 1]
+     * @param rightward The horizontal input in [-1, 1]
+     */
+    void moveHunter(float forward, float rightward);
+
+    /**
+     * Fills in the part of the match this device owns.
+     *
+     * @param snapshot  The snapshot to fill in; it is cleared first
+     */
+    void saveSnapshot(MatchSnapshot& snapshot);
+
+    /**
+     * Puts the part of the match this device owns back as it was in a
+     * snapshot. The level must be loaded.
+     *
+     * @param snapshot  The snapshot to restore
+     */
+    void restoreSnapshot(const MatchSnapshot& snapshot);
+
+    /**
+     * Follows a lost connection. After a rejoin every channel to the host
+     * starts over, and the resume request is repeated until it is answered.
+     */
+    void updateResume();
+
+    /**
+     * Lays the part of the match the host owns over our own state, once the
+     * host snapshot for a resume has arrived.
+     *
+     * @param host  The host snapshot
+     */
+    void resumeSnapshot(const MatchSnapshot& host);
+
+    /**
+     * Returns true if the host snapshot already shows an event we sent.
+     *
+     * @param event The event
+     * @param host  The host snapshot
+     * @param ours  Our traps before the host ones replaced them
+     */
+    bool hostShows(const GameMessage& event, const MatchSnapshot& host,
+                   const std::vector<TrapSnapshot>& ours) const;
+
+    /**
+     * Updates the match countdown from the synced clock and the deadline
+     * received from the host.
+     */
+    void updateTimer();
+
+    /**
+     * Shows the portrait the spirit is looking through, touching only the
+     * portrait that was active before. The indicator follows in
+     * updateIndicator.
+     *
+     * @param index The portrait index, or -1 for none
+     */
+    void setSpiritCamera(int index);
+
+    /**
+     * Shows the indicator of the watched portrait while portraits animate,
+     * and hides the one shown before. This must be called every frame.
+     */
+    void updateIndicator();
+
+    /**
+     * Returns the indicator for a portrait index, or nullptr for none
+     *
+     * @param index The portrait index, or -1 for none
+     */
+    std::shared_ptr<cugl::scene2::PolygonNode> getIndicator(int index);
+
+    /**
+     * Advances the telemetry and refreshes its overlay. This must be called
+     * every frame.
+     */
+    void updateTelemetry();
+
+    /**
+     * Tells the host we took a treasure.
+     *
+     * @param treasure  The treasure index, from 0 to 2
+     */
+    void transmitTreasureStolen(int treasure);
+
+    /**
+     * Takes a treasure another hunter stole off the map.
+     *
+     * @param treasure  The treasure index, from 0 to 2
+     */
+    void receiveTreasureStolen(int treasure);
+
+    /**
+     * Opens a door another hunter unlocked, dropping our own unlock of it.
      *
-     * @param position The hunter's new position
+     * @param door  The door index
      */
-    void transmitPos(std::vector<float> position);
+    void receiveDoorUnlocked(int door);
 
-    void transmitTreasureStolen();
+    /**
+     * Removes the trap another hunter sprang, the one nearest its position.
+     *
+     * @param position  The hunter position when the trap was sprung
+     */
+    void receiveTrapTriggered(Vec2 position);
+
+    /**
+     * Shows the other hunters where the host relays them. This must be
+     * called every frame.
+     *
+     * @param advance   Whether to advance their walking animation
+     */
+    void updateTeammates(bool advance);
 
     bool _ismovedonece;
 
@@ -494,17 +739,27 @@ class HGameController {
 
     void addCandles(int type, int c, int r);
 
-    void addPolys();
+    void addPolys(const LevelCache& cache);
 
+    /**
+     * Draws the hunters back to front, each followed by the walls, doors and
+     * portraits that stand in front of it.
+     */
     void sortNodes();
 
+    /**
+     * Draws the walls, doors and portraits in front of a position over
+     * everything before them.
+     *
+     * @param pos   The position of a hunter
+     */
+    void sortNodesAround(Vec2 pos);
+
     std::shared_ptr<Texture> getTexture(int type);
 
-    void addDetails(int type, int c, int r);
+    void addDetails(const LevelCache::Tile& detail);
 
     void modifyTexture(std::shared_ptr<Texture>& texture, int index);
-
-    float getYPos(int type, float pos, std::shared_ptr<TileController>& tile, int c, int r);
 };
 
 #endif /* __HGAME_CONTROLLER_H__ */
@@ -76,8 +76,33 @@ SGameController::SGameController(
     }
     _blocked = false;
     _hunterAdded = false;
-    _serializer = NetcodeSerializer::alloc();
-    _deserializer = NetcodeDeserializer::alloc();
+    _outbox.reset();
+    _hunters.reset(0);
+    _relay.reset();
+    auto network = _assets->get<JsonValue>("network");
+    _authoritative =
+        network != nullptr && network->getBool("authoritative movement", false);
+    _interestManaged =
+        network != nullptr && network->getBool("interest management", false);
+    _interest.reset();
+    _step = [this](Vec2 position, float forward, float rightward) {
+        return _movement.step(position, forward, rightward);
+    };
+    _resume.reset();
+    _desync.reset();
+    _messageLog.reset();
+    _treasuresStolen = 0;
+    _treasuresTaken.fill(false);
+    _telemetry.init(_assets->get<JsonValue>("telemetry"), "spirit");
+    _outbox.setTelemetry(&_telemetry);
+    _hunters.setTelemetry(&_telemetry);
+    _deadline = 0;
+    _deadlineSent = 0;
+    _deadlineDirty = true;
+    _camIndex = -1;
+    _camVersion = 0;
+    _camSent = 0;
+    _camDirty = true;
     _status = Status::START;
     _alertTimer = 0;
     _font = assets->get<Font>("gamefont");
@@ -88,10 +113,16 @@ SGameController::SGameController(
         Vec2(0, 0), "              ", _assets->get<Font>("gamefont"));
     _timerScale = _textHeight / _timerLabel->getSize().height * 1.5;
     _sixthLayer->addChild(_timerLabel);
+    _telemetryLabel = cugl::scene2::Label::allocWithText(
+        Vec2::ZERO, " ", _assets->get<Font>("gamefont"));
+    _telemetryLabel->setAnchor(Vec2::ANCHOR_TOP_LEFT);
+    _telemetryLabel->setForeground(cugl::Color4::WHITE);
+    _telemetryLabel->setVisible(_telemetry.showOverlay());
+    _sixthLayer->addChild(_telemetryLabel);
 //    _endScene = std::make_shared<EndScene>(_scene, assets, true, true);
 
     _trapTriggered = false;
-    _doorUnlocked = false;
+    _doorsToUnlock.clear();
     _treasureStolen = false;
     _trapPos = Vec2::ZERO;
     _selection = false;
@@ -147,12 +178,16 @@ void SGameController::update(float dt) {
     auto inputController = InputController::getInstance();
     inputController->update(dt);
     inputController->readInput();
+
+    if (_network && _gameStatus == 0 && waitForHunter()) {
+        return;
+    }
     
     if(_spawn){
         updateSpawn();
     }
     
-    transmitTimer(_timeLeft);
+    updateTimer();
 
     // Disable indicators by default
     for (auto& indicator : _indicators) {
@@ -377,10 +412,23 @@ void SGameController::update(float dt) {
             if (_spirit.getModel()->isOnKill && release) {
                 _spirit.getModel()->setKillState(false);
 
-                if (_spirit.getModel()->hunterAdded &&
-                    _spirit.hunterInBound(cameraPos)) {
-                    // TODO: networking; transmit to hunter for losing 1 health
-                    transmitKill();
+                // Test against the hunters the spirit saw, not the newest
+                int hit = -1;
+                Vec2 hitPos;
+                for (int p = 0; p < _hunters.size() && hit == -1; p++) {
+                    HunterLink& hunter = _hunters.get(p);
+                    Vec2 hunterPos = hunter.position;
+                    hunter.history.rewind(hunter.seen,
+                                          ClockSync::localMillis(), hunterPos);
+                    if (hunter.shown &&
+                        _spirit.hunterInBound(cameraPos, hunterPos)) {
+                        hit = p;
+                        hitPos = hunterPos;
+                    }
+                }
+                // The first hunter carries the team hearts
+                if (_spirit.getModel()->hunterAdded && hit != -1) {
+                    transmitKill(hit);
                     AudioEngine::get()->play("damage", _damageSound, false, 0.5, false);
                     _spirit.getModel()->setHealth(_spirit.getModel()->health -
                                                   1);
@@ -389,7 +437,8 @@ void SGameController::update(float dt) {
                         _obstacleNode->removeChild(_hunterNodes.at(i));
                     }
 
-                    _spirit.getModel()->updateHeart(_hunterNodes);
+                    // Where the spirit swiped, not where the hunter is now
+                    _spirit.getModel()->updateHeart(_hunterNodes, hitPos);
 
                     for (int i = 0; i < _hunterNodes.size(); i++) {
                         _obstacleNode->addChild(_hunterNodes.at(i));
@@ -414,14 +463,14 @@ void SGameController::update(float dt) {
             _blocked = true;
         }
 
-        if (_doorUnlocked && _doorToUnlock != -1) {
-            if (_doors.at(_doorToUnlock)->isLocked()) {
-                _doors.at(_doorToUnlock)->resetHunterUnlock();
+        // Every hunter may unlock a door in the same frame
+        for (int door : _doorsToUnlock) {
+            if (_doors.at(door)->isLocked()) {
+                _doors.at(door)->resetHunterUnlock();
                 _spirit.addNewLock(_fifthLayer);
-                _doorUnlocked = false;
-                _doorToUnlock = -1;
             }
         }
+        _doorsToUnlock.clear();
 
         // detect if a trap or door on the map has been removed, add a new trap
         // button to the scene
@@ -438,18 +487,16 @@ void SGameController::update(float dt) {
         }
 
         if (_network) {
-            _network->receive([this](const std::string source,
-                                     const std::vector<std::byte>& data) {
-                processData(source, data);
+            _network->drain([this](const std::string& source,
+                                   const NetEvent& event) {
+                processEvent(source, event);
             });
             checkConnection();
 
+            updateHunters();
+
             if (_spirit.getTrapAdded()) {
-                std::vector<float> pos = std::vector<float>();
-                pos.push_back(1);
-                pos.push_back(_spirit.getLastTrapPos().x);
-                pos.push_back(_spirit.getLastTrapPos().y);
-                transmitTrap(pos);
+                transmitTrap(_spirit.getLastTrapPos());
                 _spirit.setTrapAdded(false);
             }
         }
@@ -529,8 +576,73 @@ void SGameController::update(float dt) {
 //            _status = ABORT;
 //        }
     }
-    if (!_spawn){
-        _timeLeft--;
+
+    if (_network) {
+        if (_gameStatus == 0) {
+            transmitStateHash();
+        }
+        _hunters.update(_outbox);
+        _outbox.flush(_network);
+    }
+    updateTelemetry();
+}
+
+bool SGameController::waitForHunter() {
+    Uint32 now = ClockSync::localMillis();
+    bool paused =
+        _resume.update(_network->getNumPlayers(), _hunters.size(), now);
+    // A hunter that stayed away too long gives up its place; the rest play on
+    for (int p = 0; p < _hunters.size(); p++) {
+        if (_resume.isGone(p) && _hunters.leave(p)) {
+            _interest.forget(p);
+            for (auto& node : p == 0 ? _hunterNodes : _teammateNodes[p]) {
+                node->setVisible(false);
+            }
+        }
+    }
+    if (_resume.hasExpired()) {
+        CULog("No hunter came back");
+        disconnect();
+        _quit = true;
+        return true;
+    }
+    if (!paused) {
+        Uint32 pause = _resume.takePause();
+        if (pause != 0 && _deadline != 0) {
+            _deadline += pause;
+            _deadlineDirty = true;
+        }
+        return false;
+    }
+
+    _network->drain([this](const std::string& source, const NetEvent& event) {
+        processEvent(source, event);
+    });
+    if (checkConnection()) {
+        _hunters.update(_outbox);
+        _outbox.flush(_network);
+    }
+    _timerLabel->setText("PAUSED");
+    return true;
+}
+
+void SGameController::updateTimer() {
+    Uint32 now = ClockSync::localMillis();
+    if (_deadline == 0 && !_spawn) {
+        // The countdown starts once the spawn animation finishes
+        _deadline = now + _timeLeft * 1000 / 60;
+        _deadlineDirty = true;
+    }
+    if (_deadline != 0) {
+        Sint64 left = static_cast<Sint64>(_deadline) - now;
+        _timeLeft = left > 0 ? static_cast<int>(left * 60 / 1000) : 0;
+    }
+    if (_network &&
+        (_deadlineDirty || now - _deadlineSent >= MATCH_DEADLINE_REPEAT)) {
+        Uint32 remaining = _timeLeft * 1000 / 60;
+        transmit(MatchDeadlineMessage{_deadline, remaining});
+        _deadlineSent = now;
+        _deadlineDirty = false;
     }
 }
 
@@ -581,7 +693,7 @@ void SGameController::checkLevelLoaded() {
         _tilemap->updateColor(Color4::WHITE);
         _tilemap->updateTileSize(_level->getTileSize());
 
-        std::vector<int> tiles = _level->getTileTextures();
+        LevelSpan<int> tiles = _level->getTileTextures();
         for (int i = 0; i < tiles.size(); i++) {
             int c = i % width;
             int r = i / width;
@@ -589,46 +701,23 @@ void SGameController::checkLevelLoaded() {
             addFloorTile(type, c, height - 1 - r);
         }
 
-        std::vector<std::vector<int>> details = _level->getDetails();
-        for (int n = 0; n < details.size(); n++) {
-            for (int m = 0; m < details.at(n).size(); m++) {
-                int type = details[n][m];
-                if (!(type == 0 || type >= 641 || type == 129 + 16 ||
-                      type == 129 + 24)) {
-                    int c = m % width;
-                    int r = m / width;
-                    addDetails(type, c, height - 1 - r);
-                }
-            }
+        // The classification, columns and walls come from the level cache
+        LevelCache cache;
+        cache.init(*_level, LEVEL_FINAL_KEY);
+        _obstacles.clear();
+        for (const LevelCache::Tile& detail : cache.getTiles()) {
+            addDetails(detail);
         }
-
-        std::sort(_obstacles.begin(), _obstacles.end(),
-                  [](std::shared_ptr<TileController>& a,
-                     std::shared_ptr<TileController>& b) {
-                      return a->getPosition().x < b->getPosition().x;
-                  });
-
-        std::vector<std::shared_ptr<TileController>> tmp;
-        tmp.emplace_back(_obstacles.at(0));
-        for (int i = 1; i < _obstacles.size(); i++) {
-            if (_obstacles.at(i)->getPosition().x !=
-                _obstacles.at(i - 1)->getPosition().x) {
-                _sortedObstacles.emplace_back(tmp);
-                tmp.clear();
+        for (LevelSpan<uint32_t> column : cache.getColumns()) {
+            std::vector<std::shared_ptr<TileController>> tiles;
+            tiles.reserve(column.size());
+            for (uint32_t index : column) {
+                tiles.push_back(_obstacles[index]);
             }
-            tmp.emplace_back(_obstacles.at(i));
+            _sortedObstacles.push_back(std::move(tiles));
         }
         _obstacles.clear();
 
-        for (int i = 0; i < _sortedObstacles.size(); i++) {
-            std::sort(_sortedObstacles.at(i).begin(),
-                      _sortedObstacles.at(i).end(),
-                      [](std::shared_ptr<TileController>& a,
-                         std::shared_ptr<TileController>& b) {
-                          return a->getYPos() > b->getYPos();
-                      });
-        }
-
         for (int i = 0; i < _holes.size(); i++) {
             _holes[i]->removeChildFrom(_obstacleNode);
             _holes[i]->addChildTo(_obstacleNode);
@@ -648,18 +737,20 @@ void SGameController::checkLevelLoaded() {
             }
         }
 
-        for (int i = 0; i < _level->getPortaits().size(); i++) {
-            _portraits->addPortrait(_portraitNodes, i,
-                                    _level->getPortaits()[i][0],
-                                    _level->getPortaits()[i][1], Vec3(0, 0, -1),
-                                    Vec2::ZERO, false, _level->getPortraitTypes()[i],_level->getBattery());
+        LevelRagged<Vec2> portraits = _level->getPortaits();
+        LevelSpan<int> portraitTypes = _level->getPortraitTypes();
+        for (int i = 0; i < portraits.size(); i++) {
+            _portraits->addPortrait(_portraitNodes, i, portraits[i][0],
+                                    portraits[i][1], Vec3(0, 0, -1), Vec2::ZERO,
+                                    false, portraitTypes[i],
+                                    _level->getBattery());
 
             // Add camera selection indicator
             if (i <= 0)
                 continue;
             auto indicator = cugl::scene2::PolygonNode::allocWithTexture(
                 _assets->get<Texture>("redindicator" + to_string(i)));
-            indicator->setPosition(_level->getPortaits()[i][2]);
+            indicator->setPosition(portraits[i][2]);
             indicator->setScale(2);
             indicator->setVisible(false);
             _fourthLayer->addChild(indicator);
@@ -667,7 +758,7 @@ void SGameController::checkLevelLoaded() {
             
             auto shadow = cugl::scene2::PolygonNode::allocWithTexture(
                 _assets->get<Texture>("blackshadow" + to_string(i)));
-            shadow->setPosition(_level->getPortaits()[i][2]);
+            shadow->setPosition(portraits[i][2]);
             shadow->setScale(2);
             shadow->setVisible(false);
             _fourthLayer->addChild(shadow);
@@ -675,12 +766,23 @@ void SGameController::checkLevelLoaded() {
             
             auto grayshadow = cugl::scene2::PolygonNode::allocWithTexture(
                 _assets->get<Texture>("shadow" + to_string(i)));
-            grayshadow->setPosition(_level->getPortaits()[i][2]);
+            grayshadow->setPosition(portraits[i][2]);
             grayshadow->setScale(2);
             grayshadow->setVisible(false);
             _fourthLayer->addChild(grayshadow);
             _grayshadows.emplace_back(grayshadow);
         }
+        // The spirit sees through a portrait what its indicator covers
+        std::vector<Rect> views(portraits.size());
+        for (int i = 1; i < views.size(); i++) {
+            float width = _indicators[i - 1]->getSize().width;
+            float height =
+                width * _scene->getSize().height / _scene->getSize().width;
+            Vec2 center = portraits[i][2];
+            views[i] = Rect(center.x - width / 2, center.y - height / 2, width,
+                            height);
+        }
+        _interest.setViews(views);
         _portraits->setMaxbattery(_level->getBattery());
 
         _portraits->initializeSheets(_assets->get<Texture>("greenBattery"),
@@ -693,6 +795,11 @@ void SGameController::checkLevelLoaded() {
         _spirit.getView()->addKillButtonTo(_fifthLayer);
 
         initDoors();
+        std::vector<Vec2> doors;
+        for (const std::pair<Vec2, int>& door : _level->getDoors()) {
+            doors.push_back(door.first);
+        }
+        _movement.init(cache.getObstacles(), doors);
 
         std::sort(_doorNodes.begin(), _doorNodes.end(),
                   [](std::shared_ptr<scene2::PolygonNode>& a,
@@ -747,7 +854,7 @@ void SGameController::generateLevel() {
 }
 
 void SGameController::initDoors() {
-    std::vector<std::pair<Vec2, int>> doors = _level->getDoors();
+    LevelSpan<std::pair<Vec2, int>> doors = _level->getDoors();
     for (int i = 0; i < doors.size(); i++) {
         _doors.emplace_back(std::make_shared<DoorController>(
             _assets, doors[i].first, doors[i].second, 1));
@@ -757,15 +864,15 @@ void SGameController::initDoors() {
 
 bool SGameController::checkConnection() {
     // IMPLEMENT ME
-    NetcodeConnection::State network_state = _network->getState();
+    Transport::State network_state = _network->getState();
     switch (network_state) {
-    case NetcodeConnection::State::FAILED:
-    case NetcodeConnection::State::DISCONNECTED:
+    case Transport::State::FAILED:
+    case Transport::State::DISCONNECTED:
         disconnect();
         _quit = true;
         return false;
         break;
-    case NetcodeConnection::State::CONNECTED:
+    case Transport::State::CONNECTED:
         break;
     default:
         break;
@@ -773,119 +880,454 @@ bool SGameController::checkConnection() {
     return true;
 }
 
-void SGameController::processData(const std::string source,
-                                  const std::vector<std::byte>& data) {
-    if (source != _network->getHost()) {
-        _deserializer->receive(data);
-        std::vector<float> mes =
-            std::get<std::vector<float>>(_deserializer->read());
-        if (mes[0] == 0 && !_hunterAdded) {
-            _spirit.addHunter(Vec2(mes[1], mes[2]), _hunterNodes);
-            for (int i = 0; i < _hunterNodes.size(); i++) {
-                _obstacleNode->addChild(_hunterNodes.at(i));
-            }
-            _spirit.moveHunter(Vec2(400, 400));
-            _hunterAdded = true;
-        } else if (mes[0] == 0) {
-            _spirit.moveHunter(Vec2(mes[1], mes[2]));
-            _hunterXPos = mes[1];
-            _hunterYPos = mes[2];
+void SGameController::processEvent(const std::string& source,
+                                   const NetEvent& event) {
+    if (event.host) {
+        return;
+    }
+    if (event.kind == NetEvent::Kind::Packet ||
+        event.kind == NetEvent::Kind::Dropped) {
+        // A reliable header never carries over into another packet
+        int sender = _hunters.find(source);
+        if (sender != -1) {
+            _hunters.get(sender).reliable.interrupt();
         }
-
-        // lol i'll work out more coherent codes for each message later oops
-        if (mes[0] == 4) {
-            // Treasure picked up alert (not sure if position will be used)
-            // idt position will be used ?
-            _treasureStolen = true;
-            //_spirit.treasureAlert(pos);
+        if (event.kind == NetEvent::Kind::Packet) {
+            _telemetry.recordPacketReceived(event.bytes);
         }
+        return;
+    } else if (event.kind == NetEvent::Kind::Malformed) {
+        CULog("Dropping malformed packet from %s", source.c_str());
+        return;
+    }
 
-        if (mes[0] == 6) {
-            // handle index of door for unlocking
-            _doorUnlocked = true;
-            _doorToUnlock = static_cast<int>(mes[1]);
-        }
+    const GameMessage& message = event.message;
+    size_t bytes = event.bytes;
+    _telemetry.recordReceived(message.type, bytes);
+    if (message.type == MessageType::Resume) {
+        resumeHunter(source, message.get<ResumeMessage>());
+        return;
+    }
+    int player = _hunters.find(source);
+    if (player == -1) {
+        player = _hunters.join(source, _outbox);
+    }
+    if (player == -1) {
+        CULog("Dropping message from %s; it has no place in the match",
+              source.c_str());
+        return;
+    }
+    _resume.heard(player, ClockSync::localMillis());
+    auto deliver = [&](const GameMessage& delivered) {
+        _messageLog.record(delivered, false);
+        processMessage(player, delivered, bytes);
+    };
+    if (!_hunters.get(player).reliable.filter(message, deliver)) {
+        processMessage(player, message, bytes);
+    }
+}
 
-        if (mes[0] == 7) {
-            if (_neverPlayed) {
-                AudioEngine::get()->play("trapSound", _trapSound, false, 0.8,
-                                         true);
-                _neverPlayed = false;
-            }
-            _trapTriggered = true;
-            _trapPos = Vec2(mes[1], mes[2]);
+void SGameController::processMessage(int player, const GameMessage& message,
+                                     size_t bytes) {
+    HunterLink& hunter = _hunters.get(player);
+    switch (message.type) {
+    case MessageType::HunterPos:
+    case MessageType::HunterDelta: {
+        Vec2 pos;
+        Uint16 time;
+        // In authoritative mode the hunter position comes from its inputs
+        if (_authoritative ||
+            !hunter.stream.receive(message, bytes, pos, time)) {
+            break;
         }
-
-        // Win alert for spirit
-        if (mes[0] == 10) {
-            _gameStatus = 1;
+        receiveHunter(player, pos, time);
+    } break;
+    case MessageType::HunterSpawn: {
+        const HunterSpawnMessage& spawn = message.get<HunterSpawnMessage>();
+        hunter.authority.spawn(spawn);
+        receiveHunter(player, hunter.authority.getPosition(), spawn.time);
+    } break;
+    case MessageType::HunterInput:
+        hunter.authority.receive(message.get<HunterInputMessage>());
+        break;
+    case MessageType::TreasureStolen: {
+        // Treasure picked up alert; the other hunters take it off the map
+        TreasureStolenMessage stolen = message.get<TreasureStolenMessage>();
+        if (stolen.treasure >= _treasuresTaken.size()) {
+            CULog("Dropping theft of unknown treasure %d from hunter %d",
+                  stolen.treasure, player);
+            break;
         }
-
-        // Lose alert for spirit
-        if (mes[0] == 8) {
-            _gameStatus = -1;
+        stolen.player = static_cast<Uint8>(player);
+        _treasureStolen = true;
+        if (!_treasuresTaken[stolen.treasure]) {
+            // A hunter resends its theft if we missed it before a resume
+            _treasuresTaken[stolen.treasure] = true;
+            _treasuresStolen++;
+        }
+        transmitReliable(stolen, player);
+    } break;
+    case MessageType::Desync: {
+        const DesyncMessage& desync = message.get<DesyncMessage>();
+        CULog("Desync: host hash %u, hunter hash %u", desync.host,
+              desync.hunter);
+        MatchSnapshot snapshot;
+        saveSnapshot(snapshot);
+        _desync.dump("spirit", snapshot, DesyncDetector::hash(snapshot),
+                     desync.hunter, _messageLog);
+    } break;
+    case MessageType::DoorUnlocked: {
+        int door = message.get<DoorUnlockedMessage>().door;
+        if (door < 0 || door >= static_cast<int>(_doors.size())) {
+            CULog("Dropping unlock of unknown door %d from hunter %d", door,
+                  player);
+            break;
         }
+        _doorsToUnlock.push_back(door);
+        _movement.setLocked(door, false);
+        transmitReliable(message, player);
+    } break;
+    case MessageType::TrapTriggered: {
+        if (_neverPlayed) {
+            AudioEngine::get()->play("trapSound", _trapSound, false, 0.8,
+                                     true);
+            _neverPlayed = false;
+        }
+        TrapTriggeredMessage trap = message.get<TrapTriggeredMessage>();
+        _trapTriggered = true;
+        _trapPos = Vec2(trap.x, trap.y);
+        trap.player = static_cast<Uint8>(player);
+        transmitReliable(trap, player);
+    } break;
+    case MessageType::ClockPing:
+        transmit(ClockSync::answer(message.get<ClockPingMessage>()),
+                 hunter.uuid);
+        break;
+    case MessageType::SpiritWin:
+        // Win alert for spirit
+        _gameStatus = 1;
+        break;
+    case MessageType::HunterWin:
+        // Lose alert for spirit
+        _gameStatus = -1;
+        transmitReliable(message, player);
+        break;
+    default:
+        break;
+    }
+}
+
+void SGameController::resumeHunter(const std::string& source,
+                                   const ResumeMessage& request) {
+    if (request.player < _hunters.size() && _resume.isGone(request.player)) {
+        // Too late; the new connection gets no place either
+        _hunters.refuse(source);
+        return;
+    }
+    if (request.player >= _hunters.size() || !_resume.accept(request)) {
+        return;
+    }
+    // The hunter rejoined with a new connection; start over with it
+    int player = request.player;
+    _hunters.rejoin(player, source);
+    _resume.heard(player, ClockSync::localMillis());
+    _interest.forget(player);
+    HunterLink& hunter = _hunters.get(player);
+    MatchSnapshot snapshot;
+    saveSnapshot(snapshot);
+    snapshot.hunter =
+        _authoritative ? hunter.authority.getPosition() : hunter.position;
+    _resume.answer(player, snapshot, [&](const GameMessage& chunk) {
+        _messageLog.record(chunk, true);
+        hunter.reliable.send(chunk, _outbox);
+    });
+}
+
+void SGameController::transmit(const GameMessage& message,
+                               const std::string& dest) {
+    if (dest.empty()) {
+        _outbox.push(message);
+    } else {
+        _outbox.push(message, Outbox::Route::Peer, dest);
+    }
+}
+
+void SGameController::updateTelemetry() {
+    _telemetry.update();
+    if (!_telemetry.showOverlay()) {
+        return;
+    }
+    std::string summary = _telemetry.getSummary();
+    if (_network) {
+        summary += "  " + _network->getSummary();
+    }
+    _telemetryLabel->setText(summary);
+    _telemetryLabel->setScale(0.5f / getZoom());
+    _telemetryLabel->setPosition(
+        _scene->getCamera()->screenToWorldCoords(Vec2(20, 20)));
+}
+
+void SGameController::transmitReliable(const GameMessage& message,
+                                       int except) {
+    _messageLog.record(message, true);
+    _hunters.send(message, _outbox, except);
+}
 
-        //        CULog("%f", mes[0]);
-        _deserializer->reset();
+void SGameController::transmitStateHash() {
+    if (!_desync.isDue(ClockSync::localMillis())) {
+        return;
+    }
+    MatchSnapshot snapshot;
+    saveSnapshot(snapshot);
+    Uint32 hash = DesyncDetector::hash(snapshot);
+    // The event counts are per channel, so every hunter gets its own
+    for (int p = 0; p < _hunters.size(); p++) {
+        HunterLink& hunter = _hunters.get(p);
+        if (hunter.uuid.empty()) {
+            continue;
+        }
+        StateHashMessage message{hunter.reliable.getNextSeq(),
+                                 hunter.reliable.getNextExpected(), hash};
+        _messageLog.record(message, true);
+        transmit(message, hunter.uuid);
     }
 }
 
-void SGameController::transmitTrap(std::vector<float> pos) {
-    _serializer->writeFloatVector(pos);
-    _network->broadcast(_serializer->serialize());
-    _serializer->reset();
+void SGameController::transmitTrap(Vec2 pos) {
+    transmitReliable(TrapPlacedMessage{pos.x, pos.y});
 }
 
 void SGameController::transmitActiveCamIndex(int i) {
-    std::vector<float> idx = std::vector<float>();
-    idx.push_back(3);
-    idx.push_back(i);
-    _serializer->writeFloatVector(idx);
-    _network->broadcast(_serializer->serialize());
-    _serializer->reset();
+    if (i != _camIndex) {
+        _camIndex = i;
+        _interest.setCamera(i);
+        _camVersion++;
+        _camDirty = true;
+    }
+    Uint32 now = ClockSync::localMillis();
+    if (_camDirty || now - _camSent >= CAMERA_STATE_REPEAT) {
+        transmit(CameraStateMessage{_camVersion, _camIndex});
+        _camSent = now;
+        _camDirty = false;
+    }
 }
 
 void SGameController::transmitLockedDoor(int i) {
-    std::vector<float> idx = std::vector<float>();
-    idx.push_back(5);
-    idx.push_back(i);
-    _serializer->writeFloatVector(idx);
-    _network->broadcast(_serializer->serialize());
-    _serializer->reset();
+    _movement.setLocked(i, true);
+    transmitReliable(DoorLockedMessage{i});
 }
 
-void SGameController::transmitTimer(int i) {
-    std::vector<float> idx = std::vector<float>();
-    idx.push_back(11);
-    idx.push_back(i);
-    _serializer->writeFloatVector(idx);
-    _network->broadcast(_serializer->serialize());
-    _serializer->reset();
+void SGameController::receiveHunter(int player, Vec2 pos, Uint16 time) {
+    // The hunter is moved from the buffer once per frame in updateHunters
+    HunterLink& hunter = _hunters.get(player);
+    Uint32 now = ClockSync::localMillis();
+    hunter.buffer.push(time, pos, now);
+    hunter.history.record(time, pos, now);
+    _relay.record(player, time, pos);
+    // The stamp is in host time once the hunter has synced its clock
+    Uint16 delay = static_cast<Uint16>(now) - time;
+    if (delay < TELEMETRY_MAX_DELAY) {
+        _telemetry.recordDelay(delay);
+    }
+    if (hunter.shown) {
+        return;
+    }
+    hunter.shown = true;
+    hunter.position = pos;
+    if (player == 0) {
+        _spirit.addHunter(pos, _hunterNodes);
+        for (int i = 0; i < _hunterNodes.size(); i++) {
+            _obstacleNode->addChild(_hunterNodes.at(i));
+        }
+        _spirit.moveHunter(Vec2(400, 400));
+        _hunterAdded = true;
+    } else {
+        std::vector<std::shared_ptr<scene2::PolygonNode>>& nodes =
+            _teammateNodes[player];
+        _spirit.getModel()->addTeammate(player, pos, nodes);
+        for (int i = 0; i < nodes.size(); i++) {
+            _obstacleNode->addChild(nodes.at(i));
+        }
+    }
 }
 
-void SGameController::transmitKill() {
-    std::vector<float> idx = std::vector<float>();
-    idx.push_back(9);
-    _serializer->writeFloatVector(idx);
-    _network->broadcast(_serializer->serialize());
-    _serializer->reset();
+void SGameController::updateHunters() {
+    Uint32 now = ClockSync::localMillis();
+    for (int p = 0; p < _hunters.size(); p++) {
+        HunterLink& hunter = _hunters.get(p);
+        if (hunter.uuid.empty()) {
+            // The hunter left the match
+            continue;
+        }
+        GameMessage ack;
+        if (_network && hunter.stream.update(ack)) {
+            transmit(ack, hunter.uuid);
+        }
+
+        GameMessage state;
+        if (_authoritative && _levelLoaded &&
+            hunter.authority.update(
+                _step, now,
+                [this, p](Vec2 pos, Uint16 time) {
+                    receiveHunter(p, pos, time);
+                },
+                state)) {
+            hunter.state = state;
+            hunter.stateHeld = true;
+        }
+        // A hidden hunter gets the newest state at a heartbeat
+        if (hunter.stateHeld &&
+            (!_interestManaged || _interest.isDue(p, now))) {
+            transmit(hunter.state, hunter.uuid);
+            hunter.stateHeld = false;
+        }
+
+        Vec2 hunterPos;
+        if (hunter.shown && hunter.buffer.sample(now, hunterPos)) {
+            hunter.seen = hunter.buffer.getRenderTime();
+            hunter.position = hunterPos;
+            if (p == 0) {
+                _spirit.moveHunter(hunterPos);
+                _hunterXPos = hunterPos.x;
+                _hunterYPos = hunterPos.y;
+            } else {
+                _spirit.getModel()->moveTeammate(p, hunterPos);
+            }
+        }
+        // Under authority the newest position is ours, not the buffered one
+        Vec2 newest =
+            _authoritative ? hunter.authority.getPosition() : hunter.position;
+        bool visible;
+        if (_interestManaged && hunter.shown &&
+            _interest.update(p, newest, visible)) {
+            InterestMessage interest{static_cast<Uint8>(visible)};
+            _messageLog.record(interest, true);
+            hunter.reliable.send(interest, _outbox);
+        }
+        if (hunter.stream.getCounter().getFrames() % 600 == 0) {
+            CULog("hunter %d buffer: delay %.0f ms, jitter %.1f ms, depth %zu, "
+                  "%llu late, %llu extrapolated of %llu",
+                  p, hunter.buffer.getDelay(), hunter.buffer.getJitter(),
+                  hunter.buffer.getDepth(),
+                  (unsigned long long)hunter.buffer.getLate(),
+                  (unsigned long long)hunter.buffer.getExtrapolated(),
+                  (unsigned long long)hunter.buffer.getReceived());
+        }
+    }
+    if (_network) {
+        _relay.update(
+            now, [this](const GameMessage& peer) { transmit(peer); },
+            [this](int player) {
+                return _interestManaged && _interest.isHidden(player);
+            });
+    }
+}
+
+void SGameController::saveSnapshot(MatchSnapshot& snapshot) {
+    snapshot.clear();
+    snapshot.time = ClockSync::localMillis();
+    snapshot.deadline = _deadline;
+    snapshot.remaining = _timeLeft * 1000 / 60;
+    snapshot.hunter = _authoritative ? _hunters.get(0).authority.getPosition()
+                                     : Vec2(_hunterXPos, _hunterYPos);
+    std::shared_ptr<SpiritModel> model = _spirit.getModel();
+    snapshot.health = model->health;
+    snapshot.treasureCount = _treasuresStolen;
+    // The hunters place the treasures, so only whether they are taken is ours
+    for (bool taken : _treasuresTaken) {
+        snapshot.treasures.push_back({Vec2::ZERO, taken});
+    }
+    snapshot.camera = _camIndex;
+    for (int i = 0; i < _doors.size(); i++) {
+        if (_doors.at(i)->isLocked()) {
+            snapshot.lockedDoors.push_back(i);
+        }
+    }
+    for (const std::shared_ptr<TrapModel>& trap : model->getTraps()) {
+        snapshot.traps.push_back({trap->getPosition(), trap->getAge(),
+                                  trap->getTriggerTime(), trap->getTrigger()});
+    }
+    for (int i = 0; i < _portraits->getSize(); i++) {
+        snapshot.portraits.push_back(
+            {_portraits->getBattery(i), _portraits->getState(i)});
+    }
+    snapshot.trapsLeft = model->traps;
+    snapshot.doorsLeft = model->doors;
+    snapshot.energy = model->energy;
+    snapshot.killCool = model->killCool;
+    snapshot.doorCool = model->doorCool;
+    snapshot.clamCool = model->clamCool;
+    snapshot.cameraCool = model->cameraCool;
+}
+
+void SGameController::restoreSnapshot(const MatchSnapshot& snapshot) {
+    _deadline = snapshot.deadline;
+    _timeLeft = static_cast<int>(snapshot.remaining * 60 / 1000);
+    _deadlineDirty = true;
+    // The portrait in use is left alone; it is our own choice, not state
+    _hunterXPos = snapshot.hunter.x;
+    _hunterYPos = snapshot.hunter.y;
+    _hunters.get(0).authority.setPosition(snapshot.hunter);
+    if (_hunterAdded) {
+        _spirit.moveHunter(snapshot.hunter);
+    }
+
+    _treasuresStolen = snapshot.treasureCount;
+    for (int i = 0; i < _treasuresTaken.size(); i++) {
+        _treasuresTaken[i] =
+            i < snapshot.treasures.size() && snapshot.treasures[i].taken;
+    }
+    std::shared_ptr<SpiritModel> model = _spirit.getModel();
+    model->setHealth(snapshot.health);
+    std::vector<bool> locked(_doors.size(), false);
+    for (int door : snapshot.lockedDoors) {
+        if (door >= 0 && door < (int)locked.size()) {
+            locked[door] = true;
+        }
+    }
+    for (int i = 0; i < _doors.size(); i++) {
+        if (locked[i] && !_doors.at(i)->isLocked()) {
+            _doors.at(i)->lock();
+        } else if (!locked[i] && _doors.at(i)->isLocked()) {
+            _doors.at(i)->resetHunterUnlock();
+        }
+        _movement.setLocked(i, locked[i]);
+    }
+
+    model->clearTraps(_secondLayer);
+    for (const TrapSnapshot& trap : snapshot.traps) {
+        if (!model->addTrap(trap.position, _secondLayer)) {
+            continue;
+        }
+        std::shared_ptr<TrapModel> restored = model->getTraps().back();
+        restored->setAge(trap.age);
+        restored->setTriggerTime(trap.triggerTime);
+        restored->setTrigger(trap.triggered);
+    }
+    for (int i = 0; i < _portraits->getSize() && i < snapshot.portraits.size();
+         i++) {
+        _portraits->restoreBattery(i, snapshot.portraits[i].battery,
+                                   snapshot.portraits[i].on);
+    }
+    model->setTraps(snapshot.trapsLeft);
+    model->setDoors(snapshot.doorsLeft);
+    model->setEnergy(snapshot.energy);
+    model->setKillCooldown(snapshot.killCool);
+    model->setDoorCooldown(snapshot.doorCool);
+    model->setClamCooldown(snapshot.clamCool);
+    model->setCameraCooldown(snapshot.cameraCool);
+}
+
+void SGameController::transmitKill(int player) {
+    transmitReliable(KillMessage{static_cast<Uint8>(player)});
 }
 
 void SGameController::transmitSpiritWin() {
-    std::vector<float> idx = std::vector<float>();
-    idx.push_back(10);
-    _serializer->writeFloatVector(idx);
-    _network->broadcast(_serializer->serialize());
-    _serializer->reset();
+    transmitReliable(SpiritWinMessage{});
 }
 
 void SGameController::transmitHunterWin() {
-    std::vector<float> idx = std::vector<float>();
-    idx.push_back(8);
-    _serializer->writeFloatVector(idx);
-    _network->broadcast(_serializer->serialize());
-    _serializer->reset();
+    transmitReliable(HunterWinMessage{});
 }
 
 void SGameController::addFloorTile(int type, int c, int r) {
@@ -1021,19 +1463,45 @@ void SGameController::modifyTexture(std::shared_ptr<Texture>& texture,
 }
 
 void SGameController::sortNodes() {
-    if (!_selection && _spirit.getModel()->hunterAdded) {
-        for (int n = 0; n < _hunterNodes.size(); n++) {
-            _obstacleNode->removeChild(_hunterNodes.at(n));
-            _obstacleNode->addChild(_hunterNodes.at(n));
+    // Painter's order: the hunter highest up the screen is drawn first
+    std::vector<int> order;
+    for (int p = 0; p < _hunters.size(); p++) {
+        if (_hunters.get(p).shown) {
+            order.push_back(p);
         }
     }
+    if (order.empty()) {
+        sortNodesAround(Vec2(_hunterXPos, _hunterYPos));
+        return;
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return _hunters.get(a).position.y > _hunters.get(b).position.y;
+    });
+
+    for (int p : order) {
+        std::vector<std::shared_ptr<scene2::PolygonNode>>* nodes = nullptr;
+        if (p != 0) {
+            nodes = &_teammateNodes[p];
+        } else if (!_selection && _spirit.getModel()->hunterAdded) {
+            nodes = &_hunterNodes;
+        }
+        if (nodes != nullptr) {
+            for (int n = 0; n < nodes->size(); n++) {
+                _obstacleNode->removeChild(nodes->at(n));
+                _obstacleNode->addChild(nodes->at(n));
+            }
+        }
+        sortNodesAround(p == 0 ? Vec2(_hunterXPos, _hunterYPos)
+                               : _hunters.get(p).position);
+    }
+}
 
+void SGameController::sortNodesAround(Vec2 pos) {
     for (int i = 0; i < _sortedObstacles.size(); i++) {
-        float xDiff =
-            abs(_hunterXPos - _sortedObstacles[i][0]->getPosition().x);
+        float xDiff = abs(pos.x - _sortedObstacles[i][0]->getPosition().x);
         if (xDiff < 128 * 2) {
             for (int n = 0; n < _sortedObstacles.at(i).size(); n++) {
-                if (_hunterYPos > _sortedObstacles[i][n]->getYPos() &&
+                if (pos.y > _sortedObstacles[i][n]->getYPos() &&
                     _sortedObstacles[i][n]->isObstacle()) {
                     _sortedObstacles[i][n]->removeChildFrom(_obstacleNode);
                     _sortedObstacles[i][n]->addChildTo(_obstacleNode);
@@ -1043,18 +1511,18 @@ void SGameController::sortNodes() {
     }
 
     for (int i = 0; i < _doorNodes.size(); i++) {
-        if (_hunterYPos > _doorNodes.at(i)->getPositionY() + 32) {
+        if (pos.y > _doorNodes.at(i)->getPositionY() + 32) {
             _obstacleNode->removeChild(_doorNodes.at(i));
             _obstacleNode->addChild(_doorNodes.at(i));
         }
     }
 
     for (int i = 0; i < _portraitNodes.size(); i++) {
-        if (_hunterYPos > _portraitNodes.at(i)->getPositionY() - 64) {
+        if (pos.y > _portraitNodes.at(i)->getPositionY() - 64) {
             _obstacleNode->removeChild(_portraitNodes.at(i));
             _obstacleNode->addChild(_portraitNodes.at(i));
         } else {
-            return;
+            break;
         }
     }
 }
@@ -1096,110 +1564,36 @@ std::shared_ptr<Texture> SGameController::getTexture(int type) {
     return texture;
 }
 
-void SGameController::addDetails(int type, int c, int r) {
-    std::shared_ptr<Texture> texture = getTexture(type);
-    Vec2 pos(_level->getTileWidth() * c, _level->getTileWidth() * r);
+void SGameController::addDetails(const LevelCache::Tile& detail) {
+    std::shared_ptr<Texture> texture = getTexture(detail.type);
+    Vec2 pos(_level->getTileWidth() * detail.c,
+             _level->getTileWidth() * detail.r);
     std::shared_ptr<TileController> tile = std::make_shared<TileController>(
         pos, _level->getTileSize(), Color4::WHITE, false, texture, pos.y);
-    float yPos = getYPos(type, pos.y, tile, c, r);
-    if (yPos != -FLT_MAX) {
-        tile->setYPos(yPos);
-    } else {
+    switch (detail.kind) {
+    case LevelCache::Kind::Wall:
+        _tilemap->setTileTraversable(detail.c, detail.r, false);
+        tile->setYPos(detail.yPos);
+        break;
+    case LevelCache::Kind::Obstacle:
+        tile->setYPos(detail.yPos);
+        break;
+    case LevelCache::Kind::Carpet:
+        _carpets.emplace_back(tile);
+        tile->setObstacle(false);
+        break;
+    case LevelCache::Kind::Hole:
+        _holes.emplace_back(tile);
+        tile->setObstacle(false);
+        break;
+    case LevelCache::Kind::Flat:
         tile->setObstacle(false);
+        break;
     }
     _obstacles.emplace_back(tile);
     tile->addChildTo(_obstacleNode);
 }
 
-float SGameController::getYPos(int type, float pos,
-                               std::shared_ptr<TileController>& tile, int c, int r) {
-    float yPos = pos;
-    int tileSize = _level->getTileWidth();
-    int index = type;
-    if (type < 65) {
-        // wall
-        _tilemap->setTileTraversable(c, r, false);
-        yPos += 11;
-        index -= 1;
-        if (index == 0 || index == 1 || index == 8 || index == 9 ||
-            index == 10 || index == 11 || index == 20 || index == 21 ||
-            index == 22 || index == 34 || index == 35) {
-            yPos -= 2 * tileSize;
-        } else if (index == 32 || index == 33) {
-            yPos -= tileSize;
-        }
-    } else if (type < 129) {
-        // floor
-        return -FLT_MAX;
-    } else if (type < 193) {
-        // dector
-        yPos += 8;
-        index -= 129;
-        if (type == 16 || type == 24) {
-            return FLT_MAX;
-        }
-        if (index == 6 || index == 7) {
-            yPos -= 2 * tileSize;
-        } else if (index == 14 || index == 15 || index == 1 || index == 2 ||
-                   index == 3 || index == 4 || index == 17 || index == 18 ||
-                   index == 19 || index == 20 || index == 32 || index == 33 ||
-                   index == 34 || index == 35 || index == 36 || index == 37) {
-            yPos -= tileSize;
-        }
-    } else if (type < 257) {
-        // grime
-        yPos += 9;
-        index -= 193;
-    } else if (type < 321) {
-        // placeholder
-        return -FLT_MAX;
-    } else if (type < 385) {
-        // wall upper
-        yPos += 10;
-        index -= 321;
-        if (index >= 16 && index <= 63) {
-            yPos += tileSize;
-        }
-    } else if (type < 449) {
-        // ao
-        return -FLT_MAX;
-    } else if (type < 513) {
-        // dector2
-        yPos += 8;
-        index -= 449;
-        if (index == 36 || index == 37 || index == 38 || index == 44 ||
-            index == 45 || index == 46 || index == 52 || index == 53 ||
-            index == 54) {
-            _carpets.emplace_back(tile);
-            return -FLT_MAX;
-        }
-        if (index < 8 || (index >= 16 && index <= 23) || index == 32 ||
-            index == 48 || index == 49) {
-            yPos -= tileSize;
-        }
-    } else if (type < 577) {
-        // env
-        yPos += 8;
-        index -= 513;
-        if (index == 24 || index == 25 || index == 32 || index == 33 ||
-            index == 40 || index == 41 || index == 35 || index == 36 ||
-            index == 37 || index == 48 || index == 49 || index == 50 ||
-            index == 54 || index == 55 || index == 62) {
-            _holes.emplace_back(tile);
-            return -FLT_MAX;
-        }
-    } else {
-        // env2
-        yPos += 8;
-        index -= 577;
-        if (index == 0 || index == 1 || index == 6 || index == 7 ||
-            (index >= 16 && index <= 21)) {
-            yPos -= tileSize;
-        }
-    }
-    return yPos;
-}
-
 void SGameController::beginDetectTrap(){
     // get hunter position-> to grid
     // for 3*3 -> generate red cue if is transable -> push to detection -> set false place trap in tile map
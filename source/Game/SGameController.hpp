@@ -6,7 +6,9 @@
 #include "Button.h"
 #include "DoorController.hpp"
 #include "HunterController.h"
+#include "HunterMovement.h"
 #include "InputController.h"
+#include "LevelCache.h"
 #include "LevelModel.h"
 #include "Minimap.h"
 #include "PortraitSetController.h"
@@ -14,6 +16,23 @@
 #include "TileController.h"
 #include "TilemapController.h"
 #include "TrapController.hpp"
+#include "SCMessage.hpp"
+#include "SCNetTelemetry.hpp"
+#include "SCOutbox.hpp"
+#include "SCClockSync.hpp"
+#include "SCDesync.hpp"
+#include "SCHunterRoster.hpp"
+#include "SCInterest.hpp"
+#include "SCJitterBuffer.hpp"
+#include "SCMatchSnapshot.hpp"
+#include "SCPositionHistory.hpp"
+#include "SCPositionStream.hpp"
+#include "SCPrediction.hpp"
+#include "SCReliableChannel.hpp"
+#include "SCSessionResume.hpp"
+#include "SCThreadedTransport.hpp"
+#include "SCTransport.hpp"
+#include <array>
 #include <cugl/cugl.h>
 #include <unordered_set>
 #include <vector>
@@ -96,8 +115,8 @@ class SGameController {
     /** The text with the current health */
     std::shared_ptr<cugl::TextLayout> _text;
 
-    /** The network connection (as made by this scene) */
-    std::shared_ptr<cugl::net::NetcodeConnection> _network;
+    /** The network connection, received and decoded on its own thread */
+    std::shared_ptr<ThreadedTransport> _network;
 
     bool _levelLoaded = false;
 
@@ -113,9 +132,49 @@ class SGameController {
 
     bool _selection;
 
-    std::shared_ptr<cugl::net::NetcodeSerializer> _serializer;
+    /** The messages to send at the end of this frame */
+    Outbox _outbox;
 
-    std::shared_ptr<cugl::net::NetcodeDeserializer> _deserializer;
+    /** The hunters, with everything we keep for each of them */
+    HunterRoster _hunters;
+
+    /** The relay of every hunter position to the other hunters */
+    PeerRelay _relay;
+
+    /** Whether we decide where the hunters are; see json/network.json */
+    bool _authoritative;
+
+    /** Whether hidden hunters are streamed and relayed at a heartbeat */
+    bool _interestManaged;
+
+    /** The visibility of every hunter through the active portrait */
+    InterestManager _interest;
+
+    /** The walls and doors the hunter collides with, shared with the hunter */
+    HunterMovement _movement;
+
+    /** The movement step of _movement */
+    MovementStep _step;
+
+    /** The pause and resync while a hunter rejoins */
+    ResumeHost _resume;
+
+    /** The schedule of our state hashes, and the desync dumps */
+    DesyncDetector _desync;
+
+    /** The recent game events, written out on a desync */
+    MessageLog _messageLog;
+
+    /** The number of treasures the hunters have stolen */
+    int _treasuresStolen;
+    /** Whether each treasure has been stolen, by treasure index */
+    std::array<bool, 3> _treasuresTaken;
+
+    /** The wire statistics of this device */
+    NetTelemetry _telemetry;
+
+    /** The telemetry overlay, hidden unless enabled in json/telemetry.json */
+    std::shared_ptr<cugl::scene2::Label> _telemetryLabel;
 
     bool _hunterAdded;
 
@@ -130,11 +189,25 @@ class SGameController {
     float _timerScale;
     std::shared_ptr<cugl::scene2::Label> _timerLabel;
     int _timeLeft = 120 * 60;
+    /** The end of the match in local (host) milliseconds, 0 before it starts */
+    Uint32 _deadline;
+    /** The local time the deadline was last sent */
+    Uint32 _deadlineSent;
+    /** Whether the deadline changed since it was last sent */
+    bool _deadlineDirty;
+    /** The portrait index last sent to the hunter, -1 for none */
+    int _camIndex;
+    /** The version of the camera state, increased on every change */
+    Uint8 _camVersion;
+    /** The local time the camera state was last sent */
+    Uint32 _camSent;
+    /** Whether the camera state changed since it was last sent */
+    bool _camDirty;
 
     /** If hunter trigger the trap */
     bool _trapTriggered;
-    /** If hunter unlock a door */
-    bool _doorUnlocked;
+    /** The doors hunters unlocked, waiting to be unlocked on the map */
+    std::vector<int> _doorsToUnlock;
 
     bool _treasureStolen;
 
@@ -143,8 +216,6 @@ class SGameController {
 
     int _alertTimer;
 
-    int _doorToUnlock;
-
     Vec2 _trapPos;
 
     float _hunterYPos;
@@ -187,6 +258,9 @@ class SGameController {
 
     std::vector<std::shared_ptr<scene2::SpriteNode>> _candleNodes;
     std::vector<std::shared_ptr<scene2::PolygonNode>> _hunterNodes;
+    /** The nodes of the other hunters than the first, by player number */
+    std::array<std::vector<std::shared_ptr<scene2::PolygonNode>>, MAX_HUNTERS>
+        _teammateNodes;
     std::vector<std::shared_ptr<scene2::PolygonNode>> _doorNodes;
     std::vector<std::shared_ptr<scene2::PolygonNode>> _portraitNodes;
 
@@ -237,7 +311,7 @@ class SGameController {
      *
      * @return the network connection (as made by this scene)
      */
-    std::shared_ptr<cugl::net::NetcodeConnection> getConnection() const {
+    std::shared_ptr<Transport> getConnection() const {
         return _network;
     }
 
@@ -249,8 +323,11 @@ class SGameController {
      * @return the network connection (as made by this scene)
      */
     void setConnection(
-        const std::shared_ptr<cugl::net::NetcodeConnection>& network) {
-        _network = network;
+        const std::shared_ptr<Transport>& network) {
+        // Packets are received and decoded off the game loop
+        _network = network ? ThreadedTransport::alloc(network) : nullptr;
+        // Every peer in the room but us is a hunter
+        _hunters.reset(network ? (int)network->getNumPlayers() - 1 : 0);
     }
 
     /**
@@ -301,22 +378,35 @@ class SGameController {
     void generateLevel();
 
     /**
-     * Processes data sent over the network.
-     *
-     * Once connection is established, all data sent over the network consistes
-     * of byte vectors. This function is a call back function to process that
-     * data. Note that this function may be called *multiple times* per
-     * animation frame, as the messages can come from several sources.
+     * Processes something received over the network.
      *
-     * Typically this is where players would communicate their names after being
-     * connected. In this lab, we only need it to do one thing: communicate that
-     * the host has started the game.
+     * The network thread has already split each packet into its messages.
+     * This is called from the drain at the start of the frame, once per
+     * packet and once per message, and may run *many times* per animation
+     * frame, as the messages can come from several sources.
      *
      * @param source    The UUID of the sender
-     * @param data      The data received
+     * @param event     The packet or message received
+     */
+    void processEvent(const std::string& source, const NetEvent& event);
+
+    /**
+     * Processes a single message from a hunter.
+     *
+     * @param player    The player number of the sender
+     * @param message   The decoded message
+     * @param bytes     The encoded size of the message
      */
-    void processData(const std::string source,
-                     const std::vector<std::byte>& data);
+    void processMessage(int player, const GameMessage& message, size_t bytes);
+
+    /**
+     * Moves a hunter that rejoined to its new connection, and answers it
+     * with the match snapshot.
+     *
+     * @param source    The UUID of the new connection
+     * @param request   The resume request
+     */
+    void resumeHunter(const std::string& source, const ResumeMessage& request);
 
     /**
      * Checks that the network connection is still active.
@@ -329,11 +419,44 @@ class SGameController {
      */
     bool checkConnection();
 
-    void transmitTrap(std::vector<float> pos);
+    /**
+     * Queues a message to be sent at the end of this frame.
+     *
+     * @param message   The message to send
+     * @param dest      The peer to send to, or empty to broadcast
+     */
+    void transmit(const GameMessage& message, const std::string& dest = "");
+
+    /**
+     * Queues a game event for reliable, ordered delivery to every hunter.
+     *
+     * @param message   The event to send
+     * @param except    A player not to send it to, or -1
+     */
+    void transmitReliable(const GameMessage& message, int except = -1);
+
+    /**
+     * Sends the hash of our state to every hunter once every
+     * STATE_HASH_INTERVAL, so that they can check they are in sync with us.
+     */
+    void transmitStateHash();
 
+    void transmitTrap(Vec2 pos);
+
+    /**
+     * Sends the portrait the spirit is looking through if it changed, or
+     * if the last copy is older than CAMERA_STATE_REPEAT.
+     *
+     * @param i The portrait index, or -1 for none
+     */
     void transmitActiveCamIndex(int i);
 
-    void transmitKill();
+    /**
+     * Takes a team heart for a hit on a hunter.
+     *
+     * @param player    The player number of the hunter that was hit
+     */
+    void transmitKill(int player);
 
     void transmitSpiritWin();
 
@@ -344,8 +467,67 @@ class SGameController {
     void updateDoors();
 
     void transmitLockedDoor(int i);
+
+    /**
+     * Records a new hunter position, from the position stream or from an
+     * input we applied, and shows the hunter the first time.
+     *
+     * @param player    The player number of the hunter
+     * @param pos       The hunter position
+     * @param time      The low 16 bits of the hunter synced clock
+     */
+    void receiveHunter(int player, Vec2 pos, Uint16 time);
+
+    /**
+     * Moves every hunter shown to its buffered position, and relays the
+     * hunters to each other. This must be called every frame.
+     */
+    void updateHunters();
+
+    /**
+     * Fills in the part of the match this device owns.
+     *
+     * @param snapshot  The snapshot to fill in; it is cleared first
+     */
+    void saveSnapshot(MatchSnapshot& snapshot);
+
+    /**
+     * Puts the part of the match this device owns back as it was in a
+     * snapshot. The level must be loaded.
+     *
+     * @param snapshot  The snapshot to restore
+     */
+    void restoreSnapshot(const MatchSnapshot& snapshot);
+
+    /**
+     * Follows the hunters missing from the room.
+     *
+     * A missing hunter keeps its place while the others play on. One that
+     * is not back within RECONNECT_WINDOW gives up its place: it is hidden,
+     * sent nothing more and never given a player number again. The match
+     * is paused only while every hunter left is missing, with the network
+     * still served so that they can resume; the paused time is added to
+     * the deadline once one is back. The match ends once no hunter holds a
+     * place.
+     *
+     * @return true if the match is paused this frame
+     */
+    bool waitForHunter();
     
-    void transmitTimer(int i);
+    /**
+     * Updates the match countdown from the deadline.
+     *
+     * The deadline is fixed when the spawn animation ends. It is sent to the
+     * hunter when it changes and repeated at a low rate, so both sides can
+     * compute the countdown locally instead of receiving it every frame.
+     */
+    void updateTimer();
+
+    /**
+     * Advances the telemetry and refreshes its overlay. This must be called
+     * every frame.
+     */
+    void updateTelemetry();
 
     void addFloorTile(int type, int c, int r);
 
@@ -361,15 +543,25 @@ class SGameController {
 
     void addCandles(int type, int c, int r);
 
+    /**
+     * Draws the hunters back to front, each followed by the walls, doors and
+     * portraits that stand in front of it.
+     */
     void sortNodes();
 
+    /**
+     * Draws the walls, doors and portraits in front of a position over
+     * everything before them.
+     *
+     * @param pos   The position of a hunter
+     */
+    void sortNodesAround(Vec2 pos);
+
     std::shared_ptr<Texture> getTexture(int type);
 
-    void addDetails(int type, int c, int r);
+    void addDetails(const LevelCache::Tile& detail);
 
     void modifyTexture(std::shared_ptr<Texture>& texture, int index);
-
-    float getYPos(int type, float pos, std::shared_ptr<TileController>& tile, int c, int r);
     
     void beginDetectTrap();
     
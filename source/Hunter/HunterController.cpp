@@ -7,6 +7,7 @@
 //
 #include "HunterController.h"
 #include "HunterModel.h"
+#include "HunterMovement.h"
 #include "HunterView.h"
 
 #pragma mark Main Functions
@@ -37,7 +38,7 @@ HunterController::HunterController(
     _pos = _model->position;
     _ang = 0;
     _dAng = 0;
-    _vel = Vec2(7, 7);
+    _vel = Vec2(HUNTER_SPEED, HUNTER_SPEED);
 }
 
 bool HunterController::detectedDoor(cugl::Vec2 position) {
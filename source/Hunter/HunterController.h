@@ -173,6 +173,8 @@ class HunterController {
 
     void removeTrap(int index) { _model->removeTrap(index); }
 
+    void clearTraps() { _model->clearTraps(); }
+
     int getTrapSize() { return _model->getTrapSize(); }
 
     void
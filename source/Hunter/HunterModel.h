@@ -141,6 +141,15 @@ class HunterModel : public physics2::WheelObstacle {
         _size1--;
     }
 
+    void clearTraps() {
+        for (auto& trap : _trapViews) {
+            trap->removeChildFrom(_scene);
+        }
+        _trapModels.clear();
+        _trapViews.clear();
+        _size1 = 0;
+    }
+
     void applyForce(cugl::Vec2 force) {
         // Push the player in the direction they want to go
         b2Vec2 b2force(0.05 * force.x, 0.05 * force.y);
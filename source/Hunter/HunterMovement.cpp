@@ -0,0 +1,71 @@
+//
+//  HunterMovement.cpp
+//  Sunk Cost
+//
+//  This module provides the movement rule of the hunter, shared by the
+//  hunter and the host. See the header for details.
+//
+
+#include "HunterMovement.h"
+
+using namespace cugl;
+
+/**
+ * Builds the walls and doors of a level, with every door unlocked.
+ *
+ * @param obstacles The walls as polygons, such as LevelCache builds
+ * @param doors     The position of every door
+ */
+void HunterMovement::init(const std::vector<Poly2>& obstacles,
+                          const std::vector<Vec2>& doors) {
+    _obstacles = obstacles;
+    _doors.clear();
+    _locked.clear();
+    for (Vec2 door : doors) {
+        addDoor(door);
+    }
+}
+
+/**
+ * Returns true if the hunter may move by delta from position.
+ *
+ * @param position  The hunter position
+ * @param delta     The move
+ */
+bool HunterMovement::canMove(Vec2 position, Vec2 delta) const {
+    Vec2 shadow = position - HUNTER_SHADOW_OFFSET + delta;
+    Vec2 side(HUNTER_SHADOW_HALF_WIDTH, 0);
+    for (const Poly2& obstacle : _obstacles) {
+        if (obstacle.contains(shadow + side) ||
+            obstacle.contains(shadow - side) || obstacle.contains(shadow)) {
+            return false;
+        }
+    }
+
+    Vec2 next = position + delta;
+    for (size_t i = 0; i < _doors.size(); i++) {
+        if (_locked[i] && std::abs(next.x - _doors[i].x) < 128 * 2 &&
+            std::abs(next.y - (_doors[i].y - 128)) < 30) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Returns the hunter position after one frame of input.
+ *
+ * @param position  The hunter position
+ * @param forward   The vertical input in [-1, 1]
+ * @param rightward The horizontal input in [-1, 1]
+ *
+ * @return the new position, or position if the move is blocked
+ */
+Vec2 HunterMovement::step(Vec2 position, float forward,
+                          float rightward) const {
+    Vec2 delta(rightward * _velocity.x, forward * _velocity.y);
+    if (delta == Vec2::ZERO || !canMove(position, delta)) {
+        return position;
+    }
+    return position + delta;
+}
@@ -0,0 +1,102 @@
+//
+//  HunterMovement.h
+//  Sunk Cost
+//
+//  This module provides the movement rule of the hunter, shared by the
+//  hunter and the host.
+//
+//  One step moves the hunter by one frame of input, unless the move would
+//  put its shadow in a wall or walk it into a locked door. The step is a
+//  pure function of the position, the input and the door state, so the
+//  hunter can predict it and the host can check it and get the same result.
+//
+
+#ifndef _HUNTER_MOVEMENT_H
+#define _HUNTER_MOVEMENT_H
+
+#include <cugl/cugl.h>
+#include <vector>
+
+/** The distance the hunter moves per frame of full input on each axis */
+#define HUNTER_SPEED 7.0f
+/** The offset from the hunter position to its shadow, which collides */
+#define HUNTER_SHADOW_OFFSET cugl::Vec2(130, 270)
+/** The half width of the shadow for wall collisions */
+#define HUNTER_SHADOW_HALF_WIDTH 40.0f
+
+class HunterMovement {
+  private:
+    /** The walls, including the level border */
+    std::vector<cugl::Poly2> _obstacles;
+    /** The position of every door */
+    std::vector<cugl::Vec2> _doors;
+    /** Whether each door is locked */
+    std::vector<bool> _locked;
+    /** The distance moved per frame of full input */
+    cugl::Vec2 _velocity;
+
+  public:
+    HunterMovement() : _velocity(HUNTER_SPEED, HUNTER_SPEED) {}
+
+    /**
+     * Builds the walls and doors of a level, with every door unlocked.
+     *
+     * @param obstacles The walls as polygons, such as LevelCache builds
+     * @param doors     The position of every door
+     */
+    void init(const std::vector<cugl::Poly2>& obstacles,
+              const std::vector<cugl::Vec2>& doors);
+
+    /** Adds a wall */
+    void addObstacle(const cugl::Poly2& obstacle) {
+        _obstacles.push_back(obstacle);
+    }
+
+    /** Adds an unlocked door, returning its index */
+    int addDoor(cugl::Vec2 position) {
+        _doors.push_back(position);
+        _locked.push_back(false);
+        return static_cast<int>(_doors.size()) - 1;
+    }
+
+    /** Returns the walls, including the level border */
+    const std::vector<cugl::Poly2>& getObstacles() const { return _obstacles; }
+
+    /**
+     * Locks or unlocks a door. Unknown doors are ignored.
+     *
+     * @param door      The door index
+     * @param locked    Whether the door blocks the hunter
+     */
+    void setLocked(int door, bool locked) {
+        if (door >= 0 && door < (int)_locked.size()) {
+            _locked[door] = locked;
+        }
+    }
+
+    /** Returns true if the door blocks the hunter */
+    bool isLocked(int door) const {
+        return door >= 0 && door < (int)_locked.size() && _locked[door];
+    }
+
+    /**
+     * Returns true if the hunter may move by delta from position.
+     *
+     * @param position  The hunter position
+     * @param delta     The move
+     */
+    bool canMove(cugl::Vec2 position, cugl::Vec2 delta) const;
+
+    /**
+     * Returns the hunter position after one frame of input.
+     *
+     * @param position  The hunter position
+     * @param forward   The vertical input in [-1, 1]
+     * @param rightward The horizontal input in [-1, 1]
+     *
+     * @return the new position, or position if the move is blocked
+     */
+    cugl::Vec2 step(cugl::Vec2 position, float forward, float rightward) const;
+};
+
+#endif /* _HUNTER_MOVEMENT_H */
@@ -0,0 +1,174 @@
+//
+//  LevelArena.cpp
+//  Sunk Cost
+//
+//  This module provides the storage of a loaded level in a single block.
+//  See the header for details.
+//
+
+#include "LevelArena.h"
+#include <type_traits>
+
+using namespace cugl;
+
+/**
+ * Reserves a section of count elements at the end of the block.
+ *
+ * @param bytes The size of the block so far, grown by the section
+ * @param count The number of elements
+ *
+ * @return the offset of the section in the block
+ */
+template <typename T> static size_t reserve(size_t& bytes, size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "the arena never runs destructors");
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "the block is only aligned for the fundamental types");
+    size_t offset = (bytes + alignof(T) - 1) & ~(alignof(T) - 1);
+    bytes = offset + count * sizeof(T);
+    return offset;
+}
+
+/**
+ * Constructs a section reserved in the block.
+ *
+ * @param block     The block
+ * @param offset    The offset of the section
+ * @param count     The number of elements
+ */
+template <typename T>
+static T* construct(std::byte* block, size_t offset, size_t count) {
+    T* section = reinterpret_cast<T*>(block + offset);
+    std::uninitialized_value_construct_n(section, count);
+    return section;
+}
+
+/**
+ * Copies an array of arrays into a section and its table of ends.
+ *
+ * @param values    The arrays
+ * @param data      The section of the elements
+ * @param ends      The section of the ends
+ */
+template <typename T>
+static void copyRagged(const std::vector<std::vector<T>>& values, T* data,
+                       uint32_t* ends) {
+    uint32_t end = 0;
+    for (size_t ii = 0; ii < values.size(); ii++) {
+        std::copy(values[ii].begin(), values[ii].end(), data + end);
+        end += static_cast<uint32_t>(values[ii].size());
+        ends[ii] = end;
+    }
+}
+
+/**
+ * Releases the block and empties every view.
+ */
+void LevelArena::clear() {
+    _block.reset();
+    _bytes = 0;
+    _sizes = Sizes();
+    _tiles = nullptr;
+    _details = nullptr;
+    _detailEnds = nullptr;
+    _boarder = nullptr;
+    _wallPoints = nullptr;
+    _wallEnds = nullptr;
+    _portraitPoints = nullptr;
+    _portraitEnds = nullptr;
+    _portraitTypes = nullptr;
+    _doors = nullptr;
+}
+
+/**
+ * Allocates a block for the given sections, value initialized.
+ *
+ * The ends of the portraits are set here, as every portrait has the same
+ * number of positions; the other sections are left to the loader.
+ *
+ * @param sizes The number of elements in each section
+ */
+void LevelArena::allocate(const Sizes& sizes) {
+    clear();
+    size_t bytes = 0;
+    size_t tiles = reserve<int>(bytes, sizes.tiles);
+    size_t details = reserve<int>(bytes, sizes.detailTiles);
+    size_t detailEnds = reserve<uint32_t>(bytes, sizes.detailLayers);
+    size_t boarder = reserve<Vec2>(bytes, sizes.boarder);
+    size_t wallPoints = reserve<Vec2>(bytes, sizes.wallPoints);
+    size_t wallEnds = reserve<uint32_t>(bytes, sizes.walls);
+    size_t portraitPoints =
+        reserve<Vec2>(bytes, LEVEL_PORTRAIT_POINTS * sizes.portraits);
+    size_t portraitEnds = reserve<uint32_t>(bytes, sizes.portraits);
+    size_t portraitTypes = reserve<int>(bytes, sizes.portraits);
+    size_t doors = reserve<std::pair<Vec2, int>>(bytes, sizes.doors);
+    if (bytes == 0) {
+        return;
+    }
+
+    _block.reset(new std::byte[bytes]);
+    _bytes = bytes;
+    _sizes = sizes;
+    std::byte* block = _block.get();
+    _tiles = construct<int>(block, tiles, sizes.tiles);
+    _details = construct<int>(block, details, sizes.detailTiles);
+    _detailEnds = construct<uint32_t>(block, detailEnds, sizes.detailLayers);
+    _boarder = construct<Vec2>(block, boarder, sizes.boarder);
+    _wallPoints = construct<Vec2>(block, wallPoints, sizes.wallPoints);
+    _wallEnds = construct<uint32_t>(block, wallEnds, sizes.walls);
+    _portraitPoints = construct<Vec2>(block, portraitPoints,
+                                      LEVEL_PORTRAIT_POINTS * sizes.portraits);
+    _portraitEnds = construct<uint32_t>(block, portraitEnds, sizes.portraits);
+    _portraitTypes = construct<int>(block, portraitTypes, sizes.portraits);
+    _doors = construct<std::pair<Vec2, int>>(block, doors, sizes.doors);
+    for (size_t ii = 0; ii < sizes.portraits; ii++) {
+        _portraitEnds[ii] =
+            static_cast<uint32_t>(LEVEL_PORTRAIT_POINTS * (ii + 1));
+    }
+}
+
+/**
+ * Allocates and fills the arena from arrays of arrays.
+ *
+ * This is how the JSON loaders, which build vectors, hand over a level.
+ * A portrait with other than LEVEL_PORTRAIT_POINTS positions is cut or
+ * padded with zeros.
+ */
+void LevelArena::assign(const std::vector<int>& tiles,
+                        const std::vector<std::vector<int>>& details,
+                        const std::vector<Vec2>& boarder,
+                        const std::vector<std::vector<Vec2>>& collision,
+                        const std::vector<std::vector<Vec2>>& portraits,
+                        const std::vector<int>& portraitTypes,
+                        const std::vector<std::pair<Vec2, int>>& doors) {
+    Sizes sizes = Sizes();
+    sizes.tiles = tiles.size();
+    sizes.detailLayers = details.size();
+    for (const std::vector<int>& layer : details) {
+        sizes.detailTiles += layer.size();
+    }
+    sizes.boarder = boarder.size();
+    sizes.walls = collision.size();
+    for (const std::vector<Vec2>& wall : collision) {
+        sizes.wallPoints += wall.size();
+    }
+    sizes.portraits = std::min(portraits.size(), portraitTypes.size());
+    sizes.doors = doors.size();
+    allocate(sizes);
+    if (_block == nullptr) {
+        return;
+    }
+
+    std::copy(tiles.begin(), tiles.end(), _tiles);
+    copyRagged(details, _details, _detailEnds);
+    std::copy(boarder.begin(), boarder.end(), _boarder);
+    copyRagged(collision, _wallPoints, _wallEnds);
+    for (size_t ii = 0; ii < sizes.portraits; ii++) {
+        size_t count = std::min<size_t>(portraits[ii].size(),
+                                        LEVEL_PORTRAIT_POINTS);
+        std::copy_n(portraits[ii].begin(), count,
+                    _portraitPoints + LEVEL_PORTRAIT_POINTS * ii);
+        _portraitTypes[ii] = portraitTypes[ii];
+    }
+    std::copy(doors.begin(), doors.end(), _doors);
+}
@@ -0,0 +1,242 @@
+//
+//  LevelArena.h
+//  Sunk Cost
+//
+//  This module provides the storage of a loaded level, and the read-only
+//  views that LevelModel hands out in place of copies of its arrays.
+//
+//  Every array of a level lives in one block, allocated once the size of
+//  each is known. The ragged arrays, the detail layers, the walls and the
+//  portraits, are flat arrays with a table of where each entry ends, so a
+//  level of any size is a single allocation.
+//
+//  A view is a pointer and a size. It is only valid while the level it came
+//  from is loaded, so keep the LevelModel, not the view.
+//
+
+#ifndef _LEVEL_ARENA_H
+#define _LEVEL_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cugl/cugl.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/** The number of positions of each portrait */
+#define LEVEL_PORTRAIT_POINTS 3
+
+/**
+ * A read-only view of a contiguous array of a level.
+ */
+template <typename T> class LevelSpan {
+  private:
+    const T* _data;
+    size_t _size;
+
+  public:
+    /** Creates an empty view */
+    LevelSpan() : _data(nullptr), _size(0) {}
+
+    /**
+     * Creates a view of an array.
+     *
+     * @param data  The first element
+     * @param size  The number of elements
+     */
+    LevelSpan(const T* data, size_t size) : _data(data), _size(size) {}
+
+    const T* begin() const { return _data; }
+    const T* end() const { return _data + _size; }
+    const T* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    const T& operator[](size_t index) const { return _data[index]; }
+
+    /** Returns true if both views hold equal elements */
+    bool operator==(const LevelSpan& other) const {
+        return _size == other._size && std::equal(begin(), end(), other._data);
+    }
+    bool operator!=(const LevelSpan& other) const { return !(*this == other); }
+};
+
+/**
+ * A read-only view of an array of arrays of a level, such as the walls.
+ *
+ * The entries are stored one after the other, and ends[i] is where entry i
+ * stops, counted in elements from the first entry.
+ */
+template <typename T> class LevelRagged {
+  private:
+    const T* _data;
+    const uint32_t* _ends;
+    size_t _size;
+
+  public:
+    /** Iterates over the entries, each a LevelSpan */
+    class Iterator {
+      private:
+        const LevelRagged* _ragged;
+        size_t _index;
+
+      public:
+        Iterator(const LevelRagged* ragged, size_t index)
+            : _ragged(ragged), _index(index) {}
+        LevelSpan<T> operator*() const { return (*_ragged)[_index]; }
+        Iterator& operator++() {
+            _index++;
+            return *this;
+        }
+        bool operator!=(const Iterator& other) const {
+            return _index != other._index;
+        }
+    };
+
+    /** Creates an empty view */
+    LevelRagged() : _data(nullptr), _ends(nullptr), _size(0) {}
+
+    /**
+     * Creates a view of an array of arrays.
+     *
+     * @param data  The first element of the first entry
+     * @param ends  The end of each entry
+     * @param size  The number of entries
+     */
+    LevelRagged(const T* data, const uint32_t* ends, size_t size)
+        : _data(data), _ends(ends), _size(size) {}
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, _size); }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    /** Returns the entry at index */
+    LevelSpan<T> operator[](size_t index) const {
+        uint32_t start = index == 0 ? 0 : _ends[index - 1];
+        return LevelSpan<T>(_data + start, _ends[index] - start);
+    }
+
+    /** Returns true if both views hold equal entries */
+    bool operator==(const LevelRagged& other) const {
+        if (_size != other._size ||
+            !std::equal(_ends, _ends + _size, other._ends)) {
+            return false;
+        }
+        size_t total = _size == 0 ? 0 : _ends[_size - 1];
+        return std::equal(_data, _data + total, other._data);
+    }
+    bool operator!=(const LevelRagged& other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * The arrays of a loaded level, in a single allocation.
+ *
+ * The arena is sized once with allocate, after which the loader fills each
+ * section through its mutable pointer. The views stay valid until the
+ * arena is cleared or allocated again, and moving the arena keeps them.
+ */
+class LevelArena {
+  public:
+    /** The number of elements in each section */
+    struct Sizes {
+        size_t tiles;
+        size_t detailLayers;
+        size_t detailTiles;
+        size_t boarder;
+        size_t walls;
+        size_t wallPoints;
+        size_t portraits;
+        size_t doors;
+    };
+
+  private:
+    std::unique_ptr<std::byte[]> _block;
+    size_t _bytes;
+    Sizes _sizes;
+
+    int* _tiles;
+    int* _details;
+    uint32_t* _detailEnds;
+    cugl::Vec2* _boarder;
+    cugl::Vec2* _wallPoints;
+    uint32_t* _wallEnds;
+    /** LEVEL_PORTRAIT_POINTS positions per portrait */
+    cugl::Vec2* _portraitPoints;
+    uint32_t* _portraitEnds;
+    int* _portraitTypes;
+    std::pair<cugl::Vec2, int>* _doors;
+
+  public:
+    /** Creates an empty arena */
+    LevelArena() { clear(); }
+
+    /** Releases the block and empties every view */
+    void clear();
+
+    /**
+     * Allocates a block for the given sections, value initialized.
+     *
+     * The ends of the portraits are set here, as every portrait has the
+     * same number of positions; the other sections are left to the loader.
+     *
+     * @param sizes The number of elements in each section
+     */
+    void allocate(const Sizes& sizes);
+
+    /**
+     * Allocates and fills the arena from arrays of arrays.
+     *
+     * This is how the JSON loaders, which build vectors, hand over a level.
+     */
+    void assign(const std::vector<int>& tiles,
+                const std::vector<std::vector<int>>& details,
+                const std::vector<cugl::Vec2>& boarder,
+                const std::vector<std::vector<cugl::Vec2>>& collision,
+                const std::vector<std::vector<cugl::Vec2>>& portraits,
+                const std::vector<int>& portraitTypes,
+                const std::vector<std::pair<cugl::Vec2, int>>& doors);
+
+    /** Returns the size of the block in bytes */
+    size_t getBytes() const { return _bytes; }
+
+#pragma mark Sections
+    int* tiles() { return _tiles; }
+    int* details() { return _details; }
+    uint32_t* detailEnds() { return _detailEnds; }
+    cugl::Vec2* boarder() { return _boarder; }
+    cugl::Vec2* wallPoints() { return _wallPoints; }
+    uint32_t* wallEnds() { return _wallEnds; }
+    cugl::Vec2* portraitPoints() { return _portraitPoints; }
+    int* portraitTypes() { return _portraitTypes; }
+    std::pair<cugl::Vec2, int>* doors() { return _doors; }
+
+#pragma mark Views
+    LevelSpan<int> getTiles() const {
+        return LevelSpan<int>(_tiles, _sizes.tiles);
+    }
+    LevelRagged<int> getDetails() const {
+        return LevelRagged<int>(_details, _detailEnds, _sizes.detailLayers);
+    }
+    LevelSpan<cugl::Vec2> getBoarder() const {
+        return LevelSpan<cugl::Vec2>(_boarder, _sizes.boarder);
+    }
+    LevelRagged<cugl::Vec2> getCollision() const {
+        return LevelRagged<cugl::Vec2>(_wallPoints, _wallEnds, _sizes.walls);
+    }
+    LevelRagged<cugl::Vec2> getPortraits() const {
+        return LevelRagged<cugl::Vec2>(_portraitPoints, _portraitEnds,
+                                       _sizes.portraits);
+    }
+    LevelSpan<int> getPortraitTypes() const {
+        return LevelSpan<int>(_portraitTypes, _sizes.portraits);
+    }
+    LevelSpan<std::pair<cugl::Vec2, int>> getDoors() const {
+        return LevelSpan<std::pair<cugl::Vec2, int>>(_doors, _sizes.doors);
+    }
+};
+
+#endif /* _LEVEL_ARENA_H */
@@ -0,0 +1,494 @@
+//
+//  LevelBenchmark.cpp
+//  Sunk Cost
+//
+//  This module provides benchmarks for loading levels. See the header for
+//  details.
+//
+
+#include "LevelBenchmark.h"
+
+#ifdef SC_LEVEL_BENCHMARK
+
+#include "LevelCache.h"
+#include "LevelConstants.h"
+#include "LevelModel.h"
+#include "LevelParser.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cugl/cugl.h>
+#include <functional>
+#include <new>
+#include <thread>
+
+using namespace cugl;
+
+/** The number of times each level is loaded */
+#define BENCH_LEVEL_LOADS 20
+/** The bytes before each allocation holding its size; keeps the alignment */
+#define BENCH_HEAP_HEADER 16
+/** The Tiled JSON export of the older, larger map */
+#define BENCH_LARGE_FILE "json/large_map.json"
+/** How many times wider the synthetic map is than the final level */
+#define BENCH_SYNTHETIC_SCALE 10
+/** The name of the level cache the benchmark writes and removes */
+#define BENCH_CACHE_NAME "benchmark"
+
+namespace {
+
+/** The bytes allocated and not yet freed */
+std::atomic<size_t> heapBytes(0);
+/** The most bytes allocated at once since the last resetHeap */
+std::atomic<size_t> heapPeak(0);
+/** The number of allocations since the last resetHeap */
+std::atomic<size_t> heapAllocs(0);
+/** The number of allocations since the program started */
+std::atomic<size_t> heapTotal(0);
+
+/** Starts a new measure of the peak heap and the allocations */
+void resetHeap() {
+    heapPeak = heapBytes.load();
+    heapAllocs = 0;
+}
+
+/** Returns the peak heap since the last resetHeap, above what was in use */
+size_t heapGrowth(size_t base) {
+    size_t peak = heapPeak.load();
+    return peak > base ? peak - base : 0;
+}
+
+
+/** Returns true if two levels hold the same data */
+bool sameLevel(LevelModel& a, LevelModel& b) {
+    return a.getTileTextures() == b.getTileTextures() &&
+           a.getDetails() == b.getDetails() &&
+           a.getCollision() == b.getCollision() &&
+           a.getBoarder() == b.getBoarder() &&
+           a.getPortaits() == b.getPortaits() &&
+           a.getPortraitTypes() == b.getPortraitTypes() &&
+           a.getDoors() == b.getDoors() &&
+           a.getPlayerPosition() == b.getPlayerPosition() &&
+           a.getDimensions() == b.getDimensions() &&
+           a.getTileWidth() == b.getTileWidth() &&
+           a.getBattery() == b.getBattery();
+}
+
+/** Returns true if two level caches hold the same data */
+bool sameCache(const LevelCache& a, const LevelCache& b) {
+    const std::vector<LevelCache::Tile>& tilesA = a.getTiles();
+    const std::vector<LevelCache::Tile>& tilesB = b.getTiles();
+    bool same = tilesA.size() == tilesB.size() &&
+                a.getColumns() == b.getColumns() &&
+                a.getObstacles().size() == b.getObstacles().size();
+    for (size_t i = 0; same && i < tilesA.size(); i++) {
+        same = tilesA[i].c == tilesB[i].c && tilesA[i].r == tilesB[i].r &&
+               tilesA[i].type == tilesB[i].type &&
+               tilesA[i].yPos == tilesB[i].yPos &&
+               tilesA[i].kind == tilesB[i].kind;
+    }
+    for (size_t i = 0; same && i < a.getObstacles().size(); i++) {
+        same = a.getObstacles()[i].vertices == b.getObstacles()[i].vertices &&
+               a.getObstacles()[i].indices == b.getObstacles()[i].indices;
+    }
+    return same;
+}
+
+/**
+ * Loads a level BENCH_LEVEL_LOADS times.
+ *
+ * @param load  Loads the level into a new model
+ * @param mean  Set to the mean milliseconds per load
+ * @param best  Set to the fastest load in milliseconds
+ *
+ * @return the level of the last load
+ */
+std::shared_ptr<LevelModel>
+timeLoads(const std::function<bool(LevelModel&)>& load, double& mean,
+          double& best) {
+    std::shared_ptr<LevelModel> level;
+    double total = 0;
+    best = 0;
+    for (int i = 0; i < BENCH_LEVEL_LOADS; i++) {
+        level = std::make_shared<LevelModel>();
+        auto start = std::chrono::steady_clock::now();
+        if (!load(*level)) {
+            return nullptr;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        double millis =
+            std::chrono::duration<double, std::milli>(elapsed).count();
+        total += millis;
+        best = i == 0 ? millis : std::min(best, millis);
+    }
+    mean = total / BENCH_LEVEL_LOADS;
+    return level;
+}
+
+/**
+ * Loads a level once and measures its heap use.
+ *
+ * @param load      Loads the level into a new model
+ * @param peak      Set to the most bytes in use at once during the load
+ * @param allocs    Set to the number of allocations made by the load
+ */
+void measureLoad(const std::function<bool(LevelModel&)>& load, size_t& peak,
+                 size_t& allocs) {
+    auto level = std::make_shared<LevelModel>();
+    size_t base = heapBytes.load();
+    resetHeap();
+    load(*level);
+    peak = heapGrowth(base);
+    allocs = heapAllocs.load();
+}
+
+/**
+ * Returns the Tiled JSON text of a synthetic level.
+ *
+ * The level has the layers of the final level in the same order, each tile
+ * layer filled with a fixed pseudo-random pattern, and a few walls, doors
+ * and portraits.
+ *
+ * @param width     The width of the map in tiles
+ * @param height    The height of the map in tiles
+ */
+std::string syntheticLevel(int width, int height) {
+    static const char* classes[] = {
+        "undership", "floor",  "floor ao",   "floorboard variations",
+        "floorboard variations 2", "carpets", "walls", "wall upper",
+        "wall grime", "decor", "detail0", "detail", "detail2", "detail3"};
+    char buffer[256];
+    std::string text;
+    std::snprintf(buffer, sizeof(buffer),
+                  "{\"width\":%d,\"height\":%d,\"tileSize\":128,"
+                  "\"battery\":100,\"layers\":[",
+                  width, height);
+    text += buffer;
+
+    std::snprintf(buffer, sizeof(buffer),
+                  "{\"class\":\"collision\",\"x_offset\":0,"
+                  "\"y_offset\":0,\"x\":1,\"y\":1,\"boarder\":"
+                  "[0,0,%d,0,%d,%d,0,%d],\"walls\":[",
+                  width, width, height, height);
+    text += buffer;
+    for (int ii = 0; ii < width / 4; ii++) {
+        std::snprintf(buffer, sizeof(buffer),
+                      "%s{\"data\":[%d,1,%d,3,%d,3,%d,1]}",
+                      ii == 0 ? "" : ",", ii * 4, ii * 4 + 2, ii * 4 + 2,
+                      ii * 4);
+        text += buffer;
+    }
+    text += "]}";
+
+    Uint32 seed = 1;
+    for (size_t layer = 0; layer < sizeof(classes) / sizeof(*classes);
+         layer++) {
+        text += ",{\"data\":[";
+        for (int ii = 0; ii < width * height; ii++) {
+            seed = seed * 1664525 + 1013904223;
+            int tile = layer < 2 ? 1 + (seed >> 28) : (seed >> 24) % 96;
+            std::snprintf(buffer, sizeof(buffer), "%s%d", ii == 0 ? "" : ",",
+                          tile > 64 ? 0 : tile);
+            text += buffer;
+        }
+        std::snprintf(buffer, sizeof(buffer),
+                      "],\"class\":\"%s\",\"type\":\"tilelayer\"}",
+                      classes[layer]);
+        text += buffer;
+    }
+
+    text += ",{\"class\":\"doors\",\"objects\":[";
+    for (int ii = 0; ii < width / 8; ii++) {
+        std::snprintf(buffer, sizeof(buffer),
+                      "%s{\"x\":%d,\"y\":%d,\"type\":%d}",
+                      ii == 0 ? "" : ",", ii * 8, height / 2, ii % 2);
+        text += buffer;
+    }
+    text += "]},{\"class\":\"portraits\",\"objects\":[";
+    for (int ii = 0; ii < width / 8; ii++) {
+        std::snprintf(buffer, sizeof(buffer),
+                      "%s{\"class\":\"portrait\",\"x1\":%d,\"y1\":1,"
+                      "\"x2\":%d,\"y2\":2,\"x3\":%d,\"y3\":3,"
+                      "\"type\":%d}",
+                      ii == 0 ? "" : ",", ii * 8, ii * 8 + 1, ii * 8 + 2,
+                      ii % 3);
+        text += buffer;
+    }
+    text += "]},{\"class\":\"player\",\"objects\":[{\"class\":"
+            "\"player\",\"x\":2,\"y\":2}]}]}";
+    return text;
+}
+
+/**
+ * Loads a level with one worker and with one per core, and logs both.
+ *
+ * @param name  The name of the level in the log
+ * @param load  Loads the level into a new model with the given workers
+ */
+void compareWorkers(const std::string& name,
+                    const std::function<bool(LevelModel&, size_t)>& load) {
+    double oneMean, oneBest, allMean, allBest;
+    std::shared_ptr<LevelModel> one = timeLoads(
+        [&](LevelModel& level) { return load(level, 1); }, oneMean, oneBest);
+    std::shared_ptr<LevelModel> all = timeLoads(
+        [&](LevelModel& level) { return load(level, 0); }, allMean, allBest);
+    if (one == nullptr || all == nullptr) {
+        CULog("%s could not be loaded", name.c_str());
+        return;
+    }
+    CULog("%-22s %10.3f %10.3f %10.3f %10.3f  %.1fx faster, %s",
+          name.c_str(), oneMean, oneBest, allMean, allBest, oneMean / allMean,
+          sameLevel(*one, *all) ? "same level" : "LEVELS DIFFER");
+}
+
+} // namespace
+
+#pragma mark -
+#pragma mark Heap Tracking
+
+/**
+ * Allocates memory, recording its size in front of it.
+ */
+void* operator new(size_t size) {
+    void* block = std::malloc(size + BENCH_HEAP_HEADER);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    *static_cast<size_t*>(block) = size;
+    size_t bytes = heapBytes += size;
+    size_t peak = heapPeak.load();
+    while (bytes > peak && !heapPeak.compare_exchange_weak(peak, bytes)) {
+    }
+    heapAllocs++;
+    heapTotal++;
+    return static_cast<char*>(block) + BENCH_HEAP_HEADER;
+}
+
+/**
+ * Frees memory allocated by operator new.
+ */
+void operator delete(void* memory) noexcept {
+    if (memory == nullptr) {
+        return;
+    }
+    void* block = static_cast<char*>(memory) - BENCH_HEAP_HEADER;
+    heapBytes -= *static_cast<size_t*>(block);
+    std::free(block);
+}
+
+void operator delete(void* memory, size_t) noexcept { operator delete(memory); }
+
+#pragma mark -
+#pragma mark Benchmarks
+
+/**
+ * Runs every benchmark and logs the results.
+ */
+void LevelBenchmark::runAll() {
+    runFormats();
+    runParsers();
+    runWorkers();
+    runAccessors();
+    runCache();
+}
+
+/**
+ * Returns the number of heap allocations since the program started.
+ */
+size_t LevelBenchmark::getAllocations() { return heapTotal.load(); }
+
+/**
+ * Loads the final level from its Tiled JSON export and from its compiled
+ * level file, and logs the load times and whether they agree.
+ */
+void LevelBenchmark::runFormats() {
+    const std::string source = std::string(LEVEL_SOURCE_DIRECTORY) +
+                               LEVEL_FINAL_KEY + ".json";
+    double jsonMean, jsonBest, binaryMean, binaryBest;
+    std::shared_ptr<LevelModel> json = timeLoads(
+        [&](LevelModel& level) { return level.preload(source); }, jsonMean,
+        jsonBest);
+    std::shared_ptr<LevelModel> binary = timeLoads(
+        [](LevelModel& level) { return level.preloadBinary(LEVEL_FINAL_FILE); },
+        binaryMean, binaryBest);
+
+    CULog("%-22s %10s %10s", "level load", "mean ms", "best ms");
+    if (json == nullptr || binary == nullptr) {
+        CULog("%s could not be loaded", json == nullptr ? source.c_str()
+                                                        : LEVEL_FINAL_FILE);
+        return;
+    }
+    CULog("%-22s %10.3f %10.3f", source.c_str(), jsonMean, jsonBest);
+    CULog("%-22s %10.3f %10.3f  %.0fx faster, %s", LEVEL_FINAL_FILE,
+          binaryMean, binaryBest, jsonMean / binaryMean,
+          sameLevel(*json, *binary) ? "same level" : "LEVELS DIFFER");
+}
+
+/**
+ * Loads the Tiled JSON export of the final level through a JsonValue and
+ * through the streaming LevelParser, and logs the load times, the heap used
+ * and whether they agree.
+ */
+void LevelBenchmark::runParsers() {
+    const std::string source = std::string(LEVEL_SOURCE_DIRECTORY) +
+                               LEVEL_FINAL_KEY + ".json";
+    auto tree = [&](LevelModel& level) {
+        std::shared_ptr<JsonReader> reader =
+            JsonReader::allocWithAsset(source);
+        return reader != nullptr && level.preload(reader->readJson());
+    };
+    auto stream = [&](LevelModel& level) {
+        return level.preloadStream(source);
+    };
+
+    double treeMean, treeBest, streamMean, streamBest;
+    std::shared_ptr<LevelModel> treeLevel = timeLoads(tree, treeMean, treeBest);
+    std::shared_ptr<LevelModel> streamLevel =
+        timeLoads(stream, streamMean, streamBest);
+    if (treeLevel == nullptr || streamLevel == nullptr) {
+        CULog("%s could not be loaded", source.c_str());
+        return;
+    }
+    size_t treePeak, treeAllocs, streamPeak, streamAllocs;
+    measureLoad(tree, treePeak, treeAllocs);
+    measureLoad(stream, streamPeak, streamAllocs);
+
+    CULog("%-22s %10s %10s %10s %10s", "json parse", "mean ms", "best ms",
+          "peak KB", "allocs");
+    CULog("%-22s %10.3f %10.3f %10.1f %10zu", "JsonValue tree", treeMean,
+          treeBest, treePeak / 1024.0, treeAllocs);
+    CULog("%-22s %10.3f %10.3f %10.1f %10zu  %.1fx faster, %s",
+          "LevelParser stream", streamMean, streamBest, streamPeak / 1024.0,
+          streamAllocs, treeMean / streamMean,
+          sameLevel(*treeLevel, *streamLevel) ? "same level"
+                                              : "LEVELS DIFFER");
+}
+
+/**
+ * Loads the final level, the large map and a synthetic map ten times the
+ * final level with one worker and with one per core, and logs the load
+ * times and whether they agree.
+ */
+void LevelBenchmark::runWorkers() {
+    const std::string source = std::string(LEVEL_SOURCE_DIRECTORY) +
+                               LEVEL_FINAL_KEY + ".json";
+    LevelModel final;
+    if (!final.preloadStream(source)) {
+        CULog("%s could not be loaded", source.c_str());
+        return;
+    }
+    Vec2 size = final.getDimensions();
+    const std::string synthetic = syntheticLevel(
+        static_cast<int>(size.x) * BENCH_SYNTHETIC_SCALE,
+        static_cast<int>(size.y));
+
+    size_t cores = std::min<size_t>(std::thread::hardware_concurrency(),
+                                    LEVEL_MAX_WORKERS);
+    CULog("%-22s %10s %10s %10s %10s  (%zu workers)", "layer workers",
+          "1 mean ms", "1 best ms", "N mean ms", "N best ms",
+          std::max<size_t>(cores, 1));
+    compareWorkers(source, [&](LevelModel& level, size_t workers) {
+        return level.preloadStream(source, workers);
+    });
+    compareWorkers(BENCH_LARGE_FILE, [](LevelModel& level, size_t workers) {
+        return level.preloadStream(BENCH_LARGE_FILE, workers);
+    });
+    char name[32];
+    std::snprintf(name, sizeof(name), "synthetic %dx",
+                  BENCH_SYNTHETIC_SCALE);
+    compareWorkers(name, [&](LevelModel& level, size_t workers) {
+        return LevelParser(level, workers)
+            .parse(synthetic.data(), synthetic.size());
+    });
+}
+
+/**
+ * Reads every array of the final level the way the game controllers do
+ * when a level starts, and logs the allocations this took.
+ */
+void LevelBenchmark::runAccessors() {
+    auto level = std::make_shared<LevelModel>();
+    if (!level->preload(std::string(LEVEL_FINAL_FILE))) {
+        CULog("%s could not be loaded", LEVEL_FINAL_FILE);
+        return;
+    }
+    size_t start = getAllocations();
+    double checksum = 0;
+    for (int tile : level->getTileTextures()) {
+        checksum += tile;
+    }
+    LevelRagged<int> details = level->getDetails();
+    for (int n = 0; n < details.size(); n++) {
+        for (int m = 0; m < details[n].size(); m++) {
+            checksum += details[n][m];
+        }
+    }
+    LevelRagged<Vec2> portraits = level->getPortaits();
+    LevelSpan<int> portraitTypes = level->getPortraitTypes();
+    for (int i = 0; i < portraits.size(); i++) {
+        checksum += portraits[i][0].x + portraits[i][1].y +
+                    portraits[i][2].x + portraitTypes[i];
+    }
+    for (const std::pair<Vec2, int>& door : level->getDoors()) {
+        checksum += door.first.x + door.second;
+    }
+    for (const Vec2& point : level->getBoarder()) {
+        checksum += point.y;
+    }
+    for (LevelSpan<Vec2> wall : level->getCollision()) {
+        checksum += wall.size();
+    }
+    size_t allocations = getAllocations() - start;
+
+    CULog("%-22s %10zu allocations, %zu byte arena (checksum %.0f)",
+          "level accessors", allocations, level->getArenaBytes(), checksum);
+}
+
+/**
+ * Derives the data of the final level with an empty and with a current
+ * level cache, and logs the times and whether they agree.
+ */
+void LevelBenchmark::runCache() {
+    auto level = std::make_shared<LevelModel>();
+    if (!level->preload(std::string(LEVEL_FINAL_FILE))) {
+        CULog("%s could not be loaded", LEVEL_FINAL_FILE);
+        return;
+    }
+    const std::string path = Application::get()->getSaveDirectory() +
+                             BENCH_CACHE_NAME + LEVEL_CACHE_EXTENSION;
+    double times[2][BENCH_LEVEL_LOADS];
+    bool same = true;
+    for (int i = 0; i < BENCH_LEVEL_LOADS; i++) {
+        std::remove(path.c_str());
+        LevelCache caches[2];
+        for (int pass = 0; pass < 2; pass++) {
+            auto start = std::chrono::steady_clock::now();
+            bool cached = caches[pass].init(*level, BENCH_CACHE_NAME);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            times[pass][i] =
+                std::chrono::duration<double, std::milli>(elapsed).count();
+            same = same && cached == (pass == 1);
+        }
+        same = same && sameCache(caches[0], caches[1]);
+    }
+    std::remove(path.c_str());
+
+    double mean[2], best[2];
+    for (int pass = 0; pass < 2; pass++) {
+        double total = 0;
+        for (double millis : times[pass]) {
+            total += millis;
+        }
+        mean[pass] = total / BENCH_LEVEL_LOADS;
+        best[pass] = *std::min_element(times[pass],
+                                       times[pass] + BENCH_LEVEL_LOADS);
+    }
+    CULog("%-22s %10s %10s", "level cache", "mean ms", "best ms");
+    CULog("%-22s %10.3f %10.3f", "rebuilt", mean[0], best[0]);
+    CULog("%-22s %10.3f %10.3f  %.1fx faster, %s", "read", mean[1], best[1],
+          mean[0] / mean[1], same ? "same data" : "DATA DIFFERS");
+}
+
+#endif /* SC_LEVEL_BENCHMARK */
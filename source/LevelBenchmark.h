@@ -0,0 +1,87 @@
+//
+//  LevelBenchmark.h
+//  Sunk Cost
+//
+//  This module provides benchmarks for loading levels. They are compiled in
+//  only when SC_LEVEL_BENCHMARK is defined, and are run once from
+//  SCApp::onStartup with the results written to the log. They load the
+//  levels from the asset directory, outside of the AssetManager.
+//
+//  The heap figures come from replacing the global operator new and delete
+//  in the benchmark module, so they count every allocation in the program
+//  while a benchmark build runs.
+//
+
+#ifndef _LEVEL_BENCHMARK_H
+#define _LEVEL_BENCHMARK_H
+
+#ifdef SC_LEVEL_BENCHMARK
+
+#include <cstddef>
+
+/**
+ * A collection of level loading benchmarks.
+ */
+class LevelBenchmark {
+  public:
+    /**
+     * Runs every benchmark and logs the results.
+     */
+    static void runAll();
+
+    /**
+     * Loads the final level from its Tiled JSON export and from its
+     * compiled level file.
+     *
+     * This logs the mean and fastest load time of each, and whether the
+     * two levels are the same.
+     */
+    static void runFormats();
+
+    /**
+     * Loads the Tiled JSON export of the final level through a JsonValue
+     * and through the streaming LevelParser.
+     *
+     * This logs the mean and fastest load time of each, the peak heap in
+     * use and the allocations made during a load, and whether the two
+     * levels are the same.
+     */
+    static void runParsers();
+
+    /**
+     * Loads the Tiled JSON exports of the final level, of the large map and
+     * of a synthetic map ten times the final level, each with one worker
+     * and with one worker per core.
+     *
+     * This logs the mean and fastest load time of each, and whether the
+     * levels are the same.
+     */
+    static void runWorkers();
+
+    /**
+     * Reads every array of the final level the way the game controllers
+     * do when a level starts, and logs the allocations this took.
+     */
+    static void runAccessors();
+
+    /**
+     * Derives the tiles, columns and walls of the final level with an empty
+     * level cache and with a current one.
+     *
+     * This logs the mean and fastest time of each, and whether the cache
+     * read back the data it was built with.
+     */
+    static void runCache();
+
+    /**
+     * Returns the number of heap allocations since the program started.
+     *
+     * The difference of two calls counts the allocations of the code in
+     * between, as HGameController::checkLevelLoaded logs.
+     */
+    static size_t getAllocations();
+};
+
+#endif /* SC_LEVEL_BENCHMARK */
+
+#endif /* _LEVEL_BENCHMARK_H */
@@ -0,0 +1,406 @@
+//
+//  LevelCache.cpp
+//  Sunk Cost
+//
+//  This module provides the data the game controllers derive from a level,
+//  and a cache of it in the save directory. See the header for details.
+//
+
+#include "LevelCache.h"
+#include "LevelFormat.h"
+#include "LevelModel.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <numeric>
+
+using namespace cugl;
+
+/** Returns true if a detail tile is drawn at all */
+static bool isDrawn(int type) {
+    return !(type == 0 || type >= 641 || type == 129 + 16 ||
+             type == 129 + 24);
+}
+
+/**
+ * Returns true if ends is a valid table of ends of count entries.
+ *
+ * @param ends  The end of each entry
+ * @param count The number of entries
+ * @param total The number of elements, which the last entry must end at
+ */
+static bool validEnds(const uint32_t* ends, size_t count, size_t total) {
+    uint32_t start = 0;
+    for (size_t ii = 0; ii < count; ii++) {
+        if (ends[ii] < start || ends[ii] > total) {
+            return false;
+        }
+        start = ends[ii];
+    }
+    return start == total;
+}
+
+#pragma mark -
+#pragma mark Derived Data
+
+/**
+ * Returns what a detail tile is, and the height it is drawn at.
+ *
+ * The tile sets are laid out in ranges of 64 tiles, and the heights lift
+ * the tiles that stand taller than one tile so that the hunter passes
+ * behind them at the right place.
+ *
+ * @param type      The tile as exported
+ * @param tileSize  The size of a tile
+ * @param yPos      The bottom of the tile; set to its drawn height if it is
+ *                  an obstacle
+ */
+LevelCache::Kind LevelCache::classify(int type, int tileSize, float& yPos) {
+    int index = type;
+    if (type < 65) {
+        // wall
+        yPos += 11;
+        index -= 1;
+        if (index == 0 || index == 1 || index == 8 || index == 9 ||
+            index == 10 || index == 11 || index == 20 || index == 21 ||
+            index == 22 || index == 34 || index == 35) {
+            yPos -= 2 * tileSize;
+        } else if (index == 32 || index == 33) {
+            yPos -= tileSize;
+        }
+        return Kind::Wall;
+    } else if (type < 129) {
+        // floor
+        return Kind::Flat;
+    } else if (type < 193) {
+        // dector
+        yPos += 8;
+        index -= 129;
+        if (index == 6 || index == 7) {
+            yPos -= 2 * tileSize;
+        } else if (index == 14 || index == 15 || index == 1 || index == 2 ||
+                   index == 3 || index == 4 || index == 17 || index == 18 ||
+                   index == 19 || index == 20 || index == 32 || index == 33 ||
+                   index == 34 || index == 35 || index == 36 || index == 37) {
+            yPos -= tileSize;
+        }
+    } else if (type < 257) {
+        // grime
+        yPos += 9;
+    } else if (type < 321) {
+        // placeholder
+        return Kind::Flat;
+    } else if (type < 385) {
+        // wall upper
+        yPos += 10;
+        index -= 321;
+        if (index >= 16 && index <= 63) {
+            yPos += tileSize;
+        }
+    } else if (type < 449) {
+        // ao
+        return Kind::Flat;
+    } else if (type < 513) {
+        // dector2
+        yPos += 8;
+        index -= 449;
+        if (index == 36 || index == 37 || index == 38 || index == 44 ||
+            index == 45 || index == 46 || index == 52 || index == 53 ||
+            index == 54) {
+            return Kind::Carpet;
+        }
+        if (index < 8 || (index >= 16 && index <= 23) || index == 32 ||
+            index == 48 || index == 49) {
+            yPos -= tileSize;
+        }
+    } else if (type < 577) {
+        // env
+        yPos += 8;
+        index -= 513;
+        if (index == 24 || index == 25 || index == 32 || index == 33 ||
+            index == 40 || index == 41 || index == 35 || index == 36 ||
+            index == 37 || index == 48 || index == 49 || index == 50 ||
+            index == 54 || index == 55 || index == 62) {
+            return Kind::Hole;
+        }
+    } else {
+        // env2
+        yPos += 8;
+        index -= 577;
+        if (index == 0 || index == 1 || index == 6 || index == 7 ||
+            (index >= 16 && index <= 21)) {
+            yPos -= tileSize;
+        }
+    }
+    return Kind::Obstacle;
+}
+
+/**
+ * Derives the data from the level.
+ */
+void LevelCache::build(LevelModel& level) {
+    int width = static_cast<int>(level.getDimensions().x);
+    int height = static_cast<int>(level.getDimensions().y);
+    int tileSize = level.getTileWidth();
+    _tiles.clear();
+    for (LevelSpan<int> layer : level.getDetails()) {
+        for (int m = 0; m < static_cast<int>(layer.size()); m++) {
+            if (!isDrawn(layer[m])) {
+                continue;
+            }
+            Tile tile;
+            tile.c = m % width;
+            tile.r = height - 1 - m / width;
+            tile.type = layer[m];
+            float bottom = static_cast<float>(tileSize * tile.r);
+            tile.yPos = bottom;
+            tile.kind = classify(tile.type, tileSize, tile.yPos);
+            if (!isObstacle(tile.kind)) {
+                tile.yPos = bottom;
+            }
+            _tiles.push_back(tile);
+        }
+    }
+
+    // Group by column, ending each column where the next starts
+    std::vector<uint32_t> order(_tiles.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return _tiles[a].c < _tiles[b].c;
+    });
+    _columnEnds.clear();
+    for (size_t ii = 1; ii < order.size(); ii++) {
+        if (_tiles[order[ii]].c != _tiles[order[ii - 1]].c) {
+            _columnEnds.push_back(static_cast<uint32_t>(ii));
+        }
+    }
+    order.resize(_columnEnds.empty() ? 0 : _columnEnds.back());
+    _columnTiles = std::move(order);
+
+    // Back to front, by the whole height the tile controllers keep
+    uint32_t start = 0;
+    for (uint32_t end : _columnEnds) {
+        std::stable_sort(_columnTiles.begin() + start,
+                         _columnTiles.begin() + end,
+                         [&](uint32_t a, uint32_t b) {
+                             return static_cast<int>(_tiles[a].yPos) >
+                                    static_cast<int>(_tiles[b].yPos);
+                         });
+        start = end;
+    }
+
+    // CUGL takes the points as a vector, so one buffer serves every wall
+    _obstacles.clear();
+    LevelSpan<Vec2> border = level.getBoarder();
+    std::vector<Vec2> points(border.begin(), border.end());
+    SimpleExtruder extruder;
+    extruder.set(points, true);
+    extruder.calculate(10, 10);
+    _obstacles.push_back(extruder.getPolygon());
+
+    Path2 line;
+    for (LevelSpan<Vec2> wall : level.getCollision()) {
+        points.assign(wall.begin(), wall.end());
+        line.set(points);
+        EarclipTriangulator triangulator;
+        triangulator.set(line);
+        triangulator.calculate();
+        _obstacles.push_back(triangulator.getPolygon());
+    }
+}
+
+#pragma mark -
+#pragma mark Cache File
+
+/**
+ * Loads the derived data of a level, from the cache if it is current.
+ *
+ * Otherwise the data is derived from the level and the cache rewritten. A
+ * level with no hash, loaded from a JsonValue, is never cached.
+ *
+ * @param level The level
+ * @param name  The name of the cache file, without the extension
+ *
+ * @return true if the data came from the cache
+ */
+bool LevelCache::init(LevelModel& level, const std::string& name) {
+    auto start = std::chrono::steady_clock::now();
+    std::string path = Application::get()->getSaveDirectory() + name +
+                       LEVEL_CACHE_EXTENSION;
+    bool cached = level.getHash() != 0 && read(path, level);
+    if (!cached) {
+        build(level);
+        if (level.getHash() != 0 && !write(path, level)) {
+            CULog("level cache: could not write %s", path.c_str());
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    CULog("level cache: %s %s in %.2f ms", cached ? "read" : "rebuilt",
+          path.c_str(),
+          std::chrono::duration<double, std::milli>(elapsed).count());
+    return cached;
+}
+
+/**
+ * Reads the data from a cache file.
+ *
+ * Nothing is changed unless the file is a valid cache of this level.
+ *
+ * @param path  The cache file
+ * @param level The level it must be a cache of
+ *
+ * @return true if the file was read
+ */
+bool LevelCache::read(const std::string& path, LevelModel& level) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    std::streamoff length = in ? static_cast<std::streamoff>(in.tellg()) : 0;
+    if (length <= 0) {
+        return false;
+    }
+    size_t size = static_cast<size_t>(length);
+    std::unique_ptr<std::byte[]> data(new std::byte[size]);
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(data.get()), length)) {
+        return false;
+    }
+
+    LevelReader reader(data.get(), size);
+    const LevelCacheHeader* header = reader.read<LevelCacheHeader>(1);
+    Uint64 hash = level.getHash();
+    int width = static_cast<int>(level.getDimensions().x);
+    int height = static_cast<int>(level.getDimensions().y);
+    if (header == nullptr || header->magic != LEVEL_CACHE_MAGIC ||
+        header->version != LEVEL_CACHE_VERSION || header->size != size ||
+        header->hash[0] != static_cast<uint32_t>(hash) ||
+        header->hash[1] != static_cast<uint32_t>(hash >> 32) ||
+        header->tileSize != level.getTileWidth() || header->width != width ||
+        header->height != height) {
+        return false;
+    }
+    const Tile* tiles = reader.read<Tile>(header->tiles);
+    const uint32_t* columnEnds = reader.read<uint32_t>(header->columns);
+    const uint32_t* columnTiles = reader.read<uint32_t>(header->columnTiles);
+    const uint32_t* vertexEnds = reader.read<uint32_t>(header->polygons);
+    const uint32_t* indexEnds = reader.read<uint32_t>(header->polygons);
+    const float* vertices = reader.read<float>(2 * (size_t)header->vertices);
+    const uint32_t* indices = reader.read<uint32_t>(header->indices);
+    if (reader.failed() ||
+        !validEnds(columnEnds, header->columns, header->columnTiles) ||
+        !validEnds(vertexEnds, header->polygons, header->vertices) ||
+        !validEnds(indexEnds, header->polygons, header->indices)) {
+        return false;
+    }
+
+    // Check everything that is used as an index before it is used
+    for (uint32_t ii = 0; ii < header->tiles; ii++) {
+        const Tile& tile = tiles[ii];
+        if (tile.c < 0 || tile.c >= width || tile.r < 0 ||
+            tile.r >= height || tile.kind > Kind::Hole) {
+            return false;
+        }
+    }
+    for (uint32_t ii = 0; ii < header->columnTiles; ii++) {
+        if (columnTiles[ii] >= header->tiles) {
+            return false;
+        }
+    }
+    for (uint32_t ii = 0, first = 0; ii < header->polygons; ii++) {
+        uint32_t count = vertexEnds[ii] - (ii == 0 ? 0 : vertexEnds[ii - 1]);
+        for (uint32_t n = first; n < indexEnds[ii]; n++) {
+            if (indices[n] >= count) {
+                return false;
+            }
+        }
+        first = indexEnds[ii];
+    }
+
+    _tiles.assign(tiles, tiles + header->tiles);
+    _columnEnds.assign(columnEnds, columnEnds + header->columns);
+    _columnTiles.assign(columnTiles, columnTiles + header->columnTiles);
+    _obstacles.resize(header->polygons);
+    for (uint32_t ii = 0; ii < header->polygons; ii++) {
+        uint32_t vertex = ii == 0 ? 0 : vertexEnds[ii - 1];
+        uint32_t index = ii == 0 ? 0 : indexEnds[ii - 1];
+        Poly2& polygon = _obstacles[ii];
+        polygon.vertices.resize(vertexEnds[ii] - vertex);
+        for (uint32_t n = vertex; n < vertexEnds[ii]; n++) {
+            polygon.vertices[n - vertex].set(vertices[2 * n],
+                                             vertices[2 * n + 1]);
+        }
+        polygon.indices.assign(indices + index, indices + indexEnds[ii]);
+    }
+    return true;
+}
+
+/**
+ * Writes the data to a cache file.
+ *
+ * The file is written beside the cache and then renamed over it, so a
+ * crash leaves the old cache or none, never half of one.
+ *
+ * @param path  The cache file
+ * @param level The level the data is of
+ *
+ * @return true if the file was written
+ */
+bool LevelCache::write(const std::string& path, LevelModel& level) const {
+    std::vector<uint32_t> vertexEnds;
+    std::vector<uint32_t> indexEnds;
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    for (const Poly2& polygon : _obstacles) {
+        for (const Vec2& vertex : polygon.vertices) {
+            vertices.push_back(vertex.x);
+            vertices.push_back(vertex.y);
+        }
+        indices.insert(indices.end(), polygon.indices.begin(),
+                       polygon.indices.end());
+        vertexEnds.push_back(static_cast<uint32_t>(vertices.size() / 2));
+        indexEnds.push_back(static_cast<uint32_t>(indices.size()));
+    }
+
+    Uint64 hash = level.getHash();
+    LevelCacheHeader header = {};
+    header.magic = LEVEL_CACHE_MAGIC;
+    header.version = LEVEL_CACHE_VERSION;
+    header.hash[0] = static_cast<uint32_t>(hash);
+    header.hash[1] = static_cast<uint32_t>(hash >> 32);
+    header.tileSize = level.getTileWidth();
+    header.width = static_cast<int32_t>(level.getDimensions().x);
+    header.height = static_cast<int32_t>(level.getDimensions().y);
+    header.tiles = static_cast<uint32_t>(_tiles.size());
+    header.columns = static_cast<uint32_t>(_columnEnds.size());
+    header.columnTiles = static_cast<uint32_t>(_columnTiles.size());
+    header.polygons = static_cast<uint32_t>(_obstacles.size());
+    header.vertices = static_cast<uint32_t>(vertices.size() / 2);
+    header.indices = static_cast<uint32_t>(indices.size());
+
+    LevelWriter writer;
+    writer.write(&header, 1);
+    writer.write(_tiles.data(), _tiles.size());
+    writer.write(_columnEnds.data(), _columnEnds.size());
+    writer.write(_columnTiles.data(), _columnTiles.size());
+    writer.write(vertexEnds.data(), vertexEnds.size());
+    writer.write(indexEnds.data(), indexEnds.size());
+    writer.write(vertices.data(), vertices.size());
+    writer.write(indices.data(), indices.size());
+    std::vector<std::byte>& data = writer.getData();
+    uint32_t size = static_cast<uint32_t>(data.size());
+    std::memcpy(data.data() + offsetof(LevelCacheHeader, size), &size,
+                sizeof(size));
+
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!out.good()) {
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    return std::rename(temp.c_str(), path.c_str()) == 0;
+}
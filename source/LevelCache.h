@@ -0,0 +1,181 @@
+//
+//  LevelCache.h
+//  Sunk Cost
+//
+//  This module provides the data the game controllers derive from a level
+//  when a match starts, and a cache of it in the save directory.
+//
+//  The derived data is what every match used to recompute: what each
+//  detail tile is (a wall, an obstacle with the height it is drawn at, or
+//  something flat), the obstacles grouped into columns and ordered back to
+//  front, and the walls as polygons, the border extruded and the other
+//  walls triangulated.
+//
+//  The cache file holds this data for one level, along with the hash of
+//  the level file it came from. A cache of another level file, or of an
+//  older LEVEL_CACHE_VERSION, is rebuilt and rewritten, so editing the
+//  level needs no other step. Any change to classify or to the layout
+//  must bump the version.
+//
+
+#ifndef _LEVEL_CACHE_H
+#define _LEVEL_CACHE_H
+
+#include "LevelArena.h"
+#include <cstdint>
+#include <cugl/cugl.h>
+#include <string>
+#include <vector>
+
+class LevelModel;
+
+/** The first four bytes of a cache file, "SCLC" */
+#define LEVEL_CACHE_MAGIC 0x434c4353
+/** The version of the derived data and its layout; a loader refuses others */
+#define LEVEL_CACHE_VERSION 1
+/** The file extension of a cache file, in the save directory */
+#define LEVEL_CACHE_EXTENSION ".levelcache"
+
+/**
+ * The fixed start of a cache file, with the size of every section.
+ *
+ * The sections that follow, each padded to four bytes, are the tiles, the
+ * end of each column, the tiles of the columns in order, the end of the
+ * vertices and of the indices of each polygon, the vertices as x and y
+ * floats, and the indices.
+ */
+struct LevelCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    /** The size of the whole file in bytes, to catch a truncated copy */
+    uint32_t size;
+    /** The hash of the level file, low word first */
+    uint32_t hash[2];
+    int32_t tileSize;
+    int32_t width;
+    int32_t height;
+    uint32_t tiles;
+    uint32_t columns;
+    uint32_t columnTiles;
+    uint32_t polygons;
+    uint32_t vertices;
+    uint32_t indices;
+};
+
+static_assert(sizeof(LevelCacheHeader) == 56, "the header must be packed");
+
+/**
+ * The derived data of a level, built or read from the cache.
+ */
+class LevelCache {
+  public:
+    /** What a detail tile is to the game */
+    enum class Kind : uint32_t {
+        /** An obstacle the hunter cannot walk through */
+        Wall,
+        /** An obstacle drawn in front of or behind the hunter */
+        Obstacle,
+        /** Drawn under everything, like the floor */
+        Flat,
+        /** Flat, and drawn above the other flat tiles */
+        Carpet,
+        /** Flat, and drawn above the other flat tiles */
+        Hole
+    };
+
+    /** A detail tile, in the order the layers list them */
+    struct Tile {
+        /** The column of the tile */
+        int32_t c;
+        /** The row of the tile, counted from the bottom */
+        int32_t r;
+        /** The tile as exported */
+        int32_t type;
+        /** The height the tile is drawn at, if it is an obstacle */
+        float yPos;
+        Kind kind;
+    };
+
+    static_assert(sizeof(Tile) == 20, "tiles must be packed");
+
+  private:
+    std::vector<Tile> _tiles;
+    /** The tile indices of each column, back to front */
+    std::vector<uint32_t> _columnTiles;
+    std::vector<uint32_t> _columnEnds;
+    /** The border first, then every wall */
+    std::vector<cugl::Poly2> _obstacles;
+
+    /** Derives the data from the level */
+    void build(LevelModel& level);
+
+    /**
+     * Reads the data from a cache file.
+     *
+     * Nothing is changed unless the file is a valid cache of this level.
+     *
+     * @param path  The cache file
+     * @param level The level it must be a cache of
+     *
+     * @return true if the file was read
+     */
+    bool read(const std::string& path, LevelModel& level);
+
+    /**
+     * Writes the data to a cache file.
+     *
+     * @param path  The cache file
+     * @param level The level the data is of
+     *
+     * @return true if the file was written
+     */
+    bool write(const std::string& path, LevelModel& level) const;
+
+  public:
+    /**
+     * Returns what a detail tile is, and the height it is drawn at.
+     *
+     * @param type      The tile as exported
+     * @param tileSize  The size of a tile
+     * @param yPos      The bottom of the tile; set to its drawn height if it
+     *                  is an obstacle
+     */
+    static Kind classify(int type, int tileSize, float& yPos);
+
+    /** Returns true if tiles of this kind are obstacles */
+    static bool isObstacle(Kind kind) {
+        return kind == Kind::Wall || kind == Kind::Obstacle;
+    }
+
+    /**
+     * Loads the derived data of a level, from the cache if it is current.
+     *
+     * Otherwise the data is derived from the level and the cache rewritten.
+     * A level with no hash, loaded from a JsonValue, is never cached.
+     *
+     * @param level The level
+     * @param name  The name of the cache file, without the extension
+     *
+     * @return true if the data came from the cache
+     */
+    bool init(LevelModel& level, const std::string& name);
+
+    /** Returns the detail tiles, in the order of the layers */
+    const std::vector<Tile>& getTiles() const { return _tiles; }
+
+    /**
+     * Returns the obstacle columns, left to right, as indices of getTiles.
+     *
+     * Each column is back to front. As the controllers always had it, the
+     * rightmost column is left out.
+     */
+    LevelRagged<uint32_t> getColumns() const {
+        return LevelRagged<uint32_t>(_columnTiles.data(), _columnEnds.data(),
+                                     _columnEnds.size());
+    }
+
+    /** Returns the walls as polygons, the border first */
+    const std::vector<cugl::Poly2>& getObstacles() const { return _obstacles; }
+};
+
+#endif /* _LEVEL_CACHE_H */
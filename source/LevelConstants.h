@@ -73,7 +73,10 @@
 #define LEVEL_ONE_FILE "json/gppbasic_level.json"
 #define LEVEL_TWO_FILE "json/technical_level.json"
 #define LEVEL_THREE_FILE "json/large_map.json"
-#define LEVEL_FINAL_FILE "json/bigmap.json"
+/** Compiled by tools/level from json/bigmap.json */
+#define LEVEL_FINAL_FILE "levels/bigmap.sclevel"
+/** Where the Tiled export of a compiled level is, if it cannot be loaded */
+#define LEVEL_SOURCE_DIRECTORY "json/"
 
 /** The key for our loaded level */
 #define LEVEL_ONE_KEY "basic_level"
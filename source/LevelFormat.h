@@ -0,0 +1,195 @@
+//
+//  LevelFormat.h
+//  Sunk Cost
+//
+//  This module provides the compiled level format, which LevelModel loads
+//  in place of the Tiled JSON export, and which the converter in
+//  tools/level writes from that export.
+//
+//  A compiled level is one little-endian file: a LevelHeader followed by
+//  the sections below, in this order, each padded to a multiple of four
+//  bytes so that every array can be read in place.
+//
+//      floor tiles     uint16_t[floorTiles]
+//      detail layers   uint32_t[detailLayers], the tiles in each layer
+//      detail tiles    uint16_t[detailTiles], every layer in order
+//      overflows       LevelOverflow[overflows]
+//      border          float[2 * borderPoints], x and y interleaved
+//      walls           uint32_t[walls], the end of each wall in points
+//      wall points     float[2 * wallPoints], x and y interleaved
+//      doors           LevelDoor[doors]
+//      portraits       LevelPortrait[portraits]
+//
+//  A tile that does not fit in 16 bits, which is any tile Tiled flipped or
+//  rotated, is 0 in its layer and listed in the overflows with its full
+//  32 bit value. The collision points are already scaled to world units.
+//
+//  The header depends on the standard library only, so that the converter
+//  builds without CUGL. Any change to the layout must bump the version; a
+//  file of another version is refused, and LevelModel falls back to the
+//  JSON export of the same name.
+//
+
+#ifndef _LEVEL_FORMAT_H
+#define _LEVEL_FORMAT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** The first four bytes of a compiled level, "SCLV" */
+#define LEVEL_FORMAT_MAGIC 0x564c4353
+/** The version of the layout; a loader refuses any other */
+#define LEVEL_FORMAT_VERSION 1
+/** The file extension of a compiled level */
+#define LEVEL_FORMAT_EXTENSION ".sclevel"
+
+/**
+ * The fixed start of a compiled level, with the size of every section.
+ */
+struct LevelHeader {
+    uint32_t magic;
+    uint32_t version;
+    /** The size of the whole file in bytes, to catch a truncated copy */
+    uint32_t size;
+    int32_t width;
+    int32_t height;
+    int32_t tileSize;
+    float battery;
+    float playerX;
+    float playerY;
+    uint32_t floorTiles;
+    uint32_t detailLayers;
+    uint32_t detailTiles;
+    uint32_t overflows;
+    uint32_t borderPoints;
+    uint32_t walls;
+    uint32_t wallPoints;
+    uint32_t doors;
+    uint32_t portraits;
+};
+
+/**
+ * A tile too large for the packed tile arrays.
+ */
+struct LevelOverflow {
+    /** 0 for the floor, or 1 plus the index of the detail layer */
+    uint32_t layer;
+    /** The index of the tile in its layer */
+    uint32_t index;
+    /** The tile as exported, flip bits included */
+    uint32_t value;
+};
+
+/**
+ * A door and its type.
+ */
+struct LevelDoor {
+    float x;
+    float y;
+    int32_t type;
+};
+
+/**
+ * The three positions of a portrait and its type.
+ */
+struct LevelPortrait {
+    /** The positions as x1, y1, x2, y2, x3, y3 */
+    float points[6];
+    int32_t type;
+};
+
+static_assert(sizeof(LevelHeader) == 72, "the level header must be packed");
+static_assert(sizeof(LevelOverflow) == 12, "overflows must be packed");
+static_assert(sizeof(LevelDoor) == 12, "doors must be packed");
+static_assert(sizeof(LevelPortrait) == 28, "portraits must be packed");
+
+/**
+ * Writes the sections of a compiled level to a byte buffer.
+ */
+class LevelWriter {
+  private:
+    std::vector<std::byte> _data;
+
+  public:
+    /**
+     * Writes a section and pads it to a multiple of four bytes.
+     *
+     * @param values    The first element of the section
+     * @param count     The number of elements
+     */
+    template <typename T> void write(const T* values, size_t count) {
+        size_t start = _data.size();
+        _data.resize(start + count * sizeof(T));
+        if (count > 0) {
+            std::memcpy(_data.data() + start, values, count * sizeof(T));
+        }
+        _data.resize((_data.size() + 3) & ~size_t(3));
+    }
+
+    /** Returns the sections written so far */
+    std::vector<std::byte>& getData() { return _data; }
+};
+
+/**
+ * Reads the sections of a compiled level in place.
+ *
+ * The data must start on a four byte boundary, as any heap buffer does.
+ */
+class LevelReader {
+  private:
+    const std::byte* _data;
+    size_t _size;
+    size_t _offset;
+    /** Whether a read ran past the end of the data */
+    bool _failed;
+
+  public:
+    /**
+     * Creates a reader of a compiled level.
+     *
+     * @param data  The first byte of the file
+     * @param size  The size of the file
+     */
+    LevelReader(const std::byte* data, size_t size)
+        : _data(data), _size(size), _offset(0), _failed(false) {}
+
+    /**
+     * Returns the next section, or nullptr if the data is too short.
+     *
+     * The section stays valid as long as the data does.
+     *
+     * @param count The number of elements in the section
+     */
+    template <typename T> const T* read(size_t count) {
+        size_t bytes = count * sizeof(T);
+        if (_failed || count > _size || bytes > _size - _offset) {
+            _failed = true;
+            return nullptr;
+        }
+        const T* values = reinterpret_cast<const T*>(_data + _offset);
+        _offset = std::min(_size, (_offset + bytes + 3) & ~size_t(3));
+        return values;
+    }
+
+    /** Returns true if a read ran past the end of the data */
+    bool failed() const { return _failed; }
+};
+
+/**
+ * Returns the 64 bit FNV-1a hash of a file, to tell one level from another.
+ *
+ * @param data  The first byte of the file
+ * @param size  The size of the file
+ */
+inline uint64_t levelHash(const std::byte* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t ii = 0; ii < size; ii++) {
+        hash = (hash ^ static_cast<uint64_t>(data[ii])) * 0x100000001b3;
+    }
+    return hash;
+}
+
+#endif /* _LEVEL_FORMAT_H */
@@ -4,6 +4,36 @@
 
 #include "LevelModel.h"
 #include "LevelConstants.h"
+#include "LevelFormat.h"
+#include "LevelParser.h"
+#include <memory>
+
+/**
+ * Reads a file in the asset directory whole, with a single read.
+ *
+ * @param file  The name of the file
+ * @param data  Set to the contents of the file
+ * @param size  Set to the size of the file
+ *
+ * @return false if the file is missing or empty
+ */
+static bool readAsset(const std::string& file,
+                      std::unique_ptr<std::byte[]>& data, size_t& size) {
+    std::string path = Application::get()->getAssetDirectory() + file;
+    SDL_RWops* source = SDL_RWFromFile(path.c_str(), "rb");
+    if (source == nullptr) {
+        return false;
+    }
+    Sint64 length = SDL_RWsize(source);
+    bool success = length > 0;
+    if (success) {
+        data.reset(new std::byte[length]);
+        success = SDL_RWread(source, data.get(), length, 1) == 1;
+    }
+    SDL_RWclose(source);
+    size = success ? static_cast<size_t>(length) : 0;
+    return success;
+}
 
 #pragma mark -
 #pragma mark Static Constructors
@@ -11,7 +41,9 @@
 /**
  * Creates a new, empty level.
  */
-LevelModel::LevelModel() : Asset() { _bounds.size.set(1.0f, 1.0f); }
+LevelModel::LevelModel() : Asset(), _hash(0) {
+    _bounds.size.set(1.0f, 1.0f);
+}
 
 /**
  * Destroys this level, releasing all resources.
@@ -28,12 +60,28 @@ LevelModel::~LevelModel(void) { unload(); }
  * other assets, then these should be connected later, during scene
  * initialization.
  *
+ * A compiled level that is missing or of an older version falls back to the
+ * Tiled export of the same name in LEVEL_SOURCE_DIRECTORY.
+ *
  * @return true if successfully loaded the asset from a file
  */
 bool LevelModel::preload(const std::string& file) {
-    std::shared_ptr<JsonReader> reader = JsonReader::allocWithAsset(file);
+    std::string source = file;
+    size_t extension = file.rfind(LEVEL_FORMAT_EXTENSION);
+    if (extension != std::string::npos &&
+        extension + strlen(LEVEL_FORMAT_EXTENSION) == file.size()) {
+        if (preloadBinary(file)) {
+            return true;
+        }
+        size_t slash = file.find_last_of('/');
+        size_t start = slash == std::string::npos ? 0 : slash + 1;
+        source = LEVEL_SOURCE_DIRECTORY +
+                 file.substr(start, extension - start) + ".json";
+        CULog("Could not load %s; loading %s instead", file.c_str(),
+              source.c_str());
+    }
 
-    return preload(reader->readJson());
+    return preloadStream(source);
 }
 
 /**
@@ -81,9 +129,194 @@ bool LevelModel::preload(const std::shared_ptr<cugl::JsonValue>& json) {
             loadObject(objects->get(j));
         }
     }
+    seal();
+    _hash = 0;
+    return true;
+}
+
+/**
+ * Loads this game level from a compiled level file.
+ *
+ * The file is read whole with a single read and decoded in place, with one
+ * allocation per array. See LevelFormat.h for the layout.
+ *
+ * @param file the name of the compiled level file
+ *
+ * @return true if the file is a compiled level of the current version
+ */
+bool LevelModel::preloadBinary(const std::string& file) {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+    if (!readAsset(file, data, size) || !loadBinary(data.get(), size)) {
+        return false;
+    }
+    _hash = levelHash(data.get(), size);
     return true;
 }
 
+/**
+ * Loads this game level from a Tiled JSON export without a JsonValue.
+ *
+ * The text is read whole and parsed in a single pass by LevelParser, which
+ * fills the level as it goes. The result is the same as preload with the
+ * JsonValue of the file, for any number of workers.
+ *
+ * @param file      the name of the Tiled JSON export
+ * @param workers   the threads to decode the layers with, or 0 for one per
+ *                  core
+ *
+ * @return true if successfully loaded the asset from a file
+ */
+bool LevelModel::preloadStream(const std::string& file, size_t workers) {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+    if (!readAsset(file, data, size) ||
+        !LevelParser(*this, workers)
+             .parse(reinterpret_cast<const char*>(data.get()), size)) {
+        CUAssertLog(false, "Failed to load level file");
+        return false;
+    }
+    seal();
+    _hash = levelHash(data.get(), size);
+    return true;
+}
+
+/**
+ * Loads this game level from the contents of a compiled level file.
+ *
+ * Nothing is changed unless the whole file is valid.
+ *
+ * @param data the first byte of the file, on a four byte boundary
+ * @param size the size of the file in bytes
+ *
+ * @return true if the data is a compiled level of the current version
+ */
+bool LevelModel::loadBinary(const std::byte* data, size_t size) {
+    LevelReader reader(data, size);
+    const LevelHeader* header = reader.read<LevelHeader>(1);
+    if (header == nullptr || header->magic != LEVEL_FORMAT_MAGIC ||
+        header->version != LEVEL_FORMAT_VERSION || header->size != size) {
+        return false;
+    }
+    const Uint16* floor = reader.read<Uint16>(header->floorTiles);
+    const Uint32* layers = reader.read<Uint32>(header->detailLayers);
+    const Uint16* details = reader.read<Uint16>(header->detailTiles);
+    const LevelOverflow* overflows =
+        reader.read<LevelOverflow>(header->overflows);
+    const float* border = reader.read<float>(2 * (size_t)header->borderPoints);
+    const Uint32* walls = reader.read<Uint32>(header->walls);
+    const float* points = reader.read<float>(2 * (size_t)header->wallPoints);
+    const LevelDoor* doors = reader.read<LevelDoor>(header->doors);
+    const LevelPortrait* portraits =
+        reader.read<LevelPortrait>(header->portraits);
+    if (reader.failed()) {
+        return false;
+    }
+
+    // Check the offsets before anything is indexed by them
+    size_t tiles = 0;
+    for (Uint32 i = 0; i < header->detailLayers; i++) {
+        tiles += layers[i];
+    }
+    if (tiles != header->detailTiles) {
+        return false;
+    }
+    for (Uint32 i = 0; i < header->walls; i++) {
+        if (walls[i] > header->wallPoints ||
+            (i > 0 && walls[i] < walls[i - 1])) {
+            return false;
+        }
+    }
+    for (Uint32 i = 0; i < header->overflows; i++) {
+        const LevelOverflow& overflow = overflows[i];
+        if (overflow.layer > header->detailLayers ||
+            overflow.index >= (overflow.layer == 0
+                                   ? header->floorTiles
+                                   : layers[overflow.layer - 1])) {
+            return false;
+        }
+    }
+
+    _bounds.size.set(header->width, header->height);
+    _dimensions = Vec2(header->width, header->height);
+    _tileSize = header->tileSize;
+    _battery = header->battery;
+    _player = Vec2(header->playerX, header->playerY);
+
+    // Decode straight into the arena; nothing goes through the vectors
+    LevelArena::Sizes sizes;
+    sizes.tiles = header->floorTiles;
+    sizes.detailLayers = header->detailLayers;
+    sizes.detailTiles = header->detailTiles;
+    sizes.boarder = header->borderPoints;
+    sizes.walls = header->walls;
+    sizes.wallPoints = header->wallPoints;
+    sizes.portraits = header->portraits;
+    sizes.doors = header->doors;
+    _arena.allocate(sizes);
+
+    std::copy(floor, floor + header->floorTiles, _arena.tiles());
+    std::copy(details, details + header->detailTiles, _arena.details());
+    Uint32* ends = _arena.detailEnds();
+    for (Uint32 i = 0, end = 0; i < header->detailLayers; i++) {
+        end += layers[i];
+        ends[i] = end;
+    }
+    for (Uint32 i = 0; i < header->overflows; i++) {
+        const LevelOverflow& overflow = overflows[i];
+        int value = static_cast<int>(overflow.value);
+        if (overflow.layer == 0) {
+            _arena.tiles()[overflow.index] = value;
+        } else {
+            Uint32 start = overflow.layer == 1 ? 0 : ends[overflow.layer - 2];
+            _arena.details()[start + overflow.index] = value;
+        }
+    }
+
+    Vec2* boarder = _arena.boarder();
+    for (Uint32 i = 0; i < header->borderPoints; i++) {
+        boarder[i].set(border[2 * i], border[2 * i + 1]);
+    }
+    Vec2* wallPoints = _arena.wallPoints();
+    for (Uint32 n = 0; n < header->wallPoints; n++) {
+        wallPoints[n].set(points[2 * n], points[2 * n + 1]);
+    }
+    std::copy(walls, walls + header->walls, _arena.wallEnds());
+
+    std::pair<Vec2, int>* levelDoors = _arena.doors();
+    for (Uint32 i = 0; i < header->doors; i++) {
+        levelDoors[i] =
+            std::make_pair(Vec2(doors[i].x, doors[i].y), doors[i].type);
+    }
+    Vec2* portraitPoints = _arena.portraitPoints();
+    for (Uint32 i = 0; i < header->portraits; i++) {
+        const float* p = portraits[i].points;
+        for (int n = 0; n < LEVEL_PORTRAIT_POINTS; n++) {
+            portraitPoints[LEVEL_PORTRAIT_POINTS * i + n].set(p[2 * n],
+                                                              p[2 * n + 1]);
+        }
+        _arena.portraitTypes()[i] = portraits[i].type;
+    }
+    return true;
+}
+
+/**
+ * Moves the vectors built by the JSON loaders into the arena.
+ *
+ * The vectors are released, so the level is held only once.
+ */
+void LevelModel::seal() {
+    _arena.assign(_tiles, _details, _boarder, _collision, _portraits,
+                  _portraitTypes, _doors);
+    std::vector<int>().swap(_tiles);
+    std::vector<std::vector<int>>().swap(_details);
+    std::vector<Vec2>().swap(_boarder);
+    std::vector<std::vector<Vec2>>().swap(_collision);
+    std::vector<std::vector<Vec2>>().swap(_portraits);
+    std::vector<int>().swap(_portraitTypes);
+    std::vector<std::pair<Vec2, int>>().swap(_doors);
+}
+
 /**
  * Unloads this game level, releasing all sources
  *
@@ -93,7 +326,14 @@ bool LevelModel::preload(const std::shared_ptr<cugl::JsonValue>& json) {
  */
 void LevelModel::unload() {
     _bounds = Rect::ZERO;
+    _arena.clear();
+    _hash = 0;
     _tiles.clear();
+    _details.clear();
+    _collision.clear();
+    _portraitTypes.clear();
+    _doors.clear();
+    _battery = 0;
     _dimensions = Size::ZERO;
     _tileSize = 0;
     _defaultcam = Vec2::ZERO;
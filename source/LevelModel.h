@@ -6,6 +6,7 @@
 #define _LEVEL_MODEL_H
 
 #include "HunterModel.h"
+#include "LevelArena.h"
 #include "SpiritModel.h"
 #include "TileModel.h"
 #include <cugl/assets/CUAsset.h>
@@ -18,9 +19,24 @@ using namespace cugl;
 #pragma mark -
 #pragma mark Level Model
 class LevelModel : public Asset {
+    /** The streaming JSON loader fills the level directly */
+    friend class LevelParser;
+
     /** The bounds of this level in physics coordinates */
     Rect _bounds;
 
+    /**
+     * The arrays of the level, in one block.
+     *
+     * The JSON loaders build the vectors below, which seal then moves into
+     * the arena and releases; the compiled loader fills the arena directly.
+     * The getters are views of the arena, so they never copy.
+     */
+    LevelArena _arena;
+
+    /** The hash of the level file, or 0 if loaded from a JsonValue */
+    Uint64 _hash;
+
     /** Vector of textures for tiles */
     std::vector<int> _tiles;
 
@@ -90,11 +106,11 @@ class LevelModel : public Asset {
 
 #pragma mark Getters
 
-    std::vector<int> getTileTextures() { return _tiles; }
+    LevelSpan<int> getTileTextures() { return _arena.getTiles(); }
 
-    std::vector<std::vector<int>> getDetails() { return _details; }
-    
-    std::vector<int> getPortraitTypes() { return _portraitTypes; }
+    LevelRagged<int> getDetails() { return _arena.getDetails(); }
+
+    LevelSpan<int> getPortraitTypes() { return _arena.getPortraitTypes(); }
     
     Vec2 getDimensions() { return _dimensions; }
 
@@ -102,9 +118,9 @@ class LevelModel : public Asset {
 
     int getTileWidth() { return _tileSize; }
 
-    std::vector<std::vector<Vec2>> getCollision() { return _collision; }
+    LevelRagged<Vec2> getCollision() { return _arena.getCollision(); }
 
-    std::vector<Vec2> getBoarder() { return _boarder; }
+    LevelSpan<Vec2> getBoarder() { return _arena.getBoarder(); }
 
     //    Size getDimensions() { return _dimensions; }
     //
@@ -112,7 +128,7 @@ class LevelModel : public Asset {
 
     Vec2 getDefaultCamPosition() { return _defaultcam; }
 
-    std::vector<std::vector<Vec2>> getPortaits() { return _portraits; }
+    LevelRagged<Vec2> getPortaits() { return _arena.getPortraits(); }
 
     Vec2 getPlayerPosition() { return _player; }
 
@@ -120,7 +136,13 @@ class LevelModel : public Asset {
 
     float getBattery() { return _battery; }
 
-    std::vector<std::pair<Vec2, int>> getDoors() { return _doors; }
+    LevelSpan<std::pair<Vec2, int>> getDoors() { return _arena.getDoors(); }
+
+    /** Returns the size of the level arrays in bytes */
+    size_t getArenaBytes() { return _arena.getBytes(); }
+
+    /** Returns the hash of the level file, or 0 if loaded from a JsonValue */
+    Uint64 getHash() { return _hash; }
 
 #pragma mark Physics Attributes
     /**
@@ -171,6 +193,52 @@ class LevelModel : public Asset {
      */
     virtual bool preload(const std::shared_ptr<cugl::JsonValue>& json) override;
 
+    /**
+     * Loads this game level from a compiled level file.
+     *
+     * The file is read whole with a single read and decoded in place, with
+     * one allocation per array. See LevelFormat.h for the layout.
+     *
+     * @param file the name of the compiled level file
+     *
+     * @return true if the file is a compiled level of the current version
+     */
+    bool preloadBinary(const std::string& file);
+
+    /**
+     * Loads this game level from a Tiled JSON export without a JsonValue.
+     *
+     * The text is read whole and parsed in a single pass by LevelParser,
+     * which fills the level as it goes. The result is the same as
+     * preload with the JsonValue of the file, for any number of workers.
+     *
+     * @param file      the name of the Tiled JSON export
+     * @param workers   the threads to decode the layers with, or 0 for one
+     *                  per core
+     *
+     * @return true if successfully loaded the asset from a file
+     */
+    bool preloadStream(const std::string& file, size_t workers = 0);
+
+    /**
+     * Loads this game level from the contents of a compiled level file.
+     *
+     * Nothing is changed unless the whole file is valid.
+     *
+     * @param data the first byte of the file, on a four byte boundary
+     * @param size the size of the file in bytes
+     *
+     * @return true if the data is a compiled level of the current version
+     */
+    bool loadBinary(const std::byte* data, size_t size);
+
+    /**
+     * Moves the vectors built by the JSON loaders into the arena.
+     *
+     * The vectors are released, so the level is held only once.
+     */
+    void seal();
+
     /**
      * Unloads this game level, releasing all sources
      *
@@ -0,0 +1,575 @@
+//
+//  LevelParser.cpp
+//  Sunk Cost
+//
+//  This module provides a streaming loader of Tiled JSON levels. See the
+//  header for details.
+//
+
+#include "LevelParser.h"
+#include "LevelConstants.h"
+#include "LevelModel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+using namespace cugl;
+
+/** The layers before this one are loaded whole; later ones by object */
+#define LEVEL_OBJECT_LAYERS 16
+/** The longest number text that is parsed */
+#define LEVEL_NUMBER_LENGTH 63
+
+/** Returns true if a layer of this class holds detail tiles */
+static bool isDetail(const std::string& type) {
+    return type == UNDER_FIELD || type == AO_FIELD || type == FV_1_FIELD ||
+           type == FV_2_FIELD || type == CARPETS_FIELD || type == WALLS_FIELD ||
+           type == WALL_UPPER_FIELD || type == WALL_GRIME_FIELD ||
+           type == DECOR_FIELD || type == D_0_FIELD || type == D_1_FIELD ||
+           type == D_2_FIELD || type == D_3_FIELD;
+}
+
+/** Returns true if c may be part of a JSON number */
+static bool isNumber(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+           c == 'e' || c == 'E';
+}
+
+/**
+ * Forgets the layer, keeping the capacity of every buffer.
+ */
+void LevelParser::Layer::clear() {
+    fields.clear();
+    tiles.clear();
+    boarder.clear();
+    points.clear();
+    walls.clear();
+    objectCount = 0;
+}
+
+/**
+ * Creates a parser that adds to the given level.
+ *
+ * @param level     The level to fill
+ * @param workers   The threads to decode the layers with, or 0 for one per
+ *                  core up to LEVEL_MAX_WORKERS
+ */
+LevelParser::LevelParser(LevelModel& level, size_t workers)
+    : _next(nullptr), _end(nullptr), _failed(false), _level(level),
+      _workers(workers), _mapTiles(0) {
+    if (_workers == 0) {
+        _workers = std::min<size_t>(std::thread::hardware_concurrency(),
+                                    LEVEL_MAX_WORKERS);
+    }
+    _workers = std::max<size_t>(_workers, 1);
+    _layer.objectCount = 0;
+}
+
+#pragma mark -
+#pragma mark Tokens
+
+/**
+ * Skips whitespace and returns the next character, or 0 at the end.
+ */
+char LevelParser::peek() {
+    while (_next < _end &&
+           (*_next == ' ' || *_next == '\n' || *_next == '\r' ||
+            *_next == '\t')) {
+        _next++;
+    }
+    return _next < _end ? *_next : 0;
+}
+
+/**
+ * Consumes the next character if it is c.
+ */
+bool LevelParser::accept(char c) {
+    if (peek() == c) {
+        _next++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Consumes the next character, failing if it is not c.
+ */
+bool LevelParser::expect(char c) {
+    if (!accept(c)) {
+        _failed = true;
+    }
+    return !_failed;
+}
+
+/**
+ * Reads a string; escapes are kept as written, as no level field has any.
+ */
+bool LevelParser::parseString(std::string& value) {
+    if (!expect('"')) {
+        return false;
+    }
+    const char* start = _next;
+    while (_next < _end && *_next != '"') {
+        _next += *_next == '\\' ? 2 : 1;
+    }
+    if (_next >= _end) {
+        _failed = true;
+        return false;
+    }
+    value.assign(start, _next - start);
+    _next++;
+    return true;
+}
+
+/**
+ * Reads a number.
+ */
+bool LevelParser::parseNumber(double& value) {
+    peek();
+    char buffer[LEVEL_NUMBER_LENGTH + 1];
+    size_t length = 0;
+    while (_next < _end && isNumber(*_next) && length < LEVEL_NUMBER_LENGTH) {
+        buffer[length++] = *_next++;
+    }
+    buffer[length] = 0;
+    char* end = nullptr;
+    value = std::strtod(buffer, &end);
+    if (length == 0 || end != buffer + length) {
+        _failed = true;
+    }
+    return !_failed;
+}
+
+/**
+ * Reads an integer tile ID, without going through a double.
+ *
+ * A tile Tiled flipped has flag bits past 31 bits, which wrap to a negative
+ * int as they do through JsonValue::asInt.
+ */
+bool LevelParser::parseTile(int& value) {
+    peek();
+    const char* start = _next;
+    bool negative = _next < _end && *_next == '-';
+    _next += negative ? 1 : 0;
+    Sint64 tile = 0;
+    while (_next < _end && *_next >= '0' && *_next <= '9' &&
+           _next - start < 19) {
+        tile = tile * 10 + (*_next++ - '0');
+    }
+    if (_next < _end && isNumber(*_next)) {
+        // Not a plain integer, so take the slow way
+        double number;
+        _next = start;
+        if (!parseNumber(number)) {
+            return false;
+        }
+        tile = static_cast<Sint64>(number);
+    } else if (_next == start + (negative ? 1 : 0)) {
+        _failed = true;
+        return false;
+    } else if (negative) {
+        tile = -tile;
+    }
+    value = static_cast<int>(static_cast<Uint32>(tile));
+    return true;
+}
+
+/**
+ * Reads the members of an object, calling field with each key in _key.
+ *
+ * @param field Reads the value of the key; false stops the parse
+ */
+template <typename F> bool LevelParser::parseObject(F field) {
+    if (!expect('{')) {
+        return false;
+    }
+    if (accept('}')) {
+        return true;
+    }
+    do {
+        if (!parseString(_key) || !expect(':') || !field()) {
+            return false;
+        }
+    } while (accept(','));
+    return expect('}');
+}
+
+/**
+ * Reads an array, calling item for each element.
+ *
+ * @param item  Reads the element; false stops the parse
+ */
+template <typename F> bool LevelParser::parseArray(F item) {
+    if (!expect('[')) {
+        return false;
+    }
+    if (accept(']')) {
+        return true;
+    }
+    do {
+        if (!item()) {
+            return false;
+        }
+    } while (accept(','));
+    return expect(']');
+}
+
+/**
+ * Skips a value of any type.
+ */
+bool LevelParser::skipValue() {
+    switch (peek()) {
+    case '{':
+        return parseObject([this] { return skipValue(); });
+    case '[':
+        return parseArray([this] { return skipValue(); });
+    case '"':
+        return parseString(_key);
+    case 't':
+    case 'n':
+    case 'f': {
+        size_t length = *_next == 'f' ? 5 : 4;
+        if (static_cast<size_t>(_end - _next) < length) {
+            _failed = true;
+            return false;
+        }
+        _next += length;
+        return true;
+    }
+    default: {
+        double number;
+        return parseNumber(number);
+    }
+    }
+}
+
+/**
+ * Skips an array or object by matching brackets only.
+ *
+ * This is how the layers are found before the workers start, so it does
+ * not look at anything but strings and brackets.
+ */
+bool LevelParser::skipSpan() {
+    char open = peek();
+    if (open != '[' && open != '{') {
+        _failed = true;
+        return false;
+    }
+    size_t depth = 0;
+    while (_next < _end) {
+        char c = *_next++;
+        if (c == '"') {
+            while (_next < _end && *_next != '"') {
+                _next += *_next == '\\' ? 2 : 1;
+            }
+            _next++;
+        } else if (c == '[' || c == '{') {
+            depth++;
+        } else if ((c == ']' || c == '}') && --depth == 0) {
+            return true;
+        }
+    }
+    _next = _end;
+    _failed = true;
+    return false;
+}
+
+#pragma mark -
+#pragma mark Schema
+
+/**
+ * Parses a Tiled JSON level into the level.
+ *
+ * @param text  The text of the file
+ * @param size  The size of the text in bytes
+ *
+ * @return false if the text is not a JSON level
+ */
+bool LevelParser::parse(const char* text, size_t size) {
+    _next = text;
+    _end = text + size;
+    _failed = false;
+    _spans.clear();
+    int width = 0;
+    int height = 0;
+    int tileSize = 0;
+    double battery = 0;
+    size_t layers = 0;
+    bool success = parseObject([&] {
+        double value;
+        if (_key == WIDTH_FIELD || _key == HEIGHT_FIELD ||
+            _key == TILE_SIZE || _key == BATTERY_FIELD) {
+            if (!parseNumber(value)) {
+                return false;
+            }
+            if (_key == WIDTH_FIELD) {
+                width = static_cast<int>(value);
+            } else if (_key == HEIGHT_FIELD) {
+                height = static_cast<int>(value);
+            } else if (_key == TILE_SIZE) {
+                tileSize = static_cast<int>(value);
+            } else {
+                battery = value;
+            }
+            _mapTiles = width > 0 && height > 0 ? (size_t)width * height : 0;
+            return true;
+        } else if (_key == "layers" && _workers > 1) {
+            return parseArray([&] {
+                peek();
+                const char* start = _next;
+                if (!skipSpan()) {
+                    return false;
+                }
+                _spans.emplace_back(start, _next);
+                return true;
+            });
+        } else if (_key == "layers") {
+            return parseArray([&] {
+                _layer.clear();
+                if (!parseLayer(_layer)) {
+                    return false;
+                }
+                applyLayer(_layer, layers++);
+                return true;
+            });
+        }
+        return skipValue();
+    });
+    if (!success || (!_spans.empty() && !parseSpans())) {
+        return false;
+    }
+
+    _level._bounds.size.set(width, height);
+    _level._dimensions = Vec2(width, height);
+    _level._tileSize = tileSize;
+    _level._battery = static_cast<float>(battery);
+    return true;
+}
+
+/**
+ * Reads a scalar field of a layer or object, or skips the value.
+ */
+bool LevelParser::parseField(Fields& fields) {
+    if (_key == "class") {
+        return peek() == '"' ? parseString(fields.type) : skipValue();
+    }
+    double* number = nullptr;
+    if (_key == "x") {
+        fields.hasX = true;
+        number = &fields.x;
+    } else if (_key == "y") {
+        number = &fields.y;
+    } else if (_key.size() == 2 && (_key[0] == 'x' || _key[0] == 'y') &&
+               _key[1] >= '1' && _key[1] <= '3') {
+        number = &fields.points[(_key[1] - '1') * 2 + (_key[0] == 'y')];
+    }
+    double value;
+    if (number != nullptr) {
+        return parseNumber(*number);
+    } else if (_key == "type" && peek() != '"') {
+        // The type of a door or portrait; a layer has a string type instead
+        if (!parseNumber(value)) {
+            return false;
+        }
+        fields.kind = static_cast<int>(value);
+        return true;
+    } else if (_key == "x_offset" || _key == "y_offset") {
+        if (!parseNumber(value)) {
+            return false;
+        }
+        (_key[0] == 'x' ? fields.xOffset : fields.yOffset) =
+            static_cast<float>(value);
+        return true;
+    }
+    return skipValue();
+}
+
+/**
+ * Reads a layer into the given buffers.
+ *
+ * @param layer The buffers to read into, already cleared
+ */
+bool LevelParser::parseLayer(Layer& layer) {
+    auto floats = [this](std::vector<float>& values) {
+        return parseArray([&] {
+            double value;
+            if (!parseNumber(value)) {
+                return false;
+            }
+            values.push_back(static_cast<float>(value));
+            return true;
+        });
+    };
+    return parseObject([&] {
+        if (_key == "data" && peek() == '[') {
+            layer.tiles.reserve(_mapTiles);
+            return parseArray([&] {
+                int tile;
+                if (!parseTile(tile)) {
+                    return false;
+                }
+                layer.tiles.push_back(tile);
+                return true;
+            });
+        } else if (_key == "boarder") {
+            return floats(layer.boarder);
+        } else if (_key == "walls") {
+            return parseArray([&] {
+                bool wall = parseObject([&] {
+                    return _key == "data" ? floats(layer.points) : skipValue();
+                });
+                layer.walls.push_back(layer.points.size() / 2);
+                return wall;
+            });
+        } else if (_key == "objects") {
+            return parseArray([&] {
+                if (layer.objectCount == layer.objects.size()) {
+                    layer.objects.emplace_back();
+                }
+                Fields& object = layer.objects[layer.objectCount++];
+                object.clear();
+                return parseObject([&] { return parseField(object); });
+            });
+        }
+        return parseField(layer.fields);
+    });
+}
+
+/**
+ * Decodes every layer in _spans on the workers, then applies them.
+ *
+ * Each worker claims the next undecoded layer until there are none left,
+ * so one large tile layer does not hold up the small ones behind it. The
+ * calling thread is one of the workers.
+ *
+ * @return false if any layer is not valid
+ */
+bool LevelParser::parseSpans() {
+    std::vector<Layer> layers(_spans.size());
+    std::atomic<size_t> claimed(0);
+    std::atomic<bool> failed(false);
+    auto work = [&] {
+        LevelParser parser(_level);
+        parser._mapTiles = _mapTiles;
+        for (size_t ii = claimed++; ii < layers.size() && !failed;
+             ii = claimed++) {
+            Layer& layer = layers[ii];
+            layer.clear();
+            parser._next = _spans[ii].first;
+            parser._end = _spans[ii].second;
+            if (!parser.parseLayer(layer) || parser.peek() != 0) {
+                failed = true;
+            }
+        }
+    };
+
+    size_t count = std::min(_workers, layers.size());
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+    for (size_t ii = 1; ii < count; ii++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (failed) {
+        _failed = true;
+        return false;
+    }
+
+    for (size_t ii = 0; ii < layers.size(); ii++) {
+        applyLayer(layers[ii], ii);
+    }
+    return true;
+}
+
+#pragma mark -
+#pragma mark Level
+
+/**
+ * Applies a layer to the level, as LevelModel::loadObject does.
+ *
+ * The tiles of the layer are moved into the level, not copied.
+ *
+ * @param layer The decoded layer
+ * @param index The index of the layer in the map
+ */
+void LevelParser::applyLayer(Layer& layer, size_t index) {
+    if (index >= LEVEL_OBJECT_LAYERS) {
+        for (size_t ii = 0; ii < layer.objectCount; ii++) {
+            applyObject(layer.objects[ii]);
+        }
+        return;
+    }
+
+    const std::string& type = layer.fields.type;
+    if (type == FLOOR_FIELD) {
+        if (_level._tiles.empty()) {
+            _level._tiles.swap(layer.tiles);
+        } else {
+            _level._tiles.insert(_level._tiles.end(), layer.tiles.begin(),
+                                 layer.tiles.end());
+        }
+    } else if (isDetail(type)) {
+        if (!layer.tiles.empty()) {
+            // The layer keeps the buffer, and the next one reserves anew
+            _level._details.emplace_back();
+            _level._details.back().swap(layer.tiles);
+        }
+    } else if (type == COLLISION_FIELD) {
+        applyCollision(layer);
+    } else if (type == DOOR_FIELD) {
+        for (size_t ii = 0; ii < layer.objectCount; ii++) {
+            const Fields& door = layer.objects[ii];
+            _level._doors.push_back(
+                std::make_pair(Vec2(door.x, door.y), door.kind));
+        }
+    } else {
+        applyObject(layer.fields);
+    }
+}
+
+/**
+ * Applies an object of an object layer.
+ */
+void LevelParser::applyObject(const Fields& fields) {
+    if (fields.type == PORTRAIT_FIELD) {
+        const double* p = fields.points;
+        _level._portraits.push_back(std::vector<Vec2>(
+            {Vec2(p[0], p[1]), Vec2(p[2], p[3]), Vec2(p[4], p[5])}));
+        _level._portraitTypes.push_back(fields.kind);
+    } else if (fields.type == PLAYER_FIELD && fields.hasX) {
+        _level._player = Vec2(fields.x, fields.y);
+    }
+}
+
+/**
+ * Adds a collision layer, scaled to world units.
+ */
+void LevelParser::applyCollision(const Layer& layer) {
+    float xOffset = layer.fields.xOffset;
+    float yOffset = layer.fields.yOffset;
+    int x = static_cast<int>(layer.fields.x);
+    int y = static_cast<int>(layer.fields.y);
+    const std::vector<float>& boarder = layer.boarder;
+    for (size_t i = 0; i + 1 < boarder.size(); i += 2) {
+        float xw = (xOffset + x * boarder[i]) * 128;
+        float yw = (yOffset + y * boarder[i + 1]) * 128;
+        _level._boarder.emplace_back(xw, yw);
+    }
+    const std::vector<float>& points = layer.points;
+    size_t start = 0;
+    for (size_t end : layer.walls) {
+        std::vector<Vec2> wall;
+        wall.reserve(end - start);
+        for (size_t n = start; n < end; n++) {
+            float xw = (xOffset + x * points[2 * n]) * 128;
+            float yw = (yOffset + y * points[2 * n + 1]) * 128;
+            wall.emplace_back(xw, yw);
+        }
+        _level._collision.push_back(std::move(wall));
+        start = end;
+    }
+}
@@ -0,0 +1,190 @@
+//
+//  LevelParser.h
+//  Sunk Cost
+//
+//  This module provides a streaming loader of Tiled JSON levels, which fills
+//  a LevelModel without building a JsonValue tree.
+//
+//  The parser walks the text once and recognises only the fields the level
+//  uses: the size and battery of the map, and the "class", "data",
+//  "boarder", "walls" and "objects" of each layer, along with the scalar
+//  fields of the portraits, doors and player. Tile IDs are written straight
+//  into vectors reserved for the whole map as they are tokenised, and
+//  anything else is skipped without being stored. A layer is only applied
+//  once it is closed, since Tiled may write its class after its data; the
+//  buffers it is read into are reused from layer to layer.
+//
+//  With more than one worker, the layers array is first scanned for the
+//  bounds of each layer, which only matches brackets. The layers are then
+//  decoded on worker threads into buffers of their own, and applied to the
+//  level on the calling thread in the order of the file, so the level is
+//  the same however many workers there are.
+//
+//  The result is the same as LevelModel::preload with the JsonValue of the
+//  file, except that a level with fewer than 16 layers loads instead of
+//  failing, and that objects in the object layers may only be portraits
+//  or the player, which is all the levels have.
+//
+
+#ifndef _LEVEL_PARSER_H
+#define _LEVEL_PARSER_H
+
+#include <cugl/cugl.h>
+#include <string>
+#include <vector>
+
+/** The most threads that decode the layers of one level */
+#define LEVEL_MAX_WORKERS 8
+
+class LevelModel;
+
+/**
+ * A single pass parser of a Tiled JSON level into a LevelModel.
+ */
+class LevelParser {
+  private:
+    /** The scalar fields of a layer or an object */
+    struct Fields {
+        std::string type;
+        bool hasX;
+        double x;
+        double y;
+        /** The three positions of a portrait, as x1, y1, x2, y2, x3, y3 */
+        double points[6];
+        int kind;
+        float xOffset;
+        float yOffset;
+
+        /** Forgets every field, keeping the capacity of the class */
+        void clear() {
+            type.clear();
+            hasX = false;
+            x = y = 0;
+            for (double& point : points) {
+                point = 0;
+            }
+            kind = 0;
+            xOffset = yOffset = 0;
+        }
+    };
+
+    /** A decoded layer, not yet applied to the level */
+    struct Layer {
+        Fields fields;
+        std::vector<int> tiles;
+        std::vector<float> boarder;
+        std::vector<float> points;
+        /** The end of each wall in points */
+        std::vector<size_t> walls;
+        /** The objects; only the first objectCount are of this layer */
+        std::vector<Fields> objects;
+        size_t objectCount;
+
+        /** Forgets the layer, keeping the capacity of every buffer */
+        void clear();
+    };
+
+    const char* _next;
+    const char* _end;
+    /** Whether the text stopped being valid JSON */
+    bool _failed;
+    LevelModel& _level;
+    /** The number of threads to decode the layers with */
+    size_t _workers;
+    /** The number of tiles in the map, to reserve each tile layer */
+    size_t _mapTiles;
+
+    /** The last key read; its capacity is reused */
+    std::string _key;
+    /** The layer being read when there is one worker; reused between layers */
+    Layer _layer;
+    /** The text of each layer, found before the workers start */
+    std::vector<std::pair<const char*, const char*>> _spans;
+
+    /** Skips whitespace and returns the next character, or 0 at the end */
+    char peek();
+
+    /** Consumes the next character if it is c */
+    bool accept(char c);
+
+    /** Consumes the next character, failing if it is not c */
+    bool expect(char c);
+
+    /** Reads a string; escapes are kept as written */
+    bool parseString(std::string& value);
+
+    /** Reads a number */
+    bool parseNumber(double& value);
+
+    /** Reads an integer tile ID, without going through a double */
+    bool parseTile(int& value);
+
+    /** Skips a value of any type */
+    bool skipValue();
+
+    /** Skips an array or object by matching brackets only */
+    bool skipSpan();
+
+    /**
+     * Reads the members of an object, calling field with each key in _key.
+     *
+     * @param field Reads the value of the key; false stops the parse
+     */
+    template <typename F> bool parseObject(F field);
+
+    /**
+     * Reads an array, calling item for each element.
+     *
+     * @param item  Reads the element; false stops the parse
+     */
+    template <typename F> bool parseArray(F item);
+
+    /** Reads a scalar field of a layer or object, or skips the value */
+    bool parseField(Fields& fields);
+
+    /** Reads a layer into the given buffers */
+    bool parseLayer(Layer& layer);
+
+    /**
+     * Decodes every layer in _spans on the workers, then applies them.
+     *
+     * @return false if any layer is not valid
+     */
+    bool parseSpans();
+
+    /**
+     * Applies a layer to the level.
+     *
+     * @param layer The decoded layer
+     * @param index The index of the layer in the map
+     */
+    void applyLayer(Layer& layer, size_t index);
+
+    /** Applies an object of an object layer */
+    void applyObject(const Fields& fields);
+
+    /** Adds a collision layer, scaled to world units */
+    void applyCollision(const Layer& layer);
+
+  public:
+    /**
+     * Creates a parser that adds to the given level.
+     *
+     * @param level     The level to fill
+     * @param workers   The threads to decode the layers with, or 0 for one
+     *                  per core up to LEVEL_MAX_WORKERS
+     */
+    LevelParser(LevelModel& level, size_t workers = 1);
+
+    /**
+     * Parses a Tiled JSON level into the level.
+     *
+     * @param text  The text of the file
+     * @param size  The size of the text in bytes
+     *
+     * @return false if the text is not a JSON level
+     */
+    bool parse(const char* text, size_t size);
+};
+
+#endif /* _LEVEL_PARSER_H */
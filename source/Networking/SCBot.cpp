@@ -0,0 +1,225 @@
+//
+//  SCBot.cpp
+//  Sunk Cost
+//
+//  This module provides the headless bot hunter, for load-testing the host
+//  and the lobby. See the header for details.
+//
+
+#include "SCBot.hpp"
+#include "SCClockSync.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+using namespace cugl;
+
+/** The shortest and longest legs of the random walk in frames */
+#define BOT_MIN_LEG 30
+#define BOT_MAX_LEG 120
+
+/**
+ * Returns a steady clock in microseconds, for timing the game update.
+ */
+static Uint64 micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * Returns a percentile of some samples; they are reordered.
+ *
+ * @param samples   The samples
+ * @param fraction  The percentile as a fraction in [0, 1]
+ */
+static float percentile(std::vector<float>& samples, float fraction) {
+    if (samples.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+#pragma mark -
+#pragma mark Settings
+
+/**
+ * Reads the settings from json/bot.json and the environment.
+ *
+ * @param json  The contents of json/bot.json, or nullptr
+ *
+ * @return true if this copy of the game is a bot
+ */
+bool BotConfig::set(const std::shared_ptr<JsonValue>& json) {
+    *this = BotConfig();
+    if (json != nullptr) {
+        enabled = json->getBool("enabled", enabled);
+        room = json->getString("room", room);
+        mode = json->getString("input", "random walk") == "script"
+                   ? Mode::Script
+                   : Mode::RandomWalk;
+        seed = json->getInt("seed", seed);
+        reportInterval = json->getInt("report interval", reportInterval);
+        duration = json->getInt("duration", duration);
+        std::shared_ptr<JsonValue> steps = json->get("script");
+        for (size_t i = 0; steps != nullptr && i < steps->size(); i++) {
+            std::shared_ptr<JsonValue> step = steps->get(static_cast<int>(i));
+            if (step->size() == 3) {
+                script.push_back({step->get(0)->asFloat(),
+                                  step->get(1)->asFloat(),
+                                  static_cast<Uint32>(step->get(2)->asInt())});
+            }
+        }
+    }
+
+    const char* value = std::getenv("SC_BOT");
+    if (value != nullptr) {
+        enabled = std::atoi(value) != 0;
+    }
+    value = std::getenv("SC_BOT_ROOM");
+    if (value != nullptr) {
+        room = value;
+    }
+    value = std::getenv("SC_BOT_SEED");
+    if (value != nullptr) {
+        seed = static_cast<Uint32>(std::strtoul(value, nullptr, 10));
+    }
+    if (mode == Mode::Script && script.empty()) {
+        mode = Mode::RandomWalk;
+    }
+    if (enabled) {
+        CULog("bot: room %s, %s, seed %u", room.c_str(),
+              mode == Mode::Script ? "script" : "random walk", seed);
+    }
+    return enabled;
+}
+
+#pragma mark -
+#pragma mark Input
+
+/**
+ * Starts over with the given settings.
+ *
+ * @param config    The bot settings
+ */
+void Bot::init(const BotConfig& config) {
+    _config = config;
+    _random.seed(config.seed);
+    _forward = 0;
+    _rightward = 0;
+    _held = 0;
+    _step = 0;
+    _frames.clear();
+    _updates.clear();
+    _reported = 0;
+    _start = 0;
+    _lastReport = 0;
+    _updateStart = 0;
+    _done = false;
+}
+
+/**
+ * Picks the input of the next step or walk leg.
+ */
+void Bot::nextLeg() {
+    if (_config.mode == BotConfig::Mode::Script) {
+        const BotConfig::Step& step = _config.script[_step];
+        _step = (_step + 1) % _config.script.size();
+        _forward = step.forward;
+        _rightward = step.rightward;
+        _held = std::max<Uint32>(step.frames, 1);
+        return;
+    }
+
+    // One of the eight directions, or standing still one leg in nine
+    std::uniform_int_distribution<int> direction(0, 8);
+    std::uniform_int_distribution<Uint32> length(BOT_MIN_LEG, BOT_MAX_LEG);
+    int choice = direction(_random);
+    if (choice == 8) {
+        _forward = 0;
+        _rightward = 0;
+    } else {
+        static const float DIRECTIONS[8][2] = {{1, 0},  {1, 1},   {0, 1},
+                                               {-1, 1}, {-1, 0},  {-1, -1},
+                                               {0, -1}, {1, -1}};
+        _forward = DIRECTIONS[choice][0];
+        _rightward = DIRECTIONS[choice][1];
+    }
+    _held = length(_random);
+}
+
+/**
+ * Picks this frame's input and starts timing the game update.
+ */
+void Bot::beginFrame() {
+    if (_held == 0) {
+        nextLeg();
+    }
+    _held--;
+    _updateStart = micros();
+}
+
+#pragma mark -
+#pragma mark Reports
+
+/**
+ * Records the frame and logs a report when one is due.
+ *
+ * @param timestep  The seconds since the last frame
+ * @param telemetry The telemetry of the hunter
+ */
+void Bot::endFrame(float timestep, const NetTelemetry& telemetry) {
+    Uint32 now = ClockSync::localMillis();
+    if (_frames.empty()) {
+        _start = now;
+        _lastReport = now;
+    }
+    _updates.push_back((micros() - _updateStart) / 1000.0f);
+    _frames.push_back(timestep * 1000);
+
+    if (_config.reportInterval > 0 &&
+        now - _lastReport >= _config.reportInterval * 1000) {
+        report("bot", _reported, telemetry);
+        _reported = _frames.size();
+        _lastReport = now;
+    }
+    if (_config.duration > 0 && now - _start >= _config.duration * 1000) {
+        _done = true;
+    }
+}
+
+/**
+ * Logs the frames from first on, with the telemetry summary.
+ *
+ * @param label     The name of the report
+ * @param first     The first frame to report
+ * @param telemetry The telemetry of the hunter
+ */
+void Bot::report(const char* label, size_t first,
+                 const NetTelemetry& telemetry) {
+    std::vector<float> frames(_frames.begin() + first, _frames.end());
+    std::vector<float> updates(_updates.begin() + first, _updates.end());
+    float max =
+        frames.empty() ? 0 : *std::max_element(frames.begin(), frames.end());
+    CULog("%s: %zu frames, frame p50 %.1f p99 %.1f max %.1f ms, "
+          "update p50 %.2f p99 %.2f ms, %s",
+          label, frames.size(), percentile(frames, 0.5f),
+          percentile(frames, 0.99f), max, percentile(updates, 0.5f),
+          percentile(updates, 0.99f), telemetry.getSummary().c_str());
+}
+
+/**
+ * Logs the totals of the match and dumps the telemetry.
+ *
+ * @param telemetry The telemetry of the hunter
+ */
+void Bot::finish(NetTelemetry& telemetry) {
+    report("bot total", 0, telemetry);
+    const LatencyHistogram& rtt = telemetry.getRoundTrips();
+    CULog("bot total: %.1f s, rtt mean %.1f p50 %u p99 %u max %u ms",
+          (ClockSync::localMillis() - _start) / 1000.0f, rtt.getMean(),
+          rtt.getPercentile(0.5f), rtt.getPercentile(0.99f), rtt.getMax());
+    telemetry.dump();
+}
@@ -0,0 +1,163 @@
+//
+//  SCBot.hpp
+//  Sunk Cost
+//
+//  This module provides the headless bot hunter, for load-testing the host
+//  and the lobby without a human per client.
+//
+//  A bot is the normal game with json/bot.json enabled. It skips the menus,
+//  joins its room through the ClientScene as if the code had been typed in,
+//  and drives the hunter from a random walk or a looping script instead of
+//  the input controller. Nothing is drawn. Every "report interval" seconds
+//  it logs the frame interval, the time spent in the game update and the
+//  telemetry summary of message rates and round trips, and when the match
+//  ends, or after "duration" seconds, it logs the totals, dumps the
+//  telemetry and quits.
+//
+//  To run N bots against one host, start N copies with a different seed
+//  each. The environment overrides the JSON, so one script can do it:
+//
+//      SC_BOT=1 SC_BOT_ROOM=01234 SC_BOT_SEED=$i ./SunkCost &
+//
+//  The same seed, script and host give the same inputs, which makes runs
+//  repeatable. A host takes MAX_HUNTERS hunters, so more bots need more
+//  hosts.
+//
+
+#ifndef SCBot_hpp
+#define SCBot_hpp
+
+#include "SCNetTelemetry.hpp"
+#include <cugl/cugl.h>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * The settings of a bot.
+ */
+struct BotConfig {
+    /** Where the inputs come from */
+    enum class Mode { RandomWalk, Script };
+
+    /** One step of a script */
+    struct Step {
+        float forward;
+        float rightward;
+        /** The number of frames the step is held */
+        Uint32 frames;
+    };
+
+    /** Whether this copy of the game is a bot */
+    bool enabled = false;
+    /** The room code, in decimal as the players type it */
+    std::string room;
+    Mode mode = Mode::RandomWalk;
+    /** The steps of the script, played in a loop */
+    std::vector<Step> script;
+    /** The seed of the random walk */
+    Uint32 seed = 1;
+    /** The seconds between reports, or 0 for none */
+    Uint32 reportInterval = 5;
+    /** The seconds of play before the bot quits, or 0 to play to the end */
+    Uint32 duration = 0;
+
+    /**
+     * Reads the settings from json/bot.json and the environment.
+     *
+     * SC_BOT, SC_BOT_ROOM and SC_BOT_SEED override "enabled", "room" and
+     * "seed".
+     *
+     * @param json  The contents of json/bot.json, or nullptr
+     *
+     * @return true if this copy of the game is a bot
+     */
+    bool set(const std::shared_ptr<cugl::JsonValue>& json);
+};
+
+/**
+ * The inputs and the measurements of a bot.
+ */
+class Bot {
+  private:
+    BotConfig _config;
+    std::mt19937 _random;
+
+    /** The input held this frame */
+    float _forward;
+    float _rightward;
+    /** The frames left of the current step or walk leg */
+    Uint32 _held;
+    /** The next step of the script */
+    size_t _step;
+
+    /** The frame intervals and update times of the match in milliseconds */
+    std::vector<float> _frames;
+    std::vector<float> _updates;
+    /** The frames already reported */
+    size_t _reported;
+    /** The local time the match and the last report started */
+    Uint32 _start;
+    Uint32 _lastReport;
+    /** The clock reading at the start of the update */
+    Uint64 _updateStart;
+    /** Whether the bot is out of time */
+    bool _done;
+
+    /** Picks the input of the next step or walk leg */
+    void nextLeg();
+
+    /** Logs the frames from first on, with the telemetry summary */
+    void report(const char* label, size_t first, const NetTelemetry& telemetry);
+
+  public:
+    Bot() { init(BotConfig()); }
+
+    /**
+     * Starts over with the given settings.
+     *
+     * @param config    The bot settings
+     */
+    void init(const BotConfig& config);
+
+    /** Returns true if this copy of the game is a bot */
+    bool isEnabled() const { return _config.enabled; }
+
+    /** Returns the room to join */
+    const std::string& getRoom() const { return _config.room; }
+
+    /** Returns the amount of forward movement this frame */
+    float getForward() const { return _forward; }
+
+    /** Returns the amount of rightward movement this frame */
+    float getRight() const { return _rightward; }
+
+    /**
+     * Picks this frame's input and starts timing the game update.
+     *
+     * This should be called once per frame before the game update.
+     */
+    void beginFrame();
+
+    /**
+     * Records the frame and logs a report when one is due.
+     *
+     * This should be called once per frame after the game update.
+     *
+     * @param timestep  The seconds since the last frame
+     * @param telemetry The telemetry of the hunter
+     */
+    void endFrame(float timestep, const NetTelemetry& telemetry);
+
+    /** Returns true once the bot has played its duration */
+    bool isDone() const { return _done; }
+
+    /**
+     * Logs the totals of the match and dumps the telemetry.
+     *
+     * @param telemetry The telemetry of the hunter
+     */
+    void finish(NetTelemetry& telemetry);
+};
+
+#endif /* SCBot_hpp */
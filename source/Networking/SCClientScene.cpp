@@ -6,6 +6,9 @@
 //
 
 #include "SCClientScene.hpp"
+#include "SCNetcodeTransport.hpp"
+#include "SCRelayTransport.hpp"
+#include "SCSessionResume.hpp"
 
 #include <cugl/cugl.h>
 #include <iostream>
@@ -196,6 +199,8 @@ bool ClientScene::init(const std::shared_ptr<cugl::AssetManager>& assets) {
     // Create the server configuration
     auto json = _assets->get<JsonValue>("server");
     _config.set(json);
+    _relay.set(json);
+    _conditions.set(_assets->get<JsonValue>("netsim"));
 
     addChild(scene);
     setActive(false);
@@ -324,7 +329,21 @@ void ClientScene::update(float timestep) {
  */
 bool ClientScene::connect(const std::string room) {
     // THIS IS WRONG. FIX ME
-    _network = NetcodeConnection::alloc(_config, dec2hex(room));
+    // A lost connection joins the same room again instead of ending the game
+    NetcodeConfig config = _config;
+    RelayConfig relay = _relay;
+    std::string id = dec2hex(room);
+    _network = ResumableTransport::alloc([config, relay, id] {
+        if (relay.enabled) {
+            return std::static_pointer_cast<Transport>(
+                RelayTransport::alloc(relay, id));
+        }
+        return std::static_pointer_cast<Transport>(
+            NetcodeTransport::alloc(config, id));
+    });
+    if (_conditions.enabled) {
+        _network = SimulatedTransport::alloc(_network, _conditions);
+    }
     _network->open();
     checkConnection();
     return true;
@@ -364,22 +383,22 @@ void ClientScene::processData(const std::string source,
  */
 bool ClientScene::checkConnection() {
     // IMPLEMENT ME
-    NetcodeConnection::State network_status = _network->getState();
+    Transport::State network_status = _network->getState();
     switch (network_status) {
-    case NetcodeConnection::State::NEGOTIATING:
+    case Transport::State::NEGOTIATING:
         _status = Status::JOIN;
         break;
-    case NetcodeConnection::State::CONNECTED:
+    case Transport::State::CONNECTED:
         if (_status != Status::START) {
             _status = Status::WAIT;
         }
         //            _player->setText(std::to_string(_network->getNumPlayers()));
         break;
-    case NetcodeConnection::State::DENIED:
-    case NetcodeConnection::State::MISMATCHED:
-    case NetcodeConnection::State::INVALID:
-    case NetcodeConnection::State::FAILED:
-    case NetcodeConnection::State::DISCONNECTED:
+    case Transport::State::DENIED:
+    case Transport::State::MISMATCHED:
+    case Transport::State::INVALID:
+    case Transport::State::FAILED:
+    case Transport::State::DISCONNECTED:
         disconnect();
         _status = Status::IDLE;
         return false;
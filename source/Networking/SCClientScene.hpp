@@ -8,6 +8,9 @@
 #ifndef SCClientScene_hpp
 #define SCClientScene_hpp
 
+#include "SCRelayTransport.hpp"
+#include "SCSimulatedTransport.hpp"
+#include "SCTransport.hpp"
 #include <cugl/cugl.h>
 #include <vector>
 
@@ -42,7 +45,7 @@ class ClientScene : public cugl::Scene2 {
     /** The asset manager for this scene. */
     std::shared_ptr<cugl::AssetManager> _assets;
     /** The network connection (as made by this scene) */
-    std::shared_ptr<cugl::net::NetcodeConnection> _network;
+    std::shared_ptr<Transport> _network;
 
     /** The menu button for starting a game */
     std::shared_ptr<cugl::scene2::Button> _startgame;
@@ -57,6 +60,10 @@ class ClientScene : public cugl::Scene2 {
 
     /** The network configuration */
     cugl::net::NetcodeConfig _config;
+    /** The local relay to use instead of the lobby, if enabled */
+    RelayConfig _relay;
+    /** The simulated network conditions, if enabled */
+    NetworkConditions _conditions;
 
     /** The current status */
     Status _status;
@@ -136,7 +143,7 @@ class ClientScene : public cugl::Scene2 {
      *
      * @return the network connection (as made by this scene)
      */
-    std::shared_ptr<cugl::net::NetcodeConnection> getConnection() const {
+    std::shared_ptr<Transport> getConnection() const {
         return _network;
     }
 
@@ -168,6 +175,19 @@ class ClientScene : public cugl::Scene2 {
      */
     void disconnect() { _network = nullptr; }
 
+    /**
+     * Joins a room as if its code had been typed in, for the bots.
+     *
+     * @param room  The room code in decimal
+     *
+     * @return true if the connection was successful
+     */
+    bool join(const std::string room) {
+        _code = room;
+        _codePos = static_cast<int>(room.size());
+        return connect(room);
+    }
+
   private:
     /**
      * Updates the text in the given button.
@@ -0,0 +1,109 @@
+//
+//  SCClockSync.cpp
+//  Sunk Cost
+//
+//  This module provides an NTP-style estimate of the host clock on a client.
+//  See the header for details.
+//
+
+#include "SCClockSync.hpp"
+#include <chrono>
+
+/** The replacement local clock, if any */
+static Uint32 (*timeSource)() = nullptr;
+
+/**
+ * Returns the local monotonic clock in milliseconds.
+ *
+ * The clock starts near zero when the application starts, so it fits in
+ * 32 bits for any realistic session.
+ *
+ * @return the local monotonic clock in milliseconds
+ */
+Uint32 ClockSync::localMillis() {
+    if (timeSource != nullptr) {
+        return timeSource();
+    }
+    static const auto epoch = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::now() - epoch;
+    return static_cast<Uint32>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(elapsed)
+            .count());
+}
+
+/**
+ * Replaces the local clock, or restores it if source is nullptr.
+ *
+ * @param source    The replacement clock in milliseconds
+ */
+void ClockSync::setTimeSource(Uint32 (*source)()) { timeSource = source; }
+
+/**
+ * Returns the host answer to a ping. This is all the host has to do.
+ *
+ * @param ping  The ping from the client
+ *
+ * @return the pong to send back to the pinging client
+ */
+ClockPongMessage ClockSync::answer(const ClockPingMessage& ping) {
+    return ClockPongMessage{ping.clientTime, localMillis()};
+}
+
+/**
+ * Forgets all measurements and restarts the burst
+ */
+void ClockSync::reset() {
+    _samples.fill({0, 0});
+    _count = 0;
+    _pings = 0;
+    _lastPing = 0;
+    _offset = 0;
+    _roundTrip = 0;
+}
+
+/**
+ * Advances the handshake.
+ *
+ * This returns true when a ping is due, in which case message holds the
+ * ping to send to the host.
+ *
+ * @param message   The message to send, if any
+ *
+ * @return true if message should be sent
+ */
+bool ClockSync::update(GameMessage& message) {
+    Uint32 now = localMillis();
+    Uint32 interval =
+        _pings < CLOCK_SAMPLES ? CLOCK_BURST_INTERVAL : CLOCK_RESYNC_INTERVAL;
+    if (_pings > 0 && now - _lastPing < interval) {
+        return false;
+    }
+    message = ClockPingMessage{now};
+    _lastPing = now;
+    _pings++;
+    return true;
+}
+
+/**
+ * Processes the host answer to one of our pings.
+ *
+ * @param pong  The answer from the host
+ */
+void ClockSync::receivePong(const ClockPongMessage& pong) {
+    Uint32 now = localMillis();
+    Uint32 roundTrip = now - pong.clientTime;
+    Sint64 offset = static_cast<Sint64>(pong.hostTime) + roundTrip / 2 -
+                    static_cast<Sint64>(now);
+    _samples[_count % CLOCK_SAMPLES] = {roundTrip, offset};
+    _count++;
+
+    Uint32 filled = _count < CLOCK_SAMPLES ? _count : CLOCK_SAMPLES;
+    const Sample* best = &_samples[0];
+    for (Uint32 i = 1; i < filled; i++) {
+        if (_samples[i].roundTrip < best->roundTrip) {
+            best = &_samples[i];
+        }
+    }
+    _offset = best->offset;
+    _roundTrip = best->roundTrip;
+}
@@ -0,0 +1,125 @@
+//
+//  SCClockSync.hpp
+//  Sunk Cost
+//
+//  This module provides an NTP-style estimate of the host clock on a client.
+//
+//  The client stamps a ping with its local time, the host answers with its
+//  own time, and the client estimates the offset between the two clocks as
+//  hostTime + rtt/2 - localTime. Only the sample with the smallest round
+//  trip in a short window is trusted, since queuing delay is what makes the
+//  two legs asymmetric. A short burst of pings runs at match start, then a
+//  single ping every few seconds tracks drift.
+//
+//  All times are milliseconds. The host uses its local clock as the synced
+//  clock, so match deadlines can be expressed in host time.
+//
+
+#ifndef SCClockSync_hpp
+#define SCClockSync_hpp
+
+#include "SCMessage.hpp"
+#include <array>
+#include <cugl/cugl.h>
+
+/** The number of samples kept for the minimum round trip filter */
+#define CLOCK_SAMPLES 8
+/** The milliseconds between pings during the start-up burst */
+#define CLOCK_BURST_INTERVAL 100
+/** The milliseconds between pings after the burst */
+#define CLOCK_RESYNC_INTERVAL 5000
+/** The milliseconds between repeats of an unchanged match deadline */
+#define MATCH_DEADLINE_REPEAT 5000
+
+/**
+ * The client end of the clock synchronization handshake.
+ */
+class ClockSync {
+  private:
+    /** A single ping/pong measurement */
+    struct Sample {
+        Uint32 roundTrip;
+        Sint64 offset;
+    };
+
+    /** The most recent measurements */
+    std::array<Sample, CLOCK_SAMPLES> _samples;
+    /** The number of measurements taken */
+    Uint32 _count;
+    /** The number of pings sent */
+    Uint32 _pings;
+    /** The local time of the last ping */
+    Uint32 _lastPing;
+    /** The offset of the best sample in the window */
+    Sint64 _offset;
+    /** The round trip of the best sample in the window */
+    Uint32 _roundTrip;
+
+  public:
+    ClockSync() { reset(); }
+
+    /**
+     * Returns the local monotonic clock in milliseconds.
+     *
+     * The clock starts near zero when the application starts, so it fits in
+     * 32 bits for any realistic session.
+     *
+     * @return the local monotonic clock in milliseconds
+     */
+    static Uint32 localMillis();
+
+    /**
+     * Replaces the local clock, or restores it if source is nullptr.
+     *
+     * This lets offline benchmarks run every time-based module on a
+     * simulated clock much faster than real time. Never use it in a match.
+     *
+     * @param source    The replacement clock in milliseconds
+     */
+    static void setTimeSource(Uint32 (*source)());
+
+    /**
+     * Returns the host answer to a ping. This is all the host has to do.
+     *
+     * @param ping  The ping from the client
+     *
+     * @return the pong to send back to the pinging client
+     */
+    static ClockPongMessage answer(const ClockPingMessage& ping);
+
+    /** Forgets all measurements and restarts the burst */
+    void reset();
+
+    /**
+     * Advances the handshake.
+     *
+     * This returns true when a ping is due, in which case message holds the
+     * ping to send to the host.
+     *
+     * @param message   The message to send, if any
+     *
+     * @return true if message should be sent
+     */
+    bool update(GameMessage& message);
+
+    /**
+     * Processes the host answer to one of our pings.
+     *
+     * @param pong  The answer from the host
+     */
+    void receivePong(const ClockPongMessage& pong);
+
+    /** Returns true once at least one measurement has been taken */
+    bool isSynced() const { return _count > 0; }
+
+    /** Returns the current estimate of the host clock in milliseconds */
+    Uint32 now() const { return static_cast<Uint32>(localMillis() + _offset); }
+
+    /** Returns the round trip of the sample the offset is based on */
+    Uint32 getRoundTrip() const { return _roundTrip; }
+
+    /** Returns the estimated host clock minus the local clock */
+    Sint64 getOffset() const { return _offset; }
+};
+
+#endif /* SCClockSync_hpp */
@@ -0,0 +1,183 @@
+//
+//  SCDesync.cpp
+//  Sunk Cost
+//
+//  This module provides desync detection between the host and the hunter.
+//  See the header for details.
+//
+
+#include "SCDesync.hpp"
+#include <cmath>
+#include <fstream>
+
+using namespace cugl;
+
+namespace {
+
+/** Returns a well mixed 64 bit value (the splitmix64 finalizer) */
+Uint64 mix(Uint64 value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+/** Returns the hash term of one value of one kind */
+Uint64 term(Uint64 kind, Uint64 value) { return mix((kind << 56) ^ value); }
+
+/** Returns a coordinate at the wire precision */
+Uint32 quantize(float value) {
+    return static_cast<Uint32>(std::lround(value * WIRE_COORD_SCALE));
+}
+
+} // namespace
+
+#pragma mark -
+#pragma mark Message Log
+
+/**
+ * Logs a message.
+ *
+ * @param message   The message
+ * @param sent      Whether the message was sent rather than received
+ */
+void MessageLog::record(const GameMessage& message, bool sent) {
+    _entries[_count % DESYNC_LOG_CAPACITY] = {ClockSync::localMillis(), sent,
+                                              message};
+    _count++;
+}
+
+/**
+ * Writes the logged messages as text, oldest first.
+ *
+ * @param out   The stream to write to
+ */
+void MessageLog::write(std::ostream& out) const {
+    Uint64 first = _count > DESYNC_LOG_CAPACITY ? _count - DESYNC_LOG_CAPACITY
+                                                : 0;
+    for (Uint64 i = first; i < _count; i++) {
+        const Entry& entry = _entries[i % DESYNC_LOG_CAPACITY];
+        out << entry.time << (entry.sent ? " > " : " < ")
+            << MessageCodec::describe(entry.message) << "\n";
+    }
+}
+
+#pragma mark -
+#pragma mark Detector
+
+/**
+ * Forgets every comparison and statistic
+ */
+void DesyncDetector::reset() {
+    _sentAt = 0;
+    _strikes = 0;
+    _dumps = 0;
+    _checks = 0;
+    _skipped = 0;
+    _desyncs = 0;
+}
+
+/**
+ * Returns the hash of the state both ends keep.
+ *
+ * @param snapshot  The snapshot of one end
+ *
+ * @return the hash of the shared part of the snapshot
+ */
+Uint32 DesyncDetector::hash(const MatchSnapshot& snapshot) {
+    Uint64 sum = term(1, snapshot.deadline) + term(2, snapshot.health) +
+                 term(3, snapshot.treasureCount);
+    for (int door : snapshot.lockedDoors) {
+        sum += term(4, door);
+    }
+    for (const TrapSnapshot& trap : snapshot.traps) {
+        sum += term(5, static_cast<Uint64>(quantize(trap.position.x)) << 28 ^
+                           quantize(trap.position.y));
+    }
+    return static_cast<Uint32>(mix(sum) >> 32);
+}
+
+/**
+ * Returns true when the host should send its hash.
+ *
+ * @param now   The local time in milliseconds
+ */
+bool DesyncDetector::isDue(Uint32 now) {
+    if (now - _sentAt < STATE_HASH_INTERVAL) {
+        return false;
+    }
+    _sentAt = now;
+    return true;
+}
+
+/**
+ * Compares the host hash with ours.
+ *
+ * @param host      The host hash and event counts
+ * @param sent      The number of reliable events we have sent
+ * @param received  The number of reliable events we have delivered
+ * @param hash      Our hash
+ *
+ * @return true if the ends have disagreed DESYNC_STRIKES times in a row
+ */
+bool DesyncDetector::check(const StateHashMessage& host, Uint16 sent,
+                           Uint16 received, Uint32 hash) {
+    if (host.sent != received || host.received != sent) {
+        // One end has an event the other has not applied yet
+        _skipped++;
+        _strikes = 0;
+        return false;
+    }
+    _checks++;
+    if (host.hash == hash) {
+        _strikes = 0;
+        return false;
+    }
+    if (++_strikes < DESYNC_STRIKES) {
+        return false;
+    }
+    _strikes = 0;
+    _desyncs++;
+    return true;
+}
+
+/**
+ * Writes our state and recent messages to the save directory.
+ *
+ * @param name      The file name prefix, such as "hunter" or "spirit"
+ * @param snapshot  Our state
+ * @param ours      Our hash
+ * @param theirs    The hash of the other end
+ * @param log       Our recent messages
+ *
+ * @return true if the dump was written
+ */
+bool DesyncDetector::dump(const std::string& name,
+                          const MatchSnapshot& snapshot, Uint32 ours,
+                          Uint32 theirs, const MessageLog& log) {
+    if (_dumps >= DESYNC_MAX_DUMPS) {
+        return false;
+    }
+    _dumps++;
+    std::string path = Application::get()->getSaveDirectory() + name +
+                       "-desync-" + std::to_string(_dumps) + ".txt";
+    std::ofstream out(path, std::ios::trunc);
+    out << "desync at " << ClockSync::localMillis() << " ms\n";
+    out << "hash " << ours << ", other end " << theirs << "\n";
+    out << "deadline " << snapshot.deadline << "\n";
+    out << "health " << snapshot.health << "\n";
+    out << "treasures " << snapshot.treasureCount << "\n";
+    out << "locked doors";
+    for (int door : snapshot.lockedDoors) {
+        out << " " << door;
+    }
+    out << "\ntraps";
+    for (const TrapSnapshot& trap : snapshot.traps) {
+        out << " (" << trap.position.x << ", " << trap.position.y << ")";
+    }
+    out << "\n\nrecent messages (> sent, < received)\n";
+    log.write(out);
+    CULog("Desync: wrote %s", path.c_str());
+    return out.good();
+}
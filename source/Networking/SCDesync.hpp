@@ -0,0 +1,161 @@
+//
+//  SCDesync.hpp
+//  Sunk Cost
+//
+//  This module provides desync detection between the host and the hunter.
+//
+//  Both ends keep their own copy of the locked doors, the traps, the
+//  treasure count, the hunter hearts and the match deadline. Each end
+//  hashes its copy, and once every STATE_HASH_INTERVAL the host sends its
+//  hash to the hunter together with the reliable event counts in both
+//  directions. The hunter only compares when it has applied exactly the
+//  same events as the host, so an event in flight is never mistaken for a
+//  desync; a hash that still disagrees DESYNC_STRIKES times in a row is.
+//  The hunter then tells the host, and each end writes its state and its
+//  recent messages to the save directory, where the two dumps can be
+//  paired by their hashes.
+//
+//  The hash is a sum of one term per door and per trap, so the order the
+//  ends keep them in does not matter. Trap positions are hashed at the wire
+//  precision, which is all the hunter ever learns of them. Nothing is
+//  logged or hashed beyond a ring of recent messages in normal play.
+//
+
+#ifndef SCDesync_hpp
+#define SCDesync_hpp
+
+#include "SCClockSync.hpp"
+#include "SCMatchSnapshot.hpp"
+#include "SCMessage.hpp"
+#include <array>
+#include <cugl/cugl.h>
+#include <ostream>
+#include <string>
+
+/** The milliseconds between state hashes sent by the host */
+#define STATE_HASH_INTERVAL 1000
+/** The number of hash checks in a row that must disagree */
+#define DESYNC_STRIKES 2
+/** The number of recent messages kept for a dump */
+#define DESYNC_LOG_CAPACITY 256
+/** The most dumps written in one match */
+#define DESYNC_MAX_DUMPS 3
+
+/**
+ * A ring of the most recent messages sent and received.
+ */
+class MessageLog {
+  private:
+    /** A logged message */
+    struct Entry {
+        /** The local time in milliseconds */
+        Uint32 time;
+        /** Whether the message was sent rather than received */
+        bool sent;
+        GameMessage message;
+    };
+
+    /** The entries, overwritten oldest first */
+    std::array<Entry, DESYNC_LOG_CAPACITY> _entries;
+    /** The number of messages ever logged */
+    Uint64 _count;
+
+  public:
+    MessageLog() : _count(0) {}
+
+    /** Forgets every message */
+    void reset() { _count = 0; }
+
+    /**
+     * Logs a message.
+     *
+     * @param message   The message
+     * @param sent      Whether the message was sent rather than received
+     */
+    void record(const GameMessage& message, bool sent);
+
+    /**
+     * Writes the logged messages as text, oldest first.
+     *
+     * @param out   The stream to write to
+     */
+    void write(std::ostream& out) const;
+};
+
+/**
+ * Both ends of the state hash exchange.
+ */
+class DesyncDetector {
+  private:
+    /** The local time the host last sent its hash */
+    Uint32 _sentAt;
+    /** The number of comparisons in a row that disagreed */
+    int _strikes;
+    /** The number of dumps written */
+    int _dumps;
+
+    Uint64 _checks;
+    /** The number of hashes not compared because events were in flight */
+    Uint64 _skipped;
+    Uint64 _desyncs;
+
+  public:
+    DesyncDetector() { reset(); }
+
+    /** Forgets every comparison and statistic */
+    void reset();
+
+    /**
+     * Returns the hash of the state both ends keep.
+     *
+     * @param snapshot  The snapshot of one end
+     *
+     * @return the hash of the shared part of the snapshot
+     */
+    static Uint32 hash(const MatchSnapshot& snapshot);
+
+    /**
+     * Returns true when the host should send its hash.
+     *
+     * @param now   The local time in milliseconds
+     */
+    bool isDue(Uint32 now);
+
+    /**
+     * Compares the host hash with ours.
+     *
+     * @param host      The host hash and event counts
+     * @param sent      The number of reliable events we have sent
+     * @param received  The number of reliable events we have delivered
+     * @param hash      Our hash
+     *
+     * @return true if the ends have disagreed DESYNC_STRIKES times in a row
+     */
+    bool check(const StateHashMessage& host, Uint16 sent, Uint16 received,
+               Uint32 hash);
+
+    /**
+     * Writes our state and recent messages to the save directory.
+     *
+     * Each end writes <name>-desync-<n>.txt, at most DESYNC_MAX_DUMPS times
+     * in a match.
+     *
+     * @param name      The file name prefix, such as "hunter" or "spirit"
+     * @param snapshot  Our state
+     * @param ours      Our hash
+     * @param theirs    The hash of the other end
+     * @param log       Our recent messages
+     *
+     * @return true if the dump was written
+     */
+    bool dump(const std::string& name, const MatchSnapshot& snapshot,
+              Uint32 ours, Uint32 theirs, const MessageLog& log);
+
+    Uint64 getChecks() const { return _checks; }
+
+    Uint64 getSkipped() const { return _skipped; }
+
+    Uint64 getDesyncs() const { return _desyncs; }
+};
+
+#endif /* SCDesync_hpp */
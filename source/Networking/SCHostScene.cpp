@@ -6,6 +6,8 @@
 //
 
 #include "SCHostScene.hpp"
+#include "SCNetcodeTransport.hpp"
+#include "SCRelayTransport.hpp"
 
 #include <cugl/cugl.h>
 #include <iostream>
@@ -122,6 +124,8 @@ bool HostScene::init(const std::shared_ptr<cugl::AssetManager>& assets) {
     // Create the server configuration
     auto json = _assets->get<JsonValue>("server");
     _config.set(json);
+    _relay.set(json);
+    _conditions.set(_assets->get<JsonValue>("netsim"));
 
     connect();
 
@@ -240,7 +244,14 @@ void HostScene::processData(const std::string source,
  */
 bool HostScene::connect() {
     // IMPLEMENT ME
-    _network = NetcodeConnection::alloc(_config);
+    if (_relay.enabled) {
+        _network = RelayTransport::alloc(_relay);
+    } else {
+        _network = NetcodeTransport::alloc(_config);
+    }
+    if (_conditions.enabled) {
+        _network = SimulatedTransport::alloc(_network, _conditions);
+    }
     _network->open();
     checkConnection();
     return true;
@@ -257,15 +268,15 @@ bool HostScene::connect() {
  */
 bool HostScene::checkConnection() {
     // IMPLEMENT ME
-    NetcodeConnection::State network_state = _network->getState();
+    Transport::State network_state = _network->getState();
     switch (network_state) {
-    case NetcodeConnection::State::CONNECTING:
-    case NetcodeConnection::State::MIGRATING:
-    case NetcodeConnection::State::NEGOTIATING:
+    case Transport::State::CONNECTING:
+    case Transport::State::MIGRATING:
+    case Transport::State::NEGOTIATING:
         _status = Status::WAIT;
         break;
-    case NetcodeConnection::State::INSESSION:
-    case NetcodeConnection::State::CONNECTED:
+    case Transport::State::INSESSION:
+    case Transport::State::CONNECTED:
         if (_status != Status::START) {
             _status = Status::IDLE;
         }
@@ -278,12 +289,12 @@ bool HostScene::checkConnection() {
             displayCode(hex2dec(_network->getRoom()));
         }
         break;
-    case NetcodeConnection::State::DENIED:
-    case NetcodeConnection::State::MISMATCHED:
-    case NetcodeConnection::State::INVALID:
-    case NetcodeConnection::State::FAILED:
-    case NetcodeConnection::State::DISPOSED:
-    case NetcodeConnection::State::DISCONNECTED:
+    case Transport::State::DENIED:
+    case Transport::State::MISMATCHED:
+    case Transport::State::INVALID:
+    case Transport::State::FAILED:
+    case Transport::State::DISPOSED:
+    case Transport::State::DISCONNECTED:
         disconnect();
         _status = Status::WAIT;
         return false;
@@ -8,6 +8,9 @@
 #ifndef SCHostScene_hpp
 #define SCHostScene_hpp
 
+#include "SCRelayTransport.hpp"
+#include "SCSimulatedTransport.hpp"
+#include "SCTransport.hpp"
 #include <cugl/cugl.h>
 #include <vector>
 
@@ -40,7 +43,7 @@ class HostScene : public cugl::Scene2 {
     /** The asset manager for this scene. */
     std::shared_ptr<cugl::AssetManager> _assets;
     /** The network connection (as made by this scene) */
-    std::shared_ptr<cugl::net::NetcodeConnection> _network;
+    std::shared_ptr<Transport> _network;
 
     /** The menu button for starting a game */
     std::shared_ptr<cugl::scene2::Button> _startgame;
@@ -55,6 +58,10 @@ class HostScene : public cugl::Scene2 {
 
     /** The network configuration */
     cugl::net::NetcodeConfig _config;
+    /** The local relay to use instead of the lobby, if enabled */
+    RelayConfig _relay;
+    /** The simulated network conditions, if enabled */
+    NetworkConditions _conditions;
 
     /** The current status */
     Status _status;
@@ -127,7 +134,7 @@ class HostScene : public cugl::Scene2 {
      *
      * @return the network connection (as made by this scene)
      */
-    std::shared_ptr<cugl::net::NetcodeConnection> getConnection() const {
+    std::shared_ptr<Transport> getConnection() const {
         return _network;
     }
 
@@ -0,0 +1,290 @@
+//
+//  SCHunterRoster.cpp
+//  Sunk Cost
+//
+//  This module provides the hunters of a match with up to MAX_HUNTERS of
+//  them against the spirit. See the header for details.
+//
+
+#include "SCHunterRoster.hpp"
+#include <algorithm>
+
+using namespace cugl;
+
+#pragma mark -
+#pragma mark Roster
+
+/**
+ * Forgets every hunter.
+ *
+ * @param expected  The number of hunters in the room
+ */
+void HunterRoster::reset(int expected) {
+    for (HunterLink& link : _links) {
+        link.uuid.clear();
+        link.reliable.init(Outbox::Route::Peer);
+        link.stream.reset();
+        link.buffer.reset();
+        link.history.reset();
+        link.authority.reset();
+        link.stateHeld = false;
+        link.seen = 0;
+        link.shown = false;
+        link.position = Vec2::ZERO;
+    }
+    _size = 0;
+    _expected = std::min(expected, MAX_HUNTERS);
+    _backlog.clear();
+    _refused.clear();
+}
+
+/**
+ * Reports the round trips of every channel to the given telemetry.
+ *
+ * @param telemetry The telemetry, or nullptr to stop reporting
+ */
+void HunterRoster::setTelemetry(NetTelemetry* telemetry) {
+    for (HunterLink& link : _links) {
+        link.reliable.setTelemetry(telemetry);
+    }
+}
+
+/**
+ * Returns the player with this connection, or -1 if there is none.
+ *
+ * @param uuid  The connection UUID
+ */
+int HunterRoster::find(const std::string& uuid) const {
+    for (int player = 0; player < _size; player++) {
+        if (!uuid.empty() && _links[player].uuid == uuid) {
+            return player;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Gives a new hunter the next player number.
+ *
+ * @param uuid      The connection UUID
+ * @param outbox    The outbox for the events
+ *
+ * @return the player number, or -1 if the match is full
+ */
+int HunterRoster::join(const std::string& uuid, Outbox& outbox) {
+    if (_size >= MAX_HUNTERS ||
+        std::find(_refused.begin(), _refused.end(), uuid) != _refused.end()) {
+        return -1;
+    }
+    int player = _size++;
+    HunterLink& link = _links[player];
+    link.uuid = uuid;
+    link.reliable.init(Outbox::Route::Peer, uuid);
+    CULog("Hunter %s is player %d", uuid.c_str(), player);
+
+    link.reliable.send(PlayerAssignMessage{static_cast<Uint8>(player)},
+                       outbox);
+    for (const GameMessage& message : _backlog) {
+        link.reliable.send(message, outbox);
+    }
+    if (_size >= _expected) {
+        _backlog.clear();
+    }
+    return player;
+}
+
+/**
+ * Moves a player to the new connection of a hunter that rejoined.
+ *
+ * @param player    The player number the hunter was given before
+ * @param uuid      The new connection UUID
+ *
+ * @return false if the player was never given out
+ */
+bool HunterRoster::rejoin(int player, const std::string& uuid) {
+    if (player < 0 || player >= _size) {
+        return false;
+    }
+    HunterLink& link = _links[player];
+    CULog("Player %d rejoined as %s", player, uuid.c_str());
+    link.uuid = uuid;
+    link.reliable.init(Outbox::Route::Peer, uuid);
+    link.stream.reset();
+    link.authority.resume();
+    link.stateHeld = false;
+    return true;
+}
+
+/**
+ * Frees the player of a hunter that did not come back.
+ *
+ * @param player    The player number
+ *
+ * @return false if the player is already free
+ */
+bool HunterRoster::leave(int player) {
+    if (player < 0 || player >= _size || _links[player].uuid.empty()) {
+        return false;
+    }
+    HunterLink& link = _links[player];
+    CULog("Player %d left the match", player);
+    refuse(link.uuid);
+    link.uuid.clear();
+    link.reliable.init(Outbox::Route::Peer);
+    link.stream.reset();
+    link.stateHeld = false;
+    link.shown = false;
+    return true;
+}
+
+/**
+ * Never gives a player number to this connection.
+ *
+ * @param uuid  The connection UUID
+ */
+void HunterRoster::refuse(const std::string& uuid) {
+    if (std::find(_refused.begin(), _refused.end(), uuid) == _refused.end()) {
+        _refused.push_back(uuid);
+    }
+}
+
+/**
+ * Queues an event for reliable delivery to every hunter.
+ *
+ * @param message   The event to send
+ * @param outbox    The outbox for the events
+ * @param except    A player not to send it to, or -1
+ */
+void HunterRoster::send(const GameMessage& message, Outbox& outbox,
+                        int except) {
+    for (int player = 0; player < _size; player++) {
+        if (player != except && !_links[player].uuid.empty()) {
+            _links[player].reliable.send(message, outbox);
+        }
+    }
+    if (_size < _expected) {
+        _backlog.push_back(message);
+    }
+}
+
+/**
+ * Updates every reliable channel; called once per frame.
+ *
+ * @param outbox    The outbox for the events
+ */
+void HunterRoster::update(Outbox& outbox) {
+    for (int player = 0; player < _size; player++) {
+        if (!_links[player].uuid.empty()) {
+            _links[player].reliable.update(outbox);
+        }
+    }
+}
+
+#pragma mark -
+#pragma mark Relay
+
+/**
+ * Forgets every position.
+ */
+void PeerRelay::reset() {
+    for (Peer& peer : _peers) {
+        peer = {false, 0, 0, Vec2::ZERO};
+    }
+    _sentAt = 0;
+    _relayed = 0;
+}
+
+/**
+ * Records the position of a hunter.
+ *
+ * @param player    The player number
+ * @param time      The stamp of the hunter, in the synced clock
+ * @param position  The position
+ */
+void PeerRelay::record(int player, Uint16 time, Vec2 position) {
+    Peer& peer = _peers[player];
+    if (peer.position != position) {
+        peer.moved = true;
+    }
+    peer.time = time;
+    peer.position = position;
+}
+
+/**
+ * Relays the hunters that moved, once every PEER_STATE_INTERVAL, or once
+ * every PEER_HIDDEN_INTERVAL for hunters the spirit cannot see.
+ *
+ * @param now       The local time in milliseconds
+ * @param send      Called with a PeerState for every hunter that moved
+ * @param hidden    Returns true for a player the spirit cannot see, or
+ *                  nullptr if every hunter is relayed at the full rate
+ */
+void PeerRelay::update(Uint32 now,
+                       const std::function<void(const GameMessage&)>& send,
+                       const std::function<bool(int)>& hidden) {
+    if (now - _sentAt < PEER_STATE_INTERVAL) {
+        return;
+    }
+    _sentAt = now;
+    for (int player = 0; player < MAX_HUNTERS; player++) {
+        Peer& peer = _peers[player];
+        if (!peer.moved) {
+            continue;
+        }
+        // A hidden hunter keeps its newest position for the next heartbeat
+        if (hidden != nullptr && hidden(player) &&
+            now - peer.sentAt < PEER_HIDDEN_INTERVAL) {
+            continue;
+        }
+        peer.moved = false;
+        peer.sentAt = now;
+        send(PeerStateMessage{static_cast<Uint8>(player), peer.time,
+                              peer.position.x, peer.position.y});
+        _relayed++;
+    }
+}
+
+#pragma mark -
+#pragma mark View
+
+/**
+ * Forgets every other hunter and our player number.
+ */
+void PeerView::reset() {
+    for (JitterBuffer& buffer : _buffers) {
+        buffer.reset();
+    }
+    _known.fill(false);
+    _player = -1;
+}
+
+/**
+ * Adds the relayed position of a hunter; our own is ignored.
+ *
+ * @param state The relayed position
+ * @param now   The local time in milliseconds
+ */
+void PeerView::receive(const PeerStateMessage& state, Uint32 now) {
+    if (state.player >= MAX_HUNTERS || state.player == _player) {
+        return;
+    }
+    _buffers[state.player].push(state.time, Vec2(state.x, state.y), now);
+    _known[state.player] = true;
+}
+
+/**
+ * Returns where another hunter should be shown now.
+ *
+ * @param player    The player number
+ * @param now       The local time in milliseconds
+ * @param position  Set to the position if this returns true
+ *
+ * @return false for us and for hunters not heard of yet
+ */
+bool PeerView::sample(int player, Uint32 now, Vec2& position) {
+    if (player < 0 || player >= MAX_HUNTERS || player == _player ||
+        !_known[player]) {
+        return false;
+    }
+    return _buffers[player].sample(now, position);
+}
@@ -0,0 +1,294 @@
+//
+//  SCHunterRoster.hpp
+//  Sunk Cost
+//
+//  This module provides the hunters of a match with up to MAX_HUNTERS of
+//  them against the spirit.
+//
+//  The host gives every hunter a player number, in the order they are
+//  first heard from, and tells the hunter with a PlayerAssign event. A
+//  hunter is known by its connection UUID, so messages from a hunter carry
+//  no player number; the host looks the sender up in its HunterRoster, which
+//  also keeps everything the host has per hunter: the reliable channel, the
+//  position stream and its playout buffer, the position history for hit
+//  tests and the input authority. Messages from the host that are about
+//  one hunter carry its player number.
+//
+//  Events for every hunter are sent once per hunter on its own channel.
+//  Until every hunter has been heard from, they are also kept in a backlog
+//  that is replayed to a hunter when it joins, so a hunter that is slow to
+//  say hello misses nothing.
+//
+//  The host relays the newest position of every hunter to the hunters with a
+//  PeerRelay, once every PEER_STATE_INTERVAL and only for hunters that
+//  moved. The relay is broadcast, so each hunter also gets its own state
+//  back; that costs one small message per tick and keeps a single packet for
+//  all the hunters. A hunter the spirit cannot see is relayed only once
+//  every PEER_HIDDEN_INTERVAL. A hunter plays the others out through a
+//  PeerView, one jitter buffer per player. Everything here is linear in the
+//  number of hunters, on the host and on every hunter.
+//
+
+#ifndef SCHunterRoster_hpp
+#define SCHunterRoster_hpp
+
+#include "SCJitterBuffer.hpp"
+#include "SCMessage.hpp"
+#include "SCOutbox.hpp"
+#include "SCPositionHistory.hpp"
+#include "SCPositionStream.hpp"
+#include "SCPrediction.hpp"
+#include "SCReliableChannel.hpp"
+#include <array>
+#include <cugl/cugl.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+/** The most hunters in a match */
+#define MAX_HUNTERS 3
+/** The milliseconds between relays of the hunter positions */
+#define PEER_STATE_INTERVAL 50
+/**
+ * The milliseconds between relays and authoritative states of a hunter the
+ * spirit cannot see, about one every POSITION_HIDDEN_INTERVAL frames
+ */
+#define PEER_HIDDEN_INTERVAL 500
+
+/**
+ * Everything the host keeps for one hunter.
+ */
+struct HunterLink {
+    /** The connection UUID, or empty while the player is free */
+    std::string uuid;
+    /** The reliable ordered channel for game events with the hunter */
+    ReliableChannel reliable;
+    /** The replication channel for the hunter position */
+    PositionReceiver stream;
+    /** The playout buffer that smooths the hunter position */
+    JitterBuffer buffer;
+    /** The recent hunter positions, for lag-compensated hit tests */
+    PositionHistory history;
+    /** The hunter inputs, applied and checked by the host */
+    InputAuthority authority;
+    /** The newest HunterState for the hunter, while it waits to be sent */
+    GameMessage state;
+    /** Whether state has not been sent yet */
+    bool stateHeld;
+    /** The hunter time shown on screen, from the last buffer sample */
+    Sint64 seen;
+    /** Whether the hunter is shown on screen */
+    bool shown;
+    /** The hunter position shown on screen */
+    cugl::Vec2 position;
+};
+
+/**
+ * The hunters of a match, as the host knows them.
+ */
+class HunterRoster {
+  private:
+    /** The hunters, by player number */
+    std::array<HunterLink, MAX_HUNTERS> _links;
+    /** The number of hunters heard from */
+    int _size;
+    /** The number of hunters in the room when the match started */
+    int _expected;
+    /** The events for every hunter, kept until every hunter has joined */
+    std::vector<GameMessage> _backlog;
+    /** The connections of hunters that gave up their place */
+    std::vector<std::string> _refused;
+
+  public:
+    HunterRoster() { reset(0); }
+
+    /**
+     * Forgets every hunter.
+     *
+     * @param expected  The number of hunters in the room
+     */
+    void reset(int expected);
+
+    /**
+     * Reports the round trips of every channel to the given telemetry.
+     *
+     * @param telemetry The telemetry, or nullptr to stop reporting
+     */
+    void setTelemetry(NetTelemetry* telemetry);
+
+    /**
+     * Returns the player with this connection, or -1 if there is none.
+     *
+     * @param uuid  The connection UUID
+     */
+    int find(const std::string& uuid) const;
+
+    /**
+     * Gives a new hunter the next player number.
+     *
+     * The hunter is sent its player number and every event in the backlog.
+     *
+     * @param uuid      The connection UUID
+     * @param outbox    The outbox for the events
+     *
+     * @return the player number, or -1 if the match is full or the
+     * connection is refused
+     */
+    int join(const std::string& uuid, Outbox& outbox);
+
+    /**
+     * Moves a player to the new connection of a hunter that rejoined.
+     *
+     * Every channel of the player starts over, since the hunter starts over
+     * on its end too.
+     *
+     * @param player    The player number the hunter was given before
+     * @param uuid      The new connection UUID
+     *
+     * @return false if the player was never given out
+     */
+    bool rejoin(int player, const std::string& uuid);
+
+    /**
+     * Frees the player of a hunter that did not come back.
+     *
+     * The player number is not given out again, and the hunter is sent
+     * nothing more; its connection is refused.
+     *
+     * @param player    The player number
+     *
+     * @return false if the player is already free
+     */
+    bool leave(int player);
+
+    /**
+     * Never gives a player number to this connection.
+     *
+     * @param uuid  The connection UUID
+     */
+    void refuse(const std::string& uuid);
+
+    /** Returns the number of hunters heard from */
+    int size() const { return _size; }
+
+    /** Returns the hunter with this player number */
+    HunterLink& get(int player) { return _links[player]; }
+
+    /** Returns the hunter with this player number */
+    const HunterLink& get(int player) const { return _links[player]; }
+
+    /**
+     * Queues an event for reliable delivery to every hunter.
+     *
+     * @param message   The event to send
+     * @param outbox    The outbox for the events
+     * @param except    A player not to send it to, or -1
+     */
+    void send(const GameMessage& message, Outbox& outbox, int except = -1);
+
+    /**
+     * Updates every reliable channel; called once per frame.
+     *
+     * @param outbox    The outbox for the events
+     */
+    void update(Outbox& outbox);
+};
+
+/**
+ * The relay of the hunter positions on the host.
+ */
+class PeerRelay {
+  private:
+    /** The newest position of a hunter */
+    struct Peer {
+        /** Whether the hunter moved since the last relay */
+        bool moved;
+        /** The local time of the last relay of the hunter */
+        Uint32 sentAt;
+        /** The stamp of the hunter, in the synced clock */
+        Uint16 time;
+        cugl::Vec2 position;
+    };
+
+    std::array<Peer, MAX_HUNTERS> _peers;
+    /** The local time of the last relay */
+    Uint32 _sentAt;
+    /** The number of PeerState messages sent */
+    Uint64 _relayed;
+
+  public:
+    PeerRelay() { reset(); }
+
+    /** Forgets every position */
+    void reset();
+
+    /**
+     * Records the position of a hunter.
+     *
+     * @param player    The player number
+     * @param time      The stamp of the hunter, in the synced clock
+     * @param position  The position
+     */
+    void record(int player, Uint16 time, cugl::Vec2 position);
+
+    /**
+     * Relays the hunters that moved, once every PEER_STATE_INTERVAL, or
+     * once every PEER_HIDDEN_INTERVAL for hunters the spirit cannot see.
+     *
+     * @param now       The local time in milliseconds
+     * @param send      Called with a PeerState for every hunter that moved
+     * @param hidden    Returns true for a player the spirit cannot see, or
+     *                  nullptr if every hunter is relayed at the full rate
+     */
+    void update(Uint32 now,
+                const std::function<void(const GameMessage&)>& send,
+                const std::function<bool(int)>& hidden = nullptr);
+
+    Uint64 getRelayed() const { return _relayed; }
+};
+
+/**
+ * The other hunters, as a hunter sees them.
+ */
+class PeerView {
+  private:
+    /** The playout buffers, by player number */
+    std::array<JitterBuffer, MAX_HUNTERS> _buffers;
+    /** Whether each player has been heard of */
+    std::array<bool, MAX_HUNTERS> _known;
+    /** Our player number, or -1 until the host assigns it */
+    int _player;
+
+  public:
+    PeerView() { reset(); }
+
+    /** Forgets every other hunter and our player number */
+    void reset();
+
+    /** Sets the player number the host assigned us */
+    void setPlayer(int player) { _player = player; }
+
+    /** Returns our player number, or -1 until the host assigns it */
+    int getPlayer() const { return _player; }
+
+    /**
+     * Adds the relayed position of a hunter; our own is ignored.
+     *
+     * @param state The relayed position
+     * @param now   The local time in milliseconds
+     */
+    void receive(const PeerStateMessage& state, Uint32 now);
+
+    /**
+     * Returns where another hunter should be shown now.
+     *
+     * @param player    The player number
+     * @param now       The local time in milliseconds
+     * @param position  Set to the position if this returns true
+     *
+     * @return false for us and for hunters not heard of yet
+     */
+    bool sample(int player, Uint32 now, cugl::Vec2& position);
+};
+
+#endif /* SCHunterRoster_hpp */
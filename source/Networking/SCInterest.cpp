@@ -0,0 +1,80 @@
+//
+//  SCInterest.cpp
+//  Sunk Cost
+//
+//  This module provides interest management for the hunter positions. See
+//  the header for details.
+//
+
+#include "SCInterest.hpp"
+
+using namespace cugl;
+
+/**
+ * Forgets the views, the camera and what every hunter was told.
+ */
+void InterestManager::reset() {
+    _views.clear();
+    _camera = -1;
+    _told.fill(-1);
+    _stateAt.fill(0);
+    _visibleFrames = 0;
+    _hiddenFrames = 0;
+}
+
+/**
+ * Returns true if the spirit can see, or is about to see, a position.
+ *
+ * @param position  The position in world coordinates
+ */
+bool InterestManager::isVisible(Vec2 position) const {
+    if (_camera < 0 || _camera >= static_cast<int>(_views.size())) {
+        return false;
+    }
+    const Rect& view = _views[_camera];
+    if (view.size.width <= 0 || view.size.height <= 0) {
+        return false;
+    }
+    return position.x >= view.getMinX() - INTEREST_MARGIN &&
+           position.x <= view.getMaxX() + INTEREST_MARGIN &&
+           position.y >= view.getMinY() - INTEREST_MARGIN &&
+           position.y <= view.getMaxY() + INTEREST_MARGIN;
+}
+
+/**
+ * Returns true if a state about a hunter should be sent now.
+ *
+ * @param player    The player number
+ * @param now       The local time in milliseconds
+ */
+bool InterestManager::isDue(int player, Uint32 now) {
+    if (isHidden(player) && now - _stateAt[player] < PEER_HIDDEN_INTERVAL) {
+        return false;
+    }
+    _stateAt[player] = now;
+    return true;
+}
+
+/**
+ * Works out whether the spirit can see a hunter.
+ *
+ * @param player    The player number
+ * @param position  The newest position of the hunter
+ * @param visible   Set to the new visibility if this returns true
+ *
+ * @return true if the hunter should be told its new visibility
+ */
+bool InterestManager::update(int player, Vec2 position, bool& visible) {
+    bool seen = isVisible(position);
+    if (seen) {
+        _visibleFrames++;
+    } else {
+        _hiddenFrames++;
+    }
+    if (_told[player] == (seen ? 1 : 0)) {
+        return false;
+    }
+    _told[player] = seen ? 1 : 0;
+    visible = seen;
+    return true;
+}
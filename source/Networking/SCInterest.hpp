@@ -0,0 +1,133 @@
+//
+//  SCInterest.hpp
+//  Sunk Cost
+//
+//  This module provides interest management for the hunter positions.
+//
+//  The spirit only sees the hunters through the active portrait, so the
+//  host works out for every hunter whether it is inside the view of that
+//  portrait and tells the hunter with an Interest event when that changes.
+//  A hunter the spirit can see streams its position at the full rate; a
+//  hidden one drops to a heartbeat of one position every
+//  POSITION_HIDDEN_INTERVAL frames. That saves most of the position
+//  traffic, and a modified spirit learns little about hunters it is not
+//  looking at.
+//
+//  The host only knows where a hidden hunter is from its heartbeats, so the
+//  view is widened by INTEREST_MARGIN: a hunter walking into the view is
+//  back at the full rate before the spirit can see it. The views come from
+//  the portrait list of the level, one rectangle per portrait; portrait 0
+//  is the default camera, which shows nothing.
+//
+//  The host gates its own sends the same way. The PeerRelay relays a
+//  hidden hunter to the others, and the authoritative HunterState goes
+//  back to a hidden hunter, only once every PEER_HIDDEN_INTERVAL. Under
+//  authoritative movement the hunters send inputs rather than positions,
+//  so those host sends are where the saving comes from.
+//
+
+#ifndef SCInterest_hpp
+#define SCInterest_hpp
+
+#include "SCHunterRoster.hpp"
+#include <array>
+#include <cugl/cugl.h>
+#include <vector>
+
+/**
+ * The world units the portrait views are widened by on every side. A
+ * hidden hunter walks about this far between two heartbeats and the round
+ * trip of the Interest event.
+ */
+#define INTEREST_MARGIN 320.0f
+
+/**
+ * The visibility of every hunter to the spirit, as the host works it out.
+ */
+class InterestManager {
+  private:
+    /** The view of every portrait in world coordinates, by portrait index */
+    std::vector<cugl::Rect> _views;
+    /** The portrait the spirit looks through, or -1 for none */
+    int _camera;
+    /** The visibility last told to each hunter: -1 unknown, 0 or 1 */
+    std::array<int, MAX_HUNTERS> _told;
+    /** The local time of the last state sent about each hunter */
+    std::array<Uint32, MAX_HUNTERS> _stateAt;
+    /** The number of hunter frames seen and hidden, for the logs */
+    Uint64 _visibleFrames;
+    Uint64 _hiddenFrames;
+
+  public:
+    InterestManager() { reset(); }
+
+    /** Forgets the views, the camera and what every hunter was told */
+    void reset();
+
+    /**
+     * Sets the view of every portrait, by portrait index.
+     *
+     * @param views The views in world coordinates
+     */
+    void setViews(const std::vector<cugl::Rect>& views) { _views = views; }
+
+    /**
+     * Sets the portrait the spirit looks through.
+     *
+     * @param camera    The portrait index, or -1 for none
+     */
+    void setCamera(int camera) { _camera = camera; }
+
+    /**
+     * Returns true if the spirit can see, or is about to see, a position.
+     *
+     * @param position  The position in world coordinates
+     */
+    bool isVisible(cugl::Vec2 position) const;
+
+    /**
+     * Works out whether the spirit can see a hunter; called once per frame
+     * for every hunter shown.
+     *
+     * @param player    The player number
+     * @param position  The newest position of the hunter
+     * @param visible   Set to the new visibility if this returns true
+     *
+     * @return true if the hunter should be told its new visibility
+     */
+    bool update(int player, cugl::Vec2 position, bool& visible);
+
+    /**
+     * Forgets what a hunter was told, so that it is told again. The hunter
+     * streams at the full rate until then.
+     *
+     * @param player    The player number
+     */
+    void forget(int player) { _told[player] = -1; }
+
+    /**
+     * Returns true if a hunter was told the spirit cannot see it. A hunter
+     * not told anything yet counts as seen.
+     *
+     * @param player    The player number
+     */
+    bool isHidden(int player) const { return _told[player] == 0; }
+
+    /**
+     * Returns true if a state about a hunter should be sent now: every time
+     * while the spirit can see it, otherwise once every PEER_HIDDEN_INTERVAL.
+     * A true answer counts as a send.
+     *
+     * @param player    The player number
+     * @param now       The local time in milliseconds
+     */
+    bool isDue(int player, Uint32 now);
+
+    /** Returns the share of hunter frames the spirit could see */
+    float getVisibleShare() const {
+        Uint64 frames = _visibleFrames + _hiddenFrames;
+        return frames == 0 ? 0 : static_cast<float>(_visibleFrames) / frames;
+    }
+};
+
+#endif /* SCInterest_hpp */
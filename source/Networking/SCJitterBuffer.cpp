@@ -0,0 +1,169 @@
+//
+//  SCJitterBuffer.cpp
+//  Sunk Cost
+//
+//  This module provides the playout buffer for a remote position stream.
+//  See the header for details.
+//
+
+#include "SCJitterBuffer.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace cugl;
+
+/**
+ * Drops every sample and statistic, keeping the render delay
+ */
+void JitterBuffer::reset() {
+    _count = 0;
+    _previous = {0, Vec2::ZERO};
+    _hasPrevious = false;
+    _newest = 0;
+    _renderTime = 0;
+    _started = false;
+    _transits.fill(0);
+    _transitCount = 0;
+    _minTransit = 0;
+    _jitter = 0;
+    _delay = _minDelay;
+    _received = 0;
+    _late = 0;
+    _extrapolated = 0;
+}
+
+/**
+ * Inserts a sample in time order, replacing one with the same time
+ */
+void JitterBuffer::insert(const Sample& sample) {
+    size_t i = _count;
+    while (i > 0 && _samples[i - 1].time > sample.time) {
+        i--;
+    }
+    if (i > 0 && _samples[i - 1].time == sample.time) {
+        _samples[i - 1] = sample;
+        return;
+    }
+    if (_count == JITTER_CAPACITY) {
+        if (i == 0) {
+            return;
+        }
+        // Drop the oldest sample to make room
+        std::move(_samples.begin() + 1, _samples.begin() + i,
+                  _samples.begin());
+        i--;
+        _count--;
+    }
+    std::move_backward(_samples.begin() + i, _samples.begin() + _count,
+                       _samples.begin() + _count + 1);
+    _samples[i] = sample;
+    _count++;
+}
+
+/**
+ * Adds a sample from the network.
+ *
+ * @param time      The low 16 bits of the sender synced clock
+ * @param position  The sampled position
+ * @param now       The local synced clock in milliseconds
+ */
+void JitterBuffer::push(Uint16 time, Vec2 position, Uint32 now) {
+    // Unwrap against the newest sample, or the local clock for the first
+    Sint64 reference = _started ? _newest : static_cast<Sint64>(now);
+    Sint64 full =
+        reference + static_cast<Sint16>(static_cast<Uint16>(time - reference));
+    _received++;
+
+    Sint64 transit = static_cast<Sint64>(now) - full;
+    if (_transitCount > 0) {
+        Sint64 last = _transits[(_transitCount - 1) % JITTER_WINDOW];
+        _jitter += (std::abs(transit - last) - _jitter) / 16.0f;
+    }
+    _transits[_transitCount % JITTER_WINDOW] = transit;
+    _transitCount++;
+    Uint32 filled = std::min<Uint32>(_transitCount, JITTER_WINDOW);
+    _minTransit = *std::min_element(_transits.begin(),
+                                    _transits.begin() + filled);
+
+    if (_started && full <= _renderTime) {
+        _late++;
+        return;
+    }
+    if (!_started || full > _newest) {
+        _newest = full;
+    }
+    if (!_started) {
+        // Start rendering at the first sample instead of in the past
+        _renderTime = full - 1;
+        _started = true;
+    }
+    insert({full, position});
+}
+
+/**
+ * Returns the position to render this frame.
+ *
+ * This must be called once per frame.
+ *
+ * @param now       The local synced clock in milliseconds
+ * @param position  Set to the position to render if this returns true
+ *
+ * @return false if no sample has been received yet
+ */
+bool JitterBuffer::sample(Uint32 now, Vec2& position) {
+    if (_count == 0) {
+        return false;
+    }
+
+    float target = std::max(_minDelay, JITTER_DEVIATIONS * _jitter);
+    target = std::min(target, JITTER_MAX_DELAY);
+    _delay += std::max(-JITTER_SLEW, std::min(JITTER_SLEW, target - _delay));
+
+    Sint64 render = static_cast<Sint64>(now) - _minTransit -
+                    static_cast<Sint64>(_delay);
+    _renderTime = std::max(_renderTime, render);
+
+    // Keep one sample at or before the render time for interpolation
+    size_t drop = 0;
+    while (drop + 1 < _count && _samples[drop + 1].time <= _renderTime) {
+        drop++;
+    }
+    if (drop > 0) {
+        _previous = _samples[drop - 1];
+        _hasPrevious = true;
+        std::move(_samples.begin() + drop, _samples.begin() + _count,
+                  _samples.begin());
+        _count -= drop;
+    }
+
+    const Sample& first = _samples[0];
+    if (_renderTime <= first.time) {
+        position = first.position;
+    } else if (_count >= 2) {
+        const Sample& next = _samples[1];
+        float t = (float)(_renderTime - first.time) / (next.time - first.time);
+        position = first.position + (next.position - first.position) * t;
+    } else if (_hasPrevious && _previous.time < first.time) {
+        // Out of samples; continue the last motion for a bounded time
+        Sint64 ahead = std::min<Sint64>(_renderTime - first.time,
+                                        JITTER_MAX_EXTRAPOLATION);
+        Vec2 velocity = (first.position - _previous.position) *
+                        (1.0f / (first.time - _previous.time));
+        position = first.position + velocity * (float)ahead;
+        _extrapolated++;
+    } else {
+        position = first.position;
+    }
+    return true;
+}
+
+/**
+ * Returns the number of samples newer than the render time
+ */
+size_t JitterBuffer::getDepth() const {
+    size_t depth = 0;
+    for (size_t i = 0; i < _count; i++) {
+        depth += _samples[i].time > _renderTime ? 1 : 0;
+    }
+    return depth;
+}
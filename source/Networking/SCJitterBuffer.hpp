@@ -0,0 +1,155 @@
+//
+//  SCJitterBuffer.hpp
+//  Sunk Cost
+//
+//  This module provides the playout buffer for a remote position stream.
+//
+//  Samples are stamped by the sender with the synced clock. The buffer
+//  tracks the minimum transit time (arrival minus stamp) over a window of
+//  recent samples, and the RFC 3550 interarrival jitter. It then renders at
+//
+//      now - minTransit - delay
+//
+//  where delay is a few jitter deviations, never below the configured
+//  render delay. Rendering interpolates between the two samples around the
+//  render time; if the stream runs dry the last velocity is extrapolated
+//  for a bounded time before the position holds. The delay is slewed
+//  slowly so that adapting it never makes the remote player jump.
+//
+
+#ifndef SCJitterBuffer_hpp
+#define SCJitterBuffer_hpp
+
+#include <array>
+#include <cugl/cugl.h>
+
+/** The maximum number of buffered samples */
+#define JITTER_CAPACITY 32
+/** The number of samples used for the minimum transit estimate */
+#define JITTER_WINDOW 64
+/** The default minimum render delay in milliseconds */
+#define JITTER_MIN_DELAY 50.0f
+/** The maximum render delay in milliseconds */
+#define JITTER_MAX_DELAY 300.0f
+/** The number of jitter deviations covered by the render delay */
+#define JITTER_DEVIATIONS 3.0f
+/** The maximum change of the render delay per frame in milliseconds */
+#define JITTER_SLEW 2.0f
+/** The longest extrapolation past the newest sample in milliseconds */
+#define JITTER_MAX_EXTRAPOLATION 100
+
+/**
+ * An adaptive jitter buffer with interpolation for one remote player.
+ */
+class JitterBuffer {
+  private:
+    /** A position stamped with the unwrapped sender time */
+    struct Sample {
+        Sint64 time;
+        cugl::Vec2 position;
+    };
+
+    /** The buffered samples, oldest first */
+    std::array<Sample, JITTER_CAPACITY> _samples;
+    /** The number of buffered samples */
+    size_t _count;
+    /** The last sample dropped from the front, for extrapolation */
+    Sample _previous;
+    /** Whether _previous holds a sample */
+    bool _hasPrevious;
+    /** The newest unwrapped sample time, valid once _started */
+    Sint64 _newest;
+    /** The last render time, in sender time */
+    Sint64 _renderTime;
+    /** Whether any sample has been received */
+    bool _started;
+
+    /** The recent transit times */
+    std::array<Sint64, JITTER_WINDOW> _transits;
+    /** The number of transit times recorded */
+    Uint32 _transitCount;
+    /** The minimum transit time in the window */
+    Sint64 _minTransit;
+    /** The smoothed interarrival jitter in milliseconds */
+    float _jitter;
+
+    /** The configured minimum render delay */
+    float _minDelay;
+    /** The current render delay on top of the minimum transit */
+    float _delay;
+
+    /** The number of samples received */
+    Uint64 _received;
+    /** The number of samples that arrived after their render time */
+    Uint64 _late;
+    /** The number of frames rendered past the newest sample */
+    Uint64 _extrapolated;
+
+    /** Inserts a sample in time order, replacing one with the same time */
+    void insert(const Sample& sample);
+
+  public:
+    JitterBuffer() : _minDelay(JITTER_MIN_DELAY) { reset(); }
+
+    /** Drops every sample and statistic, keeping the render delay */
+    void reset();
+
+    /**
+     * Sets the minimum render delay.
+     *
+     * The buffer never renders closer than this to the newest sample, even
+     * on a perfectly steady link.
+     *
+     * @param delay The minimum render delay in milliseconds
+     */
+    void setMinDelay(float delay) { _minDelay = delay; }
+
+    /**
+     * Adds a sample from the network.
+     *
+     * @param time      The low 16 bits of the sender synced clock
+     * @param position  The sampled position
+     * @param now       The local synced clock in milliseconds
+     */
+    void push(Uint16 time, cugl::Vec2 position, Uint32 now);
+
+    /**
+     * Returns the position to render this frame.
+     *
+     * This must be called once per frame.
+     *
+     * @param now       The local synced clock in milliseconds
+     * @param position  Set to the position to render if this returns true
+     *
+     * @return false if no sample has been received yet
+     */
+    bool sample(Uint32 now, cugl::Vec2& position);
+
+    /** Returns the number of samples newer than the render time */
+    size_t getDepth() const;
+
+    /**
+     * Returns the sender time rendered by the last call to sample.
+     *
+     * This is the unwrapped sender time, so it can be looked up in a
+     * PositionHistory fed from the same stream.
+     */
+    Sint64 getRenderTime() const { return _renderTime; }
+
+    /** Returns the total delay between sampling and rendering */
+    float getDelay() const { return _minTransit + _delay; }
+
+    /** Returns the smoothed interarrival jitter in milliseconds */
+    float getJitter() const { return _jitter; }
+
+    /** Returns the minimum observed one-way transit in milliseconds */
+    Sint64 getMinTransit() const { return _minTransit; }
+
+    Uint64 getReceived() const { return _received; }
+
+    Uint64 getLate() const { return _late; }
+
+    Uint64 getExtrapolated() const { return _extrapolated; }
+};
+
+#endif /* SCJitterBuffer_hpp */
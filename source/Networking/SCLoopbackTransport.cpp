@@ -0,0 +1,193 @@
+//
+//  SCLoopbackTransport.cpp
+//  Sunk Cost
+//
+//  This module provides an in-memory transport for running a host and its
+//  clients in one process. See the header for details.
+//
+
+#include "SCLoopbackTransport.hpp"
+#include <algorithm>
+
+/**
+ * Returns the host of a new in-memory room.
+ *
+ * @param room  The room identifier reported by {@link #getRoom}
+ *
+ * @return the host of a new in-memory room
+ */
+std::shared_ptr<LoopbackTransport>
+LoopbackTransport::allocHost(const std::string& room) {
+    auto hub = std::make_shared<Hub>();
+    hub->room = room;
+    std::string uuid = "loopback-" + room + "-0";
+    hub->created = 1;
+    return std::make_shared<LoopbackTransport>(hub, uuid, uuid);
+}
+
+/**
+ * Returns a new client in the room of the given host.
+ *
+ * @param host  Any peer of the room to join
+ *
+ * @return a new client in the room of the given host
+ */
+std::shared_ptr<LoopbackTransport>
+LoopbackTransport::allocClient(const std::shared_ptr<LoopbackTransport>& host) {
+    std::lock_guard<std::mutex> lock(host->_hub->mutex);
+    std::string uuid = "loopback-" + host->_hub->room + "-" +
+                       std::to_string(host->_hub->created++);
+    return std::make_shared<LoopbackTransport>(host->_hub, uuid, host->_host);
+}
+
+/**
+ * Returns a host and one client in a new room, both opened.
+ *
+ * @return a host and one client in a new room
+ */
+std::pair<std::shared_ptr<LoopbackTransport>,
+          std::shared_ptr<LoopbackTransport>>
+LoopbackTransport::allocPair() {
+    auto host = allocHost();
+    auto client = allocClient(host);
+    host->open();
+    client->open();
+    return {host, client};
+}
+
+/**
+ * Returns the peer with this UUID, or nullptr; the hub must be locked
+ */
+LoopbackTransport::Peer* LoopbackTransport::find(const std::string& uuid) {
+    for (Peer& peer : _hub->peers) {
+        if (peer.uuid == uuid) {
+            return &peer;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Copies a packet into the inbox of a peer; the hub must be locked
+ */
+bool LoopbackTransport::deliver(Peer& peer,
+                                const std::vector<std::byte>& data) {
+    peer.inbox.push_back({_uuid, data});
+    return true;
+}
+
+/**
+ * Joins the room, connecting immediately.
+ *
+ * A client cannot join once the host has left.
+ *
+ * @return true if this peer is now connected
+ */
+bool LoopbackTransport::open() {
+    std::lock_guard<std::mutex> lock(_hub->mutex);
+    if (_state != State::IDLE || _hub->closed) {
+        _state = _state == State::IDLE ? State::FAILED : _state;
+        return false;
+    }
+    Peer peer;
+    peer.uuid = _uuid;
+    if (_uuid == _host) {
+        _hub->peers.insert(_hub->peers.begin(), std::move(peer));
+    } else {
+        _hub->peers.push_back(std::move(peer));
+    }
+    _state = State::CONNECTED;
+    return true;
+}
+
+/**
+ * Leaves the room. If this is the host, the room closes for everyone.
+ */
+void LoopbackTransport::close() {
+    std::lock_guard<std::mutex> lock(_hub->mutex);
+    if (_state != State::CONNECTED) {
+        return;
+    }
+    auto& peers = _hub->peers;
+    peers.erase(std::remove_if(peers.begin(), peers.end(),
+                               [this](const Peer& peer) {
+                                   return peer.uuid == _uuid;
+                               }),
+                peers.end());
+    if (_uuid == _host) {
+        _hub->closed = true;
+    }
+    _state = State::DISCONNECTED;
+}
+
+/**
+ * Returns the connection state.
+ *
+ * Clients report DISCONNECTED once the host has left the room.
+ *
+ * @return the connection state
+ */
+Transport::State LoopbackTransport::getState() const {
+    std::lock_guard<std::mutex> lock(_hub->mutex);
+    if (_state == State::CONNECTED && _hub->closed) {
+        return State::DISCONNECTED;
+    }
+    return _state;
+}
+
+const std::string LoopbackTransport::getRoom() const { return _hub->room; }
+
+size_t LoopbackTransport::getNumPlayers() const {
+    std::lock_guard<std::mutex> lock(_hub->mutex);
+    return _hub->peers.size();
+}
+
+bool LoopbackTransport::broadcast(const std::vector<std::byte>& data) {
+    std::lock_guard<std::mutex> lock(_hub->mutex);
+    if (_state != State::CONNECTED || _hub->closed) {
+        return false;
+    }
+    for (Peer& peer : _hub->peers) {
+        if (peer.uuid != _uuid) {
+            deliver(peer, data);
+        }
+    }
+    return true;
+}
+
+bool LoopbackTransport::sendToHost(const std::vector<std::byte>& data) {
+    return sendTo(_host, data);
+}
+
+bool LoopbackTransport::sendTo(const std::string& dest,
+                               const std::vector<std::byte>& data) {
+    std::lock_guard<std::mutex> lock(_hub->mutex);
+    if (_state != State::CONNECTED || _hub->closed) {
+        return false;
+    }
+    Peer* peer = find(dest);
+    return peer != nullptr && deliver(*peer, data);
+}
+
+/**
+ * Delivers every packet received since the last call.
+ *
+ * The inbox is swapped out under the lock and dispatched without it, so
+ * the dispatcher may send on this transport.
+ *
+ * @param dispatcher    Called once per packet, in arrival order
+ */
+void LoopbackTransport::receive(const Dispatcher& dispatcher) {
+    {
+        std::lock_guard<std::mutex> lock(_hub->mutex);
+        Peer* self = find(_uuid);
+        if (self == nullptr) {
+            return;
+        }
+        std::swap(self->inbox, _received);
+    }
+    for (const Packet& packet : _received) {
+        dispatcher(packet.source, packet.data);
+    }
+    _received.clear();
+}
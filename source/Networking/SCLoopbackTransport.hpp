@@ -0,0 +1,137 @@
+//
+//  SCLoopbackTransport.hpp
+//  Sunk Cost
+//
+//  This module provides an in-memory transport for running a host and its
+//  clients in one process without the lobby server.
+//
+//  All peers of a room share a hub holding one inbox per peer. Sending
+//  copies the packet into the destination inboxes, and receive drains the
+//  caller's inbox. Delivery is instant, lossless and in order; wrap the
+//  transport to add network conditions. The hub is locked, so every peer
+//  may run on its own thread.
+//
+
+#ifndef SCLoopbackTransport_hpp
+#define SCLoopbackTransport_hpp
+
+#include "SCTransport.hpp"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/**
+ * One peer of an in-memory room.
+ */
+class LoopbackTransport : public Transport {
+  private:
+    /** A packet waiting in an inbox */
+    struct Packet {
+        std::string source;
+        std::vector<std::byte> data;
+    };
+
+    /** A peer attached to the hub */
+    struct Peer {
+        std::string uuid;
+        std::deque<Packet> inbox;
+    };
+
+    /** The state shared by every peer in a room */
+    struct Hub {
+        std::mutex mutex;
+        std::string room;
+        /** The connected peers, host first */
+        std::vector<Peer> peers;
+        /** The number of peers ever created, for UUIDs */
+        Uint32 created = 0;
+        /** Whether the host has left, closing the room */
+        bool closed = false;
+    };
+
+    /** The room this peer belongs to */
+    std::shared_ptr<Hub> _hub;
+    /** The UUID of this peer */
+    std::string _uuid;
+    /** The UUID of the host */
+    std::string _host;
+    /** The connection state */
+    State _state;
+    /** The packets taken from the inbox, reused between calls */
+    std::deque<Packet> _received;
+
+    /** Returns the peer with this UUID, or nullptr; the hub must be locked */
+    Peer* find(const std::string& uuid);
+
+    /** Copies a packet into the inbox of a peer; the hub must be locked */
+    bool deliver(Peer& peer, const std::vector<std::byte>& data);
+
+  public:
+    /**
+     * Creates a peer of a room. Use the static allocators instead.
+     *
+     * @param hub   The room to join
+     * @param uuid  The UUID of this peer
+     * @param host  The UUID of the host
+     */
+    LoopbackTransport(const std::shared_ptr<Hub>& hub, const std::string& uuid,
+                      const std::string& host)
+        : _hub(hub), _uuid(uuid), _host(host), _state(State::IDLE) {}
+
+    ~LoopbackTransport() { close(); }
+
+    /**
+     * Returns the host of a new in-memory room.
+     *
+     * @param room  The room identifier reported by {@link #getRoom}
+     *
+     * @return the host of a new in-memory room
+     */
+    static std::shared_ptr<LoopbackTransport>
+    allocHost(const std::string& room = "0");
+
+    /**
+     * Returns a new client in the room of the given host.
+     *
+     * @param host  Any peer of the room to join
+     *
+     * @return a new client in the room of the given host
+     */
+    static std::shared_ptr<LoopbackTransport>
+    allocClient(const std::shared_ptr<LoopbackTransport>& host);
+
+    /**
+     * Returns a host and one client in a new room, both opened.
+     *
+     * @return a host and one client in a new room
+     */
+    static std::pair<std::shared_ptr<LoopbackTransport>,
+                     std::shared_ptr<LoopbackTransport>>
+    allocPair();
+
+    bool open() override;
+
+    void close() override;
+
+    State getState() const override;
+
+    const std::string getHost() const override { return _host; }
+
+    const std::string getUUID() const override { return _uuid; }
+
+    const std::string getRoom() const override;
+
+    size_t getNumPlayers() const override;
+
+    bool broadcast(const std::vector<std::byte>& data) override;
+
+    bool sendToHost(const std::vector<std::byte>& data) override;
+
+    bool sendTo(const std::string& dest,
+                const std::vector<std::byte>& data) override;
+
+    void receive(const Dispatcher& dispatcher) override;
+};
+
+#endif /* SCLoopbackTransport_hpp */
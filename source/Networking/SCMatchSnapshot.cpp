@@ -0,0 +1,226 @@
+//
+//  SCMatchSnapshot.cpp
+//  Sunk Cost
+//
+//  This module provides a versioned binary snapshot of the whole match
+//  state. See the header for details.
+//
+
+#include "SCMatchSnapshot.hpp"
+#include <fstream>
+#include <iterator>
+
+using namespace cugl;
+
+/**
+ * Resets every field, keeping the capacity of the lists
+ */
+void MatchSnapshot::clear() {
+    time = 0;
+    deadline = 0;
+    remaining = 0;
+    hunter = Vec2::ZERO;
+    health = 0;
+    exit = Vec2::ZERO;
+    treasureCount = 0;
+    treasures.clear();
+    camera = -1;
+    lockedDoors.clear();
+    traps.clear();
+    portraits.clear();
+    trapsLeft = 0;
+    doorsLeft = 0;
+    energy = 0;
+    killCool = 0;
+    doorCool = 0;
+    clamCool = 0;
+    cameraCool = 0;
+}
+
+/**
+ * Appends the encoding of a snapshot to the writer.
+ *
+ * @param snapshot  The snapshot to encode
+ * @param writer    The buffer to append to
+ */
+void SnapshotCodec::encode(const MatchSnapshot& snapshot,
+                           MessageWriter& writer) {
+    writer.writeShort(SNAPSHOT_MAGIC);
+    writer.writeByte(SNAPSHOT_VERSION);
+    // The body length is filled in once it is known
+    size_t length = writer.size();
+    writer.writeShort(0);
+    size_t body = writer.size();
+
+    writer.writeUint(snapshot.time);
+    writer.writeUint(snapshot.deadline);
+    writer.writeUint(snapshot.remaining);
+    writer.writeFloat(snapshot.hunter.x);
+    writer.writeFloat(snapshot.hunter.y);
+    writer.writeUint(snapshot.health);
+    writer.writeFloat(snapshot.exit.x);
+    writer.writeFloat(snapshot.exit.y);
+    writer.writeUint(snapshot.treasureCount);
+    writer.writeInt(snapshot.camera);
+
+    writer.writeUint(static_cast<Uint32>(snapshot.treasures.size()));
+    for (const TreasureSnapshot& treasure : snapshot.treasures) {
+        writer.writeFloat(treasure.position.x);
+        writer.writeFloat(treasure.position.y);
+        writer.writeByte(treasure.taken);
+    }
+
+    writer.writeUint(static_cast<Uint32>(snapshot.lockedDoors.size()));
+    for (int door : snapshot.lockedDoors) {
+        writer.writeUint(door);
+    }
+    writer.writeUint(static_cast<Uint32>(snapshot.traps.size()));
+    for (const TrapSnapshot& trap : snapshot.traps) {
+        writer.writeFloat(trap.position.x);
+        writer.writeFloat(trap.position.y);
+        writer.writeUint(trap.age);
+        writer.writeUint(trap.triggerTime);
+        writer.writeByte(trap.triggered);
+    }
+    writer.writeUint(static_cast<Uint32>(snapshot.portraits.size()));
+    for (const PortraitSnapshot& portrait : snapshot.portraits) {
+        writer.writeFloat(portrait.battery);
+        writer.writeByte(portrait.on);
+    }
+
+    writer.writeUint(snapshot.trapsLeft);
+    writer.writeUint(snapshot.doorsLeft);
+    writer.writeFloat(snapshot.energy);
+    writer.writeFloat(snapshot.killCool);
+    writer.writeFloat(snapshot.doorCool);
+    writer.writeFloat(snapshot.clamCool);
+    writer.writeFloat(snapshot.cameraCool);
+
+    writer.setShort(length, static_cast<Uint16>(writer.size() - body));
+}
+
+/**
+ * Decodes the next snapshot from the reader.
+ *
+ * @param reader    The buffer to read from
+ * @param snapshot  The snapshot to decode into
+ *
+ * @return false if the buffer is not a snapshot, is from a newer version,
+ * or is truncated
+ */
+bool SnapshotCodec::decode(MessageReader& reader, MatchSnapshot& snapshot) {
+    if (reader.readShort() != SNAPSHOT_MAGIC) {
+        return false;
+    }
+    Uint8 version = reader.readByte();
+    size_t length = reader.readShort();
+    if (!reader.ok() || version == 0 || version > SNAPSHOT_VERSION ||
+        length > reader.remaining()) {
+        return false;
+    }
+    // Read the body on its own, so that fields appended later are skipped
+    MessageReader body(reader.cursor(), length);
+    reader.skip(length);
+
+    snapshot.clear();
+    snapshot.time = body.readUint();
+    snapshot.deadline = body.readUint();
+    snapshot.remaining = body.readUint();
+    snapshot.hunter.x = body.readFloat();
+    snapshot.hunter.y = body.readFloat();
+    snapshot.health = body.readUint();
+    snapshot.exit.x = body.readFloat();
+    snapshot.exit.y = body.readFloat();
+    snapshot.treasureCount = body.readUint();
+    snapshot.camera = body.readInt();
+
+    // Every list entry takes at least one byte, which bounds a corrupt count
+    size_t count = body.readUint();
+    if (count > body.remaining()) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        TreasureSnapshot treasure;
+        treasure.position.x = body.readFloat();
+        treasure.position.y = body.readFloat();
+        treasure.taken = body.readByte() != 0;
+        snapshot.treasures.push_back(treasure);
+    }
+    count = body.readUint();
+    if (count > body.remaining()) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        snapshot.lockedDoors.push_back(body.readUint());
+    }
+    count = body.readUint();
+    if (count > body.remaining()) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        TrapSnapshot trap;
+        trap.position.x = body.readFloat();
+        trap.position.y = body.readFloat();
+        trap.age = body.readUint();
+        trap.triggerTime = body.readUint();
+        trap.triggered = body.readByte() != 0;
+        snapshot.traps.push_back(trap);
+    }
+    count = body.readUint();
+    if (count > body.remaining()) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        PortraitSnapshot portrait;
+        portrait.battery = body.readFloat();
+        portrait.on = body.readByte() != 0;
+        snapshot.portraits.push_back(portrait);
+    }
+
+    snapshot.trapsLeft = body.readUint();
+    snapshot.doorsLeft = body.readUint();
+    snapshot.energy = body.readFloat();
+    snapshot.killCool = body.readFloat();
+    snapshot.doorCool = body.readFloat();
+    snapshot.clamCool = body.readFloat();
+    snapshot.cameraCool = body.readFloat();
+    return body.ok();
+}
+
+/**
+ * Writes a snapshot to a file, replacing it.
+ *
+ * @param snapshot  The snapshot to write
+ * @param path      The file path
+ *
+ * @return true if the file was written
+ */
+bool SnapshotCodec::save(const MatchSnapshot& snapshot,
+                         const std::string& path) {
+    MessageWriter writer;
+    encode(snapshot, writer);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(writer.getData().data()),
+              writer.size());
+    return out.good();
+}
+
+/**
+ * Reads a snapshot written by save.
+ *
+ * @param path      The file path
+ * @param snapshot  The snapshot to decode into
+ *
+ * @return true if the file was read and decoded
+ */
+bool SnapshotCodec::load(const std::string& path, MatchSnapshot& snapshot) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)),
+                            std::istreambuf_iterator<char>());
+    MessageReader reader(reinterpret_cast<const std::byte*>(bytes.data()),
+                         bytes.size());
+    return decode(reader, snapshot);
+}
@@ -0,0 +1,157 @@
+//
+//  SCMatchSnapshot.hpp
+//  Sunk Cost
+//
+//  This module provides a versioned binary snapshot of the whole match
+//  state, for reconnects, replays, desync checks and rollback.
+//
+//  Each device fills in the part of the match it owns: the hunter its
+//  position, exit, treasures, hearts and the traps it can see, the spirit
+//  its traps, portrait batteries, counters and cooldowns. Both fill in the
+//  locked doors, the portrait in use, the match deadline and which
+//  treasures are taken; the spirit leaves the treasure positions at zero.
+//
+//  The encoding reuses the wire primitives of SCMessage. A snapshot is a
+//  magic number, a version and a body with a 16 bit length prefix.
+//  Continuous values are stored as exact floats so that a restored match
+//  steps exactly like the original. A reader skips body bytes it does not
+//  know, so fields can be appended without a new version; changing or
+//  removing a field needs SNAPSHOT_VERSION to go up. Encoding into a reused
+//  writer and decoding into a reused snapshot do not allocate once the
+//  buffers have grown, so a snapshot can be taken every frame.
+//
+
+#ifndef SCMatchSnapshot_hpp
+#define SCMatchSnapshot_hpp
+
+#include "SCMessage.hpp"
+#include <cugl/cugl.h>
+#include <string>
+#include <vector>
+
+/** The first two bytes of every snapshot, "SC" */
+#define SNAPSHOT_MAGIC 0x4353
+/** The snapshot layout version */
+#define SNAPSHOT_VERSION 1
+
+/**
+ * A trap as stored in a snapshot.
+ */
+struct TrapSnapshot {
+    cugl::Vec2 position;
+    /** The frames since the trap was placed */
+    int age;
+    /** The frames since the trap was sprung */
+    int triggerTime;
+    bool triggered;
+};
+
+/**
+ * A treasure as stored in a snapshot.
+ */
+struct TreasureSnapshot {
+    cugl::Vec2 position;
+    bool taken;
+};
+
+/**
+ * A portrait camera as stored in a snapshot.
+ */
+struct PortraitSnapshot {
+    float battery;
+    /** Whether the portrait can be looked through */
+    bool on;
+};
+
+/**
+ * The state of a match at one instant.
+ */
+struct MatchSnapshot {
+    /** The synced clock in milliseconds when the snapshot was taken */
+    Uint32 time;
+    /** The end of the match in host time, 0 before the countdown starts */
+    Uint32 deadline;
+    /** The milliseconds left in the match */
+    Uint32 remaining;
+
+    cugl::Vec2 hunter;
+    /** The hearts the hunter has left */
+    int health;
+    /** The exit, which is where the hunter spawned */
+    cugl::Vec2 exit;
+    /** The number of treasures collected */
+    int treasureCount;
+    /** The treasures, which are placed at random by the hunter */
+    std::vector<TreasureSnapshot> treasures;
+
+    /** The portrait the spirit is looking through, -1 for none */
+    int camera;
+    /** The index of every locked door */
+    std::vector<int> lockedDoors;
+    /** The traps of the device that took the snapshot */
+    std::vector<TrapSnapshot> traps;
+    /** The portrait batteries, in portrait order */
+    std::vector<PortraitSnapshot> portraits;
+
+    /** The traps the spirit may still place */
+    int trapsLeft;
+    /** The doors the spirit may still lock */
+    int doorsLeft;
+    float energy;
+    float killCool;
+    float doorCool;
+    float clamCool;
+    float cameraCool;
+
+    MatchSnapshot() { clear(); }
+
+    /** Resets every field, keeping the capacity of the lists */
+    void clear();
+};
+
+/**
+ * The encoder/decoder pair for {@link MatchSnapshot}.
+ */
+class SnapshotCodec {
+  public:
+    /**
+     * Appends the encoding of a snapshot to the writer.
+     *
+     * @param snapshot  The snapshot to encode
+     * @param writer    The buffer to append to
+     */
+    static void encode(const MatchSnapshot& snapshot, MessageWriter& writer);
+
+    /**
+     * Decodes the next snapshot from the reader.
+     *
+     * @param reader    The buffer to read from
+     * @param snapshot  The snapshot to decode into
+     *
+     * @return false if the buffer is not a snapshot, is from a newer
+     * version, or is truncated
+     */
+    static bool decode(MessageReader& reader, MatchSnapshot& snapshot);
+
+    /**
+     * Writes a snapshot to a file, replacing it.
+     *
+     * @param snapshot  The snapshot to write
+     * @param path      The file path
+     *
+     * @return true if the file was written
+     */
+    static bool save(const MatchSnapshot& snapshot, const std::string& path);
+
+    /**
+     * Reads a snapshot written by {@link #save}.
+     *
+     * @param path      The file path
+     * @param snapshot  The snapshot to decode into
+     *
+     * @return true if the file was read and decoded
+     */
+    static bool load(const std::string& path, MatchSnapshot& snapshot);
+};
+
+#endif /* SCMatchSnapshot_hpp */
@@ -0,0 +1,146 @@
+//
+//  SCMessage.cpp
+//  Sunk Cost
+//
+//  This module provides the generated encoder and decoder for the gameplay
+//  messages declared in SCMessageSchema.h.
+//
+
+#include "SCMessage.hpp"
+#include <cstdio>
+
+namespace {
+
+/** Appends an integer field value */
+void describeInteger(std::string& out, long long value) {
+    out += std::to_string(value);
+}
+
+void describeByte(std::string& out, Uint8 value) {
+    describeInteger(out, value);
+}
+
+void describeShort(std::string& out, Uint16 value) {
+    describeInteger(out, value);
+}
+
+void describeUint(std::string& out, Uint32 value) {
+    describeInteger(out, value);
+}
+
+void describeInt(std::string& out, Sint32 value) {
+    describeInteger(out, value);
+}
+
+void describeCoord(std::string& out, float value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.2f", value);
+    out += text;
+}
+
+void describeChunk(std::string& out, const WireChunk& chunk) {
+    out += std::to_string(chunk.size) + " bytes";
+}
+
+} // namespace
+
+#pragma mark -
+#pragma mark Codec
+
+/**
+ * Appends the wire encoding of a message to the writer.
+ *
+ * @param message   The message to encode
+ * @param writer    The buffer to append to
+ */
+void MessageCodec::encode(const GameMessage& message, MessageWriter& writer) {
+    writer.writeUint(static_cast<Uint32>(message.type));
+    switch (message.type) {
+#define SC_FIELD(type, wire, name) writer.write##wire(body.name);
+#define SC_MESSAGE(name, op, fields)                                           \
+    case MessageType::name: {                                                  \
+        const name##Message& body = message.get<name##Message>();              \
+        (void)body;                                                            \
+        fields                                                                 \
+    } break;
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+    }
+}
+
+/**
+ * Decodes the next message from the reader.
+ *
+ * @param reader    The buffer to read from
+ * @param message   The message to decode into
+ *
+ * @return false if the opcode is unknown or the buffer is truncated
+ */
+bool MessageCodec::decode(MessageReader& reader, GameMessage& message) {
+    Uint32 opcode = reader.readUint();
+    if (!reader.ok()) {
+        return false;
+    }
+    switch (opcode) {
+#define SC_FIELD(type, wire, name) body.name = reader.read##wire();
+#define SC_MESSAGE(name, op, fields)                                           \
+    case op: {                                                                 \
+        name##Message body{};                                                  \
+        fields message = GameMessage(body);                                    \
+    } break;
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+    default:
+        CULog("Dropping message with unknown opcode %u", opcode);
+        return false;
+    }
+    return reader.ok();
+}
+
+/**
+ * Returns a short human readable name for a message type (for logs)
+ *
+ * @param type  The message type
+ *
+ * @return the schema name of the message type
+ */
+const char* MessageCodec::name(MessageType type) {
+    switch (type) {
+#define SC_FIELD(type, wire, name)
+#define SC_MESSAGE(name, op, fields)                                           \
+    case MessageType::name:                                                    \
+        return #name;
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+    }
+    return "Unknown";
+}
+
+/**
+ * Returns a message as one line of text with every field (for dumps)
+ *
+ * @param message   The message to describe
+ *
+ * @return the message name followed by name=value for every field
+ */
+std::string MessageCodec::describe(const GameMessage& message) {
+    std::string out = name(message.type);
+    switch (message.type) {
+#define SC_FIELD(type, wire, name)                                             \
+    out += " " #name "=";                                                      \
+    describe##wire(out, body.name);
+#define SC_MESSAGE(name, op, fields)                                           \
+    case MessageType::name: {                                                  \
+        const name##Message& body = message.get<name##Message>();              \
+        (void)body;                                                            \
+        fields                                                                 \
+    } break;
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+    }
+    return out;
+}
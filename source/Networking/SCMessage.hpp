@@ -0,0 +1,395 @@
+//
+//  SCMessage.hpp
+//  Sunk Cost
+//
+//  This module provides the typed wire protocol for gameplay messages.
+//
+//  The message set is defined once in SCMessageSchema.h. This header expands
+//  that schema into an opcode enum, one plain payload struct per message
+//  (HunterPosMessage, DoorLockedMessage, ...) and a tagged GameMessage that
+//  can hold any of them. MessageCodec expands the same schema into the
+//  matching encoder and decoder, so the two can never drift apart.
+//
+//  On the wire a message is a varint opcode followed by its fields in schema
+//  order. Integers are varints, coordinates are quantized to a quarter pixel,
+//  so a hunter position is typically 7 bytes instead of the 21 bytes of a
+//  length-prefixed float vector.
+//
+
+#ifndef SCMessage_hpp
+#define SCMessage_hpp
+
+#include <algorithm>
+#include <cugl/cugl.h>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** The number of wire units per world pixel for Coord fields */
+#define WIRE_COORD_SCALE 4.0f
+/** The milliseconds between repeats of an unchanged camera state */
+#define CAMERA_STATE_REPEAT 1000
+/** The most bytes carried by one Chunk field */
+#define WIRE_CHUNK_SIZE 48
+
+/**
+ * A short run of raw bytes, the payload of a Chunk field.
+ *
+ * The bytes are held inline so that every message stays trivially copyable;
+ * longer data is split over several messages.
+ */
+struct WireChunk {
+    /** The number of bytes used */
+    Uint8 size;
+    std::byte data[WIRE_CHUNK_SIZE];
+};
+
+#pragma mark -
+#pragma mark Generated Types
+
+/** The opcode of every gameplay message */
+enum class MessageType : Uint8 {
+#define SC_FIELD(type, wire, name)
+#define SC_MESSAGE(name, op, fields) name = op,
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+};
+
+/** One more than the largest opcode, for tables indexed by opcode */
+constexpr size_t MESSAGE_TYPE_LIMIT = std::max({
+#define SC_FIELD(type, wire, name)
+#define SC_MESSAGE(name, op, fields) size_t(op + 1),
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+});
+
+#define SC_FIELD(type, wire, name) type name;
+#define SC_MESSAGE(name, op, fields)                                           \
+    struct name##Message {                                                     \
+        fields                                                                 \
+    };
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+
+/**
+ * A decoded gameplay message.
+ *
+ * This is a tagged union over the generated payload structs. Every payload is
+ * trivially copyable, so a GameMessage never allocates and can be copied
+ * around freely. Check {@link #type} before calling {@link #get}.
+ */
+class GameMessage {
+  public:
+    /** The opcode of this message */
+    MessageType type;
+
+  private:
+    union Body {
+#define SC_FIELD(type, wire, name)
+#define SC_MESSAGE(name, op, fields) name##Message name;
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+    } _body;
+
+  public:
+    /** Creates an empty message (a zero hunter position) */
+    GameMessage() : type(MessageType::HunterPos), _body() {}
+
+#define SC_FIELD(type, wire, name)
+#define SC_MESSAGE(name, op, fields)                                           \
+    GameMessage(const name##Message& body) : type(MessageType::name) {         \
+        _body.name = body;                                                     \
+    }
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+
+    /**
+     * Returns the payload of this message.
+     *
+     * The template argument must be the payload struct matching
+     * {@link #type}; anything else is undefined.
+     *
+     * @return the payload of this message
+     */
+    template <typename T> const T& get() const;
+};
+
+#define SC_FIELD(type, wire, name)
+#define SC_MESSAGE(name, op, fields)                                           \
+    template <>                                                                \
+    inline const name##Message& GameMessage::get<name##Message>() const {      \
+        return _body.name;                                                     \
+    }
+#include "SCMessageSchema.h"
+#undef SC_MESSAGE
+#undef SC_FIELD
+
+#pragma mark -
+#pragma mark Wire Primitives
+
+/**
+ * An append-only byte buffer with the primitive wire encodings.
+ *
+ * The buffer is reused between messages; call {@link #reset} instead of
+ * allocating a new writer so the capacity is kept.
+ */
+class MessageWriter {
+  private:
+    /** The encoded bytes */
+    std::vector<std::byte> _buffer;
+
+  public:
+    MessageWriter() { _buffer.reserve(64); }
+
+    /** Clears the buffer, keeping its capacity */
+    void reset() { _buffer.clear(); }
+
+    /** Returns the bytes written so far */
+    const std::vector<std::byte>& getData() const { return _buffer; }
+
+    /** Returns the number of bytes written so far */
+    size_t size() const { return _buffer.size(); }
+
+    /** Writes a single byte */
+    void writeByte(Uint8 value) { _buffer.push_back(std::byte{value}); }
+
+    /** Writes a fixed-width little-endian 16 bit value */
+    void writeShort(Uint16 value) {
+        writeByte(static_cast<Uint8>(value & 0xff));
+        writeByte(static_cast<Uint8>(value >> 8));
+    }
+
+    /** Writes an unsigned LEB128 varint */
+    void writeUint(Uint32 value) {
+        while (value >= 0x80) {
+            writeByte(static_cast<Uint8>(value | 0x80));
+            value >>= 7;
+        }
+        writeByte(static_cast<Uint8>(value));
+    }
+
+    /**
+     * Overwrites a 16 bit value written earlier, such as a length that was
+     * not known when it was reserved.
+     *
+     * @param offset    The offset the value was written at
+     * @param value     The new value
+     */
+    void setShort(size_t offset, Uint16 value) {
+        _buffer[offset] = std::byte{static_cast<Uint8>(value & 0xff)};
+        _buffer[offset + 1] = std::byte{static_cast<Uint8>(value >> 8)};
+    }
+
+    /**
+     * Replaces bytes written earlier, moving the bytes after them if the
+     * new run is a different length.
+     *
+     * @param offset    The offset of the bytes to replace
+     * @param length    The number of bytes to replace
+     * @param data      The new bytes
+     * @param size      The number of new bytes
+     */
+    void replaceBytes(size_t offset, size_t length, const std::byte* data,
+                      size_t size) {
+        if (size != length) {
+            _buffer.erase(_buffer.begin() + offset,
+                          _buffer.begin() + offset + length);
+            _buffer.insert(_buffer.begin() + offset, size, std::byte{0});
+        }
+        std::memcpy(_buffer.data() + offset, data, size);
+    }
+
+    /** Writes a zigzag-encoded signed varint */
+    void writeInt(Sint32 value) {
+        writeUint((static_cast<Uint32>(value) << 1) ^
+                  static_cast<Uint32>(value >> 31));
+    }
+
+    /** Writes a world coordinate quantized to 1/WIRE_COORD_SCALE pixels */
+    void writeCoord(float value) {
+        writeInt(static_cast<Sint32>(std::lround(value * WIRE_COORD_SCALE)));
+    }
+
+    /** Writes a float exactly, as its little-endian IEEE 754 bits */
+    void writeFloat(float value) {
+        Uint32 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        writeShort(static_cast<Uint16>(bits & 0xffff));
+        writeShort(static_cast<Uint16>(bits >> 16));
+    }
+
+    /** Appends raw bytes */
+    void writeBytes(const std::byte* data, size_t length) {
+        _buffer.insert(_buffer.end(), data, data + length);
+    }
+
+    /** Writes a byte count followed by the used bytes of a chunk */
+    void writeChunk(const WireChunk& chunk) {
+        Uint8 size = std::min<Uint8>(chunk.size, WIRE_CHUNK_SIZE);
+        writeByte(size);
+        writeBytes(chunk.data, size);
+    }
+};
+
+/**
+ * A cursor over a received byte buffer with the primitive wire decodings.
+ *
+ * Reads never throw. Reading past the end returns zero and clears the
+ * {@link #ok} flag, so a truncated packet is detected once at the end of a
+ * decode instead of after every field.
+ */
+class MessageReader {
+  private:
+    const std::byte* _data;
+    size_t _size;
+    size_t _pos;
+    bool _ok;
+
+  public:
+    MessageReader(const std::byte* data, size_t size)
+        : _data(data), _size(size), _pos(0), _ok(true) {}
+
+    MessageReader(const std::vector<std::byte>& data)
+        : MessageReader(data.data(), data.size()) {}
+
+    /** Returns true if no read has run past the end of the buffer */
+    bool ok() const { return _ok; }
+
+    /** Returns true if there are unread bytes left */
+    bool hasMore() const { return _ok && _pos < _size; }
+
+    /** Returns the current read offset */
+    size_t position() const { return _pos; }
+
+    /** Returns the number of unread bytes */
+    size_t remaining() const { return _pos < _size ? _size - _pos : 0; }
+
+    /** Returns a pointer to the unread bytes */
+    const std::byte* cursor() const { return _data + _pos; }
+
+    /** Skips over length bytes */
+    void skip(size_t length) {
+        if (length > remaining()) {
+            _ok = false;
+            _pos = _size;
+        } else {
+            _pos += length;
+        }
+    }
+
+    /** Reads a single byte */
+    Uint8 readByte() {
+        if (_pos >= _size) {
+            _ok = false;
+            return 0;
+        }
+        return static_cast<Uint8>(_data[_pos++]);
+    }
+
+    /** Reads a fixed-width little-endian 16 bit value */
+    Uint16 readShort() {
+        Uint16 low = readByte();
+        return static_cast<Uint16>(low | (readByte() << 8));
+    }
+
+    /** Reads an unsigned LEB128 varint */
+    Uint32 readUint() {
+        Uint32 result = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            Uint8 byte = readByte();
+            result |= static_cast<Uint32>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return result;
+            }
+        }
+        _ok = false;
+        return 0;
+    }
+
+    /** Reads a zigzag-encoded signed varint */
+    Sint32 readInt() {
+        Uint32 value = readUint();
+        return static_cast<Sint32>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    /** Reads a quantized world coordinate */
+    float readCoord() { return readInt() / WIRE_COORD_SCALE; }
+
+    /** Reads a float written by MessageWriter::writeFloat */
+    float readFloat() {
+        Uint32 bits = readShort();
+        bits |= static_cast<Uint32>(readShort()) << 16;
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /** Reads a chunk written by MessageWriter::writeChunk */
+    WireChunk readChunk() {
+        WireChunk chunk{};
+        Uint8 size = readByte();
+        if (size > WIRE_CHUNK_SIZE || size > remaining()) {
+            _ok = false;
+            _pos = _size;
+            return chunk;
+        }
+        chunk.size = size;
+        std::memcpy(chunk.data, cursor(), size);
+        _pos += size;
+        return chunk;
+    }
+};
+
+#pragma mark -
+#pragma mark Codec
+
+/**
+ * The generated encoder/decoder pair for {@link GameMessage}.
+ */
+class MessageCodec {
+  public:
+    /**
+     * Appends the wire encoding of a message to the writer.
+     *
+     * @param message   The message to encode
+     * @param writer    The buffer to append to
+     */
+    static void encode(const GameMessage& message, MessageWriter& writer);
+
+    /**
+     * Decodes the next message from the reader.
+     *
+     * @param reader    The buffer to read from
+     * @param message   The message to decode into
+     *
+     * @return false if the opcode is unknown or the buffer is truncated
+     */
+    static bool decode(MessageReader& reader, GameMessage& message);
+
+    /**
+     * Returns a short human readable name for a message type (for logs)
+     *
+     * @param type  The message type
+     *
+     * @return the schema name of the message type
+     */
+    static const char* name(MessageType type);
+
+    /**
+     * Returns a message as one line of text with every field (for dumps)
+     *
+     * @param message   The message to describe
+     *
+     * @return the message name followed by name=value for every field
+     */
+    static std::string describe(const GameMessage& message);
+};
+
+#endif /* SCMessage_hpp */
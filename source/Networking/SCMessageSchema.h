@@ -0,0 +1,165 @@
+//
+//  SCMessageSchema.h
+//  Sunk Cost
+//
+//  This file is the schema for every gameplay message sent between the
+//  hunter and the spirit. It is intentionally NOT include-guarded: it is
+//  expanded several times by SCMessage.hpp and SCMessage.cpp, once per
+//  generated artifact (opcodes, payload structs, encoder, decoder).
+//
+//  Each entry has the form
+//
+//      SC_MESSAGE(Name, opcode, fields)
+//
+//  where fields is a (possibly empty) sequence of
+//
+//      SC_FIELD(c++ type, wire encoding, member name)
+//
+//  The wire encodings are the read/write pairs in MessageReader and
+//  MessageWriter: Byte (fixed 1 byte), Short (fixed 2 bytes), Uint (varint),
+//  Int (zigzag varint), Coord (world coordinate quantized to
+//  1/WIRE_COORD_SCALE pixels) and Chunk (a byte count and up to
+//  WIRE_CHUNK_SIZE raw bytes).
+//
+//  Opcodes are part of the wire format. Never renumber an existing entry;
+//  append new messages with a fresh opcode instead.
+//
+
+/**
+ * Hunter position keyframe in world coordinates (hunter -> all). The time is
+ * the low 16 bits of the synced clock when the position was sampled.
+ */
+SC_MESSAGE(HunterPos, 0,
+           SC_FIELD(Uint8, Byte, seq) SC_FIELD(Uint16, Short, time)
+               SC_FIELD(float, Coord, x) SC_FIELD(float, Coord, y))
+/** The spirit placed a trap (spirit -> hunter) */
+SC_MESSAGE(TrapPlaced, 1, SC_FIELD(float, Coord, x) SC_FIELD(float, Coord, y))
+/* Opcode 3 (per-frame camera index) is retired; see CameraState */
+/**
+ * A hunter picked up treasure 0, 1 or 2 (hunter -> host, relayed by the host
+ * to the other hunters). The host overwrites the player with the one it
+ * knows the sender as.
+ */
+SC_MESSAGE(TreasureStolen, 4,
+           SC_FIELD(Uint8, Byte, player) SC_FIELD(Uint8, Byte, treasure))
+/** The spirit locked a door (spirit -> hunter) */
+SC_MESSAGE(DoorLocked, 5, SC_FIELD(int, Uint, door))
+/** A hunter unlocked a door (hunter -> host, relayed to the others) */
+SC_MESSAGE(DoorUnlocked, 6, SC_FIELD(int, Uint, door))
+/**
+ * A hunter escaped a trap at the given position (hunter -> host, relayed to
+ * the others, with the player set as for TreasureStolen)
+ */
+SC_MESSAGE(TrapTriggered, 7,
+           SC_FIELD(Uint8, Byte, player) SC_FIELD(float, Coord, x)
+               SC_FIELD(float, Coord, y))
+/** A hunter reached the exit (relayed to the other hunters) */
+SC_MESSAGE(HunterWin, 8, )
+/**
+ * The spirit landed a hit on a hunter (host -> hunters). The hearts belong
+ * to the team, so every hunter loses one.
+ */
+SC_MESSAGE(Kill, 9, SC_FIELD(Uint8, Byte, player))
+/** The spirit won the match */
+SC_MESSAGE(SpiritWin, 10, )
+/* Opcode 11 (per-frame match timer) is retired; see MatchDeadline */
+/** Hunter position relative to the acknowledged state base (hunter -> all) */
+SC_MESSAGE(HunterDelta, 12,
+           SC_FIELD(Uint8, Byte, seq) SC_FIELD(Uint8, Byte, base)
+               SC_FIELD(Uint16, Short, time) SC_FIELD(int, Int, dx)
+                   SC_FIELD(int, Int, dy))
+/** The newest hunter position the spirit has applied (spirit -> hunter) */
+SC_MESSAGE(PositionAck, 13, SC_FIELD(Uint8, Byte, seq))
+/** A clock sync request stamped with the client clock (hunter -> spirit) */
+SC_MESSAGE(ClockPing, 14, SC_FIELD(Uint32, Uint, clientTime))
+/** The answer to a ClockPing (spirit -> pinging hunter) */
+SC_MESSAGE(ClockPong, 15,
+           SC_FIELD(Uint32, Uint, clientTime) SC_FIELD(Uint32, Uint, hostTime))
+/**
+ * The end of the match in host time (spirit -> hunter). While the deadline
+ * is 0 the countdown is frozen at remaining milliseconds.
+ */
+SC_MESSAGE(MatchDeadline, 16,
+           SC_FIELD(Uint32, Uint, deadline) SC_FIELD(Uint32, Uint, remaining))
+/**
+ * Marks the event that follows it in the same frame as reliable event seq.
+ * The two are one frame, so the event is never taken without its header.
+ */
+SC_MESSAGE(Reliable, 17, SC_FIELD(Uint16, Short, seq))
+/**
+ * Acknowledges reliable events: every seq up to and including through, and
+ * seq through + 2 + i for each set bit i (through + 1 is the first gap).
+ */
+SC_MESSAGE(ReliableAck, 18,
+           SC_FIELD(Uint16, Short, through) SC_FIELD(Uint32, Uint, bits))
+/**
+ * The portrait the spirit is looking through, -1 for none (spirit ->
+ * hunter). Sent when it changes and repeated every CAMERA_STATE_REPEAT
+ * milliseconds; the version increases with every change, so a repeat or a
+ * late packet never undoes a newer state.
+ */
+SC_MESSAGE(CameraState, 19,
+           SC_FIELD(Uint8, Byte, version) SC_FIELD(int, Int, index))
+/**
+ * One frame of hunter input in authoritative mode (hunter -> host). The axes
+ * are in units of 1/INPUT_SCALE; the time is the low 16 bits of the synced
+ * clock when the input was sampled.
+ */
+SC_MESSAGE(HunterInput, 20,
+           SC_FIELD(Uint16, Short, seq) SC_FIELD(Uint16, Short, time)
+               SC_FIELD(int, Int, forward) SC_FIELD(int, Int, rightward))
+/** The host position of the hunter after input seq (host -> hunter) */
+SC_MESSAGE(HunterState, 21,
+           SC_FIELD(Uint16, Short, seq) SC_FIELD(float, Coord, x)
+               SC_FIELD(float, Coord, y))
+/**
+ * Where the hunter starts in authoritative mode, before input seq (hunter ->
+ * host). This is the only hunter position the host accepts.
+ */
+SC_MESSAGE(HunterSpawn, 22,
+           SC_FIELD(Uint16, Short, seq) SC_FIELD(Uint16, Short, time)
+               SC_FIELD(float, Coord, x) SC_FIELD(float, Coord, y))
+/**
+ * The hunter rejoined the room after losing its connection (hunter ->
+ * host). The session counts the rejoins, so a repeated request for a
+ * session already answered is ignored. The player is the one the host
+ * assigned before, since the new connection has a new UUID.
+ */
+SC_MESSAGE(Resume, 23,
+           SC_FIELD(Uint8, Byte, session) SC_FIELD(Uint8, Byte, player))
+/**
+ * A piece of the encoded match snapshot answering a Resume (host ->
+ * hunter). The pieces are sent as reliable events, so they arrive in
+ * order; offset and total place the piece in the snapshot.
+ */
+SC_MESSAGE(SnapshotChunk, 24,
+           SC_FIELD(Uint8, Byte, session) SC_FIELD(Uint16, Short, offset)
+               SC_FIELD(Uint16, Short, total) SC_FIELD(WireChunk, Chunk, data))
+/**
+ * The host hash of the state both ends keep (host -> hunter), taken when
+ * the host had sent and delivered these many reliable events. See
+ * SCDesync.hpp.
+ */
+SC_MESSAGE(StateHash, 25,
+           SC_FIELD(Uint16, Short, sent) SC_FIELD(Uint16, Short, received)
+               SC_FIELD(Uint32, Uint, hash))
+/** The hunter found a lasting desync, so both ends dump their state */
+SC_MESSAGE(Desync, 26,
+           SC_FIELD(Uint32, Uint, host) SC_FIELD(Uint32, Uint, hunter))
+/**
+ * Where another hunter is (host -> hunters), relayed from the newest
+ * position the host has. The time is the stamp of that hunter, in the
+ * synced clock.
+ * See SCHunterRoster.hpp.
+ */
+SC_MESSAGE(PeerState, 27,
+           SC_FIELD(Uint8, Byte, player) SC_FIELD(Uint16, Short, time)
+               SC_FIELD(float, Coord, x) SC_FIELD(float, Coord, y))
+/** The player number the host gave this hunter (host -> hunter) */
+SC_MESSAGE(PlayerAssign, 28, SC_FIELD(Uint8, Byte, player))
+/**
+ * Whether the spirit can see this hunter through the active portrait (host
+ * -> hunter). A hidden hunter streams its position at a heartbeat rate.
+ * See SCInterest.hpp.
+ */
+SC_MESSAGE(Interest, 29, SC_FIELD(Uint8, Byte, visible))
@@ -0,0 +1,1299 @@
+//
+//  SCNetBenchmark.cpp
+//  Sunk Cost
+//
+//  This module provides micro-benchmarks for the networking code. See the
+//  header for details.
+//
+
+#include "SCNetBenchmark.hpp"
+
+#ifdef SC_NET_BENCHMARK
+
+#include "SCClockSync.hpp"
+#include "SCDesync.hpp"
+#include "SCHunterRoster.hpp"
+#include "SCInterest.hpp"
+#include "SCJitterBuffer.hpp"
+#include "SCLoopbackTransport.hpp"
+#include "SCMatchSnapshot.hpp"
+#include "SCMessage.hpp"
+#include "SCOutbox.hpp"
+#include "SCPrediction.hpp"
+#include "SCPositionHistory.hpp"
+#include "SCPositionStream.hpp"
+#include "SCReliableChannel.hpp"
+#include "SCSessionResume.hpp"
+#include "HunterMovement.h"
+#include "SCSimulatedTransport.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cugl/cugl.h>
+#include <deque>
+#include <random>
+#include <vector>
+
+using namespace cugl;
+using namespace cugl::net;
+
+/** The number of round trips timed per message type */
+#define BENCH_ITERATIONS 100000
+/** The length of the scripted walk in frames */
+#define BENCH_WALK_FRAMES (60 * 60)
+/** The one-way delay of the scripted walk in frames */
+#define BENCH_WALK_DELAY 6
+/** The length of the loopback match in frames */
+#define BENCH_LOOPBACK_FRAMES (60 * 60)
+/** The number of frames between spirit swipes in the lag benchmark */
+#define BENCH_SWIPE_INTERVAL 20
+/** The kill radius of a swipe in the lag benchmark */
+#define BENCH_KILL_RADIUS 80.0f
+/** The position of the door in the prediction benchmark */
+#define BENCH_DOOR_POSITION Vec2(3000, 2000)
+/** The frame the hunter connection drops in the resume benchmark */
+#define BENCH_RESUME_DROP 120
+/** The milliseconds the hunter link stays down in the resume benchmark */
+#define BENCH_RESUME_OUTAGE 2000
+/** The frames the resume benchmark runs at most */
+#define BENCH_RESUME_FRAMES (60 * 30)
+/** The length of the match in the hunter count benchmark in frames */
+#define BENCH_HUNTERS_FRAMES (60 * 30)
+/** The view of the portrait in the interest benchmark */
+#define BENCH_INTEREST_VIEW Rect(2600, 1200, 1000, 560)
+/** The frames the spirit looks through the portrait out of every 600 */
+#define BENCH_INTEREST_LOOKING 420
+
+namespace {
+
+/** A message in both the typed and the legacy float vector encodings */
+struct ProtocolSample {
+    GameMessage message;
+    std::vector<float> legacy;
+};
+
+/** Returns a full snapshot piece; the legacy encoding has a float a byte */
+ProtocolSample chunkSample() {
+    WireChunk chunk;
+    chunk.size = WIRE_CHUNK_SIZE;
+    std::vector<float> legacy = {24, 1, 96, 194};
+    for (int i = 0; i < WIRE_CHUNK_SIZE; i++) {
+        chunk.data[i] = std::byte(i * 37 % 256);
+        legacy.push_back(i * 37 % 256);
+    }
+    return {SnapshotChunkMessage{1, 96, 194, chunk}, legacy};
+}
+
+/** Returns one representative sample per message type */
+std::vector<ProtocolSample> protocolSamples() {
+    return {
+        {HunterPosMessage{17, 40312, 3721.25f, 1834.5f}, {0, 3721.25f, 1834.5f}},
+        {HunterDeltaMessage{17, 14, 40312, 84, -28}, {0, 3742.25f, 1827.5f}},
+        {PositionAckMessage{17}, {13, 17}},
+        {TrapPlacedMessage{4410.0f, 2210.75f}, {1, 4410.0f, 2210.75f}},
+        {CameraStateMessage{3, 7}, {19, 3, 7}},
+        {TreasureStolenMessage{2, 1}, {4, 2, 1}},
+        {DoorLockedMessage{12}, {5, 12}},
+        {DoorUnlockedMessage{12}, {6, 12}},
+        {TrapTriggeredMessage{2, 4410.0f, 2210.75f},
+         {7, 2, 4410.0f, 2210.75f}},
+        {HunterWinMessage{}, {8}},
+        {KillMessage{2}, {9, 2}},
+        {SpiritWinMessage{}, {10}},
+        {ClockPingMessage{81234}, {14, 81234}},
+        {ClockPongMessage{81234, 95512}, {15, 81234, 95512}},
+        {MatchDeadlineMessage{215512, 120000}, {16, 215512, 120000}},
+        {HunterInputMessage{17, 40312, 127, -127}, {20, 17, 40312, 1, -1}},
+        {HunterStateMessage{17, 3721.25f, 1834.5f}, {21, 17, 3721.25f, 1834.5f}},
+        {HunterSpawnMessage{0, 40312, 3721.25f, 1834.5f},
+         {22, 0, 40312, 3721.25f, 1834.5f}},
+        {ResumeMessage{1, 2}, {23, 1, 2}},
+        chunkSample(),
+        {StateHashMessage{412, 97, 2871035417u}, {25, 412, 97, 2871035417.0f}},
+        {DesyncMessage{2871035417u, 1093385722u},
+         {26, 2871035417.0f, 1093385722.0f}},
+        {PeerStateMessage{2, 40312, 3721.25f, 1834.5f},
+         {27, 2, 40312, 3721.25f, 1834.5f}},
+        {PlayerAssignMessage{2}, {28, 2}},
+        {InterestMessage{1}, {29, 1}},
+    };
+}
+
+/** Returns the nanoseconds per iteration since start */
+double nanosPerIteration(std::chrono::steady_clock::time_point start) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() /
+           BENCH_ITERATIONS;
+}
+
+/** The simulated clock for the loopback benchmark */
+Uint32 benchTime = 0;
+
+/** Returns the simulated clock */
+Uint32 benchMillis() { return benchTime; }
+
+/** Returns a transport with the conditions applied, if enabled */
+std::shared_ptr<Transport> degrade(const std::shared_ptr<Transport>& transport,
+                                   const NetworkConditions& conditions) {
+    if (!conditions.enabled) {
+        return transport;
+    }
+    return SimulatedTransport::alloc(transport, conditions);
+}
+
+/**
+ * Plays one loopback match under the given conditions and logs the result.
+ *
+ * The hunter walks and unlocks a door every two seconds, the spirit locks
+ * a door every second. Events stop five seconds before the end so that
+ * every retransmission has time to land.
+ */
+void playLoopback(const char* label, const NetworkConditions& conditions) {
+    auto transports = LoopbackTransport::allocPair();
+    // Degrading one end applies the conditions once in each direction
+    std::shared_ptr<Transport> host = degrade(transports.first, conditions);
+    std::shared_ptr<Transport> client = transports.second;
+    Outbox hostOutbox, clientOutbox;
+    ReliableChannel hostChannel, clientChannel;
+    hostChannel.init(Outbox::Route::Broadcast);
+    clientChannel.init(Outbox::Route::Host);
+    PositionSender sender;
+    PositionReceiver receiver;
+
+    // The send time of every event, indexed by door
+    std::vector<Uint32> hostSent, clientSent;
+    int hostDelivered = 0, clientDelivered = 0;
+    double eventDelay = 0;
+    bool ordered = true;
+    Vec2 position(3000, 1500);
+    Vec2 received = position;
+    double positionError = 0;
+
+    benchTime = 0;
+    int events = BENCH_LOOPBACK_FRAMES - 300;
+    for (int frame = 0; frame < BENCH_LOOPBACK_FRAMES; frame++) {
+        benchTime = frame * 1000 / 60;
+
+        // Hunter side
+        position = position + Vec2(frame % 240 < 120 ? 7 : -7, 3.5f);
+        GameMessage message;
+        if (sender.update(position, benchTime, message)) {
+            sender.recordSent(clientOutbox.push(message));
+        }
+        if (frame % 120 == 0 && frame < events) {
+            clientChannel.send(
+                DoorUnlockedMessage{static_cast<int>(clientSent.size())},
+                clientOutbox);
+            clientSent.push_back(benchTime);
+        }
+        client->receive([&](const std::string source,
+                            const std::vector<std::byte>& data) {
+            Outbox::unpack(data, [&](const GameMessage& m, size_t) {
+                auto deliver = [&](const GameMessage& event) {
+                    int door = event.get<DoorLockedMessage>().door;
+                    ordered &= door == hostDelivered;
+                    eventDelay += benchTime - hostSent[door];
+                    hostDelivered++;
+                };
+                if (!clientChannel.filter(m, deliver) &&
+                    m.type == MessageType::PositionAck) {
+                    sender.acknowledge(m.get<PositionAckMessage>().seq);
+                }
+            });
+        });
+        clientChannel.update(clientOutbox);
+        clientOutbox.flush(client);
+
+        // Spirit side
+        if (frame % 60 == 0 && frame < events) {
+            hostChannel.send(
+                DoorLockedMessage{static_cast<int>(hostSent.size())},
+                hostOutbox);
+            hostSent.push_back(benchTime);
+        }
+        host->receive([&](const std::string source,
+                          const std::vector<std::byte>& data) {
+            Outbox::unpack(data, [&](const GameMessage& m, size_t bytes) {
+                auto deliver = [&](const GameMessage& event) {
+                    int door = event.get<DoorUnlockedMessage>().door;
+                    ordered &= door == clientDelivered;
+                    eventDelay += benchTime - clientSent[door];
+                    clientDelivered++;
+                };
+                if (!hostChannel.filter(m, deliver)) {
+                    Uint16 stamp;
+                    receiver.receive(m, bytes, received, stamp);
+                }
+            });
+        });
+        if (receiver.update(message)) {
+            hostOutbox.push(message);
+        }
+        hostChannel.update(hostOutbox);
+        hostOutbox.flush(host);
+        positionError += position.distance(received);
+    }
+
+    int sent = static_cast<int>(hostSent.size() + clientSent.size());
+    int delivered = hostDelivered + clientDelivered;
+    CULog("%-10s %7.1f %7.1f %7.1f %7.1f %7llu  %s", label,
+          hostOutbox.getBytesPerFrame(), clientOutbox.getBytesPerFrame(),
+          delivered > 0 ? eventDelay / delivered : 0.0,
+          positionError / BENCH_LOOPBACK_FRAMES,
+          (unsigned long long)(hostChannel.getResends() +
+                               clientChannel.getResends()),
+          delivered == sent && ordered ? "in order" : "LOST OR REORDERED");
+}
+
+/**
+ * Returns the scripted hunter walk, one position per frame.
+ *
+ * The hunter zigzags at full speed with short rests, which is the hardest
+ * case for a swipe at a delayed position.
+ */
+std::vector<Vec2> recordWalk() {
+    std::vector<Vec2> walk;
+    Vec2 position(3000, 1500);
+    for (int frame = 0; frame < BENCH_WALK_FRAMES; frame++) {
+        if (frame % 150 < 120) {
+            float dir = (frame / 45) % 2 == 0 ? 1 : -1;
+            position = position + Vec2(7 * dir, 5 * -dir);
+        }
+        walk.push_back(position);
+    }
+    return walk;
+}
+
+/**
+ * Replays the walk at one latency and logs the hit test accuracy.
+ *
+ * Every swipe is aimed near the hunter the spirit sees. A verdict is
+ * correct if it matches whether the aim was within the kill radius of the
+ * hunter on screen.
+ */
+void replayLag(const std::vector<Vec2>& walk, int latency) {
+    PositionSender sender;
+    PositionReceiver receiver;
+    JitterBuffer buffer;
+    PositionHistory history;
+    MessageWriter writer;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+    int delay = latency * 60 / 1000;
+    // Messages in flight, tagged with their arrival frame
+    std::deque<std::pair<int, std::vector<std::byte>>> toSpirit;
+    std::deque<std::pair<int, std::vector<std::byte>>> toHunter;
+
+    Vec2 latest;
+    int swipes = 0, newestRight = 0, rewindRight = 0, unfair = 0;
+    for (int frame = 0; frame < (int)walk.size(); frame++) {
+        Uint32 time = frame * 1000 / 60;
+        GameMessage message;
+        if (sender.update(walk[frame], time, message)) {
+            writer.reset();
+            MessageCodec::encode(message, writer);
+            toSpirit.push_back({frame + delay, writer.getData()});
+        }
+        while (!toSpirit.empty() && toSpirit.front().first <= frame) {
+            MessageReader reader(toSpirit.front().second);
+            Uint16 stamp;
+            if (MessageCodec::decode(reader, message) &&
+                receiver.receive(message, toSpirit.front().second.size(),
+                                 latest, stamp)) {
+                buffer.push(stamp, latest, time);
+                history.record(stamp, latest, time);
+            }
+            toSpirit.pop_front();
+        }
+        if (receiver.update(message)) {
+            writer.reset();
+            MessageCodec::encode(message, writer);
+            toHunter.push_back({frame + delay, writer.getData()});
+        }
+        while (!toHunter.empty() && toHunter.front().first <= frame) {
+            MessageReader reader(toHunter.front().second);
+            if (MessageCodec::decode(reader, message)) {
+                sender.acknowledge(message.get<PositionAckMessage>().seq);
+            }
+            toHunter.pop_front();
+        }
+
+        Vec2 shown;
+        if (!buffer.sample(time, shown) || frame < 60 ||
+            frame % BENCH_SWIPE_INTERVAL != 0) {
+            continue;
+        }
+        // Aim uniformly within twice the kill radius of the hunter on screen
+        float angle = unit(random) * 2 * M_PI;
+        float reach = std::sqrt(unit(random)) * 2 * BENCH_KILL_RADIUS;
+        Vec2 aim = shown + Vec2(std::cos(angle), std::sin(angle)) * reach;
+        bool seen = aim.distance(shown) <= BENCH_KILL_RADIUS;
+
+        Vec2 rewound;
+        history.rewind(buffer.getRenderTime(), time, rewound);
+        bool rewindHit = aim.distance(rewound) <= BENCH_KILL_RADIUS;
+        swipes++;
+        newestRight += (aim.distance(latest) <= BENCH_KILL_RADIUS) == seen;
+        rewindRight += rewindHit == seen;
+        unfair += rewindHit && aim.distance(walk[frame]) > 3 * BENCH_KILL_RADIUS;
+    }
+
+    CULog("%-10d %7.1f %9.1f %9.1f %7llu %7d", latency, buffer.getDelay(),
+          100.0f * newestRight / swipes, 100.0f * rewindRight / swipes,
+          (unsigned long long)history.getClamped(), unfair);
+}
+
+/**
+ * Plays one loopback match with authoritative movement under the given
+ * conditions and logs the result.
+ *
+ * The hunter paces through a doorway. The spirit locks the door after ten
+ * seconds and the hunter unlocks it ten seconds later, so both ends step
+ * against a different door for one trip over the network. The last two
+ * seconds have no input, so the prediction should settle on the host
+ * position.
+ */
+void playPrediction(const char* label, const NetworkConditions& conditions) {
+    auto transports = LoopbackTransport::allocPair();
+    std::shared_ptr<Transport> host = degrade(transports.first, conditions);
+    std::shared_ptr<Transport> client = transports.second;
+    Outbox hostOutbox, clientOutbox;
+    ReliableChannel hostChannel, clientChannel;
+    hostChannel.init(Outbox::Route::Broadcast);
+    clientChannel.init(Outbox::Route::Host);
+    HunterMovement hostMovement, clientMovement;
+    hostMovement.addDoor(BENCH_DOOR_POSITION);
+    clientMovement.addDoor(BENCH_DOOR_POSITION);
+    MovementStep hostStep = [&](Vec2 pos, float forward, float rightward) {
+        return hostMovement.step(pos, forward, rightward);
+    };
+    MovementStep clientStep = [&](Vec2 pos, float forward, float rightward) {
+        return clientMovement.step(pos, forward, rightward);
+    };
+    InputPredictor predictor;
+    InputAuthority authority;
+
+    Vec2 position = InputPredictor::snap(Vec2(3000.3f, 1500.6f));
+    clientChannel.send(predictor.spawn(position, 0), clientOutbox);
+    double divergence = 0;
+
+    benchTime = 0;
+    int still = BENCH_LOOPBACK_FRAMES - 120;
+    for (int frame = 0; frame < BENCH_LOOPBACK_FRAMES; frame++) {
+        benchTime = frame * 1000 / 60;
+
+        // Hunter side
+        float forward = frame < still ? (frame % 240 < 120 ? 1 : -1) : 0;
+        float rightward = frame < still ? 0.3f : 0;
+        if (frame % 480 >= 240) {
+            rightward = -rightward;
+        }
+        clientOutbox.push(
+            predictor.predict(clientStep, position, forward, rightward,
+                              benchTime));
+        if (frame == 1200) {
+            clientMovement.setLocked(0, false);
+            clientChannel.send(DoorUnlockedMessage{0}, clientOutbox);
+        }
+        client->receive([&](const std::string source,
+                            const std::vector<std::byte>& data) {
+            Outbox::unpack(data, [&](const GameMessage& m, size_t) {
+                auto deliver = [&](const GameMessage& event) {
+                    clientMovement.setLocked(
+                        event.get<DoorLockedMessage>().door, true);
+                };
+                if (!clientChannel.filter(m, deliver) &&
+                    m.type == MessageType::HunterState) {
+                    predictor.reconcile(m.get<HunterStateMessage>(),
+                                        clientStep, position);
+                }
+            });
+        });
+        clientChannel.update(clientOutbox);
+        clientOutbox.flush(client);
+
+        // Spirit side
+        if (frame == 600) {
+            hostMovement.setLocked(0, true);
+            hostChannel.send(DoorLockedMessage{0}, hostOutbox);
+        }
+        host->receive([&](const std::string source,
+                          const std::vector<std::byte>& data) {
+            Outbox::unpack(data, [&](const GameMessage& m, size_t) {
+                auto deliver = [&](const GameMessage& event) {
+                    if (event.type == MessageType::HunterSpawn) {
+                        authority.spawn(event.get<HunterSpawnMessage>());
+                    } else {
+                        hostMovement.setLocked(
+                            event.get<DoorUnlockedMessage>().door, false);
+                    }
+                };
+                if (!hostChannel.filter(m, deliver) &&
+                    m.type == MessageType::HunterInput) {
+                    authority.receive(m.get<HunterInputMessage>());
+                }
+            });
+        });
+        GameMessage state;
+        if (authority.update(hostStep, benchTime, [](Vec2, Uint16) {},
+                             state)) {
+            hostOutbox.push(state);
+        }
+        hostChannel.update(hostOutbox);
+        hostOutbox.flush(host);
+        divergence += position.distance(authority.getPosition());
+    }
+
+    CULog("%-10s %7.1f %7llu %7.1f %7.1f %7llu %7llu %7.2f", label,
+          clientOutbox.getBytesPerFrame(),
+          (unsigned long long)predictor.getCorrections(),
+          predictor.getMaxError(), divergence / BENCH_LOOPBACK_FRAMES,
+          (unsigned long long)authority.getRepeated(),
+          (unsigned long long)authority.getDropped(),
+          position.distance(authority.getPosition()));
+}
+
+/** Returns a snapshot of a busy match, as the spirit would take it */
+MatchSnapshot busySnapshot() {
+    MatchSnapshot snapshot;
+    snapshot.time = 81234;
+    snapshot.deadline = 215512;
+    snapshot.remaining = 95000;
+    snapshot.hunter = Vec2(3721.25f, 1834.5f);
+    snapshot.health = 2;
+    snapshot.exit = Vec2(2176, 1792);
+    snapshot.treasureCount = 1;
+    snapshot.treasures = {{Vec2(1920, 2048), true},
+                          {Vec2(5888, 4224), false},
+                          {Vec2(7040, 1280), false}};
+    snapshot.camera = 7;
+    snapshot.lockedDoors = {2, 5, 11};
+    snapshot.traps = {{Vec2(4410, 2210.75f), 312, 0, false},
+                      {Vec2(5120.5f, 3300), 840, 97, true},
+                      {Vec2(900, 4000), 12, 0, false}};
+    for (int i = 0; i < 14; i++) {
+        snapshot.portraits.push_back({600.0f - i * 37.5f, i % 5 != 0});
+    }
+    snapshot.trapsLeft = 2;
+    snapshot.doorsLeft = 1;
+    snapshot.energy = 37.5f;
+    snapshot.killCool = 655;
+    snapshot.doorCool = 12.5f;
+    snapshot.clamCool = 0;
+    snapshot.cameraCool = 3;
+    return snapshot;
+}
+
+/** Returns true if two snapshots hold the same state */
+bool sameSnapshot(const MatchSnapshot& a, const MatchSnapshot& b) {
+    MessageWriter first, second;
+    SnapshotCodec::encode(a, first);
+    SnapshotCodec::encode(b, second);
+    return first.getData() == second.getData();
+}
+
+/**
+ * Drops the hunter connection for BENCH_RESUME_OUTAGE milliseconds under
+ * the given conditions and logs how long the resume took.
+ *
+ * The hunter rejoins through a ResumableTransport, and the host answers
+ * with a busy snapshot. This logs the time from the drop to the applied
+ * snapshot, the time from the rejoin to the applied snapshot, the pause
+ * taken by the host, the connections made and whether the snapshot
+ * arrived exactly.
+ */
+void playResume(const char* label, const NetworkConditions& conditions) {
+    benchTime = 0;
+    auto room = LoopbackTransport::allocHost();
+    room->open();
+    std::shared_ptr<Transport> host = degrade(room, conditions);
+
+    // The loopback peer of the hunter, replaced on every rejoin
+    std::shared_ptr<LoopbackTransport> peer;
+    Uint32 downUntil = 0;
+    auto client = ResumableTransport::alloc([&] {
+        peer = LoopbackTransport::allocClient(room);
+        if (benchTime < downUntil) {
+            // The link is still down, so this attempt fails
+            peer->open();
+            peer->close();
+        }
+        return std::static_pointer_cast<Transport>(peer);
+    });
+    client->open();
+
+    Outbox hostOutbox, clientOutbox;
+    ReliableChannel hostChannel, clientChannel;
+    hostChannel.init(Outbox::Route::Broadcast);
+    clientChannel.init(Outbox::Route::Host);
+    ResumeHost hostResume;
+    ResumeClient clientResume;
+    clientResume.reset(client->getSession());
+    MatchSnapshot snapshot = busySnapshot();
+    MatchSnapshot received;
+    bool resumed = false;
+    Uint32 paused = 0;
+
+    for (int frame = 0; frame < BENCH_RESUME_FRAMES && !resumed; frame++) {
+        benchTime = frame * 1000 / 60;
+        if (frame == BENCH_RESUME_DROP) {
+            downUntil = benchTime + BENCH_RESUME_OUTAGE;
+            peer->close();
+        }
+
+        // Hunter side
+        client->receive([&](const std::string source,
+                            const std::vector<std::byte>& data) {
+            Outbox::unpack(data, [&](const GameMessage& m, size_t) {
+                clientChannel.filter(m, [&](const GameMessage& event) {
+                    if (event.type == MessageType::SnapshotChunk &&
+                        clientResume.receive(
+                            event.get<SnapshotChunkMessage>(), benchTime,
+                            received)) {
+                        resumed = true;
+                    }
+                });
+            });
+        });
+        if (clientResume.update(client->getState(), client->getSession(),
+                                benchTime)) {
+            clientChannel.reset();
+        }
+        GameMessage request;
+        if (clientResume.request(benchTime, 0, request)) {
+            clientOutbox.push(request, Outbox::Route::Host);
+        }
+        clientChannel.update(clientOutbox);
+        clientOutbox.flush(client);
+
+        // Spirit side
+        hostResume.update(host->getNumPlayers(), 1, benchTime);
+        paused += hostResume.takePause();
+        host->receive([&](const std::string source,
+                          const std::vector<std::byte>& data) {
+            hostResume.heard(0, benchTime);
+            Outbox::unpack(data, [&](const GameMessage& m, size_t) {
+                if (!hostChannel.filter(m, [](const GameMessage&) {}) &&
+                    m.type == MessageType::Resume &&
+                    hostResume.accept(m.get<ResumeMessage>())) {
+                    hostChannel.reset();
+                    hostResume.answer(0, snapshot, [&](const GameMessage& c) {
+                        hostChannel.send(c, hostOutbox);
+                    });
+                }
+            });
+        });
+        hostChannel.update(hostOutbox);
+        hostOutbox.flush(host);
+    }
+
+    CULog("%-10s %7u %7u %7u %7llu  %s", label,
+          resumed ? clientResume.getOutage() : 0,
+          resumed ? clientResume.getResync() : 0, paused,
+          (unsigned long long)client->getAttempts(),
+          !resumed                           ? "NOT RESUMED"
+          : sameSnapshot(snapshot, received) ? "exact"
+                                             : "NOT EXACT");
+}
+
+/**
+ * Plays a match with the given number of hunters over the loopback
+ * transport and logs the result.
+ *
+ * Every hunter walks its own zigzag and streams its position to the host,
+ * which relays it to the others. This logs the bytes per second each
+ * hunter sends and receives, the bytes per second the host sends, the
+ * host time per frame, the mean distance between where a hunter shows
+ * another and where it is, and whether every hunter saw every other.
+ */
+void playHunters(int count, const NetworkConditions& conditions) {
+    benchTime = 0;
+    auto room = LoopbackTransport::allocHost();
+    room->open();
+    std::shared_ptr<Transport> host = degrade(room, conditions);
+    std::vector<std::shared_ptr<Transport>> clients;
+    for (int i = 0; i < count; i++) {
+        clients.push_back(LoopbackTransport::allocClient(room));
+        clients.back()->open();
+    }
+
+    HunterRoster roster;
+    roster.reset(count);
+    PeerRelay relay;
+    Outbox hostOutbox;
+    std::vector<Outbox> clientOutboxes(count);
+    std::vector<PositionSender> senders(count);
+    std::vector<ReliableChannel> channels(count);
+    std::vector<PeerView> views(count);
+    std::vector<Vec2> positions(count);
+    std::vector<size_t> received(count, 0);
+    for (int i = 0; i < count; i++) {
+        channels[i].init(Outbox::Route::Host);
+        positions[i] = Vec2(3000 + 400 * i, 1500);
+    }
+    // How far a hunter shows another from where it is, over every sample
+    double peerError = 0;
+    Uint64 peerSamples = 0;
+    double hostNanos = 0;
+
+    for (int frame = 0; frame < BENCH_HUNTERS_FRAMES; frame++) {
+        benchTime = frame * 1000 / 60;
+
+        // Hunter side
+        for (int i = 0; i < count; i++) {
+            positions[i] =
+                positions[i] + Vec2((frame + 40 * i) % 240 < 120 ? 7 : -7,
+                                    i % 2 == 0 ? 3.5f : -3.5f);
+            clients[i]->receive([&](const std::string source,
+                                    const std::vector<std::byte>& data) {
+                received[i] += data.size();
+                Outbox::unpack(data, [&](const GameMessage& m, size_t) {
+                    auto deliver = [&](const GameMessage& event) {
+                        if (event.type == MessageType::PlayerAssign) {
+                            views[i].setPlayer(
+                                event.get<PlayerAssignMessage>().player);
+                        }
+                    };
+                    if (channels[i].filter(m, deliver)) {
+                        return;
+                    }
+                    if (m.type == MessageType::PositionAck) {
+                        senders[i].acknowledge(
+                            m.get<PositionAckMessage>().seq);
+                    } else if (m.type == MessageType::PeerState) {
+                        views[i].receive(m.get<PeerStateMessage>(),
+                                         benchTime);
+                    }
+                });
+            });
+            GameMessage message;
+            if (senders[i].update(positions[i], benchTime, message)) {
+                senders[i].recordSent(
+                    clientOutboxes[i].push(message, Outbox::Route::Host));
+            }
+            channels[i].update(clientOutboxes[i]);
+            clientOutboxes[i].flush(clients[i]);
+        }
+
+        // Spirit side
+        auto start = std::chrono::steady_clock::now();
+        host->receive([&](const std::string source,
+                          const std::vector<std::byte>& data) {
+            int player = roster.find(source);
+            if (player == -1) {
+                player = roster.join(source, hostOutbox);
+            }
+            if (player == -1) {
+                return;
+            }
+            HunterLink& link = roster.get(player);
+            Outbox::unpack(data, [&](const GameMessage& m, size_t bytes) {
+                Vec2 pos;
+                Uint16 stamp;
+                if (!link.reliable.filter(m, [](const GameMessage&) {}) &&
+                    link.stream.receive(m, bytes, pos, stamp)) {
+                    link.buffer.push(stamp, pos, benchTime);
+                    relay.record(player, stamp, pos);
+                }
+            });
+        });
+        for (int p = 0; p < roster.size(); p++) {
+            HunterLink& link = roster.get(p);
+            GameMessage ack;
+            if (link.stream.update(ack)) {
+                hostOutbox.push(ack, Outbox::Route::Peer, link.uuid);
+            }
+            link.buffer.sample(benchTime, link.position);
+        }
+        relay.update(benchTime, [&](const GameMessage& peer) {
+            hostOutbox.push(peer);
+        });
+        roster.update(hostOutbox);
+        hostOutbox.flush(host);
+        hostNanos += std::chrono::duration<double, std::nano>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+
+        for (int i = 0; i < count; i++) {
+            for (int j = 0; j < count; j++) {
+                Vec2 shown;
+                int player = roster.find(clients[j]->getUUID());
+                if (i != j && player != -1 &&
+                    views[i].sample(player, benchTime, shown)) {
+                    peerError += shown.distance(positions[j]);
+                    peerSamples++;
+                }
+            }
+        }
+    }
+
+    float seconds = BENCH_HUNTERS_FRAMES / 60.0f;
+    double up = 0, down = 0;
+    for (int i = 0; i < count; i++) {
+        up += clientOutboxes[i].getBytesPerFrame() * 60;
+        down += received[i] / seconds;
+    }
+    // Every hunter must have seen every other for most of the match
+    Uint64 expected = static_cast<Uint64>(count) * (count - 1) *
+                      BENCH_HUNTERS_FRAMES * 9 / 10;
+    CULog("%-10d %7.0f %7.0f %7.0f %7.1f %7.1f  %s", count, up / count,
+          down / count, hostOutbox.getBytesPerFrame() * 60.0f,
+          hostNanos / BENCH_HUNTERS_FRAMES / 1000,
+          peerSamples > 0 ? peerError / peerSamples : 0.0,
+          roster.size() == count && peerSamples >= expected ? "all seen"
+                                                            : "PEERS MISSING");
+}
+
+/**
+ * Streams a hunter pacing across the map to a spirit that looks through
+ * one portrait most of the time, and logs the result.
+ *
+ * Both directions are delayed by BENCH_WALK_DELAY frames. This logs the
+ * bytes per second of the stream, the share of frames the host counted
+ * the hunter as visible, and the mean and worst distance between the
+ * hunter and where the host has it over the frames the spirit could see
+ * the hunter.
+ */
+void playInterest(const char* label, bool managed) {
+    PositionSender sender;
+    PositionReceiver receiver;
+    InterestManager interest;
+    interest.setViews({Rect(), BENCH_INTEREST_VIEW});
+    MessageWriter writer;
+    // Messages in flight, tagged with their arrival frame
+    std::deque<std::pair<int, GameMessage>> toSpirit;
+    std::deque<std::pair<int, GameMessage>> toHunter;
+
+    Vec2 position(1000, 1500);
+    Vec2 received = position;
+    float dir = 1;
+    double shownError = 0;
+    float worstError = 0;
+    int shownFrames = 0;
+    for (int frame = 0; frame < BENCH_WALK_FRAMES; frame++) {
+        // Pace between x = 1000 and x = 5000 at full speed
+        if (position.x >= 5000 || position.x <= 1000) {
+            dir = position.x >= 5000 ? -1 : 1;
+        }
+        position = position + Vec2(7 * dir, 0);
+        Uint32 time = frame * 1000 / 60;
+
+        GameMessage message;
+        if (sender.update(position, time, message)) {
+            writer.reset();
+            MessageCodec::encode(message, writer);
+            sender.recordSent(writer.size());
+            toSpirit.push_back({frame + BENCH_WALK_DELAY, message});
+        }
+        while (!toSpirit.empty() && toSpirit.front().first <= frame) {
+            writer.reset();
+            MessageCodec::encode(toSpirit.front().second, writer);
+            Uint16 stamp;
+            receiver.receive(toSpirit.front().second, writer.size(), received,
+                             stamp);
+            toSpirit.pop_front();
+        }
+        if (receiver.update(message)) {
+            toHunter.push_back({frame + BENCH_WALK_DELAY, message});
+        }
+
+        bool looking = frame % 600 < BENCH_INTEREST_LOOKING;
+        interest.setCamera(looking ? 1 : -1);
+        bool visible;
+        if (managed && interest.update(0, received, visible)) {
+            toHunter.push_back({frame + BENCH_WALK_DELAY,
+                                InterestMessage{static_cast<Uint8>(visible)}});
+        }
+        while (!toHunter.empty() && toHunter.front().first <= frame) {
+            const GameMessage& m = toHunter.front().second;
+            if (m.type == MessageType::PositionAck) {
+                sender.acknowledge(m.get<PositionAckMessage>().seq);
+            } else {
+                sender.setVisible(m.get<InterestMessage>().visible != 0);
+            }
+            toHunter.pop_front();
+        }
+
+        if (looking && BENCH_INTEREST_VIEW.contains(position)) {
+            float error = position.distance(received);
+            shownError += error;
+            worstError = std::max(worstError, error);
+            shownFrames++;
+        }
+    }
+
+    CULog("%-10s %7.1f %7.0f %7.1f %7.1f", label,
+          sender.getCounter().getBytesPerSecond(),
+          managed ? interest.getVisibleShare() * 100 : 100.0f,
+          shownFrames > 0 ? shownError / shownFrames : 0.0, worstError);
+}
+
+/**
+ * Applies the inputs of a hunter pacing across the map on an authoritative
+ * host, while the spirit looks through one portrait most of the time, and
+ * logs the result.
+ *
+ * This logs the bytes per second of the HunterState messages back to the
+ * hunter and of the PeerState relay to the other hunters, and the share of
+ * frames the host counted the hunter as visible.
+ */
+void playInterestAuthority(const char* label, bool managed) {
+    InterestManager interest;
+    interest.setViews({Rect(), BENCH_INTEREST_VIEW});
+    PeerRelay relay;
+    MessageWriter writer;
+    size_t stateBytes = 0;
+    size_t relayBytes = 0;
+
+    Vec2 position(1000, 1500);
+    float dir = 1;
+    for (int frame = 0; frame < BENCH_WALK_FRAMES; frame++) {
+        if (position.x >= 5000 || position.x <= 1000) {
+            dir = position.x >= 5000 ? -1 : 1;
+        }
+        position = position + Vec2(7 * dir, 0);
+        Uint32 time = frame * 1000 / 60;
+
+        // One input is applied per frame, so a held state is always stale
+        if (!managed || interest.isDue(0, time)) {
+            writer.reset();
+            MessageCodec::encode(
+                HunterStateMessage{static_cast<Uint16>(frame), position.x,
+                                   position.y},
+                writer);
+            stateBytes += writer.size();
+        }
+        relay.record(0, static_cast<Uint16>(time), position);
+        relay.update(
+            time,
+            [&](const GameMessage& peer) {
+                writer.reset();
+                MessageCodec::encode(peer, writer);
+                relayBytes += writer.size();
+            },
+            [&](int player) { return managed && interest.isHidden(player); });
+
+        bool looking = frame % 600 < BENCH_INTEREST_LOOKING;
+        interest.setCamera(looking ? 1 : -1);
+        bool visible;
+        if (managed) {
+            interest.update(0, position, visible);
+        }
+    }
+
+    float seconds = BENCH_WALK_FRAMES / 60.0f;
+    CULog("%-10s %7.1f %7.1f %7.0f", label, stateBytes / seconds,
+          relayBytes / seconds,
+          managed ? interest.getVisibleShare() * 100 : 100.0f);
+}
+
+} // namespace
+
+/**
+ * Runs every benchmark and logs the results.
+ */
+void NetBenchmark::runAll() {
+    runProtocol();
+    runPositionStream();
+    runLoopback();
+    runLagCompensation();
+    runPrediction();
+    runSnapshot();
+    runResume();
+    runDesync();
+    runHunters();
+    runInterest();
+}
+
+/**
+ * Compares the typed wire protocol against the float vector protocol.
+ *
+ * For every message type this logs the encoded size and the time to
+ * encode plus decode one message with each protocol.
+ */
+void NetBenchmark::runProtocol() {
+    auto serializer = NetcodeSerializer::alloc();
+    auto deserializer = NetcodeDeserializer::alloc();
+    MessageWriter writer;
+    GameMessage decoded;
+    // Folded into the log line so the loops cannot be optimized away
+    double sink = 0;
+
+    CULog("%-15s %10s %10s %10s %10s", "message", "old bytes", "new bytes",
+          "old ns", "new ns");
+    for (const ProtocolSample& sample : protocolSamples()) {
+        serializer->writeFloatVector(sample.legacy);
+        size_t oldBytes = serializer->serialize().size();
+        serializer->reset();
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            serializer->writeFloatVector(sample.legacy);
+            const std::vector<std::byte>& data = serializer->serialize();
+            deserializer->receive(data);
+            sink += std::get<std::vector<float>>(deserializer->read())[0];
+            deserializer->reset();
+            serializer->reset();
+        }
+        double oldNanos = nanosPerIteration(start);
+
+        writer.reset();
+        MessageCodec::encode(sample.message, writer);
+        size_t newBytes = writer.size();
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) {
+            writer.reset();
+            MessageCodec::encode(sample.message, writer);
+            MessageReader reader(writer.getData());
+            MessageCodec::decode(reader, decoded);
+            sink += static_cast<int>(decoded.type);
+        }
+        double newNanos = nanosPerIteration(start);
+
+        CULog("%-15s %10zu %10zu %10.1f %10.1f",
+              MessageCodec::name(sample.message.type), oldBytes, newBytes,
+              oldNanos, newNanos);
+    }
+    CULog("protocol benchmark done (checksum %.0f)", sink);
+}
+
+/**
+ * Replays a scripted hunter walk through the position stream.
+ *
+ * This logs the bandwidth of the delta stream against sending the raw
+ * position every frame the hunter moves.
+ */
+void NetBenchmark::runPositionStream() {
+    auto serializer = NetcodeSerializer::alloc();
+    PositionSender sender;
+    PositionReceiver receiver;
+    MessageWriter writer;
+    // Messages in flight, tagged with their arrival frame
+    std::deque<std::pair<int, std::vector<std::byte>>> toSpirit;
+    std::deque<std::pair<int, std::vector<std::byte>>> toHunter;
+
+    Vec2 position(3000, 1500);
+    Vec2 received;
+    Uint64 legacyBytes = 0;
+    float maxError = 0;
+    for (int frame = 0; frame < BENCH_WALK_FRAMES; frame++) {
+        // Walk for two seconds, turn, and rest every fifth second
+        if (frame % 300 < 240) {
+            float dir = (frame / 120) % 2 == 0 ? 1 : -1;
+            position = position + Vec2(7 * dir, 3.5f);
+            serializer->writeFloatVector({0, position.x, position.y});
+            legacyBytes += serializer->serialize().size();
+            serializer->reset();
+        }
+
+        GameMessage message;
+        Uint32 time = frame * 1000 / 60;
+        if (sender.update(position, time, message)) {
+            writer.reset();
+            MessageCodec::encode(message, writer);
+            sender.recordSent(writer.size());
+            toSpirit.push_back({frame + BENCH_WALK_DELAY, writer.getData()});
+        }
+        while (!toSpirit.empty() && toSpirit.front().first <= frame) {
+            MessageReader reader(toSpirit.front().second);
+            if (MessageCodec::decode(reader, message)) {
+                Uint16 stamp;
+                receiver.receive(message, toSpirit.front().second.size(),
+                                 received, stamp);
+            }
+            toSpirit.pop_front();
+        }
+        if (receiver.update(message)) {
+            writer.reset();
+            MessageCodec::encode(message, writer);
+            toHunter.push_back({frame + BENCH_WALK_DELAY, writer.getData()});
+        }
+        while (!toHunter.empty() && toHunter.front().first <= frame) {
+            MessageReader reader(toHunter.front().second);
+            if (MessageCodec::decode(reader, message)) {
+                sender.acknowledge(message.get<PositionAckMessage>().seq);
+            }
+            toHunter.pop_front();
+        }
+        if (frame % 300 == 299) {
+            maxError = std::max(maxError, position.distance(received));
+        }
+    }
+
+    const BandwidthCounter& counter = sender.getCounter();
+    float seconds = BENCH_WALK_FRAMES / 60.0f;
+    CULog("position stream: legacy %.1f bytes/s, stream %.1f bytes/s "
+          "(%.1f msgs/s, %llu keyframes), resting error %.2f px",
+          legacyBytes / seconds, counter.getBytesPerSecond(),
+          counter.getMessagesPerSecond(),
+          (unsigned long long)sender.getKeyframes(), maxError);
+}
+
+/**
+ * Runs a host and a client against each other over the loopback
+ * transport, with the outbox and reliable channel on both ends.
+ *
+ * The match is played once per network profile on a simulated clock, so
+ * a minute of play takes a fraction of a second. For each profile this
+ * logs the bytes per frame, the mean event delay, the mean distance
+ * between the true and the received hunter position, and whether every
+ * event arrived in order.
+ */
+void NetBenchmark::runLoopback() {
+    NetworkConditions perfect;
+    NetworkConditions wifi;
+    wifi.enabled = true;
+    wifi.latency = 30;
+    wifi.jitter = 20;
+    wifi.loss = 0.01f;
+    wifi.reorder = 0.01f;
+    NetworkConditions bad = wifi;
+    bad.latency = 80;
+    bad.jitter = 60;
+    bad.loss = 0.05f;
+    bad.duplicate = 0.01f;
+    bad.reorder = 0.03f;
+    bad.bandwidth = 16000;
+    bad.queue = 300;
+
+    CULog("%-10s %7s %7s %7s %7s %7s", "loopback", "host B", "client B",
+          "event ms", "pos err", "resends");
+    ClockSync::setTimeSource(benchMillis);
+    playLoopback("perfect", perfect);
+    playLoopback("wifi", wifi);
+    playLoopback("bad wifi", bad);
+    ClockSync::setTimeSource(nullptr);
+}
+
+/**
+ * Replays a recorded hunter walk at several one-way latencies and has the
+ * spirit swipe at the hunter it sees.
+ *
+ * For each latency this logs the render delay of the jitter buffer, the
+ * percentage of swipes judged as the spirit saw them when testing against
+ * the newest received position and against the rewound position, the
+ * number of rewinds limited by LAG_MAX_REWIND, and the number of rewound
+ * hits more than three kill radii from the true hunter.
+ */
+void NetBenchmark::runLagCompensation() {
+    std::vector<Vec2> walk = recordWalk();
+    CULog("%-10s %7s %9s %9s %7s %7s", "latency", "delay", "newest %",
+          "rewind %", "clamped", "unfair");
+    for (int latency : {0, 50, 100, 150, 250, 400}) {
+        replayLag(walk, latency);
+    }
+}
+
+/**
+ * Plays a hunter with client-side prediction against a host that applies
+ * its inputs, over the loopback transport.
+ *
+ * The match is played once per network profile on a simulated clock. For
+ * each profile this logs the client bytes per frame, the number of host
+ * corrections and the largest one, the mean distance between the hunter
+ * and the host position, the inputs the host repeated for lost ones or
+ * dropped, and the distance left once the hunter stands still.
+ */
+void NetBenchmark::runPrediction() {
+    NetworkConditions perfect;
+    NetworkConditions wifi;
+    wifi.enabled = true;
+    wifi.latency = 30;
+    wifi.jitter = 20;
+    wifi.loss = 0.01f;
+    wifi.reorder = 0.01f;
+    NetworkConditions bad = wifi;
+    bad.latency = 80;
+    bad.jitter = 60;
+    bad.loss = 0.05f;
+    bad.duplicate = 0.01f;
+    bad.reorder = 0.03f;
+    bad.bandwidth = 16000;
+    bad.queue = 300;
+
+    CULog("%-10s %7s %7s %7s %7s %7s %7s %7s", "predict", "client B",
+          "fixes", "max fix", "diverge", "repeat", "dropped", "final");
+    ClockSync::setTimeSource(benchMillis);
+    playPrediction("perfect", perfect);
+    playPrediction("wifi", wifi);
+    playPrediction("bad wifi", bad);
+    ClockSync::setTimeSource(nullptr);
+}
+
+/**
+ * Times the encoding and decoding of a full match snapshot.
+ *
+ * This logs the encoded size, the time to encode into a reused writer and
+ * to decode into a reused snapshot, whether the round trip is exact, and
+ * whether a truncated snapshot is rejected.
+ */
+void NetBenchmark::runSnapshot() {
+    MatchSnapshot snapshot = busySnapshot();
+    MatchSnapshot decoded;
+    MessageWriter writer;
+    // Folded into the log line so the loops cannot be optimized away
+    double sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        writer.reset();
+        SnapshotCodec::encode(snapshot, writer);
+        sink += writer.size();
+    }
+    double encodeNanos = nanosPerIteration(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        MessageReader reader(writer.getData());
+        SnapshotCodec::decode(reader, decoded);
+        sink += decoded.portraits.size();
+    }
+    double decodeNanos = nanosPerIteration(start);
+
+    bool exact = sameSnapshot(snapshot, decoded);
+    MessageReader truncated(writer.getData().data(), writer.size() - 1);
+    bool rejected = !SnapshotCodec::decode(truncated, decoded);
+    CULog("%-15s %10s %10s %10s", "snapshot", "bytes", "encode ns",
+          "decode ns");
+    CULog("%-15s %10zu %10.1f %10.1f  %s, %s (checksum %.0f)", "busy match",
+          writer.size(), encodeNanos, decodeNanos,
+          exact ? "exact" : "NOT EXACT",
+          rejected ? "truncation rejected" : "TRUNCATION ACCEPTED", sink);
+}
+
+/**
+ * Drops the hunter connection for two seconds and resumes the match, over
+ * the loopback transport.
+ *
+ * The drop is played once per network profile on a simulated clock. For
+ * each profile this logs the milliseconds from the drop and from the
+ * rejoin to the applied snapshot, the pause taken by the host, the
+ * connections made to rejoin, and whether the snapshot arrived exactly.
+ */
+void NetBenchmark::runResume() {
+    NetworkConditions perfect;
+    NetworkConditions wifi;
+    wifi.enabled = true;
+    wifi.latency = 30;
+    wifi.jitter = 20;
+    wifi.loss = 0.01f;
+    wifi.reorder = 0.01f;
+    NetworkConditions bad = wifi;
+    bad.latency = 80;
+    bad.jitter = 60;
+    bad.loss = 0.05f;
+    bad.duplicate = 0.01f;
+    bad.reorder = 0.03f;
+    bad.bandwidth = 16000;
+    bad.queue = 300;
+
+    CULog("%-10s %7s %7s %7s %7s", "resume", "outage", "resync", "paused",
+          "joins");
+    ClockSync::setTimeSource(benchMillis);
+    playResume("perfect", perfect);
+    playResume("wifi", wifi);
+    playResume("bad wifi", bad);
+    ClockSync::setTimeSource(nullptr);
+}
+
+/**
+ * Times the state hash of a busy match, and checks that it finds what it
+ * should.
+ *
+ * The hash must not change when the doors and traps are kept in another
+ * order or a trap moves by less than the wire precision, and must change
+ * for a door the other end does not have locked. The detector is then fed
+ * hashes that disagree: once must not be a desync, twice in a row must be,
+ * and a hash taken with an event in flight must never be compared.
+ */
+void NetBenchmark::runDesync() {
+    MatchSnapshot snapshot = busySnapshot();
+    // Folded into the log line so the loop cannot be optimized away
+    Uint32 sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        snapshot.deadline = 215512 + i;
+        sink ^= DesyncDetector::hash(snapshot);
+    }
+    double hashNanos = nanosPerIteration(start);
+    snapshot.deadline = 215512;
+    Uint32 hash = DesyncDetector::hash(snapshot);
+
+    MatchSnapshot shuffled = snapshot;
+    std::reverse(shuffled.lockedDoors.begin(), shuffled.lockedDoors.end());
+    std::reverse(shuffled.traps.begin(), shuffled.traps.end());
+    shuffled.traps[0].position.x += 0.2f / WIRE_COORD_SCALE;
+    bool stable = DesyncDetector::hash(shuffled) == hash;
+    MatchSnapshot diverged = snapshot;
+    diverged.lockedDoors.push_back(7);
+    bool found = DesyncDetector::hash(diverged) != hash;
+
+    DesyncDetector detector;
+    StateHashMessage host{412, 97, hash};
+    Uint32 other = DesyncDetector::hash(diverged);
+    bool once = detector.check(host, 97, 412, other);
+    bool inFlight = detector.check(host, 97, 411, other);
+    detector.check(host, 97, 412, other);
+    bool twice = detector.check(host, 97, 412, other);
+
+    CULog("%-15s %10s", "state hash", "hash ns");
+    CULog("%-15s %10.1f  %s, %s, %s (checksum %u)", "busy match", hashNanos,
+          stable ? "order stable" : "ORDER UNSTABLE",
+          found ? "divergence found" : "DIVERGENCE MISSED",
+          !once && !inFlight && twice ? "strikes right" : "STRIKES WRONG",
+          sink);
+}
+
+
+/**
+ * Plays a match with one, two and three hunters over the loopback
+ * transport, with the host relaying every hunter to the others.
+ *
+ * Each count is played on a simulated clock over simulated wifi. For each
+ * count this logs the bytes per second up and down per hunter, the bytes
+ * per second the host sends, the host microseconds per frame, and the
+ * mean error of the other hunters as each hunter shows them. Every column
+ * should grow at most linearly with the number of hunters.
+ */
+void NetBenchmark::runHunters() {
+    NetworkConditions wifi;
+    wifi.enabled = true;
+    wifi.latency = 30;
+    wifi.jitter = 20;
+    wifi.loss = 0.01f;
+    wifi.reorder = 0.01f;
+
+    CULog("%-10s %7s %7s %7s %7s %7s", "hunters", "up B/s", "down B/s",
+          "host B/s", "host us", "peer err");
+    ClockSync::setTimeSource(benchMillis);
+    for (int count = 1; count <= MAX_HUNTERS; count++) {
+        playHunters(count, wifi);
+    }
+    ClockSync::setTimeSource(nullptr);
+}
+
+
+/**
+ * Streams a hunter pacing through the view of a portrait, with and
+ * without interest management.
+ *
+ * For each this logs the bytes per second of the position stream, the
+ * percentage of frames the hunter streamed at the full rate, and the mean
+ * and worst error of the host position while the spirit could see the
+ * hunter. The mean errors should match. The worst error grows by about a
+ * round trip of walking, from the spirit switching to the portrait while
+ * the hunter is already in its view.
+ */
+void NetBenchmark::runInterest() {
+    CULog("%-10s %7s %7s %7s %7s", "interest", "B/s", "full %", "seen err",
+          "worst");
+    playInterest("off", false);
+    playInterest("on", true);
+
+    CULog("%-10s %7s %7s %7s", "authority", "state", "relay", "full %");
+    playInterestAuthority("off", false);
+    playInterestAuthority("on", true);
+}
+
+#endif /* SC_NET_BENCHMARK */
@@ -0,0 +1,114 @@
+//
+//  SCNetBenchmark.hpp
+//  Sunk Cost
+//
+//  This module provides micro-benchmarks for the networking code. They are
+//  compiled in only when SC_NET_BENCHMARK is defined, and are run once from
+//  SCApp::onStartup with the results written to the log. None of them touch
+//  the network; they measure encoding cost and size in isolation, or run
+//  both ends of a match over the in-memory loopback transport.
+//
+
+#ifndef SCNetBenchmark_hpp
+#define SCNetBenchmark_hpp
+
+#ifdef SC_NET_BENCHMARK
+
+/**
+ * A collection of offline networking benchmarks.
+ */
+class NetBenchmark {
+  public:
+    /**
+     * Runs every benchmark and logs the results.
+     */
+    static void runAll();
+
+    /**
+     * Compares the typed wire protocol against the float vector protocol.
+     *
+     * For every message type this logs the encoded size and the time to
+     * encode plus decode one message with each protocol.
+     */
+    static void runProtocol();
+
+    /**
+     * Replays a scripted hunter walk through the position stream.
+     *
+     * This logs the bandwidth of the delta stream against sending the raw
+     * position every frame the hunter moves.
+     */
+    static void runPositionStream();
+
+    /**
+     * Runs a host and a client against each other over the loopback
+     * transport, with the outbox and reliable channel on both ends.
+     *
+     * The match is played once per network profile on a simulated clock.
+     * For each profile this logs the bytes per frame, the mean event delay,
+     * the mean hunter position error, and whether every event arrived in
+     * order.
+     */
+    static void runLoopback();
+
+    /**
+     * Replays a recorded hunter walk at several one-way latencies and has
+     * the spirit swipe at the hunter it sees.
+     *
+     * For each latency this logs how often the hit test agrees with what
+     * the spirit saw, testing against the newest received position and
+     * against the position rewound through the host history.
+     */
+    static void runLagCompensation();
+
+    /**
+     * Plays a hunter with client-side prediction against a host that
+     * applies its inputs, over the loopback transport.
+     *
+     * The match is played once per network profile on a simulated clock.
+     * For each profile this logs how often and how far the host corrected
+     * the hunter, and how far apart they are once the hunter stands still.
+     */
+    static void runPrediction();
+
+    /**
+     * Times the encoding and decoding of a full match snapshot, and checks
+     * that the round trip is exact.
+     */
+    static void runSnapshot();
+
+    /**
+     * Drops the hunter connection for two seconds and resumes the match
+     * over the loopback transport, once per network profile. This logs the
+     * time from the rejoin to the applied snapshot, which should stay well
+     * under a second.
+     */
+    static void runResume();
+
+    /**
+     * Times the state hash of a busy match, and checks that it ignores the
+     * order of the doors and traps, finds a diverged door, and only reports
+     * a desync that lasts.
+     */
+    static void runDesync();
+
+    /**
+     * Plays a match with one, two and three hunters over the loopback
+     * transport. For each count this logs the bandwidth per hunter and at
+     * the host, and the host time per frame.
+     */
+    static void runHunters();
+
+    /**
+     * Streams a hunter that walks in and out of the view of a portrait,
+     * with and without interest management. This logs the bandwidth of
+     * the position stream and the error of the host position while the
+     * spirit can see the hunter, then the bandwidth of the authoritative
+     * states and the relay the host sends about the same hunter.
+     */
+    static void runInterest();
+};
+
+#endif /* SC_NET_BENCHMARK */
+
+#endif /* SCNetBenchmark_hpp */
@@ -0,0 +1,328 @@
+//
+//  SCNetTelemetry.cpp
+//  Sunk Cost
+//
+//  This module provides the wire-level telemetry of one peer.
+//  See the header for details.
+//
+
+#include "SCNetTelemetry.hpp"
+#include "SCClockSync.hpp"
+#include <cstdio>
+#include <fstream>
+
+using namespace cugl;
+
+/** The inclusive upper limits of the latency buckets in milliseconds */
+static const std::array<Uint32, LATENCY_BUCKETS> BUCKET_LIMITS = {
+    10, 20, 30, 50, 75, 100, 150, 200, 300, 500, 1000, UINT32_MAX};
+
+#pragma mark -
+#pragma mark Histogram
+
+/**
+ * Forgets every sample
+ */
+void LatencyHistogram::reset() {
+    _counts.fill(0);
+    _total = 0;
+    _sum = 0;
+    _max = 0;
+}
+
+/**
+ * Adds a sample.
+ *
+ * @param millis    The latency in milliseconds
+ */
+void LatencyHistogram::add(Uint32 millis) {
+    size_t bucket = 0;
+    while (millis > BUCKET_LIMITS[bucket]) {
+        bucket++;
+    }
+    _counts[bucket]++;
+    _total++;
+    _sum += millis;
+    _max = std::max(_max, millis);
+}
+
+/**
+ * Returns the inclusive upper limit of a bucket in milliseconds.
+ *
+ * @param bucket    The bucket index
+ *
+ * @return the inclusive upper limit of a bucket in milliseconds
+ */
+Uint32 LatencyHistogram::getLimit(size_t bucket) {
+    return BUCKET_LIMITS[bucket];
+}
+
+/**
+ * Returns an upper bound on a percentile.
+ *
+ * @param fraction  The percentile as a fraction in [0, 1]
+ *
+ * @return an upper bound on a percentile, or 0 if there are no samples
+ */
+Uint32 LatencyHistogram::getPercentile(float fraction) const {
+    if (_total == 0) {
+        return 0;
+    }
+    Uint64 target = static_cast<Uint64>(std::ceil(fraction * _total));
+    Uint64 seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += _counts[i];
+        if (seen >= target && seen > 0) {
+            return std::min(BUCKET_LIMITS[i], _max);
+        }
+    }
+    return _max;
+}
+
+#pragma mark -
+#pragma mark Telemetry
+
+void NetTelemetry::Traffic::add(size_t size) {
+    Uint32 length = static_cast<Uint32>(size);
+    minSize = messages == 0 ? length : std::min(minSize, length);
+    maxSize = std::max(maxSize, length);
+    messages++;
+    bytes += size;
+}
+
+void NetTelemetry::Traffic::measure(float seconds) {
+    messageRate = (messages - lastMessages) / seconds;
+    byteRate = (bytes - lastBytes) / seconds;
+    lastMessages = messages;
+    lastBytes = bytes;
+}
+
+/**
+ * Reads the configuration and names the dump files.
+ *
+ * @param json  The contents of json/telemetry.json, or nullptr
+ * @param name  The file name prefix, such as "hunter" or "spirit"
+ */
+void NetTelemetry::init(const std::shared_ptr<JsonValue>& json,
+                        const std::string& name) {
+    _name = name;
+    if (json != nullptr) {
+        _overlay = json->getBool("overlay", false);
+        _dumpInterval = static_cast<Uint32>(
+            json->getFloat("dump interval", 0) * 1000);
+        _format = json->getString("format", "csv") == "json" ? Format::JSON
+                                                              : Format::CSV;
+    }
+    reset();
+}
+
+/**
+ * Forgets every statistic, keeping the configuration
+ */
+void NetTelemetry::reset() {
+    _sent.fill(Traffic());
+    _received.fill(Traffic());
+    _packetsSent = Traffic();
+    _packetsReceived = Traffic();
+    _rtt.reset();
+    _delay.reset();
+    _start = ClockSync::localMillis();
+    _lastRate = _start;
+    _lastDump = _start;
+    _headers = false;
+}
+
+/**
+ * Counts a message queued for sending.
+ *
+ * @param type  The message type
+ * @param size  The encoded size in bytes, without framing
+ */
+void NetTelemetry::recordSent(MessageType type, size_t size) {
+    _sent[static_cast<size_t>(type)].add(size);
+}
+
+/**
+ * Counts a message unpacked from a packet.
+ *
+ * @param type  The message type
+ * @param size  The encoded size in bytes, without framing
+ */
+void NetTelemetry::recordReceived(MessageType type, size_t size) {
+    _received[static_cast<size_t>(type)].add(size);
+}
+
+/**
+ * Measures rates and writes a dump when one is due.
+ *
+ * This should be called once per frame.
+ */
+void NetTelemetry::update() {
+    Uint32 now = ClockSync::localMillis();
+    if (now - _lastRate >= TELEMETRY_RATE_INTERVAL) {
+        float seconds = (now - _lastRate) / 1000.0f;
+        for (size_t i = 0; i < MESSAGE_TYPE_LIMIT; i++) {
+            _sent[i].measure(seconds);
+            _received[i].measure(seconds);
+        }
+        _packetsSent.measure(seconds);
+        _packetsReceived.measure(seconds);
+        _lastRate = now;
+    }
+    if (_dumpInterval > 0 && now - _lastDump >= _dumpInterval) {
+        dump();
+        _lastDump = now;
+    }
+}
+
+/**
+ * Writes the current state to the save directory now.
+ *
+ * @return true if the dump was written
+ */
+bool NetTelemetry::dump() {
+    std::string prefix = Application::get()->getSaveDirectory() + _name;
+    Uint32 now = ClockSync::localMillis() - _start;
+    bool written = _format == Format::JSON ? dumpJSON(prefix, now)
+                                           : dumpCSV(prefix, now);
+    if (!written) {
+        CULog("telemetry: could not write %s", prefix.c_str());
+    }
+    return written;
+}
+
+/**
+ * Appends the current state to the CSV files
+ */
+bool NetTelemetry::dumpCSV(const std::string& prefix, Uint32 now) {
+    std::ios::openmode mode = _headers ? std::ios::app : std::ios::trunc;
+    std::ofstream messages(prefix + "-messages.csv", mode);
+    std::ofstream latency(prefix + "-latency.csv", mode);
+    if (!messages || !latency) {
+        return false;
+    }
+    if (!_headers) {
+        messages << "time_ms,direction,type,messages,bytes,msgs_per_s,"
+                    "bytes_per_s,min_size,max_size,avg_size\n";
+        latency << "time_ms,histogram,limit_ms,count\n";
+        _headers = true;
+    }
+
+    auto row = [&](const char* direction, const char* type,
+                   const Traffic& traffic) {
+        if (traffic.messages == 0) {
+            return;
+        }
+        messages << now << ',' << direction << ',' << type << ','
+                 << traffic.messages << ',' << traffic.bytes << ','
+                 << traffic.messageRate << ',' << traffic.byteRate << ','
+                 << traffic.minSize << ',' << traffic.maxSize << ','
+                 << (float)traffic.bytes / traffic.messages << '\n';
+    };
+    for (size_t i = 0; i < MESSAGE_TYPE_LIMIT; i++) {
+        const char* type = MessageCodec::name(static_cast<MessageType>(i));
+        row("sent", type, _sent[i]);
+        row("received", type, _received[i]);
+    }
+    row("sent", "packets", _packetsSent);
+    row("received", "packets", _packetsReceived);
+
+    auto histogram = [&](const char* name, const LatencyHistogram& values) {
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            latency << now << ',' << name << ',';
+            if (i + 1 < LATENCY_BUCKETS) {
+                latency << LatencyHistogram::getLimit(i);
+            } else {
+                latency << "inf";
+            }
+            latency << ',' << values.getCount(i) << '\n';
+        }
+    };
+    histogram("rtt", _rtt);
+    histogram("owd", _delay);
+    return messages.good() && latency.good();
+}
+
+/**
+ * Writes the current state as a JSON snapshot
+ */
+bool NetTelemetry::dumpJSON(const std::string& prefix, Uint32 now) {
+    std::ofstream out(prefix + ".json", std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    auto traffic = [&](const Traffic& t) {
+        out << "{\"messages\": " << t.messages << ", \"bytes\": " << t.bytes
+            << ", \"msgs_per_s\": " << t.messageRate
+            << ", \"bytes_per_s\": " << t.byteRate
+            << ", \"min_size\": " << t.minSize
+            << ", \"max_size\": " << t.maxSize << "}";
+    };
+    auto histogram = [&](const LatencyHistogram& values) {
+        out << "{\"count\": " << values.getTotal()
+            << ", \"mean\": " << values.getMean()
+            << ", \"p50\": " << values.getPercentile(0.5f)
+            << ", \"p95\": " << values.getPercentile(0.95f)
+            << ", \"max\": " << values.getMax() << ", \"buckets\": [";
+        for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+            out << (i > 0 ? ", " : "") << values.getCount(i);
+        }
+        out << "]}";
+    };
+
+    out << "{\n  \"time_ms\": " << now << ",\n  \"limits_ms\": [";
+    for (size_t i = 0; i + 1 < LATENCY_BUCKETS; i++) {
+        out << (i > 0 ? ", " : "") << LatencyHistogram::getLimit(i);
+    }
+    out << "],\n  \"packets\": {\"sent\": ";
+    traffic(_packetsSent);
+    out << ", \"received\": ";
+    traffic(_packetsReceived);
+    out << "},\n  \"rtt\": ";
+    histogram(_rtt);
+    out << ",\n  \"owd\": ";
+    histogram(_delay);
+    out << ",\n  \"types\": {";
+    bool first = true;
+    for (size_t i = 0; i < MESSAGE_TYPE_LIMIT; i++) {
+        if (_sent[i].messages == 0 && _received[i].messages == 0) {
+            continue;
+        }
+        out << (first ? "\n" : ",\n") << "    \""
+            << MessageCodec::name(static_cast<MessageType>(i))
+            << "\": {\"sent\": ";
+        traffic(_sent[i]);
+        out << ", \"received\": ";
+        traffic(_received[i]);
+        out << "}";
+        first = false;
+    }
+    out << "\n  }\n}\n";
+    return out.good();
+}
+
+/**
+ * Returns a one-line summary for the overlay.
+ *
+ * @return a one-line summary for the overlay
+ */
+std::string NetTelemetry::getSummary() const {
+    size_t top = 0;
+    for (size_t i = 1; i < MESSAGE_TYPE_LIMIT; i++) {
+        if (_sent[i].byteRate > _sent[top].byteRate) {
+            top = i;
+        }
+    }
+    char line[192];
+    std::snprintf(line, sizeof(line),
+                  "tx %.0f B/s %.0f pkt/s  rx %.0f B/s %.0f pkt/s  "
+                  "rtt %u/%u  owd %u/%u  top %s %.0f B/s",
+                  _packetsSent.byteRate, _packetsSent.messageRate,
+                  _packetsReceived.byteRate, _packetsReceived.messageRate,
+                  _rtt.getPercentile(0.5f), _rtt.getPercentile(0.95f),
+                  _delay.getPercentile(0.5f), _delay.getPercentile(0.95f),
+                  MessageCodec::name(static_cast<MessageType>(top)),
+                  _sent[top].byteRate);
+    return line;
+}
@@ -0,0 +1,239 @@
+//
+//  SCNetTelemetry.hpp
+//  Sunk Cost
+//
+//  This module provides the wire-level telemetry of one peer.
+//
+//  Every message sent through the outbox and every message unpacked from a
+//  packet is counted per opcode, with its encoded size. Round trip times
+//  (clock pings and reliable acknowledgements) and one-way delays (stamped
+//  messages from a synced peer) go into fixed-bucket histograms. Rates are
+//  measured over the last whole second.
+//
+//  The telemetry is read in two ways: a one-line summary for an in-game
+//  overlay, and a periodic dump to the save directory, either as CSV rows
+//  appended to <name>-messages.csv and <name>-latency.csv or as a JSON
+//  snapshot in <name>.json. Both are configured by json/telemetry.json.
+//
+
+#ifndef SCNetTelemetry_hpp
+#define SCNetTelemetry_hpp
+
+#include "SCMessage.hpp"
+#include <array>
+#include <cugl/cugl.h>
+#include <string>
+
+/** The number of buckets in a latency histogram */
+#define LATENCY_BUCKETS 12
+/** The milliseconds between rate measurements */
+#define TELEMETRY_RATE_INTERVAL 1000
+/** The longest one-way delay believed; longer means the clocks disagree */
+#define TELEMETRY_MAX_DELAY 5000
+
+/**
+ * A histogram of latencies in milliseconds with fixed buckets.
+ */
+class LatencyHistogram {
+  private:
+    /** The number of samples in each bucket */
+    std::array<Uint64, LATENCY_BUCKETS> _counts;
+    /** The number of samples */
+    Uint64 _total;
+    /** The sum of all samples */
+    double _sum;
+    /** The largest sample */
+    Uint32 _max;
+
+  public:
+    LatencyHistogram() { reset(); }
+
+    /** Forgets every sample */
+    void reset();
+
+    /**
+     * Adds a sample.
+     *
+     * @param millis    The latency in milliseconds
+     */
+    void add(Uint32 millis);
+
+    /**
+     * Returns the inclusive upper limit of a bucket in milliseconds.
+     *
+     * The last bucket has no limit and returns UINT32_MAX.
+     *
+     * @param bucket    The bucket index
+     *
+     * @return the inclusive upper limit of a bucket in milliseconds
+     */
+    static Uint32 getLimit(size_t bucket);
+
+    /** Returns the number of samples in a bucket */
+    Uint64 getCount(size_t bucket) const { return _counts[bucket]; }
+
+    /** Returns the number of samples */
+    Uint64 getTotal() const { return _total; }
+
+    /** Returns the mean sample, or 0 if there are none */
+    float getMean() const { return _total > 0 ? _sum / _total : 0; }
+
+    /** Returns the largest sample */
+    Uint32 getMax() const { return _max; }
+
+    /**
+     * Returns an upper bound on a percentile.
+     *
+     * This is the limit of the bucket holding the percentile, or the
+     * largest sample if that is smaller.
+     *
+     * @param fraction  The percentile as a fraction in [0, 1]
+     *
+     * @return an upper bound on a percentile, or 0 if there are no samples
+     */
+    Uint32 getPercentile(float fraction) const;
+};
+
+/**
+ * The message, rate and latency statistics of one peer.
+ */
+class NetTelemetry {
+  public:
+    /** The dump file format */
+    enum class Format { CSV, JSON };
+
+  private:
+    /** The traffic of one message type in one direction */
+    struct Traffic {
+        Uint64 messages = 0;
+        Uint64 bytes = 0;
+        Uint32 minSize = 0;
+        Uint32 maxSize = 0;
+        /** The totals at the last rate measurement */
+        Uint64 lastMessages = 0;
+        Uint64 lastBytes = 0;
+        /** The rates over the last measurement interval */
+        float messageRate = 0;
+        float byteRate = 0;
+
+        void add(size_t size);
+        void measure(float seconds);
+    };
+
+    /** The file name prefix in the save directory */
+    std::string _name;
+    /** Whether the overlay should be shown */
+    bool _overlay;
+    /** The milliseconds between dumps, or 0 for none */
+    Uint32 _dumpInterval;
+    /** The dump format */
+    Format _format;
+
+    /** The messages sent, by opcode */
+    std::array<Traffic, MESSAGE_TYPE_LIMIT> _sent;
+    /** The messages received, by opcode */
+    std::array<Traffic, MESSAGE_TYPE_LIMIT> _received;
+    /** The packets sent, with framing */
+    Traffic _packetsSent;
+    /** The packets received, with framing */
+    Traffic _packetsReceived;
+    /** The round trip times */
+    LatencyHistogram _rtt;
+    /** The one-way delays */
+    LatencyHistogram _delay;
+
+    /** The local time telemetry started */
+    Uint32 _start;
+    /** The local time of the last rate measurement */
+    Uint32 _lastRate;
+    /** The local time of the last dump */
+    Uint32 _lastDump;
+    /** Whether the CSV headers have been written */
+    bool _headers;
+
+    /** Appends the current state to the CSV files */
+    bool dumpCSV(const std::string& prefix, Uint32 now);
+
+    /** Writes the current state as a JSON snapshot */
+    bool dumpJSON(const std::string& prefix, Uint32 now);
+
+  public:
+    NetTelemetry()
+        : _name("telemetry"), _overlay(false), _dumpInterval(0),
+          _format(Format::CSV) {
+        reset();
+    }
+
+    /**
+     * Reads the configuration and names the dump files.
+     *
+     * @param json  The contents of json/telemetry.json, or nullptr
+     * @param name  The file name prefix, such as "hunter" or "spirit"
+     */
+    void init(const std::shared_ptr<cugl::JsonValue>& json,
+              const std::string& name);
+
+    /** Forgets every statistic, keeping the configuration */
+    void reset();
+
+    /** Returns true if the in-game overlay should be shown */
+    bool showOverlay() const { return _overlay; }
+
+    /**
+     * Counts a message queued for sending.
+     *
+     * @param type  The message type
+     * @param size  The encoded size in bytes, without framing
+     */
+    void recordSent(MessageType type, size_t size);
+
+    /**
+     * Counts a message unpacked from a packet.
+     *
+     * @param type  The message type
+     * @param size  The encoded size in bytes, without framing
+     */
+    void recordReceived(MessageType type, size_t size);
+
+    /** Counts a packet handed to the transport */
+    void recordPacketSent(size_t size) { _packetsSent.add(size); }
+
+    /** Counts a packet received from the transport */
+    void recordPacketReceived(size_t size) { _packetsReceived.add(size); }
+
+    /** Adds a round trip time in milliseconds */
+    void recordRoundTrip(Uint32 millis) { _rtt.add(millis); }
+
+    /** Adds a one-way delay in milliseconds */
+    void recordDelay(Uint32 millis) { _delay.add(millis); }
+
+    /**
+     * Measures rates and writes a dump when one is due.
+     *
+     * This should be called once per frame.
+     */
+    void update();
+
+    /**
+     * Writes the current state to the save directory now.
+     *
+     * @return true if the dump was written
+     */
+    bool dump();
+
+    /**
+     * Returns a one-line summary for the overlay.
+     *
+     * This shows the packet rates in each direction, the round trip and
+     * one-way delay percentiles, and the most expensive message type.
+     *
+     * @return a one-line summary for the overlay
+     */
+    std::string getSummary() const;
+
+    const LatencyHistogram& getRoundTrips() const { return _rtt; }
+
+    const LatencyHistogram& getDelays() const { return _delay; }
+};
+
+#endif /* SCNetTelemetry_hpp */
@@ -0,0 +1,50 @@
+//
+//  SCNetcodeTransport.cpp
+//  Sunk Cost
+//
+//  This module provides the transport over the CUGL netcode lobby.
+//  See the header for details.
+//
+
+#include "SCNetcodeTransport.hpp"
+
+bool NetcodeTransport::open() { return _connection->open(); }
+
+void NetcodeTransport::close() { _connection->close(); }
+
+Transport::State NetcodeTransport::getState() const {
+    return _connection->getState();
+}
+
+const std::string NetcodeTransport::getHost() const {
+    return _connection->getHost();
+}
+
+const std::string NetcodeTransport::getUUID() const {
+    return _connection->getUUID();
+}
+
+const std::string NetcodeTransport::getRoom() const {
+    return _connection->getRoom();
+}
+
+size_t NetcodeTransport::getNumPlayers() const {
+    return _connection->getNumPlayers();
+}
+
+bool NetcodeTransport::broadcast(const std::vector<std::byte>& data) {
+    return _connection->broadcast(data);
+}
+
+bool NetcodeTransport::sendToHost(const std::vector<std::byte>& data) {
+    return _connection->sendToHost(data);
+}
+
+bool NetcodeTransport::sendTo(const std::string& dest,
+                              const std::vector<std::byte>& data) {
+    return _connection->sendTo(dest, data);
+}
+
+void NetcodeTransport::receive(const Dispatcher& dispatcher) {
+    _connection->receive(dispatcher);
+}
@@ -0,0 +1,84 @@
+//
+//  SCNetcodeTransport.hpp
+//  Sunk Cost
+//
+//  This module provides the transport over the CUGL netcode lobby. It is a
+//  thin forwarding wrapper around NetcodeConnection.
+//
+
+#ifndef SCNetcodeTransport_hpp
+#define SCNetcodeTransport_hpp
+
+#include "SCTransport.hpp"
+#include <cugl/cugl.h>
+
+/**
+ * A transport backed by a CUGL NetcodeConnection.
+ */
+class NetcodeTransport : public Transport {
+  private:
+    /** The underlying connection */
+    std::shared_ptr<cugl::net::NetcodeConnection> _connection;
+
+  public:
+    /**
+     * Creates a transport around an existing connection.
+     *
+     * @param connection    The connection to forward to
+     */
+    NetcodeTransport(
+        const std::shared_ptr<cugl::net::NetcodeConnection>& connection)
+        : _connection(connection) {}
+
+    /**
+     * Returns a transport that hosts a new room on the lobby.
+     *
+     * @param config    The lobby configuration
+     *
+     * @return a transport that hosts a new room on the lobby
+     */
+    static std::shared_ptr<NetcodeTransport>
+    alloc(const cugl::net::NetcodeConfig& config) {
+        return std::make_shared<NetcodeTransport>(
+            cugl::net::NetcodeConnection::alloc(config));
+    }
+
+    /**
+     * Returns a transport that joins an existing room on the lobby.
+     *
+     * @param config    The lobby configuration
+     * @param room      The room to join
+     *
+     * @return a transport that joins an existing room on the lobby
+     */
+    static std::shared_ptr<NetcodeTransport>
+    alloc(const cugl::net::NetcodeConfig& config, const std::string& room) {
+        return std::make_shared<NetcodeTransport>(
+            cugl::net::NetcodeConnection::alloc(config, room));
+    }
+
+    bool open() override;
+
+    void close() override;
+
+    State getState() const override;
+
+    const std::string getHost() const override;
+
+    const std::string getUUID() const override;
+
+    const std::string getRoom() const override;
+
+    size_t getNumPlayers() const override;
+
+    bool broadcast(const std::vector<std::byte>& data) override;
+
+    bool sendToHost(const std::vector<std::byte>& data) override;
+
+    bool sendTo(const std::string& dest,
+                const std::vector<std::byte>& data) override;
+
+    void receive(const Dispatcher& dispatcher) override;
+};
+
+#endif /* SCNetcodeTransport_hpp */
@@ -0,0 +1,231 @@
+//
+//  SCOutbox.cpp
+//  Sunk Cost
+//
+//  This module provides the frame-scoped outbox for gameplay messages.
+//  See the header for details.
+//
+
+#include "SCOutbox.hpp"
+
+/**
+ * Drops every queued message and clears the statistics
+ */
+void Outbox::reset() {
+    _batches.clear();
+    _frames = 0;
+    _packets = 0;
+    _bytes = 0;
+    _messages = 0;
+    _superseded = 0;
+}
+
+/**
+ * Returns true if only the latest message of this type matters.
+ *
+ * @param type  The message type
+ *
+ * @return true if a newer message of this type supersedes an older one
+ */
+bool Outbox::isState(MessageType type) {
+    switch (type) {
+    case MessageType::CameraState:
+    case MessageType::MatchDeadline:
+    case MessageType::PositionAck:
+    case MessageType::ReliableAck:
+    case MessageType::HunterState:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Returns the batch for a destination, creating it if necessary
+ */
+Outbox::Batch& Outbox::getBatch(Route route, const std::string& dest) {
+    for (Batch& batch : _batches) {
+        if (batch.route == route && batch.dest == dest) {
+            return batch;
+        }
+    }
+    _batches.push_back({route, dest, MessageWriter(), {}});
+    return _batches.back();
+}
+
+/**
+ * Queues a message to be sent at the next flush.
+ *
+ * @param message   The message to send
+ * @param route     Where to send the message
+ * @param dest      The peer UUID when route is Peer
+ *
+ * @return the encoded size of the message in bytes
+ */
+size_t Outbox::push(const GameMessage& message, Route route,
+                    const std::string& dest) {
+    Batch& batch = getBatch(route, dest);
+    _scratch.reset();
+    MessageCodec::encode(message, _scratch);
+    _framed.reset();
+    _framed.writeUint(static_cast<Uint32>(_scratch.size()));
+    _framed.writeBytes(_scratch.getData().data(), _scratch.size());
+
+    if (isState(message.type)) {
+        for (size_t i = 0; i < batch.entries.size(); i++) {
+            Entry& queued = batch.entries[i];
+            if (queued.type != message.type) {
+                continue;
+            }
+            // Patch the older copy in place, moving the messages after it
+            batch.packet.replaceBytes(queued.offset, queued.length,
+                                      _framed.getData().data(),
+                                      _framed.size());
+            for (size_t j = i + 1; j < batch.entries.size(); j++) {
+                batch.entries[j].offset += _framed.size();
+                batch.entries[j].offset -= queued.length;
+            }
+            queued.length = _framed.size();
+            queued.size = _scratch.size();
+            _superseded++;
+            return _scratch.size();
+        }
+    }
+    batch.entries.push_back(
+        {message.type, batch.packet.size(), _framed.size(), _scratch.size()});
+    batch.packet.writeBytes(_framed.getData().data(), _framed.size());
+    return _scratch.size();
+}
+
+/**
+ * Queues a reliable event and its header as a single frame.
+ *
+ * A receiver that cannot decode either drops both, so an event can never
+ * be taken for the one its header numbers.
+ *
+ * @param seq       The sequence number of the event
+ * @param event     The event to send
+ * @param route     Where to send the event
+ * @param dest      The peer UUID when route is Peer
+ */
+void Outbox::pushReliable(Uint16 seq, const GameMessage& event, Route route,
+                          const std::string& dest) {
+    Batch& batch = getBatch(route, dest);
+    _scratch.reset();
+    MessageCodec::encode(ReliableMessage{seq}, _scratch);
+    size_t header = _scratch.size();
+    MessageCodec::encode(event, _scratch);
+    _framed.reset();
+    _framed.writeUint(static_cast<Uint32>(_scratch.size()));
+    _framed.writeBytes(_scratch.getData().data(), _scratch.size());
+
+    // Neither is a state message, so only the telemetry reads these entries
+    size_t offset = batch.packet.size();
+    batch.entries.push_back(
+        {MessageType::Reliable, offset, _framed.size(), header});
+    batch.entries.push_back({event.type, offset, 0, _scratch.size() - header});
+    batch.packet.writeBytes(_framed.getData().data(), _framed.size());
+}
+
+/**
+ * Sends one packet per destination with everything queued this frame.
+ *
+ * This should be called exactly once at the end of every frame.
+ *
+ * @param network   The connection to send on
+ */
+void Outbox::flush(const std::shared_ptr<Transport>& network) {
+    _frames++;
+    for (auto it = _batches.begin(); it != _batches.end();) {
+        if (it->entries.empty()) {
+            // Peer batches are per-request; do not let them pile up
+            it = it->route == Route::Peer ? _batches.erase(it) : it + 1;
+            continue;
+        }
+
+        if (_telemetry != nullptr) {
+            for (const Entry& entry : it->entries) {
+                _telemetry->recordSent(entry.type, entry.size);
+            }
+        }
+        _messages += it->entries.size();
+
+        const std::vector<std::byte>& packet = it->packet.getData();
+        if (network) {
+            switch (it->route) {
+            case Route::Broadcast:
+                network->broadcast(packet);
+                break;
+            case Route::Host:
+                network->sendToHost(packet);
+                break;
+            case Route::Peer:
+                network->sendTo(it->dest, packet);
+                break;
+            }
+            _packets++;
+            _bytes += packet.size();
+            if (_telemetry != nullptr) {
+                _telemetry->recordPacketSent(packet.size());
+            }
+        }
+        it->packet.reset();
+        it->entries.clear();
+        ++it;
+    }
+
+    if (_frames % OUTBOX_LOG_INTERVAL == 0) {
+        CULog("outbox: %.2f packets/frame, %.2f msgs/frame, %.1f bytes/frame, "
+              "%llu superseded",
+              getPacketsPerFrame(), getMessagesPerFrame(), getBytesPerFrame(),
+              (unsigned long long)_superseded);
+    }
+}
+
+/**
+ * Decodes every message in a packet produced by {@link #flush}.
+ *
+ * A frame that does not decode, such as one with an unknown opcode, is
+ * passed to dropped and skipped; a reliable header and its event are handed
+ * over together or dropped together. Decoding stops at the first frame
+ * whose length is corrupt.
+ *
+ * @param packet    The packet received from the network
+ * @param handler   Called with each message and its encoded size
+ * @param dropped   Called with the size of each frame that was skipped
+ *
+ * @return false if the packet framing is corrupt
+ */
+bool Outbox::unpack(
+    const std::vector<std::byte>& packet,
+    const std::function<void(const GameMessage&, size_t)>& handler,
+    const std::function<void(size_t)>& dropped) {
+    MessageReader reader(packet);
+    GameMessage message;
+    GameMessage event;
+    while (reader.hasMore()) {
+        Uint32 length = reader.readUint();
+        if (!reader.ok() || length > reader.remaining()) {
+            return false;
+        }
+        MessageReader body(reader.cursor(), length);
+        bool valid = MessageCodec::decode(body, message);
+        if (valid && message.type == MessageType::Reliable) {
+            // The event is the rest of the frame of its header
+            size_t header = body.position();
+            valid = body.hasMore() && MessageCodec::decode(body, event) &&
+                    event.type != MessageType::Reliable;
+            if (valid) {
+                handler(message, header);
+                handler(event, length - header);
+            }
+        } else if (valid) {
+            handler(message, length);
+        }
+        if (!valid && dropped) {
+            dropped(length);
+        }
+        reader.skip(length);
+    }
+    return reader.ok();
+}
@@ -0,0 +1,185 @@
+//
+//  SCOutbox.hpp
+//  Sunk Cost
+//
+//  This module provides the frame-scoped outbox for gameplay messages.
+//
+//  Controllers push messages into the outbox while they update, and the
+//  outbox sends everything for one destination as a single packet when it
+//  is flushed at the end of the frame. Inside a packet each message is
+//  prefixed by its varint length, so a receiver can skip messages it does
+//  not understand. State messages that only matter in their latest form
+//  (such as the camera index) replace an earlier copy queued in the same
+//  frame instead of being sent twice. Each message is encoded once, into
+//  the packet of its destination, when it is pushed.
+//
+
+#ifndef SCOutbox_hpp
+#define SCOutbox_hpp
+
+#include "SCMessage.hpp"
+#include "SCNetTelemetry.hpp"
+#include "SCTransport.hpp"
+#include <cugl/cugl.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+/** The number of flushes between outbox statistics in the log */
+#define OUTBOX_LOG_INTERVAL 600
+
+/**
+ * A per-frame queue of outgoing messages, batched by destination.
+ */
+class Outbox {
+  public:
+    /** Where a message is sent */
+    enum class Route {
+        /** To every other peer */
+        Broadcast,
+        /** To the host only */
+        Host,
+        /** To a single peer, named by UUID */
+        Peer
+    };
+
+  private:
+    /** A message queued in a batch */
+    struct Entry {
+        MessageType type;
+        /** Where the framed message starts in the packet */
+        size_t offset;
+        /** The size of the framed message, with its length prefix */
+        size_t length;
+        /** The encoded size of the message alone */
+        size_t size;
+    };
+
+    /** The messages queued this frame for one destination */
+    struct Batch {
+        Route route;
+        std::string dest;
+        /** The packet so far; each message is encoded once, when pushed */
+        MessageWriter packet;
+        std::vector<Entry> entries;
+    };
+
+    /** The batches, kept between frames to reuse their storage */
+    std::vector<Batch> _batches;
+    /** The buffer for the message being pushed */
+    MessageWriter _scratch;
+    /** The buffer for the message being pushed, with its length prefix */
+    MessageWriter _framed;
+
+    /** The number of flushes */
+    Uint64 _frames;
+    /** The number of packets sent */
+    Uint64 _packets;
+    /** The number of bytes sent */
+    Uint64 _bytes;
+    /** The number of messages sent */
+    Uint64 _messages;
+    /** The number of messages replaced by a newer copy */
+    Uint64 _superseded;
+    /** The telemetry to report sent traffic to, if any */
+    NetTelemetry* _telemetry;
+
+    /** Returns the batch for a destination, creating it if necessary */
+    Batch& getBatch(Route route, const std::string& dest);
+
+  public:
+    Outbox() : _telemetry(nullptr) { reset(); }
+
+    /** Drops every queued message and clears the statistics */
+    void reset();
+
+    /**
+     * Reports every message and packet sent to the given telemetry.
+     *
+     * @param telemetry The telemetry, or nullptr to stop reporting
+     */
+    void setTelemetry(NetTelemetry* telemetry) { _telemetry = telemetry; }
+
+    /**
+     * Returns true if only the latest message of this type matters.
+     *
+     * @param type  The message type
+     *
+     * @return true if a newer message of this type supersedes an older one
+     */
+    static bool isState(MessageType type);
+
+    /**
+     * Queues a message to be sent at the next flush.
+     *
+     * @param message   The message to send
+     * @param route     Where to send the message
+     * @param dest      The peer UUID when route is Peer
+     *
+     * @return the encoded size of the message in bytes
+     */
+    size_t push(const GameMessage& message, Route route = Route::Broadcast,
+                const std::string& dest = "");
+
+    /**
+     * Queues a reliable event and its header as a single frame.
+     *
+     * A receiver that cannot decode either drops both, so an event can
+     * never be taken for the one its header numbers.
+     *
+     * @param seq       The sequence number of the event
+     * @param event     The event to send
+     * @param route     Where to send the event
+     * @param dest      The peer UUID when route is Peer
+     */
+    void pushReliable(Uint16 seq, const GameMessage& event, Route route,
+                      const std::string& dest);
+
+    /**
+     * Sends one packet per destination with everything queued this frame.
+     *
+     * This should be called exactly once at the end of every frame.
+     *
+     * @param network   The connection to send on
+     */
+    void flush(const std::shared_ptr<Transport>& network);
+
+    /**
+     * Decodes every message in a packet produced by {@link #flush}.
+     *
+     * A frame that does not decode, such as one with an unknown opcode, is
+     * passed to dropped and skipped; a reliable header and its event are
+     * handed over together or dropped together. Decoding stops at the first
+     * frame whose length is corrupt.
+     *
+     * @param packet    The packet received from the network
+     * @param handler   Called with each message and its encoded size
+     * @param dropped   Called with the size of each frame that was skipped
+     *
+     * @return false if the packet framing is corrupt
+     */
+    static bool
+    unpack(const std::vector<std::byte>& packet,
+           const std::function<void(const GameMessage&, size_t)>& handler,
+           const std::function<void(size_t)>& dropped = nullptr);
+
+    /** Returns the average packets sent per frame */
+    float getPacketsPerFrame() const {
+        return _frames == 0 ? 0 : (float)_packets / _frames;
+    }
+
+    /** Returns the average bytes sent per frame */
+    float getBytesPerFrame() const {
+        return _frames == 0 ? 0 : (float)_bytes / _frames;
+    }
+
+    /** Returns the average messages sent per frame */
+    float getMessagesPerFrame() const {
+        return _frames == 0 ? 0 : (float)_messages / _frames;
+    }
+
+    /** Returns the number of messages replaced by a newer copy */
+    Uint64 getSuperseded() const { return _superseded; }
+};
+
+#endif /* SCOutbox_hpp */
@@ -0,0 +1,85 @@
+//
+//  SCPositionHistory.cpp
+//  Sunk Cost
+//
+//  This module provides the host history of a remote player position, for
+//  lag-compensated hit tests. See the header for details.
+//
+
+#include "SCPositionHistory.hpp"
+#include <algorithm>
+
+using namespace cugl;
+
+/**
+ * Drops every sample and statistic
+ */
+void PositionHistory::reset() {
+    _head = 0;
+    _count = 0;
+    _rewinds = 0;
+    _clamped = 0;
+}
+
+/**
+ * Adds a sample from the network.
+ *
+ * @param time      The low 16 bits of the sender synced clock
+ * @param position  The sampled position
+ * @param now       The local synced clock in milliseconds
+ */
+void PositionHistory::record(Uint16 time, Vec2 position, Uint32 now) {
+    // Unwrap against the newest sample, or the local clock for the first
+    Sint64 reference = _count > 0 ? getNewest() : static_cast<Sint64>(now);
+    Sint64 full =
+        reference + static_cast<Sint16>(static_cast<Uint16>(time - reference));
+    if (_count > 0 && full <= getNewest()) {
+        return;
+    }
+    if (_count == HISTORY_CAPACITY) {
+        _head = (_head + 1) % HISTORY_CAPACITY;
+        _count--;
+    }
+    _samples[(_head + _count) % HISTORY_CAPACITY] = {full, position};
+    _count++;
+}
+
+/**
+ * Returns the position at the given sender time.
+ *
+ * @param time      The unwrapped sender time, such as a render time
+ * @param now       The local synced clock in milliseconds
+ * @param position  Set to the position if this returns true
+ *
+ * @return false if there are no samples
+ */
+bool PositionHistory::rewind(Sint64 time, Uint32 now, Vec2& position) {
+    if (_count == 0) {
+        return false;
+    }
+    _rewinds++;
+    // Unwrap now the same way as the samples
+    Sint64 newest = getNewest();
+    Sint64 host =
+        newest + static_cast<Sint32>(static_cast<Uint32>(now - newest));
+    Sint64 oldest = host - LAG_MAX_REWIND;
+    if (time < oldest) {
+        time = oldest;
+        _clamped++;
+    }
+
+    // Search back from the newest sample, since rewinds are short
+    size_t i = _count - 1;
+    while (i > 0 && at(i).time > time) {
+        i--;
+    }
+    const Sample& before = at(i);
+    if (time <= before.time || i + 1 == _count) {
+        position = before.position;
+        return true;
+    }
+    const Sample& after = at(i + 1);
+    float t = (float)(time - before.time) / (after.time - before.time);
+    position = before.position + (after.position - before.position) * t;
+    return true;
+}
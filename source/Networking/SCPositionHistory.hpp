@@ -0,0 +1,103 @@
+//
+//  SCPositionHistory.hpp
+//  Sunk Cost
+//
+//  This module provides the host history of a remote player position, for
+//  lag-compensated hit tests.
+//
+//  The spirit sees the hunter through the jitter buffer, some way in the
+//  past. When the spirit lands a swipe, the host rewinds the hunter to the
+//  time the spirit was looking at and tests the hit against that position,
+//  rather than against the newest position received. The rewind is bounded
+//  by LAG_MAX_REWIND behind the host clock, so that a very slow link cannot
+//  make the hunter die far from where it really is.
+//
+//  Times are the sender synced clock, unwrapped the same way as in the
+//  JitterBuffer, so that a render time of the buffer can be looked up here.
+//  Since the sender syncs to the host, they are also host times.
+//
+
+#ifndef SCPositionHistory_hpp
+#define SCPositionHistory_hpp
+
+#include <array>
+#include <cugl/cugl.h>
+
+/** The number of samples kept, about a second of hunter movement */
+#define HISTORY_CAPACITY 64
+/** The furthest a hit test may rewind behind the host clock in ms */
+#define LAG_MAX_REWIND 250
+
+/**
+ * A ring buffer of timestamped positions of one remote player.
+ */
+class PositionHistory {
+  private:
+    /** A position stamped with the unwrapped sender time */
+    struct Sample {
+        Sint64 time;
+        cugl::Vec2 position;
+    };
+
+    /** The samples, oldest first starting at _head */
+    std::array<Sample, HISTORY_CAPACITY> _samples;
+    /** The index of the oldest sample */
+    size_t _head;
+    /** The number of samples */
+    size_t _count;
+
+    /** The number of rewinds */
+    Uint64 _rewinds;
+    /** The number of rewinds limited by LAG_MAX_REWIND */
+    Uint64 _clamped;
+
+    /** Returns the sample i places after the oldest */
+    const Sample& at(size_t i) const {
+        return _samples[(_head + i) % HISTORY_CAPACITY];
+    }
+
+  public:
+    PositionHistory() { reset(); }
+
+    /** Drops every sample and statistic */
+    void reset();
+
+    /**
+     * Adds a sample from the network.
+     *
+     * Samples older than the newest one are ignored, since the position
+     * stream never applies them either.
+     *
+     * @param time      The low 16 bits of the sender synced clock
+     * @param position  The sampled position
+     * @param now       The local synced clock in milliseconds
+     */
+    void record(Uint16 time, cugl::Vec2 position, Uint32 now);
+
+    /**
+     * Returns the position at the given sender time.
+     *
+     * The position is interpolated between the samples around the time.
+     * A time older than LAG_MAX_REWIND behind now is moved up to that
+     * bound, and a time past the newest sample gives the newest position.
+     *
+     * @param time      The unwrapped sender time, such as a render time
+     * @param now       The local synced clock in milliseconds
+     * @param position  Set to the position if this returns true
+     *
+     * @return false if there are no samples
+     */
+    bool rewind(Sint64 time, Uint32 now, cugl::Vec2& position);
+
+    /** Returns true if there are no samples */
+    bool isEmpty() const { return _count == 0; }
+
+    /** Returns the newest sample time, or 0 if there are no samples */
+    Sint64 getNewest() const { return _count > 0 ? at(_count - 1).time : 0; }
+
+    Uint64 getRewinds() const { return _rewinds; }
+
+    Uint64 getClamped() const { return _clamped; }
+};
+
+#endif /* SCPositionHistory_hpp */
@@ -0,0 +1,211 @@
+//
+//  SCPositionStream.cpp
+//  Sunk Cost
+//
+//  This module provides the replication channel for the hunter position.
+//  See the header for details.
+//
+
+#include "SCPositionStream.hpp"
+#include <cmath>
+
+using namespace cugl;
+
+/** Returns a position in wire coordinate units */
+static QuantizedPos quantize(float x, float y) {
+    return {static_cast<Sint32>(std::lround(x * WIRE_COORD_SCALE)),
+            static_cast<Sint32>(std::lround(y * WIRE_COORD_SCALE))};
+}
+
+/** Returns true if sequence number a is newer than b */
+static bool seqNewer(Uint8 a, Uint8 b) {
+    return static_cast<Sint8>(static_cast<Uint8>(a - b)) > 0;
+}
+
+#pragma mark -
+#pragma mark Sender
+
+/**
+ * Forgets all stream state; the next send is a keyframe
+ */
+void PositionSender::reset() {
+    _history.fill({0, 0});
+    _seq = 0;
+    _hasAck = false;
+    _ackSeq = 0;
+    _upToDate = false;
+    _lastSent = {0, 0};
+    _sinceSend = POSITION_SEND_INTERVAL;
+    _visible = true;
+    _sinceKeyframe = 0;
+    _keyframes = 0;
+    _counter.reset();
+}
+
+/**
+ * Advances the stream by one frame.
+ *
+ * This must be called every frame, moving or not. It returns true if a
+ * position message is due, in which case message holds a keyframe or a
+ * delta that should be broadcast.
+ *
+ * @param position  The current hunter position
+ * @param time      The synced clock in milliseconds
+ * @param message   The message to send, if any
+ *
+ * @return true if message should be sent
+ */
+bool PositionSender::update(Vec2 position, Uint32 time, GameMessage& message) {
+    _counter.tick();
+    _sinceSend++;
+
+    QuantizedPos current = quantize(position.x, position.y);
+    int interval = _visible ? POSITION_SEND_INTERVAL : POSITION_HIDDEN_INTERVAL;
+    // Keep resending while the spirit has not confirmed the resting position
+    if (_sinceSend < interval ||
+        (current == _lastSent && _upToDate)) {
+        return false;
+    }
+
+    // An ack more than half the sequence space old is ambiguous
+    bool ackStale = static_cast<Uint8>(_seq - _ackSeq) >= POSITION_HISTORY / 2;
+    if (!_hasAck || ackStale || _sinceKeyframe >= POSITION_KEYFRAME_INTERVAL) {
+        message = HunterPosMessage{_seq, static_cast<Uint16>(time),
+                                   current.x / WIRE_COORD_SCALE,
+                                   current.y / WIRE_COORD_SCALE};
+        _sinceKeyframe = 0;
+        _keyframes++;
+    } else {
+        const QuantizedPos& base = _history[_ackSeq];
+        message = HunterDeltaMessage{_seq, _ackSeq, static_cast<Uint16>(time),
+                                     current.x - base.x, current.y - base.y};
+        _sinceKeyframe++;
+    }
+
+    _history[_seq] = current;
+    _seq++;
+    _lastSent = current;
+    _sinceSend = 0;
+    _upToDate = false;
+    return true;
+}
+
+/**
+ * Sets whether the spirit can see the hunter.
+ *
+ * @param visible   Whether the spirit can see the hunter
+ */
+void PositionSender::setVisible(bool visible) {
+    if (visible && !_visible) {
+        _sinceSend = POSITION_SEND_INTERVAL;
+    }
+    _visible = visible;
+}
+
+/**
+ * Processes an acknowledgement from the spirit.
+ *
+ * @param seq   The newest sequence number the spirit has applied
+ */
+void PositionSender::acknowledge(Uint8 seq) {
+    Uint8 newestSent = _seq - 1;
+    if (seqNewer(seq, newestSent) || (_hasAck && !seqNewer(seq, _ackSeq))) {
+        return;
+    }
+    _hasAck = true;
+    _ackSeq = seq;
+    _upToDate = _history[seq] == _lastSent;
+}
+
+#pragma mark -
+#pragma mark Receiver
+
+/**
+ * Forgets all stream state; waits for the next keyframe
+ */
+void PositionReceiver::reset() {
+    _history.fill({0, 0});
+    _valid.fill(false);
+    _hasLatest = false;
+    _latest = 0;
+    _ackPending = false;
+    _sinceAck = 0;
+    _dropped = 0;
+    _counter.reset();
+}
+
+/**
+ * Applies a keyframe or delta message.
+ *
+ * Stale or undecodable messages are ignored.
+ *
+ * @param message   A HunterPos or HunterDelta message
+ * @param bytes     The encoded size of the message
+ * @param position  Set to the new hunter position if this returns true
+ * @param time      Set to the sample time if this returns true
+ *
+ * @return true if the message produced a newer position
+ */
+bool PositionReceiver::receive(const GameMessage& message, size_t bytes,
+                               Vec2& position, Uint16& time) {
+    _counter.add(bytes);
+
+    Uint8 seq;
+    Uint16 stamp;
+    QuantizedPos current;
+    if (message.type == MessageType::HunterPos) {
+        const HunterPosMessage& key = message.get<HunterPosMessage>();
+        seq = key.seq;
+        stamp = key.time;
+        current = quantize(key.x, key.y);
+    } else if (message.type == MessageType::HunterDelta) {
+        const HunterDeltaMessage& delta = message.get<HunterDeltaMessage>();
+        if (!_valid[delta.base]) {
+            _dropped++;
+            return false;
+        }
+        seq = delta.seq;
+        stamp = delta.time;
+        current = {_history[delta.base].x + delta.dx,
+                   _history[delta.base].y + delta.dy};
+    } else {
+        return false;
+    }
+
+    _history[seq] = current;
+    _valid[seq] = true;
+    // Retire the slot half a cycle back so a wrapped base is never trusted
+    _valid[static_cast<Uint8>(seq + POSITION_HISTORY / 2)] = false;
+
+    if (_hasLatest && !seqNewer(seq, _latest)) {
+        return false;
+    }
+    _hasLatest = true;
+    _latest = seq;
+    _ackPending = true;
+    position = Vec2(current.x / WIRE_COORD_SCALE, current.y / WIRE_COORD_SCALE);
+    time = stamp;
+    return true;
+}
+
+/**
+ * Advances the stream by one frame.
+ *
+ * This returns true when an acknowledgement is due, in which case
+ * message holds the PositionAck to send back to the hunter.
+ *
+ * @param message   The message to send, if any
+ *
+ * @return true if message should be sent
+ */
+bool PositionReceiver::update(GameMessage& message) {
+    _counter.tick();
+    _sinceAck++;
+    if (!_ackPending || _sinceAck < POSITION_ACK_INTERVAL) {
+        return false;
+    }
+    message = PositionAckMessage{_latest};
+    _ackPending = false;
+    _sinceAck = 0;
+    return true;
+}
@@ -0,0 +1,230 @@
+//
+//  SCPositionStream.hpp
+//  Sunk Cost
+//
+//  This module provides the replication channel for the hunter position.
+//
+//  Positions are quantized to the wire coordinate grid and sent at a fixed
+//  rate as deltas against the last position the spirit acknowledged. Until
+//  the first acknowledgement, and periodically after that, a full keyframe
+//  is sent instead so a lost ack or a late joiner can always resynchronize.
+//  The spirit acknowledges at a low rate; acks are cumulative, so losing one
+//  only makes the following deltas slightly larger.
+//
+
+#ifndef SCPositionStream_hpp
+#define SCPositionStream_hpp
+
+#include "SCMessage.hpp"
+#include <array>
+#include <cugl/cugl.h>
+
+/** The number of frames between position sends while moving */
+#define POSITION_SEND_INTERVAL 2
+/** The number of frames between position sends while hidden from the spirit */
+#define POSITION_HIDDEN_INTERVAL 30
+/** The number of sends between forced keyframes */
+#define POSITION_KEYFRAME_INTERVAL 60
+/** The number of frames between acknowledgements from the spirit */
+#define POSITION_ACK_INTERVAL 6
+/** The number of sequence numbers remembered by both ends */
+#define POSITION_HISTORY 256
+
+/**
+ * A position in wire coordinate units.
+ */
+struct QuantizedPos {
+    Sint32 x;
+    Sint32 y;
+
+    bool operator==(const QuantizedPos& other) const {
+        return x == other.x && y == other.y;
+    }
+
+    bool operator!=(const QuantizedPos& other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * A running total of the traffic on one channel.
+ */
+class BandwidthCounter {
+  private:
+    Uint64 _messages;
+    Uint64 _bytes;
+    Uint64 _frames;
+
+  public:
+    BandwidthCounter() { reset(); }
+
+    /** Clears all totals */
+    void reset() {
+        _messages = 0;
+        _bytes = 0;
+        _frames = 0;
+    }
+
+    /** Records one message of the given encoded size */
+    void add(size_t bytes) {
+        _messages++;
+        _bytes += bytes;
+    }
+
+    /** Advances the frame clock used for the per-second averages */
+    void tick() { _frames++; }
+
+    Uint64 getMessages() const { return _messages; }
+
+    Uint64 getBytes() const { return _bytes; }
+
+    Uint64 getFrames() const { return _frames; }
+
+    /** Returns the average bytes per second, assuming 60 frames per second */
+    float getBytesPerSecond() const {
+        return _frames == 0 ? 0 : _bytes * 60.0f / _frames;
+    }
+
+    /** Returns the average messages per second */
+    float getMessagesPerSecond() const {
+        return _frames == 0 ? 0 : _messages * 60.0f / _frames;
+    }
+};
+
+/**
+ * The hunter end of the position stream.
+ */
+class PositionSender {
+  private:
+    /** The quantized position sent with each sequence number */
+    std::array<QuantizedPos, POSITION_HISTORY> _history;
+    /** The sequence number of the next message */
+    Uint8 _seq;
+    /** Whether the spirit has acknowledged anything yet */
+    bool _hasAck;
+    /** The newest acknowledged sequence number */
+    Uint8 _ackSeq;
+    /** Whether the last sent position has been acknowledged */
+    bool _upToDate;
+    /** The last quantized position sent */
+    QuantizedPos _lastSent;
+    /** Frames since the last send */
+    int _sinceSend;
+    /** Whether the spirit can see the hunter; see SCInterest.hpp */
+    bool _visible;
+    /** Sends since the last keyframe */
+    int _sinceKeyframe;
+    /** The number of keyframes sent */
+    Uint64 _keyframes;
+    /** The traffic sent on this stream */
+    BandwidthCounter _counter;
+
+  public:
+    PositionSender() { reset(); }
+
+    /** Forgets all stream state; the next send is a keyframe */
+    void reset();
+
+    /**
+     * Advances the stream by one frame.
+     *
+     * This must be called every frame, moving or not. It returns true if a
+     * position message is due, in which case message holds a keyframe or a
+     * delta that should be broadcast.
+     *
+     * @param position  The current hunter position
+     * @param time      The synced clock in milliseconds
+     * @param message   The message to send, if any
+     *
+     * @return true if message should be sent
+     */
+    bool update(cugl::Vec2 position, Uint32 time, GameMessage& message);
+
+    /**
+     * Processes an acknowledgement from the spirit.
+     *
+     * @param seq   The newest sequence number the spirit has applied
+     */
+    void acknowledge(Uint8 seq);
+
+    /** Records the encoded size of a message returned by update */
+    void recordSent(size_t bytes) { _counter.add(bytes); }
+
+    /**
+     * Sets whether the spirit can see the hunter. A hidden hunter sends its
+     * position every POSITION_HIDDEN_INTERVAL frames instead of every
+     * POSITION_SEND_INTERVAL, and a hunter that comes into view sends at
+     * once.
+     *
+     * @param visible   Whether the spirit can see the hunter
+     */
+    void setVisible(bool visible);
+
+    bool isVisible() const { return _visible; }
+
+    const BandwidthCounter& getCounter() const { return _counter; }
+
+    Uint64 getKeyframes() const { return _keyframes; }
+};
+
+/**
+ * The spirit end of the position stream.
+ */
+class PositionReceiver {
+  private:
+    /** The quantized position received with each sequence number */
+    std::array<QuantizedPos, POSITION_HISTORY> _history;
+    /** Whether each history slot holds a decoded position */
+    std::array<bool, POSITION_HISTORY> _valid;
+    /** Whether any position has been applied */
+    bool _hasLatest;
+    /** The newest applied sequence number */
+    Uint8 _latest;
+    /** Whether an ack is owed for _latest */
+    bool _ackPending;
+    /** Frames since the last ack */
+    int _sinceAck;
+    /** The number of deltas dropped because their base was unknown */
+    Uint64 _dropped;
+    /** The traffic received on this stream */
+    BandwidthCounter _counter;
+
+  public:
+    PositionReceiver() { reset(); }
+
+    /** Forgets all stream state; waits for the next keyframe */
+    void reset();
+
+    /**
+     * Applies a keyframe or delta message.
+     *
+     * Stale or undecodable messages are ignored.
+     *
+     * @param message   A HunterPos or HunterDelta message
+     * @param bytes     The encoded size of the message
+     * @param position  Set to the new hunter position if this returns true
+     * @param time      Set to the sample time if this returns true
+     *
+     * @return true if the message produced a newer position
+     */
+    bool receive(const GameMessage& message, size_t bytes,
+                 cugl::Vec2& position, Uint16& time);
+
+    /**
+     * Advances the stream by one frame.
+     *
+     * This returns true when an acknowledgement is due, in which case
+     * message holds the PositionAck to send back to the hunter.
+     *
+     * @param message   The message to send, if any
+     *
+     * @return true if message should be sent
+     */
+    bool update(GameMessage& message);
+
+    const BandwidthCounter& getCounter() const { return _counter; }
+
+    Uint64 getDropped() const { return _dropped; }
+};
+
+#endif /* SCPositionStream_hpp */
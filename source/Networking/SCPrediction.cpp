@@ -0,0 +1,245 @@
+//
+//  SCPrediction.cpp
+//  Sunk Cost
+//
+//  This module provides client-side prediction and host reconciliation for
+//  the hunter movement. See the header for details.
+//
+
+#include "SCPrediction.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace cugl;
+
+#pragma mark -
+#pragma mark Predictor
+
+/**
+ * Forgets every input and statistic
+ */
+void InputPredictor::reset() {
+    _pending.clear();
+    _next = 0;
+    _corrections = 0;
+    _maxError = 0;
+}
+
+/**
+ * Returns the wire value of an input axis in [-1, 1]
+ */
+int InputPredictor::quantize(float axis) {
+    axis = std::max(-1.0f, std::min(1.0f, axis));
+    return static_cast<int>(std::lround(axis * INPUT_SCALE));
+}
+
+/**
+ * Returns the position rounded to the wire precision.
+ */
+Vec2 InputPredictor::snap(Vec2 position) {
+    return Vec2(std::lround(position.x * WIRE_COORD_SCALE) / WIRE_COORD_SCALE,
+                std::lround(position.y * WIRE_COORD_SCALE) / WIRE_COORD_SCALE);
+}
+
+/**
+ * Returns the spawn announcement for the host.
+ *
+ * @param position  The spawn position, already snapped
+ * @param time      The synced clock in milliseconds
+ */
+GameMessage InputPredictor::spawn(Vec2 position, Uint32 time) const {
+    return HunterSpawnMessage{_next, static_cast<Uint16>(time), position.x,
+                              position.y};
+}
+
+/**
+ * Applies one frame of input locally and returns it for the host.
+ *
+ * @param step      The shared movement step
+ * @param position  The hunter position, moved by the input
+ * @param forward   The vertical input in [-1, 1]
+ * @param rightward The horizontal input in [-1, 1]
+ * @param time      The synced clock in milliseconds
+ *
+ * @return the input message for the host
+ */
+GameMessage InputPredictor::predict(const MovementStep& step, Vec2& position,
+                                    float forward, float rightward,
+                                    Uint32 time) {
+    Pending input{_next++, quantize(forward), quantize(rightward)};
+    position = snap(step(position, axis(input.forward), axis(input.rightward)));
+    input.position = position;
+    if (_pending.size() == PREDICTION_CAPACITY) {
+        _pending.pop_front();
+    }
+    _pending.push_back(input);
+    return HunterInputMessage{input.seq, static_cast<Uint16>(time),
+                              input.forward, input.rightward};
+}
+
+/**
+ * Checks a host position against the prediction for the same input.
+ *
+ * @param state     The host position after an input
+ * @param step      The shared movement step
+ * @param position  The hunter position, corrected if necessary
+ *
+ * @return true if the position was corrected
+ */
+bool InputPredictor::reconcile(const HunterStateMessage& state,
+                               const MovementStep& step, Vec2& position) {
+    while (!_pending.empty() &&
+           static_cast<Sint16>(_pending.front().seq - state.seq) < 0) {
+        _pending.pop_front();
+    }
+    if (_pending.empty() || _pending.front().seq != state.seq) {
+        // A late answer for an input already checked
+        return false;
+    }
+
+    Vec2 authoritative(state.x, state.y);
+    float error = _pending.front().position.distance(authoritative);
+    _pending.pop_front();
+    if (error <= PREDICTION_TOLERANCE) {
+        return false;
+    }
+
+    _corrections++;
+    _maxError = std::max(_maxError, error);
+    for (Pending& input : _pending) {
+        authoritative = snap(step(authoritative, axis(input.forward),
+                                  axis(input.rightward)));
+        input.position = authoritative;
+    }
+    position = authoritative;
+    return true;
+}
+
+#pragma mark -
+#pragma mark Authority
+
+/**
+ * Forgets the hunter, every input and statistic
+ */
+void InputAuthority::reset() {
+    _queue.clear();
+    _position = Vec2::ZERO;
+    _last = HunterInputMessage{0, 0, 0, 0};
+    _expected = 0;
+    _spawned = false;
+    _resumed = false;
+    _allowance = AUTHORITY_BURST;
+    _lastTime = 0;
+    _applied = 0;
+    _repeated = 0;
+    _dropped = 0;
+}
+
+/**
+ * Places the hunter. This is the only position the host accepts.
+ *
+ * @param spawn The spawn announcement from the hunter
+ */
+void InputAuthority::spawn(const HunterSpawnMessage& spawn) {
+    if (!_resumed) {
+        _position = Vec2(spawn.x, spawn.y);
+    }
+    _resumed = false;
+    _expected = spawn.seq;
+    _last = HunterInputMessage{spawn.seq, spawn.time, 0, 0};
+    _spawned = true;
+    // Inputs queued before the spawn arrived may predate it
+    while (!_queue.empty() &&
+           static_cast<Sint16>(_queue.front().seq - _expected) < 0) {
+        _queue.pop_front();
+        _dropped++;
+    }
+}
+
+/**
+ * Forgets the inputs of a lost connection, keeping the position.
+ */
+void InputAuthority::resume() {
+    _queue.clear();
+    _resumed = _spawned;
+    _spawned = false;
+}
+
+/**
+ * Queues an input from the hunter.
+ *
+ * @param input The input message
+ */
+void InputAuthority::receive(const HunterInputMessage& input) {
+    if (_spawned && static_cast<Sint16>(input.seq - _expected) < 0) {
+        _dropped++;
+        return;
+    }
+    auto pos = std::lower_bound(
+        _queue.begin(), _queue.end(), input,
+        [](const HunterInputMessage& a, const HunterInputMessage& b) {
+            return static_cast<Sint16>(a.seq - b.seq) < 0;
+        });
+    if ((pos != _queue.end() && pos->seq == input.seq) ||
+        _queue.size() == AUTHORITY_QUEUE) {
+        _dropped++;
+        return;
+    }
+    _queue.insert(pos, input);
+}
+
+/**
+ * Applies the queued inputs that the rate limit allows.
+ *
+ * @param step  The shared movement step
+ * @param now   The local time in milliseconds
+ * @param moved Called with the position and input time after each input
+ * @param state Set to the position for the hunter if this returns true
+ *
+ * @return true if any input was applied
+ */
+bool InputAuthority::update(const MovementStep& step, Uint32 now,
+                            const std::function<void(Vec2, Uint16)>& moved,
+                            GameMessage& state) {
+    _allowance = std::min<float>(AUTHORITY_BURST,
+                                 _allowance + (now - _lastTime) *
+                                                  AUTHORITY_RATE / 1000.0f);
+    _lastTime = now;
+    if (!_spawned) {
+        return false;
+    }
+
+    bool applied = false;
+    while (!_queue.empty() && _allowance >= 1) {
+        const HunterInputMessage& next = _queue.front();
+        Uint16 gap = next.seq - _expected;
+        HunterInputMessage input = next;
+        if (gap > AUTHORITY_MAX_GAP) {
+            // Too much was lost to replay; start again from this input
+            _expected = next.seq;
+        } else if (gap > 0) {
+            // Assume the stick held still through a lost input
+            input = _last;
+            input.seq = _expected;
+            input.time = next.time - gap * 1000 / 60;
+            _repeated++;
+        }
+        if (input.seq == next.seq) {
+            _queue.pop_front();
+        }
+
+        _position = InputPredictor::snap(
+            step(_position, InputPredictor::axis(input.forward),
+                 InputPredictor::axis(input.rightward)));
+        moved(_position, input.time);
+        _last = input;
+        _expected = input.seq + 1;
+        _allowance -= 1;
+        _applied++;
+        applied = true;
+    }
+    if (applied) {
+        state = HunterStateMessage{_last.seq, _position.x, _position.y};
+    }
+    return applied;
+}
@@ -0,0 +1,230 @@
+//
+//  SCPrediction.hpp
+//  Sunk Cost
+//
+//  This module provides client-side prediction and host reconciliation for
+//  the hunter movement.
+//
+//  In authoritative mode the hunter no longer sends its position. It sends
+//  one sequenced input per frame, and applies the same input at once with
+//  the shared movement step, so moving still feels immediate. The host
+//  applies the inputs in sequence order with its own copy of the walls and
+//  doors, and answers with the position after the newest input it applied.
+//  When that answer disagrees with what the hunter predicted for the same
+//  input, the hunter snaps to the host position and replays every input
+//  the host has not applied yet.
+//
+//  The host never trusts a position after the spawn. Lost inputs are
+//  replaced by the previous input, and the host applies inputs no faster
+//  than AUTHORITY_RATE per second, so a modified client can neither
+//  teleport nor speed up. Inputs are quantized before they are predicted,
+//  and every step is rounded to the wire precision, so that both ends step
+//  with exactly the same values and the host position survives the trip.
+//
+
+#ifndef SCPrediction_hpp
+#define SCPrediction_hpp
+
+#include "SCMessage.hpp"
+#include <cugl/cugl.h>
+#include <deque>
+#include <functional>
+
+/** The wire value of a full input on one axis */
+#define INPUT_SCALE 127
+/** The number of unacknowledged inputs kept by the hunter, about 2 s */
+#define PREDICTION_CAPACITY 128
+/** The largest prediction error in pixels that is not corrected */
+#define PREDICTION_TOLERANCE 0.5f
+/** The number of inputs the host queues before dropping new ones */
+#define AUTHORITY_QUEUE 64
+/** The number of inputs the host may apply at once after a stall */
+#define AUTHORITY_BURST 8
+/** The number of inputs the host applies per second, a little over 60 */
+#define AUTHORITY_RATE 66
+/** The largest gap in input numbers filled by repeating the last input */
+#define AUTHORITY_MAX_GAP 30
+
+/**
+ * The shared movement step: the position after one frame of input.
+ */
+using MovementStep = std::function<cugl::Vec2(cugl::Vec2, float, float)>;
+
+/**
+ * The hunter end of authoritative movement.
+ */
+class InputPredictor {
+  private:
+    /** An input the host has not acknowledged */
+    struct Pending {
+        Uint16 seq;
+        int forward;
+        int rightward;
+        /** The predicted position after this input */
+        cugl::Vec2 position;
+    };
+
+    /** The unacknowledged inputs, oldest first */
+    std::deque<Pending> _pending;
+    /** The number of the next input */
+    Uint16 _next;
+
+    /** The number of corrections from the host */
+    Uint64 _corrections;
+    /** The largest corrected error in pixels */
+    float _maxError;
+
+  public:
+    InputPredictor() { reset(); }
+
+    /** Forgets every input and statistic */
+    void reset();
+
+    /** Returns the wire value of an input axis in [-1, 1] */
+    static int quantize(float axis);
+
+    /** Returns the input axis of a wire value */
+    static float axis(int value) { return (float)value / INPUT_SCALE; }
+
+    /**
+     * Returns the position rounded to the wire precision.
+     *
+     * Both ends round the spawn and every step, so that a position sent
+     * over the wire arrives exactly as it was.
+     */
+    static cugl::Vec2 snap(cugl::Vec2 position);
+
+    /**
+     * Returns the spawn announcement for the host.
+     *
+     * @param position  The spawn position, already snapped
+     * @param time      The synced clock in milliseconds
+     */
+    GameMessage spawn(cugl::Vec2 position, Uint32 time) const;
+
+    /**
+     * Applies one frame of input locally and returns it for the host.
+     *
+     * @param step      The shared movement step
+     * @param position  The hunter position, moved by the input
+     * @param forward   The vertical input in [-1, 1]
+     * @param rightward The horizontal input in [-1, 1]
+     * @param time      The synced clock in milliseconds
+     *
+     * @return the input message for the host
+     */
+    GameMessage predict(const MovementStep& step, cugl::Vec2& position,
+                        float forward, float rightward, Uint32 time);
+
+    /**
+     * Checks a host position against the prediction for the same input.
+     *
+     * If they disagree by more than PREDICTION_TOLERANCE, the position is
+     * moved to the host position with every later input replayed on it.
+     *
+     * @param state     The host position after an input
+     * @param step      The shared movement step
+     * @param position  The hunter position, corrected if necessary
+     *
+     * @return true if the position was corrected
+     */
+    bool reconcile(const HunterStateMessage& state, const MovementStep& step,
+                   cugl::Vec2& position);
+
+    /** Returns the number of inputs the host has not acknowledged */
+    size_t getPending() const { return _pending.size(); }
+
+    Uint64 getCorrections() const { return _corrections; }
+
+    float getMaxError() const { return _maxError; }
+};
+
+/**
+ * The host end of authoritative movement.
+ */
+class InputAuthority {
+  private:
+    /** The received inputs not yet applied, in sequence order */
+    std::deque<HunterInputMessage> _queue;
+    /** The hunter position after the last applied input */
+    cugl::Vec2 _position;
+    /** The last applied input, repeated for lost ones */
+    HunterInputMessage _last;
+    /** The number of the next input to apply */
+    Uint16 _expected;
+    /** Whether the spawn has been received */
+    bool _spawned;
+    /** Whether the next spawn only restarts the input numbers */
+    bool _resumed;
+    /** The number of inputs that may be applied now */
+    float _allowance;
+    /** The local time the allowance was last raised */
+    Uint32 _lastTime;
+
+    Uint64 _applied;
+    /** The number of lost inputs replaced by the previous input */
+    Uint64 _repeated;
+    /** The number of inputs dropped as late, duplicate or over the queue */
+    Uint64 _dropped;
+
+  public:
+    InputAuthority() { reset(); }
+
+    /** Forgets the hunter, every input and statistic */
+    void reset();
+
+    /**
+     * Places the hunter. This is the only position the host accepts.
+     *
+     * @param spawn The spawn announcement from the hunter
+     */
+    void spawn(const HunterSpawnMessage& spawn);
+
+    /**
+     * Forgets the inputs of a lost connection, keeping the position.
+     *
+     * The hunter spawns again after it resumes, but that spawn only
+     * restarts the input numbers; the hunter stays where we had it.
+     */
+    void resume();
+
+    /**
+     * Queues an input from the hunter.
+     *
+     * @param input The input message
+     */
+    void receive(const HunterInputMessage& input);
+
+    /**
+     * Applies the queued inputs that the rate limit allows.
+     *
+     * This should be called once per frame.
+     *
+     * @param step  The shared movement step
+     * @param now   The local time in milliseconds
+     * @param moved Called with the position and input time after each input
+     * @param state Set to the position for the hunter if this returns true
+     *
+     * @return true if any input was applied
+     */
+    bool update(const MovementStep& step, Uint32 now,
+                const std::function<void(cugl::Vec2, Uint16)>& moved,
+                GameMessage& state);
+
+    /** Returns true once the hunter has spawned */
+    bool isSpawned() const { return _spawned; }
+
+    /** Returns the hunter position after the last applied input */
+    cugl::Vec2 getPosition() const { return _position; }
+
+    /** Moves the hunter without an input, as when a match is restored */
+    void setPosition(cugl::Vec2 position) { _position = position; }
+
+    Uint64 getApplied() const { return _applied; }
+
+    Uint64 getRepeated() const { return _repeated; }
+
+    Uint64 getDropped() const { return _dropped; }
+};
+
+#endif /* SCPrediction_hpp */
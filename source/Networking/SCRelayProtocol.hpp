@@ -0,0 +1,280 @@
+//
+//  SCRelayProtocol.hpp
+//  Sunk Cost
+//
+//  This module provides the wire format between the game and the local
+//  relay server in tools/relay, which stands in for the CUGL lobby on a LAN
+//  or in CI.
+//
+//  The relay speaks the same room-code handshake as the lobby: the host
+//  asks for a room and is given a code of four hexadecimal digits, which
+//  the other players enter to join. After that the relay forwards packets
+//  between the peers of a room, to everyone, to the host or to one peer,
+//  and tells everyone when the player count changes.
+//
+//  Everything travels over one TCP connection per peer as frames of a
+//  4 byte big-endian length, a 1 byte opcode and the body. Strings in a
+//  body are a 1 byte length and the characters. The header depends on the
+//  standard library only, so that the relay builds without CUGL.
+//
+
+#ifndef SCRelayProtocol_hpp
+#define SCRelayProtocol_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** The version of this wire format; a relay refuses any other */
+#define RELAY_PROTOCOL_VERSION 1
+/** The size of the frame header: the length and the opcode */
+#define RELAY_HEADER_SIZE 5
+/** The largest frame body; a larger frame closes the connection */
+#define RELAY_MAX_FRAME (64 * 1024)
+/** The default port of the relay */
+#define RELAY_DEFAULT_PORT 8090
+
+/**
+ * The frame opcodes.
+ */
+enum class RelayOp : uint8_t {
+    /** Open a room: protocol version, API version, most players */
+    Host = 1,
+    /** Join a room: protocol version, API version, room code */
+    Join = 2,
+    /** A packet for every other peer: the data */
+    Broadcast = 3,
+    /** A packet for the host: the data */
+    ToHost = 4,
+    /** A packet for one peer: its UUID, the data */
+    ToPeer = 5,
+    /** The peer is in the room: room code, our UUID, host UUID, players */
+    Welcome = 16,
+    /** The handshake was refused: a RelayDenial */
+    Denied = 17,
+    /** The number of players in the room changed: players */
+    Players = 18,
+    /** A packet from another peer: its UUID, the data */
+    Data = 19,
+    /** The host left, so the room is gone */
+    Closed = 20,
+};
+
+/**
+ * Why the relay refused a handshake.
+ */
+enum class RelayDenial : uint8_t {
+    /** There is no room with that code */
+    NoRoom = 1,
+    /** The room has its most players */
+    Full = 2,
+    /** The protocol or API version is not the one of the room */
+    Mismatched = 3,
+    /** Every room code is in use */
+    NoCodes = 4,
+};
+
+/**
+ * Writes relay frames to a byte buffer.
+ */
+class RelayWriter {
+  private:
+    /** The frames written so far */
+    std::vector<std::byte> _data;
+    /** The offset of the length of the open frame */
+    size_t _start;
+
+  public:
+    RelayWriter() : _start(0) {}
+
+    /**
+     * Starts a frame; it is closed by the next begin or by getData.
+     *
+     * @param op    The frame opcode
+     */
+    void begin(RelayOp op) {
+        finish();
+        _start = _data.size();
+        _data.resize(_start + RELAY_HEADER_SIZE);
+        _data[_start + 4] = std::byte(static_cast<uint8_t>(op));
+    }
+
+    void writeByte(uint8_t value) { _data.push_back(std::byte(value)); }
+
+    void writeUint32(uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            _data.push_back(std::byte((value >> shift) & 0xff));
+        }
+    }
+
+    /** Writes a string of at most 255 characters */
+    void writeString(const std::string& value) {
+        size_t size = value.size() < 255 ? value.size() : 255;
+        writeByte(static_cast<uint8_t>(size));
+        for (size_t i = 0; i < size; i++) {
+            _data.push_back(std::byte(value[i]));
+        }
+    }
+
+    /** Writes raw bytes to the end of the frame */
+    void writeBytes(const std::byte* data, size_t size) {
+        _data.insert(_data.end(), data, data + size);
+    }
+
+    /** Returns the frames written, with the open frame closed */
+    const std::vector<std::byte>& getData() {
+        finish();
+        return _data;
+    }
+
+    /** Forgets every frame */
+    void reset() {
+        _data.clear();
+        _start = 0;
+    }
+
+  private:
+    /** Fills in the length of the open frame */
+    void finish() {
+        if (_data.size() < _start + RELAY_HEADER_SIZE) {
+            return;
+        }
+        uint32_t length =
+            static_cast<uint32_t>(_data.size() - _start - RELAY_HEADER_SIZE);
+        for (int i = 0; i < 4; i++) {
+            _data[_start + i] = std::byte((length >> (24 - 8 * i)) & 0xff);
+        }
+        _start = _data.size();
+    }
+};
+
+/**
+ * Reads the body of one relay frame.
+ */
+class RelayReader {
+  private:
+    const std::byte* _data;
+    size_t _size;
+    size_t _offset;
+    /** Whether a read ran past the end of the body */
+    bool _failed;
+
+  public:
+    /**
+     * Creates a reader of a frame body.
+     *
+     * @param data  The first byte of the body
+     * @param size  The size of the body
+     */
+    RelayReader(const std::byte* data, size_t size)
+        : _data(data), _size(size), _offset(0), _failed(false) {}
+
+    uint8_t readByte() {
+        if (_offset + 1 > _size) {
+            _failed = true;
+            return 0;
+        }
+        return static_cast<uint8_t>(_data[_offset++]);
+    }
+
+    uint32_t readUint32() {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value = value << 8 | readByte();
+        }
+        return value;
+    }
+
+    std::string readString() {
+        size_t size = readByte();
+        if (_offset + size > _size) {
+            _failed = true;
+            return "";
+        }
+        std::string value(reinterpret_cast<const char*>(_data + _offset), size);
+        _offset += size;
+        return value;
+    }
+
+    /** Returns the first unread byte */
+    const std::byte* getRest() const { return _data + _offset; }
+
+    /** Returns the number of unread bytes */
+    size_t getRemaining() const { return _failed ? 0 : _size - _offset; }
+
+    /** Returns true if a read ran past the end of the body */
+    bool failed() const { return _failed; }
+};
+
+/**
+ * Splits a byte stream into relay frames.
+ */
+class RelayDecoder {
+  private:
+    /** The bytes received and not yet taken as frames */
+    std::vector<std::byte> _buffer;
+    /** The offset of the first byte not yet taken */
+    size_t _offset;
+    /** Whether a frame was too large, which ends the stream */
+    bool _failed;
+
+  public:
+    RelayDecoder() : _offset(0), _failed(false) {}
+
+    /**
+     * Adds received bytes.
+     *
+     * @param data  The bytes
+     * @param size  The number of bytes
+     */
+    void push(const std::byte* data, size_t size) {
+        if (_offset > 0 && _offset == _buffer.size()) {
+            _buffer.clear();
+            _offset = 0;
+        } else if (_offset > RELAY_MAX_FRAME) {
+            _buffer.erase(_buffer.begin(), _buffer.begin() + _offset);
+            _offset = 0;
+        }
+        _buffer.insert(_buffer.end(), data, data + size);
+    }
+
+    /**
+     * Takes the next complete frame.
+     *
+     * The body stays valid until the next call to push.
+     *
+     * @param op    Set to the frame opcode
+     * @param body  Set to the first byte of the body
+     * @param size  Set to the size of the body
+     *
+     * @return false if no complete frame is buffered
+     */
+    bool next(RelayOp& op, const std::byte*& body, size_t& size) {
+        if (_failed || _buffer.size() - _offset < RELAY_HEADER_SIZE) {
+            return false;
+        }
+        const std::byte* header = _buffer.data() + _offset;
+        uint32_t length = 0;
+        for (int i = 0; i < 4; i++) {
+            length = length << 8 | static_cast<uint8_t>(header[i]);
+        }
+        if (length > RELAY_MAX_FRAME) {
+            _failed = true;
+            return false;
+        }
+        if (_buffer.size() - _offset < RELAY_HEADER_SIZE + length) {
+            return false;
+        }
+        op = static_cast<RelayOp>(header[4]);
+        body = header + RELAY_HEADER_SIZE;
+        size = length;
+        _offset += RELAY_HEADER_SIZE + length;
+        return true;
+    }
+
+    /** Returns true if the stream had a frame that was too large */
+    bool failed() const { return _failed; }
+};
+
+#endif /* SCRelayProtocol_hpp */
@@ -0,0 +1,441 @@
+//
+//  SCRelayTransport.cpp
+//  Sunk Cost
+//
+//  This module provides the transport over the local relay server.
+//  See the header for details.
+//
+
+#include "SCRelayTransport.hpp"
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define poll WSAPoll
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace cugl;
+
+/** The bytes read from the socket at a time */
+#define RELAY_READ_SIZE 16384
+
+#pragma mark -
+#pragma mark Sockets
+
+/**
+ * Returns true if the last socket call failed only because it would block.
+ */
+static bool wouldBlock() {
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS ||
+           errno == EINTR;
+#endif
+}
+
+/**
+ * Closes a socket.
+ */
+static void closeSocket(Sint64 socket) {
+#ifdef _WIN32
+    closesocket(static_cast<SOCKET>(socket));
+#else
+    ::close(static_cast<int>(socket));
+#endif
+}
+
+/**
+ * Starts a non-blocking connection to the relay.
+ *
+ * @param config    The relay to connect to
+ *
+ * @return the socket, or -1 if the connection could not be started
+ */
+static Sint64 connectTo(const RelayConfig& config) {
+#ifdef _WIN32
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            return -1;
+        }
+        started = true;
+    }
+#endif
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    std::string port = std::to_string(config.port);
+    if (getaddrinfo(config.address.c_str(), port.c_str(), &hints, &found) !=
+        0) {
+        CULog("Relay address %s is unknown", config.address.c_str());
+        return -1;
+    }
+
+    Sint64 result = -1;
+    for (addrinfo* info = found; info != nullptr; info = info->ai_next) {
+#ifdef _WIN32
+        SOCKET handle =
+            ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (handle == INVALID_SOCKET) {
+            continue;
+        }
+        u_long nonblocking = 1;
+        ioctlsocket(handle, FIONBIO, &nonblocking);
+#else
+        int handle =
+            ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (handle < 0) {
+            continue;
+        }
+        fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+#endif
+        // Positions go out every frame, so never hold them back for more
+        int nodelay = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY,
+                   reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+        if (::connect(handle, info->ai_addr,
+                      static_cast<socklen_t>(info->ai_addrlen)) == 0 ||
+            wouldBlock()) {
+            result = static_cast<Sint64>(handle);
+            break;
+        }
+        closeSocket(static_cast<Sint64>(handle));
+    }
+    freeaddrinfo(found);
+    return result;
+}
+
+/**
+ * Returns the state of a connection attempt.
+ *
+ * @param socket    The connecting socket
+ *
+ * @return 1 if connected, 0 if still connecting and -1 if it failed
+ */
+static int checkConnect(Sint64 socket) {
+    pollfd entry;
+    entry.fd = static_cast<decltype(entry.fd)>(socket);
+    entry.events = POLLOUT;
+    entry.revents = 0;
+    if (poll(&entry, 1, 0) <= 0) {
+        return 0;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(entry.fd, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error),
+               &length);
+    return error == 0 ? 1 : -1;
+}
+
+#pragma mark -
+#pragma mark Connection
+
+/**
+ * Reads the relay from the server configuration.
+ *
+ * @param json  The contents of json/server.json
+ *
+ * @return true if the relay is enabled
+ */
+bool RelayConfig::set(const std::shared_ptr<JsonValue>& json) {
+    *this = RelayConfig();
+    if (json == nullptr) {
+        return false;
+    }
+    maxPlayers = json->getInt("max players", maxPlayers);
+    apiVersion = json->getInt("API version", apiVersion);
+    std::shared_ptr<JsonValue> relay = json->get("relay");
+    if (relay == nullptr || !relay->getBool("enabled", false)) {
+        return false;
+    }
+    enabled = true;
+    address = relay->getString("address", address);
+    port = relay->getInt("port", port);
+    CULog("relay: %s:%u", address.c_str(), port);
+    return true;
+}
+
+/**
+ * Creates a transport. Use the static allocators instead.
+ *
+ * @param config    The relay to connect to
+ * @param room      The room to join, or empty to host one
+ */
+RelayTransport::RelayTransport(const RelayConfig& config,
+                               const std::string& room)
+    : _config(config), _hosting(room.empty()), _room(room), _socket(-1),
+      _connecting(false), _state(State::IDLE), _players(0), _sent(0) {}
+
+RelayTransport::~RelayTransport() {
+    if (_socket >= 0) {
+        closeSocket(_socket);
+    }
+}
+
+/**
+ * Starts connecting to the relay and asks for the room.
+ *
+ * @return true if the connection attempt started
+ */
+bool RelayTransport::open() {
+    if (_state != State::IDLE) {
+        return false;
+    }
+    _socket = connectTo(_config);
+    if (_socket < 0) {
+        CULog("Could not reach the relay at %s:%u", _config.address.c_str(),
+              _config.port);
+        fail(State::FAILED);
+        return false;
+    }
+    _connecting = true;
+    _state = State::CONNECTING;
+
+    _writer.begin(_hosting ? RelayOp::Host : RelayOp::Join);
+    _writer.writeByte(RELAY_PROTOCOL_VERSION);
+    _writer.writeUint32(_config.apiVersion);
+    if (_hosting) {
+        _writer.writeByte(_config.maxPlayers);
+    } else {
+        _writer.writeString(_room);
+    }
+    return post();
+}
+
+/**
+ * Leaves the room. If this is the host, the room closes for everyone.
+ */
+void RelayTransport::close() {
+    if (_state == State::CONNECTING || _state == State::CONNECTED) {
+        fail(State::DISCONNECTED);
+    }
+}
+
+/**
+ * Closes the socket and moves to the given state.
+ */
+void RelayTransport::fail(State state) {
+    if (_socket >= 0) {
+        closeSocket(_socket);
+        _socket = -1;
+    }
+    _outgoing.clear();
+    _sent = 0;
+    _state = state;
+}
+
+#pragma mark -
+#pragma mark Sending
+
+/**
+ * Queues the frame in the writer and sends what the socket takes.
+ *
+ * @return true if the frame was queued
+ */
+bool RelayTransport::post() {
+    const std::vector<std::byte>& frame = _writer.getData();
+    if (_socket >= 0) {
+        _outgoing.insert(_outgoing.end(), frame.begin(), frame.end());
+    }
+    _writer.reset();
+    if (_socket < 0) {
+        return false;
+    }
+    flush();
+    return _socket >= 0;
+}
+
+/**
+ * Sends what the socket takes of the outgoing frames.
+ */
+void RelayTransport::flush() {
+    if (_connecting) {
+        int connected = checkConnect(_socket);
+        if (connected < 0) {
+            CULog("Could not reach the relay at %s:%u",
+                  _config.address.c_str(), _config.port);
+            fail(State::FAILED);
+            return;
+        } else if (connected == 0) {
+            return;
+        }
+        _connecting = false;
+    }
+
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags = MSG_NOSIGNAL;
+#endif
+    while (_sent < _outgoing.size()) {
+        size_t size = _outgoing.size() - _sent;
+        auto count = ::send(
+            _socket, reinterpret_cast<const char*>(_outgoing.data() + _sent),
+            static_cast<int>(size), flags);
+        if (count < 0) {
+            if (!wouldBlock()) {
+                CULog("Lost the relay connection");
+                fail(State::DISCONNECTED);
+            }
+            break;
+        }
+        _sent += count;
+    }
+    if (_sent == _outgoing.size()) {
+        _outgoing.clear();
+        _sent = 0;
+    }
+}
+
+bool RelayTransport::broadcast(const std::vector<std::byte>& data) {
+    if (_state != State::CONNECTED) {
+        return false;
+    }
+    _writer.begin(RelayOp::Broadcast);
+    _writer.writeBytes(data.data(), data.size());
+    return post();
+}
+
+bool RelayTransport::sendToHost(const std::vector<std::byte>& data) {
+    if (_state != State::CONNECTED) {
+        return false;
+    }
+    _writer.begin(RelayOp::ToHost);
+    _writer.writeBytes(data.data(), data.size());
+    return post();
+}
+
+bool RelayTransport::sendTo(const std::string& dest,
+                            const std::vector<std::byte>& data) {
+    if (_state != State::CONNECTED) {
+        return false;
+    }
+    _writer.begin(RelayOp::ToPeer);
+    _writer.writeString(dest);
+    _writer.writeBytes(data.data(), data.size());
+    return post();
+}
+
+#pragma mark -
+#pragma mark Receiving
+
+/**
+ * Sends what the socket takes and reads what it has.
+ */
+void RelayTransport::pump() {
+    if (_socket < 0) {
+        return;
+    }
+    flush();
+    if (_socket < 0 || _connecting) {
+        return;
+    }
+
+    std::byte buffer[RELAY_READ_SIZE];
+    while (true) {
+        auto count = ::recv(_socket, reinterpret_cast<char*>(buffer),
+                            RELAY_READ_SIZE, 0);
+        if (count > 0) {
+            _decoder.push(buffer, count);
+            continue;
+        }
+        if (count == 0 || !wouldBlock()) {
+            CULog("Lost the relay connection");
+            fail(State::DISCONNECTED);
+        }
+        break;
+    }
+}
+
+/**
+ * Handles one frame from the relay.
+ *
+ * @param op    The frame opcode
+ * @param body  The first byte of the body
+ * @param size  The size of the body
+ */
+void RelayTransport::handle(RelayOp op, const std::byte* body, size_t size) {
+    RelayReader reader(body, size);
+    switch (op) {
+    case RelayOp::Welcome:
+        _room = reader.readString();
+        _uuid = reader.readString();
+        _host = reader.readString();
+        _players = reader.readByte();
+        if (!reader.failed()) {
+            _state = State::CONNECTED;
+        }
+        break;
+    case RelayOp::Denied: {
+        RelayDenial reason = static_cast<RelayDenial>(reader.readByte());
+        CULog("The relay refused room %s (%d)", _room.c_str(),
+              static_cast<int>(reason));
+        fail(reason == RelayDenial::Mismatched ? State::MISMATCHED
+                                               : State::DENIED);
+        break;
+    }
+    case RelayOp::Players:
+        _players = reader.readByte();
+        break;
+    case RelayOp::Data: {
+        std::string source = reader.readString();
+        if (reader.failed()) {
+            break;
+        }
+        _received.push_back(
+            {source, std::vector<std::byte>(
+                         reader.getRest(),
+                         reader.getRest() + reader.getRemaining())});
+        break;
+    }
+    case RelayOp::Closed:
+        fail(State::DISCONNECTED);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Delivers every packet received since the last call.
+ *
+ * This is also where the socket is serviced, so it must be called every
+ * frame, even before the transport is connected.
+ *
+ * @param dispatcher    Called once per packet, in arrival order
+ */
+void RelayTransport::receive(const Dispatcher& dispatcher) {
+    pump();
+    RelayOp op;
+    const std::byte* body;
+    size_t size;
+    while (_decoder.next(op, body, size)) {
+        handle(op, body, size);
+    }
+    if (_decoder.failed() && _socket >= 0) {
+        CULog("The relay sent a frame that is too large");
+        fail(State::FAILED);
+    }
+    for (const Packet& packet : _received) {
+        dispatcher(packet.source, packet.data);
+    }
+    _received.clear();
+}
@@ -0,0 +1,166 @@
+//
+//  SCRelayTransport.hpp
+//  Sunk Cost
+//
+//  This module provides the transport over the local relay server in
+//  tools/relay, for matches on a LAN or in CI without the CUGL lobby.
+//
+//  The relay does the room-code handshake of the lobby and then forwards
+//  every packet itself, so there is no WebRTC and no ICE server. Each peer
+//  holds one non-blocking TCP connection to the relay. Nothing runs in the
+//  background: the socket is serviced whenever the transport sends and in
+//  receive, which the scenes and controllers call every frame.
+//
+//  TCP delivers everything in order, so a lost segment holds up the packets
+//  behind it. That is fine on a LAN, and the game's own channels do not mind
+//  packets that are late rather than lost.
+//
+
+#ifndef SCRelayTransport_hpp
+#define SCRelayTransport_hpp
+
+#include "SCRelayProtocol.hpp"
+#include "SCTransport.hpp"
+#include <cugl/cugl.h>
+#include <memory>
+
+/**
+ * The relay server to use instead of the lobby.
+ */
+struct RelayConfig {
+    /** Whether the relay is used at all */
+    bool enabled = false;
+    /** The host name or address of the relay */
+    std::string address = "127.0.0.1";
+    /** The port of the relay */
+    Uint16 port = RELAY_DEFAULT_PORT;
+    /** The most players in a room we host */
+    Uint8 maxPlayers = 4;
+    /** The API version, which every player of a room must share */
+    Uint32 apiVersion = 0;
+
+    /**
+     * Reads the relay from the server configuration.
+     *
+     * The relay is the "relay" object, with "enabled", "address" and
+     * "port". The player limit and API version are the ones of the lobby.
+     *
+     * @param json  The contents of json/server.json
+     *
+     * @return true if the relay is enabled
+     */
+    bool set(const std::shared_ptr<cugl::JsonValue>& json);
+};
+
+/**
+ * A transport backed by a TCP connection to the local relay.
+ */
+class RelayTransport : public Transport {
+  private:
+    /** A packet received from the relay */
+    struct Packet {
+        std::string source;
+        std::vector<std::byte> data;
+    };
+
+    /** The relay to connect to */
+    RelayConfig _config;
+    /** Whether this peer hosts the room */
+    bool _hosting;
+    /** The room code, as asked for or as given by the relay */
+    std::string _room;
+    /** The socket, or -1 when there is none */
+    Sint64 _socket;
+    /** Whether the socket is still connecting */
+    bool _connecting;
+    /** The connection state */
+    State _state;
+    std::string _uuid;
+    std::string _host;
+    size_t _players;
+
+    /** The frames to send and how much of them has been sent */
+    std::vector<std::byte> _outgoing;
+    size_t _sent;
+    /** Builds the outgoing frames, reused between sends */
+    RelayWriter _writer;
+    /** Splits the incoming bytes into frames */
+    RelayDecoder _decoder;
+    /** The packets to dispatch, reused between calls */
+    std::vector<Packet> _received;
+
+    /** Sends what the socket takes and reads what it has */
+    void pump();
+
+    /** Sends what the socket takes of the outgoing frames */
+    void flush();
+
+    /** Handles one frame from the relay */
+    void handle(RelayOp op, const std::byte* body, size_t size);
+
+    /** Queues the frame in the writer and sends what the socket takes */
+    bool post();
+
+    /** Closes the socket and moves to the given state */
+    void fail(State state);
+
+  public:
+    /**
+     * Creates a transport. Use the static allocators instead.
+     *
+     * @param config    The relay to connect to
+     * @param room      The room to join, or empty to host one
+     */
+    RelayTransport(const RelayConfig& config, const std::string& room);
+
+    ~RelayTransport();
+
+    /**
+     * Returns a transport that hosts a new room on the relay.
+     *
+     * @param config    The relay configuration
+     *
+     * @return a transport that hosts a new room on the relay
+     */
+    static std::shared_ptr<RelayTransport> alloc(const RelayConfig& config) {
+        return std::make_shared<RelayTransport>(config, "");
+    }
+
+    /**
+     * Returns a transport that joins an existing room on the relay.
+     *
+     * @param config    The relay configuration
+     * @param room      The room to join
+     *
+     * @return a transport that joins an existing room on the relay
+     */
+    static std::shared_ptr<RelayTransport> alloc(const RelayConfig& config,
+                                                 const std::string& room) {
+        return std::make_shared<RelayTransport>(config, room);
+    }
+
+    bool open() override;
+
+    void close() override;
+
+    State getState() const override { return _state; }
+
+    const std::string getHost() const override { return _host; }
+
+    const std::string getUUID() const override { return _uuid; }
+
+    const std::string getRoom() const override { return _room; }
+
+    size_t getNumPlayers() const override { return _players; }
+
+    bool broadcast(const std::vector<std::byte>& data) override;
+
+    bool sendToHost(const std::vector<std::byte>& data) override;
+
+    bool sendTo(const std::string& dest,
+                const std::vector<std::byte>& data) override;
+
+    void receive(const Dispatcher& dispatcher) override;
+};
+
+#endif /* SCRelayTransport_hpp */
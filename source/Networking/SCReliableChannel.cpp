@@ -0,0 +1,279 @@
+//
+//  SCReliableChannel.cpp
+//  Sunk Cost
+//
+//  This module provides reliable, ordered delivery of game events.
+//  See the header for details.
+//
+//  The timeout estimate follows RFC 6298. Only events acknowledged after
+//  their first send are sampled (Karn's rule), since an ack for a resent
+//  event cannot tell which copy it answers.
+//
+
+#include "SCReliableChannel.hpp"
+#include "SCClockSync.hpp"
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Sets where this channel sends and forgets all channel state.
+ *
+ * @param route The outbox route to the peer
+ * @param dest  The peer UUID when route is Peer
+ */
+void ReliableChannel::init(Outbox::Route route, const std::string& dest) {
+    _route = route;
+    _dest = dest;
+    reset();
+}
+
+/**
+ * Forgets all channel state, keeping the route
+ */
+void ReliableChannel::reset() {
+    _unacked.clear();
+    _nextSeq = 0;
+    _nextExpected = 0;
+    _held.fill(false);
+    _headerPending = false;
+    _headerSeq = 0;
+    _ackOwed = false;
+    _srtt = 0;
+    _rttvar = 0;
+    _rto = RELIABLE_INITIAL_RTO;
+    _hasRtt = false;
+    _updates = 0;
+    _sent = 0;
+    _resends = 0;
+    _rttSamples = 0;
+    _delivered = 0;
+    _duplicates = 0;
+}
+
+/**
+ * Hands over every event the peer has not acknowledged, oldest first.
+ *
+ * @param events    The list to append the events to
+ */
+void ReliableChannel::takeUnacked(std::vector<GameMessage>& events) {
+    for (const Pending& pending : _unacked) {
+        events.push_back(pending.message);
+    }
+    _unacked.clear();
+}
+
+/**
+ * Returns true if the peer can hold this event.
+ *
+ * The receiver drops anything RELIABLE_WINDOW or more past the oldest event
+ * it is missing, so sending further ahead only wastes bandwidth.
+ */
+bool ReliableChannel::inWindow(const Pending& pending) const {
+    Sint16 ahead = static_cast<Sint16>(pending.seq - _unacked.front().seq);
+    return ahead < RELIABLE_WINDOW;
+}
+
+/**
+ * Queues an event with its header
+ */
+void ReliableChannel::push(const Pending& pending, Outbox& outbox) {
+    outbox.pushReliable(pending.seq, pending.message, _route, _dest);
+}
+
+/**
+ * Queues an event for reliable delivery.
+ *
+ * @param message   The event to send
+ * @param outbox    The outbox for this frame
+ */
+void ReliableChannel::send(const GameMessage& message, Outbox& outbox) {
+    _unacked.push_back({_nextSeq++, message, 0, 0});
+    _sent++;
+    Pending& pending = _unacked.back();
+    if (inWindow(pending)) {
+        push(pending, outbox);
+        pending.sentAt = ClockSync::localMillis();
+        pending.sends = 1;
+    }
+}
+
+/**
+ * Resends timed out events and queues an acknowledgement if one is owed.
+ *
+ * This should be called once per frame, before the outbox is flushed.
+ *
+ * @param outbox    The outbox for this frame
+ */
+void ReliableChannel::update(Outbox& outbox) {
+    _updates++;
+    Uint32 now = ClockSync::localMillis();
+    for (Pending& pending : _unacked) {
+        if (!inWindow(pending)) {
+            break;
+        }
+        if (pending.sends == 0) {
+            // The window has opened up for an event held back by send
+            push(pending, outbox);
+            pending.sentAt = now;
+            pending.sends = 1;
+            continue;
+        }
+        // Back off exponentially while the same event keeps timing out
+        Uint32 shift = std::min<Uint32>(pending.sends - 1, 16);
+        Uint32 timeout = std::min<Uint32>(_rto << shift, RELIABLE_MAX_RTO);
+        if (now - pending.sentAt >= timeout) {
+            push(pending, outbox);
+            pending.sentAt = now;
+            pending.sends++;
+            _resends++;
+        }
+    }
+
+    if (_ackOwed) {
+        Uint32 bits = 0;
+        for (Uint32 i = 0; i + 1 < RELIABLE_WINDOW; i++) {
+            Uint16 seq = static_cast<Uint16>(_nextExpected + 1 + i);
+            if (_held[seq % RELIABLE_WINDOW]) {
+                bits |= 1u << i;
+            }
+        }
+        Uint16 through = static_cast<Uint16>(_nextExpected - 1);
+        outbox.push(ReliableAckMessage{through, bits}, _route, _dest);
+        _ackOwed = false;
+    }
+
+    if (_updates % RELIABLE_LOG_INTERVAL == 0) {
+        CULog("reliable: %zu in flight, srtt %.1f ms, rto %u ms, %llu sent, "
+              "%llu resent, %llu rtt samples, %llu delivered, %llu duplicates",
+              _unacked.size(), _srtt, _rto, (unsigned long long)_sent,
+              (unsigned long long)_resends, (unsigned long long)_rttSamples,
+              (unsigned long long)_delivered,
+              (unsigned long long)_duplicates);
+    }
+}
+
+/**
+ * Processes an acknowledgement from the peer
+ */
+void ReliableChannel::acknowledge(const ReliableAckMessage& ack) {
+    Uint32 now = ClockSync::localMillis();
+    bool sampled = false;
+    Uint32 rtt = 0;
+    for (auto it = _unacked.begin(); it != _unacked.end();) {
+        // Seq through + 1 is missing by definition, so bit 0 is through + 2
+        Sint16 d = static_cast<Sint16>(it->seq - ack.through);
+        bool acked =
+            d <= 0 || (d >= 2 && d - 2 < 32 && (ack.bits >> (d - 2)) & 1u);
+        if (!acked) {
+            ++it;
+            continue;
+        }
+        if (it->sends == 0) {
+            // Acknowledged without being sent can only be a stale ack
+            ++it;
+            continue;
+        }
+        if (it->sends == 1) {
+            // Later entries were sent later, so this keeps the freshest
+            rtt = now - it->sentAt;
+            sampled = true;
+        }
+        it = _unacked.erase(it);
+    }
+    if (sampled) {
+        sampleRtt(rtt);
+    }
+}
+
+/**
+ * Folds a round trip sample into the timeout estimate
+ */
+void ReliableChannel::sampleRtt(Uint32 rtt) {
+    float r = static_cast<float>(rtt);
+    if (!_hasRtt) {
+        _srtt = r;
+        _rttvar = r / 2;
+        _hasRtt = true;
+    } else {
+        _rttvar = 0.75f * _rttvar + 0.25f * std::fabs(_srtt - r);
+        _srtt = 0.875f * _srtt + 0.125f * r;
+    }
+    float rto = _srtt + std::max(1.0f, 4 * _rttvar);
+    _rto = static_cast<Uint32>(std::min<float>(
+        std::max<float>(rto, RELIABLE_MIN_RTO), RELIABLE_MAX_RTO));
+    _rttSamples++;
+    if (_telemetry != nullptr) {
+        _telemetry->recordRoundTrip(rtt);
+    }
+}
+
+/**
+ * Accepts a reliable event and delivers everything now in order
+ */
+void ReliableChannel::accept(
+    Uint16 seq, const GameMessage& message,
+    const std::function<void(const GameMessage&)>& deliver) {
+    // Even a duplicate means our last ack may have been lost
+    _ackOwed = true;
+    Sint16 d = static_cast<Sint16>(seq - _nextExpected);
+    if (d < 0) {
+        _duplicates++;
+        return;
+    }
+    if (d >= RELIABLE_WINDOW) {
+        // Too far ahead to hold; the sender will resend it
+        return;
+    }
+
+    size_t slot = seq % RELIABLE_WINDOW;
+    if (_held[slot]) {
+        _duplicates++;
+        return;
+    }
+    _reorder[slot] = message;
+    _held[slot] = true;
+
+    while (_held[_nextExpected % RELIABLE_WINDOW]) {
+        size_t next = _nextExpected % RELIABLE_WINDOW;
+        _held[next] = false;
+        _nextExpected++;
+        _delivered++;
+        deliver(_reorder[next]);
+    }
+}
+
+/**
+ * Passes a received message through the channel.
+ *
+ * Headers, acknowledgements and reliable events are consumed by the
+ * channel; events are handed to deliver in sequence order, possibly
+ * later than they arrive. Any other message is left to the caller.
+ *
+ * @param message   A message unpacked from a packet from the peer
+ * @param deliver   Called with each event in order
+ *
+ * @return true if the channel consumed the message
+ */
+bool ReliableChannel::filter(
+    const GameMessage& message,
+    const std::function<void(const GameMessage&)>& deliver) {
+    switch (message.type) {
+    case MessageType::Reliable:
+        // Outbox::unpack hands over the event right after its header
+        _headerPending = true;
+        _headerSeq = message.get<ReliableMessage>().seq;
+        return true;
+    case MessageType::ReliableAck:
+        _headerPending = false;
+        acknowledge(message.get<ReliableAckMessage>());
+        return true;
+    default:
+        break;
+    }
+    if (!_headerPending) {
+        return false;
+    }
+    _headerPending = false;
+    accept(_headerSeq, message, deliver);
+    return true;
+}
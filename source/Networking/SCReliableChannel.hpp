@@ -0,0 +1,218 @@
+//
+//  SCReliableChannel.hpp
+//  Sunk Cost
+//
+//  This module provides reliable, ordered delivery of game events.
+//
+//  An event is sent as a Reliable header carrying its sequence number,
+//  followed by the event itself in the same frame of the packet, so the
+//  receiver gets both or neither. The receiver delivers events strictly in
+//  sequence order, holding early ones in a small reorder buffer, and answers
+//  with a ReliableAck that rides in the next frame's batch. The ack is
+//  cumulative plus a 32 bit selective bitfield, so only the events that were
+//  actually lost are resent when their retransmission timeout expires. The
+//  timeout follows RFC 6298 and doubles on every resend of the same event.
+//  The sender never runs more than RELIABLE_WINDOW events ahead of the
+//  oldest unacknowledged one.
+//
+//  Continuous state (positions, the camera index, clocks) stays on the
+//  unreliable path; only discrete events that must never be missed go
+//  through this channel.
+//
+
+#ifndef SCReliableChannel_hpp
+#define SCReliableChannel_hpp
+
+#include "SCMessage.hpp"
+#include "SCNetTelemetry.hpp"
+#include "SCOutbox.hpp"
+#include <array>
+#include <cugl/cugl.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/** The number of sequence numbers the receiver can hold out of order */
+#define RELIABLE_WINDOW 32
+/** The retransmission timeout before the first RTT sample, in ms */
+#define RELIABLE_INITIAL_RTO 250
+/** The smallest retransmission timeout in ms */
+#define RELIABLE_MIN_RTO 50
+/** The largest retransmission timeout in ms */
+#define RELIABLE_MAX_RTO 2000
+/** The number of updates between channel statistics in the log */
+#define RELIABLE_LOG_INTERVAL 600
+
+/**
+ * One end of a reliable ordered event channel to a single peer.
+ */
+class ReliableChannel {
+  private:
+    /** An event waiting for its acknowledgement */
+    struct Pending {
+        Uint16 seq;
+        GameMessage message;
+        /** The local time of the last send */
+        Uint32 sentAt;
+        /** The number of sends, 0 while held back by the window */
+        Uint32 sends;
+    };
+
+    /** Where this channel sends */
+    Outbox::Route _route;
+    /** The peer UUID when the route is Peer */
+    std::string _dest;
+
+    /** The unacknowledged events, oldest first */
+    std::deque<Pending> _unacked;
+    /** The sequence number of the next event sent */
+    Uint16 _nextSeq;
+
+    /** The sequence number of the next event to deliver */
+    Uint16 _nextExpected;
+    /** The events received ahead of _nextExpected */
+    std::array<GameMessage, RELIABLE_WINDOW> _reorder;
+    /** Whether each reorder slot holds an event */
+    std::array<bool, RELIABLE_WINDOW> _held;
+    /** Whether the last message was a Reliable header */
+    bool _headerPending;
+    /** The sequence number of that header */
+    Uint16 _headerSeq;
+    /** Whether the peer is owed an acknowledgement */
+    bool _ackOwed;
+
+    /** The smoothed round trip time in ms */
+    float _srtt;
+    /** The round trip time variation in ms */
+    float _rttvar;
+    /** The current retransmission timeout in ms */
+    Uint32 _rto;
+    /** Whether there has been an RTT sample yet */
+    bool _hasRtt;
+    /** The telemetry to report RTT samples to, if any */
+    NetTelemetry* _telemetry;
+
+    Uint64 _updates;
+    Uint64 _sent;
+    Uint64 _resends;
+    Uint64 _rttSamples;
+    Uint64 _delivered;
+    Uint64 _duplicates;
+
+    /** Returns true if the peer can hold this event */
+    bool inWindow(const Pending& pending) const;
+
+    /** Queues an event with its header */
+    void push(const Pending& pending, Outbox& outbox);
+
+    /** Processes an acknowledgement from the peer */
+    void acknowledge(const ReliableAckMessage& ack);
+
+    /** Folds a round trip sample into the timeout estimate */
+    void sampleRtt(Uint32 rtt);
+
+    /** Accepts a reliable event and delivers everything now in order */
+    void accept(Uint16 seq, const GameMessage& message,
+                const std::function<void(const GameMessage&)>& deliver);
+
+  public:
+    ReliableChannel() : _route(Outbox::Route::Broadcast), _telemetry(nullptr) {
+        reset();
+    }
+
+    /**
+     * Sets where this channel sends and forgets all channel state.
+     *
+     * @param route The outbox route to the peer
+     * @param dest  The peer UUID when route is Peer
+     */
+    void init(Outbox::Route route, const std::string& dest = "");
+
+    /** Forgets all channel state, keeping the route */
+    void reset();
+
+    /**
+     * Hands over every event the peer has not acknowledged, oldest first.
+     *
+     * The events are no longer resent by the channel. This is meant for a
+     * channel about to be reset, whose events may still need to be sent
+     * again on the new one.
+     *
+     * @param events    The list to append the events to
+     */
+    void takeUnacked(std::vector<GameMessage>& events);
+
+    /**
+     * Reports every round trip sample to the given telemetry.
+     *
+     * @param telemetry The telemetry, or nullptr to stop reporting
+     */
+    void setTelemetry(NetTelemetry* telemetry) { _telemetry = telemetry; }
+
+    /**
+     * Queues an event for reliable delivery.
+     *
+     * @param message   The event to send
+     * @param outbox    The outbox for this frame
+     */
+    void send(const GameMessage& message, Outbox& outbox);
+
+    /**
+     * Resends timed out events and queues an acknowledgement if one is owed.
+     *
+     * This should be called once per frame, before the outbox is flushed.
+     *
+     * @param outbox    The outbox for this frame
+     */
+    void update(Outbox& outbox);
+
+    /**
+     * Forgets a header still waiting for its event.
+     *
+     * This should be called at every packet boundary and whenever a message
+     * from the peer fails to decode, so that no other message is ever taken
+     * for the event of a header.
+     */
+    void interrupt() { _headerPending = false; }
+
+    /**
+     * Passes a received message through the channel.
+     *
+     * Headers, acknowledgements and reliable events are consumed by the
+     * channel; events are handed to deliver in sequence order, possibly
+     * later than they arrive. Any other message is left to the caller.
+     *
+     * @param message   A message unpacked from a packet from the peer
+     * @param deliver   Called with each event in order
+     *
+     * @return true if the channel consumed the message
+     */
+    bool filter(const GameMessage& message,
+                const std::function<void(const GameMessage&)>& deliver);
+
+    /** Returns the sequence number of the next event sent */
+    Uint16 getNextSeq() const { return _nextSeq; }
+
+    /** Returns the sequence number of the next event to deliver */
+    Uint16 getNextExpected() const { return _nextExpected; }
+
+    /** Returns the number of events waiting for an acknowledgement */
+    size_t getInFlight() const { return _unacked.size(); }
+
+    /** Returns the smoothed round trip time in ms */
+    float getRoundTrip() const { return _srtt; }
+
+    Uint32 getTimeout() const { return _rto; }
+
+    Uint64 getSent() const { return _sent; }
+
+    Uint64 getResends() const { return _resends; }
+
+    Uint64 getRttSamples() const { return _rttSamples; }
+
+    Uint64 getDelivered() const { return _delivered; }
+
+    Uint64 getDuplicates() const { return _duplicates; }
+};
+
+#endif /* SCReliableChannel_hpp */
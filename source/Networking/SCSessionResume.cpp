@@ -0,0 +1,342 @@
+//
+//  SCSessionResume.cpp
+//  Sunk Cost
+//
+//  This module provides session resume, so that a short drop of the hunter
+//  connection no longer ends the match. See the header for details.
+//
+
+#include "SCSessionResume.hpp"
+#include "SCClockSync.hpp"
+#include <algorithm>
+
+using namespace cugl;
+
+#pragma mark -
+#pragma mark Transport
+
+/**
+ * Creates a transport on connections from the factory.
+ *
+ * @param factory   Returns a new, unopened connection to the room
+ */
+ResumableTransport::ResumableTransport(const Factory& factory)
+    : _factory(factory), _inner(factory()), _joined(false), _rejoining(false),
+      _expired(false), _lostAt(0), _attemptAt(0), _session(0), _attempts(0) {}
+
+/**
+ * Leaves the room for good.
+ */
+void ResumableTransport::close() {
+    _joined = false;
+    _rejoining = false;
+    _inner->close();
+}
+
+/**
+ * Returns the connection state.
+ *
+ * A lost connection is reported as CONNECTING while it is being replaced,
+ * and as FAILED once RECONNECT_WINDOW has run out.
+ *
+ * @return the connection state
+ */
+Transport::State ResumableTransport::getState() const {
+    if (_expired) {
+        return State::FAILED;
+    }
+    State state = _inner->getState();
+    if ((_rejoining && state != State::CONNECTED) ||
+        (_joined && isLost(state))) {
+        return State::CONNECTING;
+    }
+    return state;
+}
+
+/**
+ * Notices a lost connection and replaces it; called once per frame.
+ */
+void ResumableTransport::poll() {
+    Uint32 now = ClockSync::localMillis();
+    State state = _inner->getState();
+    if (state == State::CONNECTED) {
+        if (_rejoining) {
+            _rejoining = false;
+            _session++;
+            CULog("Rejoined room %s after %u ms", _inner->getRoom().c_str(),
+                  now - _lostAt);
+        }
+        _joined = true;
+        return;
+    }
+    if (!_joined || _expired) {
+        // A connection that never reached the room fails as it is
+        return;
+    }
+    if (!_rejoining) {
+        if (!isLost(state)) {
+            return;
+        }
+        CULog("Lost the connection to room %s", _inner->getRoom().c_str());
+        _rejoining = true;
+        _lostAt = now;
+        _attemptAt = now - RECONNECT_RETRY;
+    }
+    if (now - _lostAt >= RECONNECT_WINDOW) {
+        CULog("Could not rejoin room %s", _inner->getRoom().c_str());
+        _expired = true;
+        _inner->close();
+        return;
+    }
+    // The room may still hold our old peer for a while, which denies us
+    bool pending =
+        state == State::CONNECTING || state == State::NEGOTIATING;
+    if (!pending && now - _attemptAt >= RECONNECT_RETRY) {
+        _inner->close();
+        _inner = _factory();
+        _inner->open();
+        _attemptAt = now;
+        _attempts++;
+    }
+}
+
+/**
+ * Delivers every packet received since the last call.
+ *
+ * @param dispatcher    Called once per packet, in arrival order
+ */
+void ResumableTransport::receive(const Dispatcher& dispatcher) {
+    poll();
+    _inner->receive(dispatcher);
+}
+
+#pragma mark -
+#pragma mark Host
+
+/**
+ * Forgets the hunters and every answered session
+ */
+void ResumeHost::reset() {
+    _peak = 1;
+    _hunters = 0;
+    _left = 0;
+    _heardAt.fill(0);
+    _away.fill(false);
+    _leftAt.fill(0);
+    _gone.fill(false);
+    _paused = false;
+    _pausedAt = 0;
+    _pause = 0;
+    _answered.fill(0);
+    _writer.reset();
+}
+
+/**
+ * Checks which hunters are in the room.
+ *
+ * @param players   The number of peers in the room, the host included
+ * @param hunters   The number of players given out
+ * @param now       The local time in milliseconds
+ *
+ * @return true while every hunter is missing and the match is paused
+ */
+bool ResumeHost::update(size_t players, int hunters, Uint32 now) {
+    _hunters = std::min(hunters, MAX_HUNTERS);
+    _peak = std::max(_peak, players);
+
+    // The hunters still holding a place, heard from least recently first
+    std::array<int, MAX_HUNTERS> order;
+    int count = 0;
+    for (int player = 0; player < _hunters; player++) {
+        if (!_gone[player]) {
+            order[count++] = player;
+        }
+    }
+    std::stable_sort(order.begin(), order.begin() + count, [&](int a, int b) {
+        return now - _heardAt[a] > now - _heardAt[b];
+    });
+
+    int missing = static_cast<int>(_peak - std::min(players, _peak));
+    _left = 0;
+    int away = 0;
+    for (int i = 0; i < count; i++) {
+        int player = order[i];
+        if (i < missing && !_away[player]) {
+            CULog("Player %d left; holding its place", player);
+            _away[player] = true;
+            _leftAt[player] = now;
+        } else if (i >= missing && _away[player]) {
+            CULog("Player %d is back after %u ms", player,
+                  now - _leftAt[player]);
+            _away[player] = false;
+        }
+        if (_away[player] && now - _leftAt[player] >= RECONNECT_WINDOW) {
+            CULog("Player %d did not come back", player);
+            _away[player] = false;
+            _gone[player] = true;
+            // Its peer is not coming back to the room either
+            _peak--;
+            continue;
+        }
+        _left++;
+        away += _away[player] ? 1 : 0;
+    }
+
+    bool paused = _left > 0 && away == _left;
+    if (paused && !_paused) {
+        CULog("Every hunter left; pausing the match");
+        _paused = true;
+        _pausedAt = now;
+    } else if (!paused && _paused && _left > 0) {
+        CULog("The hunters are back after %u ms", now - _pausedAt);
+        _pause += now - _pausedAt;
+        _paused = false;
+    }
+    return _paused;
+}
+
+/**
+ * Accepts a resume request.
+ *
+ * @param request   The resume request
+ *
+ * @return false if the session has already been answered, or the player
+ * is not one of ours or gave up its place
+ */
+bool ResumeHost::accept(const ResumeMessage& request) {
+    if (request.player >= MAX_HUNTERS || _gone[request.player] ||
+        request.session == _answered[request.player]) {
+        return false;
+    }
+    _answered[request.player] = request.session;
+    return true;
+}
+
+/**
+ * Answers the accepted request of a player with the match snapshot.
+ *
+ * @param player    The player of the accepted request
+ * @param snapshot  The host snapshot
+ * @param send      Called with every piece of the snapshot, in order
+ */
+void ResumeHost::answer(int player, const MatchSnapshot& snapshot,
+                        const std::function<void(const GameMessage&)>& send) {
+    _writer.reset();
+    SnapshotCodec::encode(snapshot, _writer);
+
+    const std::vector<std::byte>& bytes = _writer.getData();
+    Uint16 total = static_cast<Uint16>(bytes.size());
+    for (size_t offset = 0; offset < bytes.size(); offset += WIRE_CHUNK_SIZE) {
+        WireChunk chunk;
+        chunk.size = static_cast<Uint8>(
+            std::min<size_t>(WIRE_CHUNK_SIZE, bytes.size() - offset));
+        std::copy_n(bytes.begin() + offset, chunk.size, chunk.data);
+        send(SnapshotChunkMessage{_answered[player],
+                                  static_cast<Uint16>(offset), total, chunk});
+    }
+}
+
+#pragma mark -
+#pragma mark Client
+
+/**
+ * Forgets every resume in progress and statistic.
+ *
+ * @param session   The current transport session
+ */
+void ResumeClient::reset(Uint8 session) {
+    _session = session;
+    _lost = false;
+    _waiting = false;
+    _lostAt = 0;
+    _joinedAt = 0;
+    _requestAt = 0;
+    _bytes.clear();
+    _outage = 0;
+    _resync = 0;
+    _resumes = 0;
+}
+
+/**
+ * Follows the connection.
+ *
+ * @param state     The transport state
+ * @param session   The transport session
+ * @param now       The local time in milliseconds
+ *
+ * @return true if the room was rejoined
+ */
+bool ResumeClient::update(Transport::State state, Uint8 session, Uint32 now) {
+    if (session != _session) {
+        _session = session;
+        _lost = false;
+        _waiting = true;
+        _joinedAt = now;
+        _requestAt = now - RESUME_REPEAT;
+        _bytes.clear();
+        return true;
+    }
+    if (state != Transport::State::CONNECTED && !_lost) {
+        if (!_waiting) {
+            _lostAt = now;
+        }
+        _lost = true;
+    }
+    return false;
+}
+
+/**
+ * Returns the resume request when it is due.
+ *
+ * @param now       The local time in milliseconds
+ * @param player    The player number the host gave us
+ * @param request   Set to the resume request if this returns true
+ *
+ * @return true if the request must be sent
+ */
+bool ResumeClient::request(Uint32 now, Uint8 player, GameMessage& request) {
+    if (_lost || !_waiting || !_bytes.empty() ||
+        now - _requestAt < RESUME_REPEAT) {
+        return false;
+    }
+    _requestAt = now;
+    request = ResumeMessage{_session, player};
+    return true;
+}
+
+/**
+ * Adds a piece of the host snapshot.
+ *
+ * @param chunk     The piece
+ * @param now       The local time in milliseconds
+ * @param snapshot  Set to the host snapshot if this returns true
+ *
+ * @return true if the snapshot is complete
+ */
+bool ResumeClient::receive(const SnapshotChunkMessage& chunk, Uint32 now,
+                           MatchSnapshot& snapshot) {
+    // The pieces arrive in order, so anything else is from an old session
+    if (!_waiting || chunk.session != _session ||
+        chunk.offset != _bytes.size() ||
+        chunk.offset + chunk.data.size > chunk.total) {
+        return false;
+    }
+    _bytes.insert(_bytes.end(), chunk.data.data,
+                  chunk.data.data + chunk.data.size);
+    if (_bytes.size() < chunk.total) {
+        return false;
+    }
+
+    MessageReader reader(_bytes);
+    if (!SnapshotCodec::decode(reader, snapshot)) {
+        // Play on unsynced rather than wait for an answer that never comes
+        CULog("Dropping a corrupt resume snapshot");
+        _waiting = false;
+        return false;
+    }
+    _waiting = false;
+    _outage = now - _lostAt;
+    _resync = now - _joinedAt;
+    _resumes++;
+    return true;
+}
@@ -0,0 +1,346 @@
+//
+//  SCSessionResume.hpp
+//  Sunk Cost
+//
+//  This module provides session resume, so that a short drop of the
+//  hunter connection no longer ends the match.
+//
+//  A ResumableTransport wraps the hunter connection. When the connection
+//  is lost it reports CONNECTING instead of DISCONNECTED, and joins the
+//  same room again with a new connection until RECONNECT_WINDOW runs out;
+//  only then does it report FAILED. Every rejoin starts a new session.
+//
+//  The host holds the place of a hunter while it is missing from the room,
+//  and pauses the match only while every hunter is missing. A hunter that
+//  stays away for RECONNECT_WINDOW gives up its place, and the match ends
+//  once no hunter is left.
+//  A hunter that starts a new session resets its channels and repeats a
+//  Resume request until the answer starts to arrive; the request cannot be
+//  reliable, since the host channel still counts the old session. The
+//  request names the player the hunter was, as its new connection has a
+//  new UUID. The host moves that player to the new connection, resets its
+//  channels too and answers with its match snapshot, split into
+//  SnapshotChunk messages on the fresh reliable channel. The hunter lays
+//  the host part of the snapshot over its own state and sends again every
+//  event the old channel had not seen acknowledged, unless the snapshot
+//  shows the host got it. The ordinary events and state messages that
+//  follow carry the match on from there. The time
+//  from the rejoin to the applied snapshot is measured on the hunter.
+//
+//  The host itself cannot resume: the room closes when its host leaves.
+//
+
+#ifndef SCSessionResume_hpp
+#define SCSessionResume_hpp
+
+#include "SCHunterRoster.hpp"
+#include "SCMatchSnapshot.hpp"
+#include "SCMessage.hpp"
+#include <array>
+#include "SCTransport.hpp"
+#include <functional>
+#include <memory>
+#include <vector>
+
+/** The milliseconds a lost hunter has to rejoin before the match ends */
+#define RECONNECT_WINDOW 15000
+/** The milliseconds between attempts to join the room again */
+#define RECONNECT_RETRY 2000
+/** The milliseconds between repeats of an unanswered resume request */
+#define RESUME_REPEAT 250
+
+/**
+ * A transport that joins its room again when the connection is lost.
+ */
+class ResumableTransport : public Transport {
+  public:
+    /** Returns a new, unopened connection to the room */
+    using Factory = std::function<std::shared_ptr<Transport>()>;
+
+  private:
+    /** Makes the connections */
+    Factory _factory;
+    /** The current connection */
+    std::shared_ptr<Transport> _inner;
+    /** Whether a connection has reached the room, so that it can rejoin */
+    bool _joined;
+    /** Whether the connection is lost and being replaced */
+    bool _rejoining;
+    /** Whether the window ran out, which is final */
+    bool _expired;
+    /** The local time the connection was lost */
+    Uint32 _lostAt;
+    /** The local time of the last attempt to rejoin */
+    Uint32 _attemptAt;
+    /** The number of rejoins */
+    Uint8 _session;
+    /** The number of connections made to rejoin */
+    Uint64 _attempts;
+
+    /** Returns true if a connection in this state has to be replaced */
+    static bool isLost(State state) {
+        return state == State::DISCONNECTED || state == State::FAILED;
+    }
+
+    /** Notices a lost connection and replaces it; called once per frame */
+    void poll();
+
+  public:
+    /**
+     * Creates a transport on connections from the factory.
+     *
+     * @param factory   Returns a new, unopened connection to the room
+     */
+    ResumableTransport(const Factory& factory);
+
+    /**
+     * Returns a transport on connections from the factory.
+     *
+     * @param factory   Returns a new, unopened connection to the room
+     *
+     * @return a transport on connections from the factory
+     */
+    static std::shared_ptr<ResumableTransport> alloc(const Factory& factory) {
+        return std::make_shared<ResumableTransport>(factory);
+    }
+
+    bool open() override { return _inner->open(); }
+
+    void close() override;
+
+    State getState() const override;
+
+    const std::string getHost() const override { return _inner->getHost(); }
+
+    const std::string getUUID() const override { return _inner->getUUID(); }
+
+    const std::string getRoom() const override { return _inner->getRoom(); }
+
+    size_t getNumPlayers() const override { return _inner->getNumPlayers(); }
+
+    Uint8 getSession() const override { return _session; }
+
+    bool broadcast(const std::vector<std::byte>& data) override {
+        return _inner->broadcast(data);
+    }
+
+    bool sendToHost(const std::vector<std::byte>& data) override {
+        return _inner->sendToHost(data);
+    }
+
+    bool sendTo(const std::string& dest,
+                const std::vector<std::byte>& data) override {
+        return _inner->sendTo(dest, data);
+    }
+
+    /**
+     * Delivers every packet received since the last call.
+     *
+     * This is also where a lost connection is noticed and replaced, so it
+     * must be called every frame.
+     *
+     * @param dispatcher    Called once per packet, in arrival order
+     */
+    void receive(const Dispatcher& dispatcher) override;
+
+    /** Returns the number of connections made to rejoin */
+    Uint64 getAttempts() const { return _attempts; }
+};
+
+/**
+ * The host end of session resume.
+ */
+class ResumeHost {
+  private:
+    /** The most peers that have been in the room, the host included */
+    size_t _peak;
+    /** The number of players given out */
+    int _hunters;
+    /** The number of players that have not given up their place */
+    int _left;
+    /** The local time each player was last heard from */
+    std::array<Uint32, MAX_HUNTERS> _heardAt;
+    /** Whether each player is missing from the room */
+    std::array<bool, MAX_HUNTERS> _away;
+    /** The local time each player went missing */
+    std::array<Uint32, MAX_HUNTERS> _leftAt;
+    /** Whether each player stayed away too long and gave up its place */
+    std::array<bool, MAX_HUNTERS> _gone;
+    /** Whether every hunter is missing and the match is paused */
+    bool _paused;
+    /** The local time the match was paused */
+    Uint32 _pausedAt;
+    /** The milliseconds of pause not yet taken by the match clock */
+    Uint32 _pause;
+    /** The last session answered with a snapshot, by player */
+    std::array<Uint8, MAX_HUNTERS> _answered;
+    /** The encoded snapshot, reused between answers */
+    MessageWriter _writer;
+
+  public:
+    ResumeHost() { reset(); }
+
+    /** Forgets the hunters and every answered session */
+    void reset();
+
+    /**
+     * Records that a player was heard from.
+     *
+     * This should be called for every message from a hunter.
+     *
+     * @param player    The player number
+     * @param now       The local time in milliseconds
+     */
+    void heard(int player, Uint32 now) { _heardAt[player] = now; }
+
+    /**
+     * Checks which hunters are in the room.
+     *
+     * The room only tells how many peers are missing, so the hunters heard
+     * from least recently are taken to be the missing ones.
+     *
+     * This should be called once per frame.
+     *
+     * @param players   The number of peers in the room, the host included
+     * @param hunters   The number of players given out
+     * @param now       The local time in milliseconds
+     *
+     * @return true while every hunter is missing and the match is paused
+     */
+    bool update(size_t players, int hunters, Uint32 now);
+
+    /** Returns true if the player is missing from the room */
+    bool isAway(int player) const { return _away[player]; }
+
+    /** Returns true if the player stayed away for RECONNECT_WINDOW */
+    bool isGone(int player) const { return _gone[player]; }
+
+    /** Returns true once every hunter has given up its place */
+    bool hasExpired() const { return _hunters > 0 && _left == 0; }
+
+    /**
+     * Returns the milliseconds of a pause that has ended, once.
+     *
+     * The match clock is moved on by this much, so the missing time is not
+     * taken from the hunter.
+     */
+    Uint32 takePause() {
+        Uint32 pause = _pause;
+        _pause = 0;
+        return pause;
+    }
+
+    /**
+     * Accepts a resume request.
+     *
+     * An accepted request starts a new session: every channel to the
+     * hunter has to be reset before it is answered.
+     *
+     * @param request   The resume request
+     *
+     * @return false if the session has already been answered, or the player
+     * is not one of ours or gave up its place
+     */
+    bool accept(const ResumeMessage& request);
+
+    /**
+     * Answers the accepted request of a player with the match snapshot.
+     *
+     * The snapshot is split into SnapshotChunk messages, which must be sent
+     * reliably and in order.
+     *
+     * @param player    The player of the accepted request
+     * @param snapshot  The host snapshot
+     * @param send      Called with every piece of the snapshot, in order
+     */
+    void answer(int player, const MatchSnapshot& snapshot,
+                const std::function<void(const GameMessage&)>& send);
+};
+
+/**
+ * The hunter end of session resume.
+ */
+class ResumeClient {
+  private:
+    /** The transport session last seen */
+    Uint8 _session;
+    /** Whether the connection is lost */
+    bool _lost;
+    /** Whether the room was rejoined and the snapshot is on its way */
+    bool _waiting;
+    /** The local time the connection was lost */
+    Uint32 _lostAt;
+    /** The local time the room was rejoined */
+    Uint32 _joinedAt;
+    /** The local time the resume request was last sent */
+    Uint32 _requestAt;
+    /** The snapshot bytes received so far */
+    std::vector<std::byte> _bytes;
+
+    /** The milliseconds from the loss to the applied snapshot, last time */
+    Uint32 _outage;
+    /** The milliseconds from the rejoin to the applied snapshot, last time */
+    Uint32 _resync;
+    /** The number of completed resumes */
+    Uint64 _resumes;
+
+  public:
+    ResumeClient() { reset(0); }
+
+    /**
+     * Forgets every resume in progress and statistic.
+     *
+     * @param session   The current transport session
+     */
+    void reset(Uint8 session);
+
+    /**
+     * Follows the connection.
+     *
+     * This should be called once per frame.
+     *
+     * @param state     The transport state
+     * @param session   The transport session
+     * @param now       The local time in milliseconds
+     *
+     * @return true if the room was rejoined, so that every channel to the
+     * host has to be reset
+     */
+    bool update(Transport::State state, Uint8 session, Uint32 now);
+
+    /**
+     * Returns the resume request when it is due: at once after a rejoin,
+     * then every RESUME_REPEAT milliseconds until the answer arrives.
+     *
+     * @param now       The local time in milliseconds
+     * @param player    The player number the host gave us
+     * @param request   Set to the resume request if this returns true
+     *
+     * @return true if the request must be sent
+     */
+    bool request(Uint32 now, Uint8 player, GameMessage& request);
+
+    /** Returns true while the connection is lost or the snapshot pending */
+    bool isWaiting() const { return _lost || _waiting; }
+
+    /**
+     * Adds a piece of the host snapshot.
+     *
+     * @param chunk     The piece
+     * @param now       The local time in milliseconds
+     * @param snapshot  Set to the host snapshot if this returns true
+     *
+     * @return true if the snapshot is complete
+     */
+    bool receive(const SnapshotChunkMessage& chunk, Uint32 now,
+                 MatchSnapshot& snapshot);
+
+    Uint32 getOutage() const { return _outage; }
+
+    /** Returns the milliseconds from the rejoin to the applied snapshot */
+    Uint32 getResync() const { return _resync; }
+
+    Uint64 getResumes() const { return _resumes; }
+};
+
+#endif /* SCSessionResume_hpp */
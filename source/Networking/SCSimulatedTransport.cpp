@@ -0,0 +1,226 @@
+//
+//  SCSimulatedTransport.cpp
+//  Sunk Cost
+//
+//  This module provides a transport decorator that degrades the link to
+//  reproduce bad networks on demand. See the header for details.
+//
+
+#include "SCSimulatedTransport.hpp"
+#include "SCClockSync.hpp"
+#include <algorithm>
+#include <iterator>
+
+using namespace cugl;
+
+#pragma mark -
+#pragma mark Conditions
+
+/**
+ * Reads the conditions from a JSON profile.
+ *
+ * The JSON names the active profile in "profile" and lists the profiles by
+ * name in "profiles". A profile of "none", or one that does not exist,
+ * disables the simulator.
+ *
+ * @param json  The contents of json/netsim.json
+ *
+ * @return true if the simulator is enabled
+ */
+bool NetworkConditions::set(const std::shared_ptr<JsonValue>& json) {
+    *this = NetworkConditions();
+    if (json == nullptr || !json->has("profiles")) {
+        return false;
+    }
+    std::string name = json->getString("profile", "none");
+    std::shared_ptr<JsonValue> profile = json->get("profiles")->get(name);
+    if (name == "none" || profile == nullptr) {
+        return false;
+    }
+
+    enabled = true;
+    latency = profile->getFloat("latency", latency);
+    jitter = profile->getFloat("jitter", jitter);
+    loss = profile->getFloat("loss", loss);
+    duplicate = profile->getFloat("duplicate", duplicate);
+    reorder = profile->getFloat("reorder", reorder);
+    bandwidth = profile->getInt("bandwidth", bandwidth);
+    queue = profile->getInt("queue", queue);
+    seed = json->getInt("seed", seed);
+    CULog("netsim: profile %s, %.0f+%.0f ms, %.1f%% loss, %.1f%% dup, "
+          "%.1f%% reorder, %u bytes/s",
+          name.c_str(), latency, jitter, loss * 100, duplicate * 100,
+          reorder * 100, bandwidth);
+    return true;
+}
+
+#pragma mark -
+#pragma mark Simulation
+
+/**
+ * Creates a simulator around another transport.
+ *
+ * @param inner         The transport to degrade
+ * @param conditions    The conditions to impose
+ */
+SimulatedTransport::SimulatedTransport(const std::shared_ptr<Transport>& inner,
+                                       const NetworkConditions& conditions)
+    : _inner(inner), _conditions(conditions), _random(conditions.seed),
+      _scheduled(0), _receives(0), _packets(0), _dropped(0), _duplicated(0),
+      _reordered(0), _overflowed(0) {}
+
+/**
+ * Returns true with the given probability
+ */
+bool SimulatedTransport::chance(float probability) {
+    if (probability <= 0) {
+        return false;
+    }
+    return std::uniform_real_distribution<float>(0, 1)(_random) < probability;
+}
+
+/**
+ * Delays a packet per the conditions, or drops it
+ */
+void SimulatedTransport::schedule(Direction& direction, Packet&& packet) {
+    _packets++;
+    if (chance(_conditions.loss)) {
+        _dropped++;
+        return;
+    }
+
+    Uint32 now = ClockSync::localMillis();
+    Uint32 depart = now;
+    if (_conditions.bandwidth > 0) {
+        // Serialize through the link; a long queue means a full router
+        depart = std::max(now, direction.linkFree);
+        if (depart - now > _conditions.queue) {
+            _overflowed++;
+            return;
+        }
+        direction.linkFree = depart + static_cast<Uint32>(
+                                          packet.data.size() * 1000 /
+                                          _conditions.bandwidth);
+    }
+
+    int copies = chance(_conditions.duplicate) ? 2 : 1;
+    _duplicated += copies - 1;
+    for (int i = 0; i < copies; i++) {
+        float delay = _conditions.latency;
+        if (_conditions.jitter > 0) {
+            delay += std::uniform_real_distribution<float>(
+                0, _conditions.jitter)(_random);
+        }
+        if (chance(_conditions.reorder)) {
+            delay += std::max(_conditions.latency, 1.0f);
+            _reordered++;
+        }
+        Packet copy = i + 1 < copies ? packet : std::move(packet);
+        copy.due = depart + static_cast<Uint32>(delay);
+        copy.order = _scheduled++;
+        auto pos = std::upper_bound(
+            direction.packets.begin(), direction.packets.end(), copy,
+            [](const Packet& a, const Packet& b) {
+                return a.due != b.due ? a.due < b.due : a.order < b.order;
+            });
+        direction.packets.insert(pos, std::move(copy));
+    }
+}
+
+/**
+ * Moves every packet due by now into released, in due order
+ */
+void SimulatedTransport::release(Direction& direction, Uint32 now,
+                                 std::vector<Packet>& released) {
+    released.clear();
+    auto end = direction.packets.begin();
+    while (end != direction.packets.end() && end->due <= now) {
+        ++end;
+    }
+    std::move(direction.packets.begin(), end, std::back_inserter(released));
+    direction.packets.erase(direction.packets.begin(), end);
+}
+
+/**
+ * Sends every outgoing packet that is due
+ */
+void SimulatedTransport::pump() {
+    release(_outgoing, ClockSync::localMillis(), _sending);
+    for (const Packet& packet : _sending) {
+        switch (packet.route) {
+        case Packet::Route::Broadcast:
+            _inner->broadcast(packet.data);
+            break;
+        case Packet::Route::Host:
+            _inner->sendToHost(packet.data);
+            break;
+        case Packet::Route::Peer:
+            _inner->sendTo(packet.peer, packet.data);
+            break;
+        }
+    }
+}
+
+/**
+ * Queues an outgoing packet; returns false if the transport is down
+ */
+bool SimulatedTransport::send(Packet::Route route, const std::string& dest,
+                              const std::vector<std::byte>& data) {
+    State state = _inner->getState();
+    if (state != State::CONNECTED && state != State::INSESSION) {
+        return false;
+    }
+    schedule(_outgoing, {0, 0, route, dest, data});
+    pump();
+    return true;
+}
+
+/**
+ * Drops every packet in flight and closes the real transport
+ */
+void SimulatedTransport::close() {
+    _outgoing.packets.clear();
+    _incoming.packets.clear();
+    _inner->close();
+}
+
+bool SimulatedTransport::broadcast(const std::vector<std::byte>& data) {
+    return send(Packet::Route::Broadcast, "", data);
+}
+
+bool SimulatedTransport::sendToHost(const std::vector<std::byte>& data) {
+    return send(Packet::Route::Host, "", data);
+}
+
+bool SimulatedTransport::sendTo(const std::string& dest,
+                                const std::vector<std::byte>& data) {
+    return send(Packet::Route::Peer, dest, data);
+}
+
+/**
+ * Delivers every received packet whose simulated delay has passed.
+ *
+ * @param dispatcher    Called once per packet, in simulated arrival order
+ */
+void SimulatedTransport::receive(const Dispatcher& dispatcher) {
+    pump();
+    _inner->receive([this](const std::string source,
+                           const std::vector<std::byte>& data) {
+        schedule(_incoming, {0, 0, Packet::Route::Peer, source, data});
+    });
+    // The dispatcher may send, which only touches the outgoing buffers
+    release(_incoming, ClockSync::localMillis(), _delivering);
+    for (const Packet& packet : _delivering) {
+        dispatcher(packet.peer, packet.data);
+    }
+
+    _receives++;
+    if (_receives % NETSIM_LOG_INTERVAL == 0) {
+        CULog("netsim: %llu packets, %llu dropped, %llu duplicated, "
+              "%llu reordered, %llu over bandwidth",
+              (unsigned long long)_packets, (unsigned long long)_dropped,
+              (unsigned long long)_duplicated,
+              (unsigned long long)_reordered,
+              (unsigned long long)_overflowed);
+    }
+}
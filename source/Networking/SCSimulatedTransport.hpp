@@ -0,0 +1,200 @@
+//
+//  SCSimulatedTransport.hpp
+//  Sunk Cost
+//
+//  This module provides a transport decorator that degrades the link to
+//  reproduce bad networks on demand.
+//
+//  Every packet, in either direction, independently may be dropped,
+//  duplicated, or held back an extra latency to arrive out of order, and
+//  is otherwise delayed by the base latency plus uniform jitter. A
+//  bandwidth cap serializes the packets of one direction through a
+//  fixed-rate link, and drops any packet that would wait in the link
+//  queue too long, like a congested router.
+//
+//  The conditions come from json/netsim.json. Since both directions are
+//  degraded, enable the simulator on one device only to get the stated
+//  one-way conditions. Delayed packets are released whenever the
+//  transport is used, which the game does at least once per frame.
+//
+
+#ifndef SCSimulatedTransport_hpp
+#define SCSimulatedTransport_hpp
+
+#include "SCTransport.hpp"
+#include <cugl/cugl.h>
+#include <random>
+
+/** The number of receive calls between simulator statistics in the log */
+#define NETSIM_LOG_INTERVAL 600
+
+/**
+ * The link conditions imposed by a SimulatedTransport.
+ */
+struct NetworkConditions {
+    /** Whether the simulator is used at all */
+    bool enabled = false;
+    /** The one-way latency in milliseconds */
+    float latency = 0;
+    /** The maximum random addition to the latency in milliseconds */
+    float jitter = 0;
+    /** The probability that a packet is dropped */
+    float loss = 0;
+    /** The probability that a packet is delivered twice */
+    float duplicate = 0;
+    /** The probability that a packet is held back an extra latency */
+    float reorder = 0;
+    /** The link rate in bytes per second, or 0 for unlimited */
+    Uint32 bandwidth = 0;
+    /** The longest a packet may wait for the link in milliseconds */
+    Uint32 queue = 500;
+    /** The random seed, so that runs are repeatable */
+    Uint32 seed = 1;
+
+    /**
+     * Reads the conditions from a JSON profile.
+     *
+     * The JSON names the active profile in "profile" and lists the
+     * profiles by name in "profiles". A profile of "none", or one that
+     * does not exist, disables the simulator.
+     *
+     * @param json  The contents of json/netsim.json
+     *
+     * @return true if the simulator is enabled
+     */
+    bool set(const std::shared_ptr<cugl::JsonValue>& json);
+};
+
+/**
+ * A transport that passes packets through a simulated bad link.
+ */
+class SimulatedTransport : public Transport {
+  private:
+    /** A packet in flight */
+    struct Packet {
+        /** The local time the packet is released */
+        Uint32 due;
+        /** The order the packet was scheduled, to keep equal times stable */
+        Uint64 order;
+        /** The route for outgoing packets */
+        enum class Route { Broadcast, Host, Peer } route;
+        /** The destination of outgoing or the source of incoming packets */
+        std::string peer;
+        std::vector<std::byte> data;
+    };
+
+    /** The packets in flight in one direction */
+    struct Direction {
+        /** The packets, ordered by due time */
+        std::vector<Packet> packets;
+        /** The local time the rate-limited link is free again */
+        Uint32 linkFree = 0;
+    };
+
+    /** The real transport */
+    std::shared_ptr<Transport> _inner;
+    /** The simulated conditions */
+    NetworkConditions _conditions;
+    /** The source of every random decision */
+    std::mt19937 _random;
+    /** The packets being sent */
+    Direction _outgoing;
+    /** The packets being received */
+    Direction _incoming;
+    /** The number of packets scheduled, for stable ordering */
+    Uint64 _scheduled;
+    /** The outgoing packets being sent, reused between calls */
+    std::vector<Packet> _sending;
+    /** The incoming packets being delivered, reused between calls */
+    std::vector<Packet> _delivering;
+
+    Uint64 _receives;
+    Uint64 _packets;
+    Uint64 _dropped;
+    Uint64 _duplicated;
+    Uint64 _reordered;
+    Uint64 _overflowed;
+
+    /** Returns true with the given probability */
+    bool chance(float probability);
+
+    /** Delays a packet per the conditions, or drops it */
+    void schedule(Direction& direction, Packet&& packet);
+
+    /** Moves every packet due by now into released, in due order */
+    void release(Direction& direction, Uint32 now,
+                 std::vector<Packet>& released);
+
+    /** Sends every outgoing packet that is due */
+    void pump();
+
+    /** Queues an outgoing packet; returns false if the transport is down */
+    bool send(Packet::Route route, const std::string& dest,
+              const std::vector<std::byte>& data);
+
+  public:
+    /**
+     * Creates a simulator around another transport.
+     *
+     * @param inner         The transport to degrade
+     * @param conditions    The conditions to impose
+     */
+    SimulatedTransport(const std::shared_ptr<Transport>& inner,
+                       const NetworkConditions& conditions);
+
+    /**
+     * Returns a simulator around another transport.
+     *
+     * @param inner         The transport to degrade
+     * @param conditions    The conditions to impose
+     *
+     * @return a simulator around another transport
+     */
+    static std::shared_ptr<SimulatedTransport>
+    alloc(const std::shared_ptr<Transport>& inner,
+          const NetworkConditions& conditions) {
+        return std::make_shared<SimulatedTransport>(inner, conditions);
+    }
+
+    /** Returns the conditions imposed by this transport */
+    const NetworkConditions& getConditions() const { return _conditions; }
+
+    bool open() override { return _inner->open(); }
+
+    void close() override;
+
+    State getState() const override { return _inner->getState(); }
+
+    const std::string getHost() const override { return _inner->getHost(); }
+
+    const std::string getUUID() const override { return _inner->getUUID(); }
+
+    const std::string getRoom() const override { return _inner->getRoom(); }
+
+    size_t getNumPlayers() const override { return _inner->getNumPlayers(); }
+
+    Uint8 getSession() const override { return _inner->getSession(); }
+
+    bool broadcast(const std::vector<std::byte>& data) override;
+
+    bool sendToHost(const std::vector<std::byte>& data) override;
+
+    bool sendTo(const std::string& dest,
+                const std::vector<std::byte>& data) override;
+
+    void receive(const Dispatcher& dispatcher) override;
+
+    /** Returns the number of packets put through the simulator */
+    Uint64 getPackets() const { return _packets; }
+
+    Uint64 getDropped() const { return _dropped; }
+
+    Uint64 getDuplicated() const { return _duplicated; }
+
+    Uint64 getReordered() const { return _reordered; }
+
+    /** Returns the number of packets dropped by the bandwidth cap */
+    Uint64 getOverflowed() const { return _overflowed; }
+};
+
+#endif /* SCSimulatedTransport_hpp */
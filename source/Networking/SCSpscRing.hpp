@@ -0,0 +1,92 @@
+//
+//  SCSpscRing.hpp
+//  Sunk Cost
+//
+//  This module provides a fixed-size, lock-free ring buffer for handing
+//  values from exactly one producer thread to exactly one consumer thread.
+//
+//  The slots are preallocated, so neither side ever allocates or blocks. The
+//  producer owns the tail and the consumer owns the head; each publishes its
+//  index with release order and reads the other's with acquire order, which
+//  is all the synchronization a single producer and consumer need. The two
+//  indices sit on separate cache lines so the threads do not contend.
+//
+
+#ifndef SCSpscRing_hpp
+#define SCSpscRing_hpp
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * A single-producer/single-consumer queue of at most N values.
+ *
+ * N must be a power of two. The indices count up forever and wrap with a
+ * mask, so the ring is full when they are N apart.
+ */
+template <typename T, size_t N> class SpscRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0,
+                  "the ring capacity must be a power of two");
+
+  private:
+    std::array<T, N> _slots;
+    /** The next slot to pop; written by the consumer only */
+    alignas(64) std::atomic<size_t> _head;
+    /** The next slot to push; written by the producer only */
+    alignas(64) std::atomic<size_t> _tail;
+
+  public:
+    SpscRing() : _slots(), _head(0), _tail(0) {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /**
+     * Adds a value at the back. Call from the producer thread only.
+     *
+     * @param value The value to copy in
+     *
+     * @return false if the ring is full
+     */
+    bool push(const T& value) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        _slots[tail & (N - 1)] = value;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Removes the value at the front. Call from the consumer thread only.
+     *
+     * @param value Set to the value removed
+     *
+     * @return false if the ring is empty
+     */
+    bool pop(T& value) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = _slots[head & (N - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Returns the number of values queued; only a snapshot if shared */
+    size_t size() const {
+        size_t head = _head.load(std::memory_order_acquire);
+        return _tail.load(std::memory_order_acquire) - head;
+    }
+
+    /** Returns true if nothing is queued; only a snapshot if shared */
+    bool empty() const { return size() == 0; }
+
+    /** Returns the number of values the ring holds */
+    static constexpr size_t capacity() { return N; }
+};
+
+#endif /* SCSpscRing_hpp */
@@ -0,0 +1,282 @@
+//
+//  SCThreadedTransport.cpp
+//  Sunk Cost
+//
+//  This module provides a transport decorator that receives and decodes
+//  packets on a background thread. See the header for details.
+//
+
+#include "SCThreadedTransport.hpp"
+#include "SCOutbox.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace cugl;
+
+/** The most senders the peer table can name */
+#define NET_MAX_PEERS 255
+
+/**
+ * Returns a steady clock in microseconds, for timing the drains.
+ */
+static Uint64 micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+#pragma mark -
+#pragma mark Constructors
+
+/**
+ * Creates a threaded transport around another transport.
+ *
+ * The network thread starts at once.
+ *
+ * @param inner The transport to receive from
+ */
+ThreadedTransport::ThreadedTransport(const std::shared_ptr<Transport>& inner)
+    : _inner(inner), _running(true), _received(0), _highWater(0), _stalls(0),
+      _drains(0), _drained(0), _drainMicros(0), _drainMax(0), _deferred(0) {
+    _thread = std::thread([this] { run(); });
+}
+
+/**
+ * Stops the network thread and logs the drain statistics.
+ */
+ThreadedTransport::~ThreadedTransport() {
+    _running = false;
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_drains > 0) {
+        CULog("net thread: %llu events in %llu drains, %s",
+              (unsigned long long)_drained, (unsigned long long)_drains,
+              getSummary().c_str());
+    }
+}
+
+#pragma mark -
+#pragma mark Network Thread
+
+/**
+ * Polls the real transport until the transport is destroyed.
+ *
+ * The lock is held only while the packets are copied out, so a send from
+ * the game loop waits at most one copy.
+ */
+void ThreadedTransport::run() {
+    while (_running) {
+        _received = 0;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            const std::string host = _inner->getHost();
+            _inner->receive([&](const std::string source,
+                                const std::vector<std::byte>& data) {
+                Uint8 peer;
+                if (!findPeer(source, peer)) {
+                    return;
+                }
+                if (_received == _packets.size()) {
+                    _packets.emplace_back();
+                }
+                Packet& packet = _packets[_received++];
+                packet.peer = peer;
+                packet.host = source == host;
+                packet.data.assign(data.begin(), data.end());
+            });
+        }
+
+        for (size_t ii = 0; ii < _received && _running; ii++) {
+            const Packet& packet = _packets[ii];
+            NetEvent event;
+            event.peer = packet.peer;
+            event.host = packet.host;
+            event.bytes = static_cast<Uint32>(packet.data.size());
+            if (!push(event)) {
+                break;
+            }
+            bool valid = Outbox::unpack(
+                packet.data,
+                [&](const GameMessage& message, size_t bytes) {
+                    event.kind = NetEvent::Kind::Message;
+                    event.bytes = static_cast<Uint32>(bytes);
+                    event.message = message;
+                    push(event);
+                },
+                [&](size_t bytes) {
+                    event.kind = NetEvent::Kind::Dropped;
+                    event.bytes = static_cast<Uint32>(bytes);
+                    push(event);
+                });
+            if (!valid) {
+                event.kind = NetEvent::Kind::Malformed;
+                event.bytes = static_cast<Uint32>(packet.data.size());
+                push(event);
+            }
+        }
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(NET_THREAD_INTERVAL));
+    }
+}
+
+/**
+ * Finds or adds the peer index of a sender; network thread only.
+ *
+ * The table only grows, so an index stays valid for the whole match.
+ *
+ * @param source    The UUID of the sender
+ * @param peer      Set to the peer index
+ *
+ * @return false if the peer table is full
+ */
+bool ThreadedTransport::findPeer(const std::string& source, Uint8& peer) {
+    std::lock_guard<std::mutex> lock(_peerMutex);
+    for (size_t ii = 0; ii < _peers.size(); ii++) {
+        if (_peers[ii] == source) {
+            peer = static_cast<Uint8>(ii);
+            return true;
+        }
+    }
+    if (_peers.size() == NET_MAX_PEERS) {
+        return false;
+    }
+    peer = static_cast<Uint8>(_peers.size());
+    _peers.push_back(source);
+    return true;
+}
+
+/**
+ * Pushes an event, waiting while the ring is full.
+ *
+ * A full ring means the game loop is behind, so the thread backs off rather
+ * than dropping messages the reliable channel may depend on.
+ *
+ * @param event The event to push
+ *
+ * @return false if the transport is being destroyed
+ */
+bool ThreadedTransport::push(const NetEvent& event) {
+    while (!_ring.push(event)) {
+        if (!_running) {
+            return false;
+        }
+        _stalls++;
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(NET_THREAD_INTERVAL));
+    }
+    size_t size = _ring.size();
+    if (size > _highWater.load(std::memory_order_relaxed)) {
+        _highWater.store(size, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+#pragma mark -
+#pragma mark Game Loop
+
+/**
+ * Handles the events received since the last call, up to a budget.
+ *
+ * @param handler   Called once per event, in arrival order
+ * @param budget    The most events to handle
+ *
+ * @return the number of events handled
+ */
+size_t ThreadedTransport::drain(const Handler& handler, size_t budget) {
+    Uint64 start = micros();
+    size_t count = 0;
+    NetEvent event;
+    while (count < budget && _ring.pop(event)) {
+        if (event.peer >= _peerCache.size()) {
+            // The only lock the game loop takes, once per new sender
+            std::lock_guard<std::mutex> lock(_peerMutex);
+            _peerCache = _peers;
+        }
+        handler(_peerCache[event.peer], event);
+        count++;
+    }
+
+    Uint64 elapsed = micros() - start;
+    _drains++;
+    _drained += count;
+    _drainMicros += elapsed;
+    _drainMax = std::max(_drainMax, elapsed);
+    if (count == budget && !_ring.empty()) {
+        _deferred++;
+    }
+    return count;
+}
+
+/**
+ * Returns a one-line summary of the drain costs, for the overlay.
+ */
+std::string ThreadedTransport::getSummary() const {
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer),
+             "drain %.0f/%llu us, ring peak %zu, %llu deferred, %llu stalls",
+             getMeanDrainMicros(), (unsigned long long)_drainMax,
+             getHighWater(), (unsigned long long)_deferred,
+             (unsigned long long)_stalls.load());
+    return buffer;
+}
+
+#pragma mark -
+#pragma mark Transport
+
+bool ThreadedTransport::open() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->open();
+}
+
+void ThreadedTransport::close() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _inner->close();
+}
+
+Transport::State ThreadedTransport::getState() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->getState();
+}
+
+const std::string ThreadedTransport::getHost() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->getHost();
+}
+
+const std::string ThreadedTransport::getUUID() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->getUUID();
+}
+
+const std::string ThreadedTransport::getRoom() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->getRoom();
+}
+
+size_t ThreadedTransport::getNumPlayers() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->getNumPlayers();
+}
+
+Uint8 ThreadedTransport::getSession() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->getSession();
+}
+
+bool ThreadedTransport::broadcast(const std::vector<std::byte>& data) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->broadcast(data);
+}
+
+bool ThreadedTransport::sendToHost(const std::vector<std::byte>& data) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->sendToHost(data);
+}
+
+bool ThreadedTransport::sendTo(const std::string& dest,
+                               const std::vector<std::byte>& data) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _inner->sendTo(dest, data);
+}
@@ -0,0 +1,213 @@
+//
+//  SCThreadedTransport.hpp
+//  Sunk Cost
+//
+//  This module provides a transport decorator that receives and decodes
+//  packets on a background thread, so the game loop only pays for the
+//  messages it handles.
+//
+//  The network thread polls the real transport every NET_THREAD_INTERVAL
+//  milliseconds, decodes each packet with Outbox::unpack, and pushes one
+//  NetEvent per packet and per message into a lock-free SpscRing. The game
+//  loop calls drain once per frame to handle at most a budget of events;
+//  the rest wait for the next frame, so a burst of packets spreads over a
+//  few frames instead of stalling one. Nothing on the path allocates once
+//  the packet buffers and the peer table have warmed up.
+//
+//  Sends and state queries still come from the game loop. They reach the
+//  real transport under a lock that the network thread holds only while
+//  it copies packets out, never while it decodes or waits on a full ring.
+//
+
+#ifndef SCThreadedTransport_hpp
+#define SCThreadedTransport_hpp
+
+#include "SCMessage.hpp"
+#include "SCSpscRing.hpp"
+#include "SCTransport.hpp"
+#include <atomic>
+#include <cugl/cugl.h>
+#include <mutex>
+#include <thread>
+
+/** The number of events the ring holds between frames */
+#define NET_RING_SIZE 4096
+/** The most events the game loop handles in one frame */
+#define NET_DRAIN_BUDGET 512
+/** The milliseconds the network thread sleeps between polls */
+#define NET_THREAD_INTERVAL 1
+
+/**
+ * Something the network thread received, handed to the game loop.
+ *
+ * Every packet produces a Packet event followed by a Message event for
+ * each message in it, a Dropped event for each message that could not be
+ * decoded, and a Malformed event if its framing is corrupt.
+ */
+struct NetEvent {
+    enum class Kind : Uint8 { Packet, Message, Dropped, Malformed };
+
+    Kind kind = Kind::Packet;
+    /** The sender, as an index into the peer table of the transport */
+    Uint8 peer = 0;
+    /** Whether the sender is the room host */
+    bool host = false;
+    /** The size of the packet, or the encoded size of the message */
+    Uint32 bytes = 0;
+    /** The message, for Message events */
+    GameMessage message;
+};
+
+/**
+ * A transport that receives on a background thread.
+ */
+class ThreadedTransport : public Transport {
+  public:
+    /** The handler of drain, with the UUID of the sender */
+    using Handler =
+        std::function<void(const std::string& source, const NetEvent& event)>;
+
+  private:
+    /** A packet copied out of the real transport */
+    struct Packet {
+        Uint8 peer;
+        bool host;
+        std::vector<std::byte> data;
+    };
+
+    /** The real transport; guarded by _mutex */
+    std::shared_ptr<Transport> _inner;
+    mutable std::mutex _mutex;
+
+    std::thread _thread;
+    std::atomic<bool> _running;
+    SpscRing<NetEvent, NET_RING_SIZE> _ring;
+
+    /** The packets of one poll, reused; network thread only */
+    std::vector<Packet> _packets;
+    size_t _received;
+
+    /** The UUID of every sender by peer index; guarded by _peerMutex */
+    std::vector<std::string> _peers;
+    std::mutex _peerMutex;
+    /** The copy of _peers the game loop reads without the lock */
+    std::vector<std::string> _peerCache;
+
+    /** The most events ever waiting in the ring */
+    std::atomic<size_t> _highWater;
+    /** The number of times the network thread waited on a full ring */
+    std::atomic<Uint64> _stalls;
+
+    /** The drain statistics; game loop only */
+    Uint64 _drains;
+    Uint64 _drained;
+    Uint64 _drainMicros;
+    Uint64 _drainMax;
+    /** The number of drains that left events for the next frame */
+    Uint64 _deferred;
+
+    /** Polls the real transport until the transport is destroyed */
+    void run();
+
+    /**
+     * Finds or adds the peer index of a sender; network thread only.
+     *
+     * @param source    The UUID of the sender
+     * @param peer      Set to the peer index
+     *
+     * @return false if the peer table is full
+     */
+    bool findPeer(const std::string& source, Uint8& peer);
+
+    /** Pushes an event, waiting while the ring is full */
+    bool push(const NetEvent& event);
+
+  public:
+    /**
+     * Creates a threaded transport around another transport.
+     *
+     * The network thread starts at once.
+     *
+     * @param inner The transport to receive from
+     */
+    ThreadedTransport(const std::shared_ptr<Transport>& inner);
+
+    /**
+     * Stops the network thread and logs the drain statistics.
+     */
+    ~ThreadedTransport();
+
+    /**
+     * Returns a threaded transport around another transport.
+     *
+     * @param inner The transport to receive from
+     *
+     * @return a threaded transport around another transport
+     */
+    static std::shared_ptr<ThreadedTransport>
+    alloc(const std::shared_ptr<Transport>& inner) {
+        return std::make_shared<ThreadedTransport>(inner);
+    }
+
+    bool open() override;
+
+    void close() override;
+
+    State getState() const override;
+
+    const std::string getHost() const override;
+
+    const std::string getUUID() const override;
+
+    const std::string getRoom() const override;
+
+    size_t getNumPlayers() const override;
+
+    Uint8 getSession() const override;
+
+    bool broadcast(const std::vector<std::byte>& data) override;
+
+    bool sendToHost(const std::vector<std::byte>& data) override;
+
+    bool sendTo(const std::string& dest,
+                const std::vector<std::byte>& data) override;
+
+    /**
+     * Delivers nothing, as the network thread owns the real transport.
+     *
+     * Use {@link #drain} instead.
+     */
+    void receive(const Dispatcher&) override {}
+
+    /**
+     * Handles the events received since the last call, up to a budget.
+     *
+     * This should be called once per frame from the game loop. Events past
+     * the budget stay queued, in order, for the next call.
+     *
+     * @param handler   Called once per event, in arrival order
+     * @param budget    The most events to handle
+     *
+     * @return the number of events handled
+     */
+    size_t drain(const Handler& handler, size_t budget = NET_DRAIN_BUDGET);
+
+    /** Returns the mean game loop time per drain in microseconds */
+    float getMeanDrainMicros() const {
+        return _drains == 0 ? 0 : (float)_drainMicros / _drains;
+    }
+
+    /** Returns the longest drain in microseconds */
+    Uint64 getMaxDrainMicros() const { return _drainMax; }
+
+    /** Returns the number of drains that hit the budget */
+    Uint64 getDeferred() const { return _deferred; }
+
+    /** Returns the most events ever waiting in the ring */
+    size_t getHighWater() const { return _highWater.load(); }
+
+    /** Returns a one-line summary of the drain costs, for the overlay */
+    std::string getSummary() const;
+};
+
+#endif /* SCThreadedTransport_hpp */
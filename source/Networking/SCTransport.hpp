@@ -0,0 +1,108 @@
+//
+//  SCTransport.hpp
+//  Sunk Cost
+//
+//  This module provides the packet transport used by the lobby scenes and
+//  the game controllers.
+//
+//  The scenes and controllers only ever need a small part of the netcode
+//  connection: its state, who the host is, and best-effort packet delivery
+//  to everyone, the host, or one peer. This interface captures exactly
+//  that, so the game can run over the CUGL lobby (NetcodeTransport) or
+//  entirely in process (LoopbackTransport) without changing any caller.
+//
+//  The connection states are the netcode states, so existing switches on
+//  the state keep working unchanged.
+//
+
+#ifndef SCTransport_hpp
+#define SCTransport_hpp
+
+#include <cugl/cugl.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * A connection to a room of peers, one of which is the host.
+ */
+class Transport {
+  public:
+    /** The connection state */
+    using State = cugl::net::NetcodeConnection::State;
+
+    /** The callback for a received packet: the sender UUID and the data */
+    using Dispatcher = std::function<void(const std::string source,
+                                          const std::vector<std::byte>& data)>;
+
+    virtual ~Transport() = default;
+
+    /**
+     * Starts connecting to the room.
+     *
+     * @return true if the connection attempt started
+     */
+    virtual bool open() = 0;
+
+    /** Leaves the room; the transport cannot be reopened */
+    virtual void close() = 0;
+
+    /** Returns the connection state */
+    virtual State getState() const = 0;
+
+    /** Returns the UUID of the room host */
+    virtual const std::string getHost() const = 0;
+
+    /** Returns the UUID of this peer */
+    virtual const std::string getUUID() const = 0;
+
+    /** Returns the room identifier */
+    virtual const std::string getRoom() const = 0;
+
+    /** Returns the number of peers in the room, including this one */
+    virtual size_t getNumPlayers() const = 0;
+
+    /**
+     * Returns the number of times this peer has rejoined the room after
+     * losing its connection. Only a ResumableTransport ever rejoins.
+     */
+    virtual Uint8 getSession() const { return 0; }
+
+    /**
+     * Sends a packet to every other peer in the room.
+     *
+     * @param data  The packet to send
+     *
+     * @return true if the packet was accepted for delivery
+     */
+    virtual bool broadcast(const std::vector<std::byte>& data) = 0;
+
+    /**
+     * Sends a packet to the room host.
+     *
+     * @param data  The packet to send
+     *
+     * @return true if the packet was accepted for delivery
+     */
+    virtual bool sendToHost(const std::vector<std::byte>& data) = 0;
+
+    /**
+     * Sends a packet to a single peer.
+     *
+     * @param dest  The UUID of the peer
+     * @param data  The packet to send
+     *
+     * @return true if the packet was accepted for delivery
+     */
+    virtual bool sendTo(const std::string& dest,
+                        const std::vector<std::byte>& data) = 0;
+
+    /**
+     * Delivers every packet received since the last call.
+     *
+     * @param dispatcher    Called once per packet, in arrival order
+     */
+    virtual void receive(const Dispatcher& dispatcher) = 0;
+};
+
+#endif /* SCTransport_hpp */
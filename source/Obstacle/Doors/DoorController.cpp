@@ -81,6 +81,11 @@ void DoorController::resetHunterUnlock() {
     setFrame(0);
 }
 
+void DoorController::lock() {
+    _model->setState(1);
+    setLockFrame();
+}
+
 Vec2 DoorController::getModelPosition() { return _model->getPosition(); }
 
 Vec2 DoorController::getViewPosition() { return _view->getPosition(); }
@@ -61,6 +61,9 @@ class DoorController {
 
     void resetHunterUnlock();
 
+    /** Locks the door at once, without the drag */
+    void lock();
+
 #pragma mark Getters
     Vec2 getPosition() { return _model->getPosition(); }
 
@@ -67,6 +67,14 @@ class TrapModel {
 
     bool getTrigger() { return _triggered; }
 
+    int getAge() { return _age; }
+
+    void setAge(int age) { _age = age; }
+
+    int getTriggerTime() { return _trigger_time; }
+
+    void setTriggerTime(int time) { _trigger_time = time; }
+
     void updateTrigger() {
         if (_triggered) {
             _trigger_time++;
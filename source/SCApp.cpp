@@ -12,8 +12,10 @@
 //  Version: 2/22/23
 //
 #include "SCApp.h"
+#include "LevelBenchmark.h"
 #include "LevelConstants.h"
 #include "LevelModel.h"
+#include "SCNetBenchmark.hpp"
 
 using namespace cugl;
 
@@ -52,6 +54,11 @@ void SCApp::onStartup() {
     _assets->attach<scene2::SceneNode>(
                                        Scene2Loader::alloc()->getHook()); // Needed for loading screen
     _assets->attach<LevelModel>(GenericLoader<LevelModel>::alloc()->getHook());
+
+    // A bot needs its settings before the loading screen is done
+    BotConfig bot;
+    bot.set(_assets->load<JsonValue>("bot", "json/bot.json"));
+    _bot.init(bot);
     
     // Create a "loading" screen
     _scene = State::LOAD;
@@ -66,6 +73,12 @@ void SCApp::onStartup() {
     
     net::NetworkLayer::start(net::NetworkLayer::Log::INFO);
     AudioEngine::start();
+#ifdef SC_NET_BENCHMARK
+    NetBenchmark::runAll();
+#endif
+#ifdef SC_LEVEL_BENCHMARK
+    LevelBenchmark::runAll();
+#endif
     Application::onStartup(); // YOU MUST END with call to parent
 }
 
@@ -212,6 +225,7 @@ void SCApp::updateSpawnScene(float timestep) {
         _hunterGameplay.setConnection(_joingame.getConnection());
         _joingame.disconnect();
         _hunterGameplay.setHost(false);
+        _hunterGameplay.setBot(_bot.isEnabled() ? &_bot : nullptr);
         
         //        _spawn.setActive(false);
         //        _joingame.setActive(true);
@@ -277,6 +291,10 @@ void SCApp::updateTutorialScene(float timestep) {
 void SCApp::updateLoadingScene(float timestep) {
     if (!_loaded && _loading.isActive()) {
         _loading.update(0.01f);
+        // A bot presses play as soon as the assets are in
+        if (_bot.isEnabled() && _loading.isPending()) {
+            _loading.setActive(false);
+        }
     } else {
         CULog("init");
         if (!_scenesInitialized){
@@ -307,6 +325,12 @@ void SCApp::updateLoadingScene(float timestep) {
                 _credit.setActive(true);
                 break;
             case LoadingScene::Choice::NONE:
+                // A bot joins its room as if the code had been typed in
+                if (_bot.isEnabled()) {
+                    _scene = State::CLIENT;
+                    _joingame.setActive(true);
+                    _joingame.join(_bot.getRoom());
+                }
                 break;
         }
     }
@@ -371,13 +395,33 @@ void SCApp::updateClientScene(float timestep) {
         case ClientScene::Status::IDLE:
             _joingame.update(timestep);
             
-            // DO NOTHING
+            // A bot has no menu to go back to
+            if (_bot.isEnabled() && _joingame.getConnection() == nullptr) {
+                CULog("bot: could not join room %s", _bot.getRoom().c_str());
+                quit();
+            }
             break;
     }
 }
 
 void SCApp::updateHGameController(float timestep) {
+    if (_bot.isEnabled()) {
+        _bot.beginFrame();
+    }
     _hunterGameplay.update(timestep);
+    if (_bot.isEnabled()) {
+        // A bot plays one match, or for its duration, and then quits
+        _bot.endFrame(timestep, _hunterGameplay.getTelemetry());
+        HGameController::Status status = _hunterGameplay.getStatus();
+        if (_bot.isDone() || status == HGameController::Status::RESET ||
+            status == HGameController::Status::ABORT) {
+            _bot.finish(_hunterGameplay.getTelemetry());
+            _bot.init(BotConfig());
+            _hunterGameplay.setBot(nullptr);
+            quit();
+            return;
+        }
+    }
     
     switch (_hunterGameplay.getStatus()) {
         case HGameController::Status::ABORT:
@@ -445,6 +489,10 @@ void SCApp::updateCreditScene(float timestep) {
  * at all. The default implmentation does nothing.
  */
 void SCApp::draw() {
+    // A bot is headless
+    if (_bot.isEnabled()) {
+        return;
+    }
     switch (_scene) {
         case LOAD:
             _loading.render(_batch);
@@ -14,6 +14,7 @@
 #define _SC_APP_H__
 #include "HGameController.h"
 #include "LoadingScene.h"
+#include "SCBot.hpp"
 #include "SCClientScene.hpp"
 #include "SCHostScene.hpp"
 #include "SCMenuScene.h"
@@ -81,6 +82,9 @@ class SCApp : public cugl::Application {
     
     CreditScene _credit;
 
+    /** The bot that plays instead of a human, if json/bot.json enables it */
+    Bot _bot;
+
     /** Whether or not we have finished loading all assets */
     bool _loaded;
 
@@ -183,6 +183,10 @@ bool SpiritController::touchInKillBound(Vec2 touchPos) {
 }
 
 bool SpiritController::hunterInBound(Vec2 pos) {
-    float dis = abs(_model->getHunterPos().distance(pos));
+    return hunterInBound(pos, _model->getHunterPos());
+}
+
+bool SpiritController::hunterInBound(Vec2 pos, Vec2 hunterPos) {
+    float dis = abs(hunterPos.distance(pos));
     return dis <= _view->getKillSize().width;
 }
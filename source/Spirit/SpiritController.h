@@ -229,6 +229,14 @@ class SpiritController {
     bool touchInKillBound(Vec2 touchPos);
 
     bool hunterInBound(Vec2 pos);
+
+    /**
+     * Returns true if a swipe at pos hits a hunter standing at hunterPos
+     *
+     * @param pos       The swipe position in world coordinates
+     * @param hunterPos The hunter position to test against
+     */
+    bool hunterInBound(Vec2 pos, Vec2 hunterPos);
 };
 
 #endif /* _SPIRIT_CONTROLLER_H */
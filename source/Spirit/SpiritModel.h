@@ -16,6 +16,7 @@
 #include "TrapModel.hpp"
 #include "TrapView.h"
 #include <cugl/cugl.h>
+#include <unordered_map>
 
 class SpiritModel {
 #pragma mark State
@@ -50,6 +51,16 @@ class SpiritModel {
     int forward = 0, right = 0;
     int _ticks = 0;
 
+    /** Another hunter than the first, which carries the team hearts */
+    struct Teammate {
+        std::shared_ptr<HunterView> view;
+        Vec2 position;
+        /** The movement since the last animation frame */
+        Vec2 step;
+    };
+    /** The other hunters, by player number */
+    std::unordered_map<int, Teammate> _teammates;
+
     bool _isOnLock;
 
     bool _isOnTrap;
@@ -224,6 +235,16 @@ class SpiritModel {
         return true;
     }
 
+    std::vector<std::shared_ptr<TrapModel>> getTraps() { return _trapModels; }
+
+    void clearTraps(std::shared_ptr<cugl::scene2::PolygonNode>& node) {
+        for (auto& trap : _trapViews) {
+            trap->removeChildFromNode(node);
+        }
+        _trapModels.clear();
+        _trapViews.clear();
+    }
+
     float getZoom() {
         return std::dynamic_pointer_cast<OrthographicCamera>(
                    _scene->getCamera())
@@ -271,6 +292,14 @@ class SpiritModel {
             forward = 0;
             right = 0;
         }
+        if (_ticks == 0) {
+            for (auto& entry : _teammates) {
+                Teammate& teammate = entry.second;
+                teammate.view->advanceFrame(teammate.step.y, teammate.step.x,
+                                            false);
+                teammate.step = Vec2::ZERO;
+            }
+        }
         _ticks = (_ticks + 1) % 6;
 
         return result;
@@ -305,17 +334,57 @@ class SpiritModel {
         }
     }
 
+    /**
+     * Shows another hunter than the first.
+     *
+     * @param player        The player number of the hunter
+     * @param position      The hunter position
+     * @param hunterNodes   Filled with the nodes of the hunter
+     */
+    void
+    addTeammate(int player, Vec2 position,
+                std::vector<std::shared_ptr<scene2::PolygonNode>>& hunterNodes) {
+        Teammate& teammate = _teammates[player];
+        teammate.view = std::make_shared<HunterView>(_assets, position,
+                                                     Vec2(40, 40), player);
+        teammate.view->addChildToNode(hunterNodes);
+        teammate.position = position;
+        teammate.step = Vec2::ZERO;
+    }
+
+    /**
+     * Moves another hunter than the first.
+     *
+     * @param player    The player number of the hunter
+     * @param position  The hunter position
+     */
+    void moveTeammate(int player, Vec2 position) {
+        auto it = _teammates.find(player);
+        if (it == _teammates.end()) {
+            return;
+        }
+        Teammate& teammate = it->second;
+        teammate.step += position - teammate.position;
+        teammate.position = position;
+        teammate.view->setPosition(position);
+    }
+
     void alertTreasure(Vec2 position) {}
 
+    /**
+     * Returns the index of the trap closest to the hunter, or -1 for none
+     *
+     * @param pos   The hunter position when the trap fired, which may be
+     *              ahead of the hunter shown on this device
+     */
     int cloestTrapToHunter(Vec2 pos) {
         int result = -1;
         float minDis = 100000;
         if (!_hunterModel) {
             return -1;
         }
-        Vec2 hunterPos = _hunterModel->getPosition();
         for (int i = 0; i < _trapModels.size(); i++) {
-            float dis = hunterPos.distance(_trapModels.at(i)->getPosition());
+            float dis = pos.distance(_trapModels.at(i)->getPosition());
             if (dis < minDis) {
                 minDis = dis;
                 result = i;
@@ -357,12 +426,20 @@ class SpiritModel {
         }
     }
 
+    /**
+     * Takes a team heart and plays the hit animation.
+     *
+     * @param hunterNodes   The nodes of the first hunter, replaced while the
+     *                      animation plays
+     * @param position      Where the hunter that was hit stands
+     */
     void updateHeart(
-        std::vector<std::shared_ptr<scene2::PolygonNode>>& hunterNodes) {
+        std::vector<std::shared_ptr<scene2::PolygonNode>>& hunterNodes,
+        Vec2 position) {
         _killing = true;
         hunterNodes.clear();
         _liveHearts.pop_back();
-        _killAnimation->setPosition(getHunterPos());
+        _killAnimation->setPosition(position);
 
         hunterNodes.emplace_back(_killAnimation);
         for (int i = 0; i < _liveHearts.size(); i++) {
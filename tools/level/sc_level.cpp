@@ -0,0 +1,434 @@
+//
+//  sc_level.cpp
+//  Sunk Cost
+//
+//  This module provides the offline level compiler, which turns a Tiled
+//  JSON export into the compiled level format of source/LevelFormat.h.
+//
+//  It reads the export the same way LevelModel reads the JSON: layers 0 to
+//  15 are tile, collision or door layers, picked by their "class", and every
+//  later layer is an object layer whose objects are portraits or the
+//  player. The collision points are scaled to world units here, so that
+//  the game only copies them.
+//
+//  Build it and compile a level with
+//
+//      g++ -std=c++17 -O2 -o sc_level tools/level/sc_level.cpp
+//      ./sc_level assets/json/bigmap.json assets/levels/bigmap.sclevel
+//
+//  Run it again whenever the Tiled export changes; the game loads the
+//  compiled level named in LevelConstants.h, and only falls back to the
+//  JSON when the compiled level is missing or of another version.
+//
+
+#include "../../source/LevelFormat.h"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#pragma mark -
+#pragma mark JSON
+
+/**
+ * A parsed JSON value; just enough of a DOM for a Tiled export.
+ */
+struct Json {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    double number = 0;
+    std::string string;
+    std::vector<Json> items;
+    std::vector<std::pair<std::string, Json>> fields;
+
+    /** Returns the field with the given name, or nullptr */
+    const Json* get(const std::string& name) const {
+        for (const auto& field : fields) {
+            if (field.first == name) {
+                return &field.second;
+            }
+        }
+        return nullptr;
+    }
+
+    /** Returns a field as a float, as JsonValue::getFloat does */
+    float getFloat(const std::string& name) const {
+        const Json* value = get(name);
+        return value == nullptr ? 0 : static_cast<float>(value->number);
+    }
+
+    /** Returns a field as an int, as JsonValue::getInt does */
+    int getInt(const std::string& name) const {
+        const Json* value = get(name);
+        return value == nullptr ? 0 : static_cast<int>(value->number);
+    }
+};
+
+/**
+ * A recursive descent parser of standard JSON.
+ */
+class JsonParser {
+  private:
+    const std::string& _text;
+    size_t _offset;
+
+    void skip() {
+        while (_offset < _text.size() &&
+               std::isspace(static_cast<unsigned char>(_text[_offset]))) {
+            _offset++;
+        }
+    }
+
+    bool expect(char c) {
+        skip();
+        if (_offset < _text.size() && _text[_offset] == c) {
+            _offset++;
+            return true;
+        }
+        return false;
+    }
+
+    bool parseString(std::string& value) {
+        if (!expect('"')) {
+            return false;
+        }
+        while (_offset < _text.size() && _text[_offset] != '"') {
+            char c = _text[_offset++];
+            if (c == '\\' && _offset < _text.size()) {
+                c = _text[_offset++];
+                switch (c) {
+                case 'n':
+                    c = '\n';
+                    break;
+                case 't':
+                    c = '\t';
+                    break;
+                case 'r':
+                    c = '\r';
+                    break;
+                case 'b':
+                    c = '\b';
+                    break;
+                case 'f':
+                    c = '\f';
+                    break;
+                case 'u':
+                    // Level fields are ASCII; keep the escape as text
+                    value += "\\u";
+                    continue;
+                default:
+                    break;
+                }
+            }
+            value += c;
+        }
+        return expect('"');
+    }
+
+  public:
+    JsonParser(const std::string& text) : _text(text), _offset(0) {}
+
+    /**
+     * Parses the next value.
+     *
+     * @param value Set to the value
+     *
+     * @return false if the text is not valid JSON
+     */
+    bool parse(Json& value) {
+        skip();
+        if (_offset >= _text.size()) {
+            return false;
+        }
+        char c = _text[_offset];
+        if (c == '{') {
+            _offset++;
+            value.type = Json::Type::Object;
+            if (expect('}')) {
+                return true;
+            }
+            do {
+                std::string name;
+                if (!parseString(name) || !expect(':')) {
+                    return false;
+                }
+                value.fields.emplace_back(std::move(name), Json());
+                if (!parse(value.fields.back().second)) {
+                    return false;
+                }
+            } while (expect(','));
+            return expect('}');
+        } else if (c == '[') {
+            _offset++;
+            value.type = Json::Type::Array;
+            if (expect(']')) {
+                return true;
+            }
+            do {
+                value.items.emplace_back();
+                if (!parse(value.items.back())) {
+                    return false;
+                }
+            } while (expect(','));
+            return expect(']');
+        } else if (c == '"') {
+            value.type = Json::Type::String;
+            return parseString(value.string);
+        } else if (_text.compare(_offset, 4, "true") == 0) {
+            _offset += 4;
+            value.type = Json::Type::Bool;
+            value.number = 1;
+            return true;
+        } else if (_text.compare(_offset, 5, "false") == 0) {
+            _offset += 5;
+            value.type = Json::Type::Bool;
+            return true;
+        } else if (_text.compare(_offset, 4, "null") == 0) {
+            _offset += 4;
+            return true;
+        }
+        const char* start = _text.c_str() + _offset;
+        char* end = nullptr;
+        value.type = Json::Type::Number;
+        value.number = std::strtod(start, &end);
+        _offset += end - start;
+        return end != start;
+    }
+};
+
+#pragma mark -
+#pragma mark Compiler
+
+/**
+ * The contents of a level, as LevelModel holds them.
+ */
+struct Level {
+    std::vector<double> floor;
+    std::vector<std::vector<double>> details;
+    std::vector<float> border;
+    std::vector<uint32_t> walls;
+    std::vector<float> points;
+    std::vector<LevelDoor> doors;
+    std::vector<LevelPortrait> portraits;
+    float playerX = 0;
+    float playerY = 0;
+};
+
+/** The classes of the layers loaded as detail tiles */
+static const char* DETAIL_CLASSES[] = {"undership",
+                                      "floor ao",
+                                      "floorboard variations",
+                                      "floorboard variations 2",
+                                      "carpets",
+                                      "walls",
+                                      "wall upper",
+                                      "wall grime",
+                                      "decor",
+                                      "detail0",
+                                      "detail",
+                                      "detail2",
+                                      "detail3"};
+
+/** Returns true if a layer of this class holds detail tiles */
+static bool isDetail(const std::string& type) {
+    for (const char* name : DETAIL_CLASSES) {
+        if (type == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Adds the collision layer, scaled as LevelModel::loadCollision does.
+ */
+static void addCollision(const Json& json, Level& level) {
+    float xOffset = json.getFloat("x_offset");
+    float yOffset = json.getFloat("y_offset");
+    int x = json.getInt("x");
+    int y = json.getInt("y");
+    const Json* border = json.get("boarder");
+    for (size_t i = 0; border != nullptr && i + 1 < border->items.size();
+         i += 2) {
+        float xw = static_cast<float>(border->items[i].number);
+        float yw = static_cast<float>(border->items[i + 1].number);
+        level.border.push_back((xOffset + x * xw) * 128);
+        level.border.push_back((yOffset + y * yw) * 128);
+    }
+    const Json* walls = json.get("walls");
+    for (size_t i = 0; walls != nullptr && i < walls->items.size(); i++) {
+        const Json* data = walls->items[i].get("data");
+        for (size_t n = 0; data != nullptr && n + 1 < data->items.size();
+             n += 2) {
+            float xw = static_cast<float>(data->items[n].number);
+            float yw = static_cast<float>(data->items[n + 1].number);
+            level.points.push_back((xOffset + x * xw) * 128);
+            level.points.push_back((yOffset + y * yw) * 128);
+        }
+        level.walls.push_back(static_cast<uint32_t>(level.points.size() / 2));
+    }
+}
+
+/**
+ * Adds a layer or object, picked by its class as LevelModel::loadObject does.
+ */
+static void addObject(const Json& json, Level& level) {
+    const Json* type = json.get("class");
+    if (type == nullptr) {
+        return;
+    }
+    const Json* data = json.get("data");
+    if (type->string == "floor") {
+        for (size_t i = 0; data != nullptr && i < data->items.size(); i++) {
+            level.floor.push_back(data->items[i].number);
+        }
+    } else if (isDetail(type->string)) {
+        if (data != nullptr && !data->items.empty()) {
+            level.details.emplace_back();
+            for (const Json& tile : data->items) {
+                level.details.back().push_back(tile.number);
+            }
+        }
+    } else if (type->string == "collision") {
+        addCollision(json, level);
+    } else if (type->string == "doors") {
+        const Json* objects = json.get("objects");
+        for (size_t i = 0; objects != nullptr && i < objects->items.size();
+             i++) {
+            const Json& door = objects->items[i];
+            level.doors.push_back(
+                {door.getFloat("x"), door.getFloat("y"), door.getInt("type")});
+        }
+    } else if (type->string == "portrait") {
+        LevelPortrait portrait = {{json.getFloat("x1"), json.getFloat("y1"),
+                                   json.getFloat("x2"), json.getFloat("y2"),
+                                   json.getFloat("x3"), json.getFloat("y3")},
+                                  json.getInt("type")};
+        level.portraits.push_back(portrait);
+    } else if (type->string == "player" && json.get("x") != nullptr) {
+        level.playerX = json.getFloat("x");
+        level.playerY = json.getFloat("y");
+    }
+}
+
+/**
+ * Packs a tile layer into 16 bits, listing the tiles that do not fit.
+ */
+static std::vector<uint16_t> pack(const std::vector<double>& tiles,
+                                  uint32_t layer,
+                                  std::vector<LevelOverflow>& overflows) {
+    std::vector<uint16_t> packed(tiles.size());
+    for (size_t i = 0; i < tiles.size(); i++) {
+        double tile = tiles[i];
+        if (tile >= 0 && tile <= UINT16_MAX && tile == std::floor(tile)) {
+            packed[i] = static_cast<uint16_t>(tile);
+        } else {
+            packed[i] = 0;
+            uint32_t value = static_cast<uint32_t>(static_cast<int64_t>(tile));
+            overflows.push_back({layer, static_cast<uint32_t>(i), value});
+        }
+    }
+    return packed;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s LEVEL.json OUTPUT%s\n", argv[0],
+                     LEVEL_FORMAT_EXTENSION);
+        return 2;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    std::string text((std::istreambuf_iterator<char>(input)),
+                     std::istreambuf_iterator<char>());
+    Json root;
+    if (!input || !JsonParser(text).parse(root) ||
+        root.type != Json::Type::Object) {
+        std::fprintf(stderr, "%s: not a JSON level\n", argv[1]);
+        return 1;
+    }
+    const Json* layers = root.get("layers");
+    if (layers == nullptr) {
+        std::fprintf(stderr, "%s: no layers\n", argv[1]);
+        return 1;
+    }
+
+    Level level;
+    for (size_t i = 0; i < layers->items.size(); i++) {
+        if (i < 16) {
+            addObject(layers->items[i], level);
+            continue;
+        }
+        const Json* objects = layers->items[i].get("objects");
+        for (size_t j = 0; objects != nullptr && j < objects->items.size();
+             j++) {
+            addObject(objects->items[j], level);
+        }
+    }
+
+    std::vector<LevelOverflow> overflows;
+    std::vector<uint16_t> floor = pack(level.floor, 0, overflows);
+    std::vector<uint32_t> sizes;
+    std::vector<uint16_t> details;
+    for (size_t i = 0; i < level.details.size(); i++) {
+        std::vector<uint16_t> layer =
+            pack(level.details[i], static_cast<uint32_t>(i + 1), overflows);
+        sizes.push_back(static_cast<uint32_t>(layer.size()));
+        details.insert(details.end(), layer.begin(), layer.end());
+    }
+
+    LevelHeader header = {};
+    header.magic = LEVEL_FORMAT_MAGIC;
+    header.version = LEVEL_FORMAT_VERSION;
+    header.width = root.getInt("width");
+    header.height = root.getInt("height");
+    header.tileSize = root.getInt("tileSize");
+    header.battery = root.getFloat("battery");
+    header.playerX = level.playerX;
+    header.playerY = level.playerY;
+    header.floorTiles = static_cast<uint32_t>(floor.size());
+    header.detailLayers = static_cast<uint32_t>(sizes.size());
+    header.detailTiles = static_cast<uint32_t>(details.size());
+    header.overflows = static_cast<uint32_t>(overflows.size());
+    header.borderPoints = static_cast<uint32_t>(level.border.size() / 2);
+    header.walls = static_cast<uint32_t>(level.walls.size());
+    header.wallPoints = static_cast<uint32_t>(level.points.size() / 2);
+    header.doors = static_cast<uint32_t>(level.doors.size());
+    header.portraits = static_cast<uint32_t>(level.portraits.size());
+
+    LevelWriter writer;
+    writer.write(&header, 1);
+    writer.write(floor.data(), floor.size());
+    writer.write(sizes.data(), sizes.size());
+    writer.write(details.data(), details.size());
+    writer.write(overflows.data(), overflows.size());
+    writer.write(level.border.data(), level.border.size());
+    writer.write(level.walls.data(), level.walls.size());
+    writer.write(level.points.data(), level.points.size());
+    writer.write(level.doors.data(), level.doors.size());
+    writer.write(level.portraits.data(), level.portraits.size());
+
+    std::vector<std::byte>& data = writer.getData();
+    uint32_t size = static_cast<uint32_t>(data.size());
+    std::memcpy(data.data() + offsetof(LevelHeader, size), &size,
+                sizeof(size));
+
+    std::ofstream output(argv[2], std::ios::binary);
+    output.write(reinterpret_cast<const char*>(data.data()), data.size());
+    if (!output) {
+        std::fprintf(stderr, "%s: could not write\n", argv[2]);
+        return 1;
+    }
+    std::printf("%s: %u floor tiles, %u detail layers of %u tiles, "
+                "%u overflows, %u walls, %u doors, %u portraits, %u bytes\n",
+                argv[2], header.floorTiles, header.detailLayers,
+                header.detailTiles, header.overflows, header.walls,
+                header.doors, header.portraits, size);
+    return 0;
+}
@@ -0,0 +1,892 @@
+//
+//  sc_relay.cpp
+//  Sunk Cost
+//
+//  This module provides a local stand-in for the CUGL lobby, so that matches
+//  can be hosted on a LAN or in CI with no internet.
+//
+//  The relay speaks the room-code handshake of the lobby over the protocol
+//  in SCRelayProtocol.hpp and then forwards every packet of a room itself,
+//  so there is no WebRTC and no ICE server. It is a single thread around
+//  poll(), with one TCP connection per peer and a buffer per direction, and
+//  holds hundreds of rooms on one core. A peer that stops reading loses the
+//  packets for it once RELAY_BACKLOG bytes are waiting; the handshake and
+//  room events are never dropped.
+//
+//  To use it, set "enabled" in the "relay" object of json/server.json, and
+//  point "address" and "port" at the machine running the relay.
+//
+//  Build and run it with
+//
+//      g++ -std=c++17 -O2 -pthread -o sc_relay tools/relay/sc_relay.cpp
+//      ./sc_relay --port 8090
+//
+//  The load test runs the relay on a thread and fills it with rooms from
+//  one client loop, then reports the room setup latency and the relay
+//  throughput, latency and CPU time:
+//
+//      ./sc_relay --load-test 200 --players 4 --seconds 10
+//
+//  The relay needs POSIX sockets, so it builds on Linux and macOS only.
+//
+
+#include "../../source/Networking/SCRelayProtocol.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <random>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+/** The bytes waiting for a peer before packets for it are dropped */
+#define RELAY_BACKLOG (1 << 20)
+/** The bytes read from a socket at a time */
+#define RELAY_READ_SIZE 16384
+/** The milliseconds between packets of a load test peer, as in the game */
+#define LOAD_INTERVAL 16
+/** The bytes in a load test packet, about a position message */
+#define LOAD_PACKET 24
+/** The longest the load test waits for its rooms, in seconds */
+#define LOAD_SETUP_LIMIT 10
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/** Returns a steady time in microseconds */
+static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/** Makes a socket non-blocking and turns off Nagle */
+static void configure(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+}
+
+/** Returns true if the last socket call failed only because it would block */
+static bool wouldBlock() {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+/**
+ * Sends what a socket takes of a buffer.
+ *
+ * @param fd    The socket
+ * @param out   The buffer, emptied once it is all sent
+ * @param sent  The bytes of the buffer already sent
+ *
+ * @return false if the connection is lost
+ */
+static bool flush(int fd, std::vector<std::byte>& out, size_t& sent) {
+    while (sent < out.size()) {
+        ssize_t count = ::send(fd, out.data() + sent, out.size() - sent,
+                               MSG_NOSIGNAL);
+        if (count < 0) {
+            return wouldBlock();
+        }
+        sent += count;
+    }
+    out.clear();
+    sent = 0;
+    return true;
+}
+
+/**
+ * Reads everything a socket has.
+ *
+ * @param fd        The socket
+ * @param decoder   The decoder for the bytes
+ *
+ * @return false if the connection is lost
+ */
+static bool drain(int fd, RelayDecoder& decoder) {
+    std::byte buffer[RELAY_READ_SIZE];
+    while (true) {
+        ssize_t count = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (count > 0) {
+            decoder.push(buffer, count);
+        } else if (count == 0 || !wouldBlock()) {
+            return false;
+        } else {
+            return !decoder.failed();
+        }
+    }
+}
+
+#pragma mark -
+#pragma mark Relay
+
+/**
+ * The relay server.
+ */
+class Relay {
+  private:
+    /** A connected peer */
+    struct Client {
+        int fd;
+        std::string uuid;
+        /** The room code, or empty until the peer is in a room */
+        std::string room;
+        RelayDecoder in;
+        std::vector<std::byte> out;
+        size_t sent = 0;
+    };
+
+    /** A room of peers */
+    struct Room {
+        /** The UUID of the host */
+        std::string host;
+        uint8_t maxPlayers;
+        uint32_t apiVersion;
+        /** The sockets of the peers, host first */
+        std::vector<int> members;
+    };
+
+    int _listener;
+    std::unordered_map<int, Client> _clients;
+    std::unordered_map<std::string, int> _uuids;
+    std::unordered_map<std::string, Room> _rooms;
+    /** The sockets lost in this step, closed at its end */
+    std::vector<int> _lost;
+    std::vector<pollfd> _polled;
+    /** Builds the outgoing frames, reused between frames */
+    RelayWriter _writer;
+    std::mt19937 _random;
+    uint64_t _connected;
+    uint64_t _relayed;
+    uint64_t _dropped;
+
+  public:
+    Relay()
+        : _listener(-1), _random(std::random_device()()), _connected(0),
+          _relayed(0), _dropped(0) {}
+
+    ~Relay() {
+        for (auto& entry : _clients) {
+            ::close(entry.first);
+        }
+        if (_listener >= 0) {
+            ::close(_listener);
+        }
+    }
+
+    /**
+     * Starts listening on every interface.
+     *
+     * @param port  The port, or 0 for any free one
+     *
+     * @return the port, or -1 if it could not listen
+     */
+    int listen(int port) {
+        _listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (_listener < 0) {
+            return -1;
+        }
+        int on = 1;
+        setsockopt(_listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        socklen_t length = sizeof(address);
+        if (::bind(_listener, reinterpret_cast<sockaddr*>(&address),
+                   length) < 0 ||
+            ::listen(_listener, SOMAXCONN) < 0 ||
+            getsockname(_listener, reinterpret_cast<sockaddr*>(&address),
+                        &length) < 0) {
+            return -1;
+        }
+        fcntl(_listener, F_SETFL, fcntl(_listener, F_GETFL, 0) | O_NONBLOCK);
+        return ntohs(address.sin_port);
+    }
+
+    /**
+     * Services every socket once.
+     *
+     * @param timeout   The longest to wait for a socket in milliseconds
+     */
+    void step(int timeout) {
+        _polled.clear();
+        _polled.push_back({_listener, POLLIN, 0});
+        for (auto& entry : _clients) {
+            short events = POLLIN;
+            if (!entry.second.out.empty()) {
+                events |= POLLOUT;
+            }
+            _polled.push_back({entry.first, events, 0});
+        }
+        if (::poll(_polled.data(), _polled.size(), timeout) <= 0) {
+            return;
+        }
+
+        for (size_t i = 1; i < _polled.size(); i++) {
+            if (_polled[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read(_clients[_polled[i].fd]);
+            }
+        }
+        if (_polled[0].revents & POLLIN) {
+            accept();
+        }
+        for (auto& entry : _clients) {
+            Client& client = entry.second;
+            if (client.fd >= 0 && !client.out.empty() &&
+                !flush(client.fd, client.out, client.sent)) {
+                lose(client);
+            }
+        }
+        for (int fd : _lost) {
+            ::close(fd);
+            _clients.erase(fd);
+        }
+        _lost.clear();
+    }
+
+    size_t getRooms() const { return _rooms.size(); }
+
+    uint64_t getRelayed() const { return _relayed; }
+
+    uint64_t getDropped() const { return _dropped; }
+
+  private:
+    /** Takes every waiting connection */
+    void accept() {
+        while (true) {
+            int fd = ::accept(_listener, nullptr, nullptr);
+            if (fd < 0) {
+                return;
+            }
+            configure(fd);
+            Client& client = _clients[fd];
+            client.fd = fd;
+            client.uuid = "relay-" + std::to_string(++_connected);
+            _uuids[client.uuid] = fd;
+        }
+    }
+
+    /** Reads and handles everything from a peer */
+    void read(Client& client) {
+        if (client.fd < 0) {
+            return;
+        }
+        bool open = drain(client.fd, client.in);
+        RelayOp op;
+        const std::byte* body;
+        size_t size;
+        while (client.fd >= 0 && client.in.next(op, body, size)) {
+            handle(client, op, body, size);
+        }
+        if (!open) {
+            lose(client);
+        }
+    }
+
+    /** Takes a peer out of its room and closes it at the end of the step */
+    void lose(Client& client) {
+        if (client.fd < 0) {
+            return;
+        }
+        leave(client);
+        _uuids.erase(client.uuid);
+        _lost.push_back(client.fd);
+        client.fd = -1;
+    }
+
+    /** Queues the frame in the writer for a peer */
+    void post(Client& client) {
+        const std::vector<std::byte>& frame = _writer.getData();
+        client.out.insert(client.out.end(), frame.begin(), frame.end());
+        _writer.reset();
+    }
+
+    /** Queues the frame in the writer for a peer, unless it is backed up */
+    void relay(int fd) {
+        Client& client = _clients[fd];
+        if (client.fd < 0) {
+            return;
+        }
+        const std::vector<std::byte>& frame = _writer.getData();
+        if (client.out.size() - client.sent > RELAY_BACKLOG) {
+            _dropped++;
+            return;
+        }
+        client.out.insert(client.out.end(), frame.begin(), frame.end());
+        _relayed++;
+    }
+
+    /** Refuses a handshake */
+    void deny(Client& client, RelayDenial reason) {
+        _writer.begin(RelayOp::Denied);
+        _writer.writeByte(static_cast<uint8_t>(reason));
+        post(client);
+    }
+
+    /** Tells a peer it is in its room */
+    void welcome(Client& client, const Room& room) {
+        _writer.begin(RelayOp::Welcome);
+        _writer.writeString(client.room);
+        _writer.writeString(client.uuid);
+        _writer.writeString(room.host);
+        _writer.writeByte(static_cast<uint8_t>(room.members.size()));
+        post(client);
+    }
+
+    /** Tells everyone else in a room its player count */
+    void announce(const Room& room, int except) {
+        for (int fd : room.members) {
+            if (fd != except) {
+                _writer.begin(RelayOp::Players);
+                _writer.writeByte(static_cast<uint8_t>(room.members.size()));
+                post(_clients[fd]);
+            }
+        }
+    }
+
+    /** Takes a peer out of its room; the room closes if it is the host */
+    void leave(Client& client) {
+        auto found = _rooms.find(client.room);
+        client.room.clear();
+        if (found == _rooms.end()) {
+            return;
+        }
+        Room& room = found->second;
+        auto& members = room.members;
+        members.erase(std::remove(members.begin(), members.end(), client.fd),
+                      members.end());
+        if (room.host != client.uuid) {
+            announce(room, -1);
+            return;
+        }
+        for (int fd : members) {
+            Client& peer = _clients[fd];
+            peer.room.clear();
+            _writer.begin(RelayOp::Closed);
+            post(peer);
+        }
+        _rooms.erase(found);
+    }
+
+    /** Handles one frame from a peer */
+    void handle(Client& client, RelayOp op, const std::byte* body,
+                size_t size) {
+        RelayReader reader(body, size);
+        switch (op) {
+        case RelayOp::Host:
+            if (client.room.empty()) {
+                host(client, reader);
+            }
+            break;
+        case RelayOp::Join:
+            if (client.room.empty()) {
+                join(client, reader);
+            }
+            break;
+        case RelayOp::Broadcast:
+        case RelayOp::ToHost:
+        case RelayOp::ToPeer:
+            if (!client.room.empty()) {
+                forward(client, op, reader);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    /** Opens a room with a free code */
+    void host(Client& client, RelayReader& reader) {
+        uint8_t protocol = reader.readByte();
+        uint32_t api = reader.readUint32();
+        uint8_t players = reader.readByte();
+        if (reader.failed() || protocol != RELAY_PROTOCOL_VERSION) {
+            deny(client, RelayDenial::Mismatched);
+            return;
+        }
+        std::string code;
+        for (int attempt = 0; attempt < 64 && code.empty(); attempt++) {
+            char text[8];
+            std::snprintf(text, sizeof(text), "%04X",
+                          static_cast<unsigned>(_random() & 0xffff));
+            if (_rooms.count(text) == 0) {
+                code = text;
+            }
+        }
+        if (code.empty()) {
+            deny(client, RelayDenial::NoCodes);
+            return;
+        }
+        Room& room = _rooms[code];
+        room.host = client.uuid;
+        room.maxPlayers = std::max<uint8_t>(players, 1);
+        room.apiVersion = api;
+        room.members.push_back(client.fd);
+        client.room = code;
+        welcome(client, room);
+    }
+
+    /** Adds a peer to the room with its code */
+    void join(Client& client, RelayReader& reader) {
+        uint8_t protocol = reader.readByte();
+        uint32_t api = reader.readUint32();
+        std::string code = reader.readString();
+        // The game writes codes in either case, so compare them upper case
+        std::transform(code.begin(), code.end(), code.begin(), ::toupper);
+        auto found = _rooms.find(code);
+        if (reader.failed() || found == _rooms.end()) {
+            deny(client, RelayDenial::NoRoom);
+            return;
+        }
+        Room& room = found->second;
+        if (protocol != RELAY_PROTOCOL_VERSION || api != room.apiVersion) {
+            deny(client, RelayDenial::Mismatched);
+            return;
+        } else if (room.members.size() >= room.maxPlayers) {
+            deny(client, RelayDenial::Full);
+            return;
+        }
+        room.members.push_back(client.fd);
+        client.room = code;
+        welcome(client, room);
+        announce(room, client.fd);
+    }
+
+    /** Forwards a packet to its peers in the room */
+    void forward(Client& client, RelayOp op, RelayReader& reader) {
+        Room& room = _rooms[client.room];
+        int dest = -1;
+        if (op == RelayOp::ToHost) {
+            dest = room.members.front();
+        } else if (op == RelayOp::ToPeer) {
+            auto found = _uuids.find(reader.readString());
+            if (found == _uuids.end() ||
+                _clients[found->second].room != client.room) {
+                return;
+            }
+            dest = found->second;
+        }
+        if (reader.failed() || dest == client.fd) {
+            return;
+        }
+
+        _writer.begin(RelayOp::Data);
+        _writer.writeString(client.uuid);
+        _writer.writeBytes(reader.getRest(), reader.getRemaining());
+        if (dest >= 0) {
+            relay(dest);
+        } else {
+            for (int fd : room.members) {
+                if (fd != client.fd) {
+                    relay(fd);
+                }
+            }
+        }
+        _writer.reset();
+    }
+};
+
+#pragma mark -
+#pragma mark Load Test
+
+/**
+ * A load test that fills a relay with rooms and streams packets through it.
+ */
+class LoadTest {
+  private:
+    /** One peer of the test */
+    struct Peer {
+        int fd;
+        int room;
+        bool host;
+        bool welcomed = false;
+        RelayDecoder in;
+        std::vector<std::byte> out;
+        size_t sent = 0;
+    };
+
+    /** One room of the test */
+    struct Room {
+        std::string code;
+        /** The time the host connected */
+        int64_t started;
+        int joined = 0;
+        bool ready = false;
+    };
+
+    int _port;
+    int _players;
+    std::vector<Peer> _peers;
+    std::vector<Room> _rooms;
+    std::vector<pollfd> _polled;
+    RelayWriter _writer;
+    /** The room setup times and relay latencies in microseconds */
+    std::vector<int64_t> _setups;
+    std::vector<int64_t> _latencies;
+    int _ready;
+    int _failed;
+    uint64_t _received;
+    uint64_t _bytes;
+    /** Whether packets are timed */
+    bool _measuring;
+
+  public:
+    LoadTest(int port, int rooms, int players)
+        : _port(port), _players(players), _rooms(rooms), _ready(0),
+          _failed(0), _received(0), _bytes(0), _measuring(false) {
+        _peers.reserve(rooms * players);
+    }
+
+    ~LoadTest() {
+        for (Peer& peer : _peers) {
+            if (peer.fd >= 0) {
+                ::close(peer.fd);
+            }
+        }
+    }
+
+    /**
+     * Opens every room and waits for all the players.
+     *
+     * @return the number of rooms that are full
+     */
+    int setup() {
+        for (size_t room = 0; room < _rooms.size(); room++) {
+            _rooms[room].started = now();
+            Peer& peer = connect(room, true);
+            _writer.begin(RelayOp::Host);
+            _writer.writeByte(RELAY_PROTOCOL_VERSION);
+            _writer.writeUint32(0);
+            _writer.writeByte(static_cast<uint8_t>(_players));
+            post(peer);
+        }
+        int64_t limit = now() + LOAD_SETUP_LIMIT * 1000000LL;
+        while (_ready + _failed < static_cast<int>(_rooms.size()) &&
+               now() < limit) {
+            step(10);
+        }
+        return _ready;
+    }
+
+    /**
+     * Streams packets through every room.
+     *
+     * Every player sends a packet every LOAD_INTERVAL, the host to all the
+     * others and the others to the host, as in a match.
+     *
+     * @param seconds   The length of the test
+     */
+    void stream(int seconds) {
+        _measuring = true;
+        int64_t end = now() + seconds * 1000000LL;
+        int64_t next = now();
+        while (now() < end) {
+            if (now() >= next) {
+                next += LOAD_INTERVAL * 1000;
+                for (Peer& peer : _peers) {
+                    if (peer.fd >= 0 && peer.welcomed) {
+                        send(peer);
+                    }
+                }
+            }
+            int wait = static_cast<int>((next - now()) / 1000);
+            step(std::max(wait, 0));
+        }
+        _measuring = false;
+    }
+
+    /**
+     * Prints the results.
+     *
+     * @param seconds   The length of the stream
+     * @param cpu       The CPU seconds of the relay while streaming, or < 0
+     */
+    void report(int seconds, double cpu) {
+        std::printf("rooms: %d of %zu set up, %d players each\n", _ready,
+                    _rooms.size(), _players);
+        std::printf("room setup: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+                    percentile(_setups, 0.5) / 1000.0,
+                    percentile(_setups, 0.99) / 1000.0,
+                    percentile(_setups, 1) / 1000.0);
+        std::printf("relay: %.0f msgs/s, %.2f MB/s of payload\n",
+                    static_cast<double>(_received) / seconds,
+                    static_cast<double>(_bytes) / seconds / 1e6);
+        std::printf("relay latency: p50 %.3f ms, p99 %.3f ms\n",
+                    percentile(_latencies, 0.5) / 1000.0,
+                    percentile(_latencies, 0.99) / 1000.0);
+        if (cpu >= 0) {
+            std::printf("relay cpu: %.1f%% of one core\n",
+                        100 * cpu / seconds);
+        }
+    }
+
+  private:
+    /** Returns a percentile of some samples, sorting them */
+    static double percentile(std::vector<int64_t>& samples, double share) {
+        if (samples.empty()) {
+            return 0;
+        }
+        std::sort(samples.begin(), samples.end());
+        size_t index = static_cast<size_t>(share * (samples.size() - 1));
+        return static_cast<double>(samples[index]);
+    }
+
+    /** Connects a new peer of a room */
+    Peer& connect(int room, bool host) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(_port));
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                                 sizeof(address)) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        if (fd >= 0) {
+            configure(fd);
+        } else {
+            _failed++;
+        }
+        _peers.emplace_back();
+        Peer& peer = _peers.back();
+        peer.fd = fd;
+        peer.room = room;
+        peer.host = host;
+        return peer;
+    }
+
+    /** Queues the frame in the writer for a peer */
+    void post(Peer& peer) {
+        if (peer.fd < 0) {
+            _writer.reset();
+            return;
+        }
+        const std::vector<std::byte>& frame = _writer.getData();
+        peer.out.insert(peer.out.end(), frame.begin(), frame.end());
+        _writer.reset();
+        if (!flush(peer.fd, peer.out, peer.sent)) {
+            ::close(peer.fd);
+            peer.fd = -1;
+        }
+    }
+
+    /** Sends a timed packet from a peer */
+    void send(Peer& peer) {
+        std::byte packet[LOAD_PACKET] = {};
+        int64_t stamp = now();
+        std::memcpy(packet, &stamp, sizeof(stamp));
+        _writer.begin(peer.host ? RelayOp::Broadcast : RelayOp::ToHost);
+        _writer.writeBytes(packet, sizeof(packet));
+        post(peer);
+    }
+
+    /** Services every peer once */
+    void step(int timeout) {
+        _polled.clear();
+        for (Peer& peer : _peers) {
+            short events = POLLIN;
+            if (!peer.out.empty()) {
+                events |= POLLOUT;
+            }
+            _polled.push_back({peer.fd, events, 0});
+        }
+        if (::poll(_polled.data(), _polled.size(), timeout) <= 0) {
+            return;
+        }
+        // Joining adds peers, so walk the ones polled by index
+        size_t count = _polled.size();
+        for (size_t i = 0; i < count; i++) {
+            if (_peers[i].fd < 0) {
+                continue;
+            }
+            if ((_polled[i].revents & POLLOUT) &&
+                !flush(_peers[i].fd, _peers[i].out, _peers[i].sent)) {
+                ::close(_peers[i].fd);
+                _peers[i].fd = -1;
+                continue;
+            }
+            if (_polled[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read(i);
+            }
+        }
+    }
+
+    /** Reads and handles everything for a peer */
+    void read(size_t index) {
+        bool open = drain(_peers[index].fd, _peers[index].in);
+        RelayOp op;
+        const std::byte* body;
+        size_t size;
+        while (_peers[index].in.next(op, body, size)) {
+            handle(index, op, body, size);
+        }
+        if (!open) {
+            ::close(_peers[index].fd);
+            _peers[index].fd = -1;
+        }
+    }
+
+    /** Handles one frame for a peer */
+    void handle(size_t index, RelayOp op, const std::byte* body, size_t size) {
+        RelayReader reader(body, size);
+        int room = _peers[index].room;
+        if (op == RelayOp::Denied) {
+            _failed++;
+        } else if (op == RelayOp::Welcome) {
+            _peers[index].welcomed = true;
+            if (_peers[index].host) {
+                _rooms[room].code = reader.readString();
+                for (int player = 1; player < _players; player++) {
+                    Peer& peer = connect(room, false);
+                    _writer.begin(RelayOp::Join);
+                    _writer.writeByte(RELAY_PROTOCOL_VERSION);
+                    _writer.writeUint32(0);
+                    _writer.writeString(_rooms[room].code);
+                    post(peer);
+                }
+            } else {
+                _rooms[room].joined++;
+            }
+            if (_rooms[room].joined == _players - 1 && !_rooms[room].ready) {
+                _rooms[room].ready = true;
+                _ready++;
+                _setups.push_back(now() - _rooms[room].started);
+            }
+        } else if (op == RelayOp::Data && _measuring) {
+            reader.readString();
+            int64_t stamp;
+            if (reader.getRemaining() >= sizeof(stamp)) {
+                std::memcpy(&stamp, reader.getRest(), sizeof(stamp));
+                _latencies.push_back(now() - stamp);
+                _received++;
+                _bytes += reader.getRemaining();
+            }
+        }
+    }
+};
+
+#pragma mark -
+#pragma mark Main
+
+/** Whether the relay keeps running */
+static std::atomic<bool> running(true);
+
+static void stop(int) { running = false; }
+
+/**
+ * Runs a load test against a relay on a thread of this process.
+ *
+ * @return the exit status
+ */
+static int loadTest(int rooms, int players, int seconds) {
+    // Each player takes a socket here and one in the relay
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    Relay relay;
+    int port = relay.listen(0);
+    if (port < 0) {
+        std::perror("listen");
+        return 1;
+    }
+    std::thread server([&relay] {
+        while (running) {
+            relay.step(10);
+        }
+    });
+
+    LoadTest test(port, rooms, players);
+    test.setup();
+
+    double cpu = -1;
+#ifdef __linux__
+    clockid_t clock;
+    timespec before;
+    timespec after;
+    bool timed = pthread_getcpuclockid(server.native_handle(), &clock) == 0 &&
+                 clock_gettime(clock, &before) == 0;
+#endif
+    test.stream(seconds);
+#ifdef __linux__
+    if (timed && clock_gettime(clock, &after) == 0) {
+        cpu = (after.tv_sec - before.tv_sec) +
+              (after.tv_nsec - before.tv_nsec) / 1e9;
+    }
+#endif
+
+    running = false;
+    server.join();
+    test.report(seconds, cpu);
+    std::printf("relay: %llu packets relayed, %llu dropped\n",
+                static_cast<unsigned long long>(relay.getRelayed()),
+                static_cast<unsigned long long>(relay.getDropped()));
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int port = RELAY_DEFAULT_PORT;
+    int rooms = 0;
+    int players = 4;
+    int seconds = 10;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        int value = std::atoi(argv[i + 1]);
+        if (option == "--port") {
+            port = value;
+        } else if (option == "--load-test") {
+            rooms = value;
+        } else if (option == "--players") {
+            players = std::max(value, 1);
+        } else if (option == "--seconds") {
+            seconds = std::max(value, 1);
+        } else {
+            std::fprintf(stderr,
+                         "usage: %s [--port PORT] [--load-test ROOMS "
+                         "[--players N] [--seconds S]]\n",
+                         argv[0]);
+            return 1;
+        }
+    }
+    if (rooms > 0) {
+        return loadTest(rooms, players, seconds);
+    }
+
+    Relay relay;
+    if (relay.listen(port) < 0) {
+        std::perror("listen");
+        return 1;
+    }
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::printf("relay: listening on port %d\n", port);
+    while (running) {
+        relay.step(1000);
+    }
+    return 0;
+}